@@ -0,0 +1,111 @@
+#ifndef APPROACH_PREDICTOR_HPP_
+#define APPROACH_PREDICTOR_HPP_
+#include <cstdint>
+#include <cmath>
+
+namespace approach
+{
+    //Tracks the nearest target with an alpha-beta filter and predicts when it
+    //crosses 'threshold' (the sensor's trigger distance).
+    //Fires once per approach when the predicted crossing is within 'lead'.
+    //The confidence gate requires:
+    // - a track at least 'min_updates' frames old without gaps over 'max_gap'
+    // - smoothed innovation (|measured - predicted|) below 'max_residual'
+    // - closing in at 'min_speed' or faster, with the sensor's own
+    //   radial speed agreeing on the direction
+    //Distances in m, speeds in m/s, times in ms.
+    class predictor_t
+    {
+    public:
+        struct cfg_t
+        {
+            float alpha = 0.5f;
+            float beta = 0.2f;
+            //how much the measured radial speed pulls the velocity estimate
+            float speed_weight = 0.3f;
+            int64_t lead = 0;           //0 - disabled
+            float threshold = 0;
+            uint8_t min_updates = 4;
+            float max_residual = 0.3f;
+            float min_speed = 0.2f;
+            int64_t max_gap = 500;
+        };
+
+        void SetConfig(cfg_t const& c) { m_Cfg = c; }
+        cfg_t const& GetConfig() const { return m_Cfg; }
+
+        //a frame with a target; true if the approach trigger fires now
+        bool Update(float range, float speed, int64_t now)
+        {
+            if (!m_Tracking || (now - m_LastAt) > m_Cfg.max_gap || now <= m_LastAt)
+            {
+                Start(range, speed, now);
+                return false;
+            }
+            float dt = float(now - m_LastAt) / 1000.f;
+            m_LastAt = now;
+
+            float predicted = m_X + m_V * dt;
+            float r = range - predicted;
+            m_X = predicted + m_Cfg.alpha * r;
+            m_V += m_Cfg.beta / dt * r;
+            m_V += m_Cfg.speed_weight * (speed - m_V);
+            m_Residual = 0.8f * m_Residual + 0.2f * std::fabs(r);
+            if (m_Updates < 255)
+                ++m_Updates;
+
+            //moving away or already inside: the next approach may fire again
+            if (m_V >= 0 || m_X <= m_Cfg.threshold)
+            {
+                if (m_V >= 0)
+                    m_Fired = false;
+                return false;
+            }
+            if (m_Fired || !Confident(speed))
+                return false;
+            float tta = (m_X - m_Cfg.threshold) / -m_V;
+            if (tta * 1000.f > (float)m_Cfg.lead)
+                return false;
+            m_Fired = true;
+            return true;
+        }
+
+        //a frame without targets
+        void Lost() { m_Tracking = false; }
+
+        float Distance() const { return m_X; }
+        float Velocity() const { return m_V; }
+        bool Tracking() const { return m_Tracking; }
+    private:
+        void Start(float range, float speed, int64_t now)
+        {
+            m_Tracking = true;
+            m_Fired = false;
+            m_X = range;
+            m_V = speed;
+            m_Residual = 0;
+            m_Updates = 1;
+            m_LastAt = now;
+        }
+
+        bool Confident(float measuredSpeed) const
+        {
+            return m_Cfg.lead > 0
+                && m_Updates >= m_Cfg.min_updates
+                && m_Residual <= m_Cfg.max_residual
+                && m_V <= -m_Cfg.min_speed
+                && measuredSpeed < 0;
+        }
+
+        cfg_t m_Cfg;
+        bool m_Tracking = false;
+        bool m_Fired = false;
+        uint8_t m_Updates = 0;
+        float m_X = 0;
+        float m_V = 0;
+        float m_Residual = 0;
+        int64_t m_LastAt = 0;
+    };
+}
+
+#endif
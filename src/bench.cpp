@@ -0,0 +1,431 @@
+#include <zephyr/kernel.h>
+#if defined(__ZEPHYR__)
+#include <zephyr/settings/settings.h>
+#endif
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+#include "bench.hpp"
+#include "lib/lib_reply_grammar.h"
+#include "lib/lib_dfr_c4001_frames.h"
+#if UART_TRANSPORT == UART_TRANSPORT_MEMORY
+#include "lib/lib_uart_primitives.h"
+#include "lib/lib_dfr_c4001.h"
+#endif
+
+namespace bench
+{
+    using namespace grammar;
+
+    constexpr const char kSettingsRoot[] = "bench";
+    constexpr const char kSettingsBaseline[] = "base";
+    //best of: the first run also warms up the caches
+    constexpr int kRuns = 8;
+#if defined(__ZEPHYR__)
+    constexpr int kReps = 1;
+#else
+    //a run repeats the case: single passes are too short for a preemptive OS's clock
+    constexpr int kReps = 200;
+#endif
+
+    template<size_t N>
+    constexpr std::string_view sv(const char (&s)[N]) { return {s, N - 1}; }
+
+    static alloc_count_t g_alloc_count = nullptr;
+
+    /**********************************************************************/
+    /* Inputs                                                             */
+    /**********************************************************************/
+    //a frame and a presence report the sensor may interleave with replies
+    #define BENCH_FRAME "$DFDMD,1,1,2.35,-0.12,1234, , *\r\n"
+    #define BENCH_PRESENCE "$DFHPD,1, , , *\r\n"
+
+    constexpr const char kRangeClean[] = "getRange\r\nResponse 0.6 25.0\r\nDone\r\n";
+    constexpr const char kRangeNoisy[] = BENCH_FRAME BENCH_PRESENCE "\x7f\x00\xff junk\r\n"
+	"getRange\r\n" BENCH_PRESENCE "Response 0.6 25.0\r\nDone\r\n";
+    //partial matches everywhere: every matcher has to fall back
+    constexpr const char kRangeAdversarial[] = "getRangetRanggetRange\r\n"
+	"RRespRespoResponsResponse 0.6 25.0\r\nDoDonDErrorDone\r\n";
+
+    constexpr const char kVersionClean[] = "getSWV\r\nSoftwareVersion:V4.2.10 20240311\r\nDone\r\n";
+    constexpr const char kVersionAdversarial[] = "getSWV\r\nSoftSoftwareSoftwareVersionSoftwareVersion:V4.2.10 20240311\r\n"
+	"DoneDone\rDone\r\nDone\r\n";
+
+    //what read_float_from_str_t used to do: one number up to the line end
+    constexpr const char kNumClean[] = "12.5\r\n";
+    constexpr const char kNumAdversarial[] = "-0000012.5\r\n";
+
+    constexpr const char kFramesClean[] = BENCH_FRAME BENCH_FRAME BENCH_FRAME BENCH_FRAME;
+    //replies, a frame cut short and stray '$' in between: 3 good frames
+    constexpr const char kFramesNoisy[] = BENCH_FRAME "Response 1\r\nDone\r\n$DFDMD,1,1,2.3\r\n"
+	BENCH_PRESENCE "$$$$\r\n" BENCH_FRAME;
+
+    //the final line of a command, as find_any_str and match_any_bytes_term look for it
+    constexpr const char kDoneClean[] = "Done\r\n";
+    constexpr const char kDoneNoisy[] = BENCH_FRAME BENCH_PRESENCE "sensorStop\r\nDone\r\n";
+    constexpr const char kDoneAdversarial[] = "DoDonDErroDoneErrorDone\r\n";
+
+    constexpr const char kLineClean[] = "SoftwareVersion:V4.2.10 20240311\r\n";
+    constexpr const char kLineNoisy[] = "$DFDMD,1,1,2.35,-0.12,1234, ,\x7f\x00\xff junk, , , , , , *\r\n";
+
+    #undef BENCH_FRAME
+    #undef BENCH_PRESENCE
+
+    /**********************************************************************/
+    /* Cases                                                              */
+    /**********************************************************************/
+    //what a case adds to its result besides the time
+    struct counts_t
+    {
+	uint32_t commands = 0;
+	uint32_t isr = 0;
+    };
+
+    struct reply_t
+    {
+	float from = 0;
+	float to = 0;
+	char version[32]{};
+    };
+
+    constexpr auto kRangeReply = find<"getRange"> >> find<"Response ">
+	>> num<&reply_t::from, 6, 250, 10> >> ws
+	>> num<&reply_t::to, 6, 250, 10> >> crlf >> done_or_error;
+    constexpr auto kVersionReply = find<"SoftwareVersion:"> >> text<&reply_t::version> >> crlf >> done_or_error;
+    constexpr auto kNum = num<&reply_t::from, -1000, 1000, 10> >> crlf;
+
+    template<class G>
+    static bool parse(std::string_view in, reply_t &r)
+    {
+	auto p = G::parser();
+	for(char c : in)
+	{
+	    switch(p.Feed((uint8_t)c, r))
+	    {
+		case step_t::More: break;
+		case step_t::Done: return true;
+		default: return false;
+	    }
+	}
+	return false;
+    }
+
+    static bool range_reply(std::string_view in, counts_t&)
+    {
+	reply_t r;
+	return parse<decltype(kRangeReply)>(in, r) && r.from == 0.6f && r.to == 25.f;
+    }
+
+    static bool version_reply(std::string_view in, counts_t&)
+    {
+	reply_t r;
+	return parse<decltype(kVersionReply)>(in, r) && !strcmp(r.version, "V4.2.10 20240311");
+    }
+
+    static bool number(std::string_view in, counts_t&)
+    {
+	reply_t r;
+	return parse<decltype(kNum)>(in, r) && (r.from == 12.5f || r.from == -12.5f);
+    }
+
+    template<size_t Expected>
+    static bool frames(std::string_view in, counts_t&)
+    {
+	dfr::frames::Decoder d;
+	size_t n = 0;
+	for(char c : in)
+	    n += d.Feed((uint8_t)c) != dfr::frames::kind_t::None;
+	return n == Expected;
+    }
+
+#if UART_TRANSPORT == UART_TRANSPORT_MEMORY
+    //RX handed over the way the async transport does: a DMA buffer at a time
+    constexpr size_t kChunk = uart::transport::Async::kBufSize;
+
+    static void feed(uart::Channel &c, std::string_view in)
+    {
+	for(size_t i = 0; i < in.size(); i += kChunk)
+	    c.GetTransport().Feed((const uint8_t *)in.data() + i, std::min(kChunk, in.size() - i));
+    }
+
+    //A channel reading continuously, fed 'in' before 'f' runs on it.
+    //The same one every run: construction isn't what is measured.
+    template<class F>
+    static bool on_channel(std::string_view in, counts_t &n, F &&f)
+    {
+	static uart::Channel c(nullptr);
+	static uint8_t ring[640];
+	static bool configured = false;
+	if (!configured)
+	{
+	    //the input is there before any read: never waited for
+	    c.SetDefaultWait(10);
+	    configured = (bool)c.Configure();
+	}
+	if (!configured || !c.StartContinuousReading(ring, sizeof(ring)))
+	    return false;
+	const uint32_t events = c.GetStats().m_Events;
+	feed(c, in);
+	bool ok = f(c);
+	n.isr = c.GetStats().m_Events - events;
+	c.StopContinuousReading();
+	return ok;
+    }
+
+    //512 bytes of frames read back 'N' bytes at a time
+    constexpr const char kStream[] =
+	"$DFDMD,1,1,2.35,-0.12,123, , *\r\n$DFDMD,1,1,2.35,-0.12,123, , *\r\n"
+	"$DFDMD,1,1,2.35,-0.12,123, , *\r\n$DFDMD,1,1,2.35,-0.12,123, , *\r\n"
+	"$DFDMD,1,1,2.35,-0.12,123, , *\r\n$DFDMD,1,1,2.35,-0.12,123, , *\r\n"
+	"$DFDMD,1,1,2.35,-0.12,123, , *\r\n$DFDMD,1,1,2.35,-0.12,123, , *\r\n"
+	"$DFDMD,1,1,2.35,-0.12,123, , *\r\n$DFDMD,1,1,2.35,-0.12,123, , *\r\n"
+	"$DFDMD,1,1,2.35,-0.12,123, , *\r\n$DFDMD,1,1,2.35,-0.12,123, , *\r\n"
+	"$DFDMD,1,1,2.35,-0.12,123, , *\r\n$DFDMD,1,1,2.35,-0.12,123, , *\r\n"
+	"$DFDMD,1,1,2.35,-0.12,123, , *\r\n$DFDMD,1,1,2.35,-0.12,123, , *\r\n";
+    static_assert(sizeof(kStream) - 1 == 512);
+
+    template<size_t N>
+    static bool channel_read(std::string_view in, counts_t &n)
+    {
+	return on_channel(in, n, [&](uart::Channel &c){
+	    uint8_t buf[N];
+	    for(size_t left = in.size(); left; left -= N)
+		if (auto r = c.Read(buf, N); !r || r->v != N)
+		    return false;
+	    return true;
+	});
+    }
+
+    static bool match_bytes(std::string_view in, counts_t &n)
+    {
+	return on_channel(in, n, [](uart::Channel &c){
+	    return (bool)uart::primitives::match_bytes(c, "SoftwareVersion:V4.2.10 20240311\r\n");
+	});
+    }
+
+    static bool read_until_into(std::string_view in, counts_t &n)
+    {
+	return on_channel(in, n, [](uart::Channel &c){
+	    uint8_t buf[80];
+	    return (bool)uart::primitives::read_until_into(c, '\r', buf, sizeof(buf), true, {});
+	});
+    }
+
+    static bool match_any_bytes_term(std::string_view in, counts_t &n)
+    {
+	return on_channel(in, n, [](uart::Channel &c){
+	    static constexpr uint8_t kDone[] = "Done\r\n";
+	    static constexpr uint8_t kError[] = "Error\r\n";
+	    auto r = uart::primitives::match_any_bytes_term(c, 0, std::span<const uint8_t>(kDone), std::span<const uint8_t>(kError));
+	    return r && r->v == 0;
+	});
+    }
+
+    static bool find_any_str(std::string_view in, counts_t &n)
+    {
+	return on_channel(in, n, [](uart::Channel &c){
+	    auto r = uart::primitives::find_any_str({}, c, "Done\r\n", "Error\r\n");
+	    return r && r->v == 0;
+	});
+    }
+
+    //A whole query as the driver runs it (sensorStop, getRange, sensorStart)
+    //against a sensor that answers getRange with 'in' and the rest with Done
+    class Responder
+    {
+    public:
+	Responder(dfr::C4001 &c):m_C(c) { c.GetTransport().SetOnTx(on_tx, this); }
+
+	std::string_view m_Reply;
+	uint32_t m_Commands = 0;
+    private:
+	static void on_tx(void *ctx, const uint8_t *p, size_t n)
+	{
+	    auto &r = *(Responder *)ctx;
+	    for(size_t i = 0; i < n; ++i)
+	    {
+		if (r.m_Len < sizeof(r.m_Line))
+		    r.m_Line[r.m_Len++] = (char)p[i];
+		if (p[i] != '\n')
+		    continue;
+		std::string_view l(r.m_Line, r.m_Len);
+		r.m_Len = 0;
+		++r.m_Commands;
+		if (l.starts_with("getRange"))
+		    feed(r.m_C, r.m_Reply);
+		else
+		{
+		    feed(r.m_C, l);
+		    feed(r.m_C, "Done\r\n");
+		}
+	    }
+	}
+
+	dfr::C4001 &m_C;
+	char m_Line[48];
+	size_t m_Len = 0;
+    };
+
+    static bool range_query(std::string_view in, counts_t &n)
+    {
+	static dfr::C4001 c(nullptr);
+	static Responder sensor(c);
+	static bool configured = false;
+	if (!configured)
+	{
+	    c.SetDefaultWait(dfr::C4001::kDefaultWait);
+	    configured = (bool)c.Configure();
+	}
+	sensor.m_Reply = in;
+	sensor.m_Commands = 0;
+	const uint32_t events = c.GetStats().m_Events;
+	bool ok;
+	{
+	    auto cfg = c.GetConfigurator();
+	    ok = cfg.UpdateRange() && cfg.End();
+	}
+	n.commands = sensor.m_Commands;
+	n.isr = c.GetStats().m_Events - events;
+	return ok && c.GetRangeFrom() == 0.6f && c.GetRangeTo() == 25.f;
+    }
+#endif
+
+    struct case_t
+    {
+	const char *name;
+	const char *input;
+	std::string_view data;
+	bool (*run)(std::string_view, counts_t&);
+    };
+
+    constexpr case_t kCases[] = {
+	{"range_reply",          "clean",       sv(kRangeClean),         range_reply},
+	{"range_reply",          "noisy",       sv(kRangeNoisy),         range_reply},
+	{"range_reply",          "adversarial", sv(kRangeAdversarial),   range_reply},
+	{"version_reply",        "clean",       sv(kVersionClean),       version_reply},
+	{"version_reply",        "adversarial", sv(kVersionAdversarial), version_reply},
+	{"num",                  "clean",       sv(kNumClean),           number},
+	{"num",                  "adversarial", sv(kNumAdversarial),     number},
+	{"frames",               "clean",       sv(kFramesClean),        frames<4>},
+	{"frames",               "noisy",       sv(kFramesNoisy),        frames<3>},
+#if UART_TRANSPORT == UART_TRANSPORT_MEMORY
+	{"channel_read_1",       "clean",       sv(kStream),             channel_read<1>},
+	{"channel_read_8",       "clean",       sv(kStream),             channel_read<8>},
+	{"channel_read_64",      "clean",       sv(kStream),             channel_read<64>},
+	{"match_bytes",          "clean",       sv(kLineClean),          match_bytes},
+	{"read_until_into",      "clean",       sv(kLineClean),          read_until_into},
+	{"read_until_into",      "noisy",       sv(kLineNoisy),          read_until_into},
+	{"match_any_bytes_term", "clean",       sv(kDoneClean),          match_any_bytes_term},
+	{"find_any_str",         "clean",       sv(kDoneClean),          find_any_str},
+	{"find_any_str",         "noisy",       sv(kDoneNoisy),          find_any_str},
+	{"find_any_str",         "adversarial", sv(kDoneAdversarial),    find_any_str},
+	{"range_query",          "clean",       sv(kRangeClean),         range_query},
+	{"range_query",          "noisy",       sv(kRangeNoisy),         range_query},
+	{"range_query",          "adversarial", sv(kRangeAdversarial),   range_query},
+#endif
+    };
+    constexpr size_t kCaseCount = std::size(kCases);
+
+    static uint32_t g_baseline[kCaseCount];
+    static uint32_t g_last[kCaseCount];
+
+    /**********************************************************************/
+    /* Run                                                                */
+    /**********************************************************************/
+    size_t run(on_result_t on_result, void *ctx)
+    {
+	size_t bad = 0;
+	for(size_t i = 0; i < kCaseCount; ++i)
+	{
+	    auto const& c = kCases[i];
+	    bool ok = true;
+	    uint32_t best = UINT32_MAX;
+	    uint32_t allocs = 0;
+	    counts_t n;
+	    for(int k = 0; k < kRuns; ++k)
+	    {
+		const uint32_t a0 = g_alloc_count ? g_alloc_count() : 0;
+		uint32_t t0 = k_cycle_get_32();
+		for(int rep = 0; rep < kReps; ++rep)
+		    ok = c.run(c.data, n) && ok;
+		best = std::min(best, (k_cycle_get_32() - t0) / kReps);
+		if (g_alloc_count)
+		    allocs = std::max(allocs, (g_alloc_count() - a0) / kReps);
+	    }
+	    g_last[i] = best;
+	    result_t r{
+		.name = c.name,
+		.input = c.input,
+		.bytes = (uint32_t)c.data.size(),
+		.cycles = best,
+		.ns = (uint32_t)k_cyc_to_ns_floor64(best),
+		.commands = n.commands,
+		.allocs = g_alloc_count ? allocs : kNotCounted,
+		.isr = n.isr,
+		.baseline = g_baseline[i],
+		.ok = ok,
+		.regressed = g_baseline[i] && uint64_t(best) * 100 > uint64_t(g_baseline[i]) * (100 + kRegressionPct),
+	    };
+	    bad += !r.ok || r.regressed;
+	    if (on_result)
+		on_result(ctx, r);
+	}
+	return bad;
+    }
+
+    void set_alloc_counter(alloc_count_t f)
+    {
+	g_alloc_count = f;
+    }
+
+    size_t to_json(result_t const& r, char *buf, size_t len)
+    {
+	uint32_t ns_x10 = r.bytes ? uint32_t(uint64_t(r.ns) * 10 / r.bytes) : 0;
+	char allocs[12] = "null";
+	if (r.allocs != kNotCounted)
+	    snprintf(allocs, sizeof(allocs), "%u", (unsigned)r.allocs);
+	int n = snprintf(buf, len,
+		"{\"case\":\"%s\",\"input\":\"%s\",\"bytes\":%u,\"cycles\":%u,\"ns_per_byte\":%u.%u,"
+		"\"commands\":%u,\"cycles_per_command\":%u,\"allocs\":%s,\"isr\":%u,"
+		"\"baseline\":%u,\"ok\":%s,\"regressed\":%s}",
+		r.name, r.input, (unsigned)r.bytes, (unsigned)r.cycles, (unsigned)(ns_x10 / 10), (unsigned)(ns_x10 % 10),
+		(unsigned)r.commands, (unsigned)(r.commands ? r.cycles / r.commands : 0), allocs, (unsigned)r.isr,
+		(unsigned)r.baseline, r.ok ? "true" : "false", r.regressed ? "true" : "false");
+	return n < 0 ? 0 : std::min((size_t)n, len ? len - 1 : 0);
+    }
+
+#if defined(__ZEPHYR__)
+    bool store_baseline()
+    {
+	if (std::find(std::begin(g_last), std::end(g_last), 0) != std::end(g_last))
+	    return false;//nothing ran yet
+	std::copy(std::begin(g_last), std::end(g_last), std::begin(g_baseline));
+	char key[16];
+	snprintf(key, sizeof(key), "%s/%s", kSettingsRoot, kSettingsBaseline);
+	if (int err = settings_save_one(key, g_baseline, sizeof(g_baseline)); err != 0)
+	{
+	    printk("bench: failed to save %s: %d\r\n", key, err);
+	    return false;
+	}
+	return true;
+    }
+
+    static int bench_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+    {
+	if (strcmp(name, kSettingsBaseline))
+	    return -ENOENT;
+	//a different set of cases: start over
+	if (len != sizeof(g_baseline))
+	    return 0;
+	return read_cb(cb_arg, g_baseline, sizeof(g_baseline)) < 0 ? -EIO : 0;
+    }
+#else
+    //host: the runner keeps the baselines
+    bool store_baseline() { return false; }
+#endif
+}
+
+#if defined(__ZEPHYR__)
+SETTINGS_STATIC_HANDLER_DEFINE(bench, bench::kSettingsRoot, nullptr, bench::bench_set, nullptr, nullptr);
+#endif
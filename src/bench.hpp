@@ -0,0 +1,54 @@
+#ifndef BENCH_HPP_
+#define BENCH_HPP_
+#include <cstdint>
+#include <cstddef>
+
+//Micro benchmarks of the sensor protocol code on in-memory input, each on
+//clean, noisy and adversarial byte streams:
+// - reply parsing (lib_reply_grammar.h, grammar::num alone) and frame decoding
+// - with the memory UART transport (native_sim, host: tests/host), also
+//   Channel::Read in 1/8/64 byte reads, the uart::primitives and whole
+//   C4001 query round trips against a scripted sensor
+//Built with -DC4001_BENCH=ON, and by the host tests (tests/host/bench_protocol.cpp,
+//which keeps its baselines in a file).
+namespace bench
+{
+    //slower than the stored baseline by more than this counts as a regression
+    constexpr uint32_t kRegressionPct = 15;
+    //'allocs' when nothing counts them
+    constexpr uint32_t kNotCounted = UINT32_MAX;
+
+    struct result_t
+    {
+        const char *name;
+        const char *input;      //clean, noisy or adversarial
+        uint32_t bytes;         //input size
+        uint32_t cycles;        //best of the runs for the whole input
+        uint32_t ns;
+        uint32_t commands;      //sensor commands per run, 0 - no exchange
+        uint32_t allocs;        //heap allocations per run, kNotCounted
+        uint32_t isr;           //transport RX events per run (UART_TRACE counters)
+        uint32_t baseline;      //cycles stored as the baseline, 0 - none
+        bool ok;                //parsed as expected
+        bool regressed;
+    };
+
+    using on_result_t = void (*)(void *ctx, result_t const& r);
+
+    //runs every case, calls on_result for each; returns how many regressed or failed
+    size_t run(on_result_t on_result, void *ctx);
+
+    //persists the results of the last run as the baseline (settings)
+    bool store_baseline();
+
+    //heap allocations so far, e.g. from a counting operator new; none - not reported
+    using alloc_count_t = uint32_t (*)();
+    void set_alloc_counter(alloc_count_t f);
+
+    //one line of JSON, e.g.
+    //{"case":"range_query","input":"noisy","bytes":122,"cycles":5210,"ns_per_byte":43.2,"commands":3,
+    // "cycles_per_command":1736,"allocs":0,"isr":2,"baseline":5100,"ok":true,"regressed":false}
+    size_t to_json(result_t const& r, char *buf, size_t len);
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <cstdio>
+#include <cstring>
+#include <array>
+#include "c4001_presets.hpp"
+
+namespace c4001::presets
+{
+    constexpr const char kSettingsRoot[] = "c4001";
+    constexpr const char kSettingsActive[] = "active";
+    constexpr const char kSettingsPreset[] = "p";
+
+    //presets are shared by all sensors, each one has its own active preset
+    static preset_t g_presets[kMaxPresets];
+    static std::array<uint8_t, kSensors> g_active = []{
+	std::array<uint8_t, kSensors> a;
+	a.fill(kNone);
+	return a;
+    }();
+
+    //"active" for the first sensor (as before multi-sensor support), "active<id>" for the others
+    static void active_key(char (&key)[16], uint8_t id)
+    {
+	if (!id)
+	    snprintf(key, sizeof(key), "%s/%s", kSettingsRoot, kSettingsActive);
+	else
+	    snprintf(key, sizeof(key), "%s/%s%d", kSettingsRoot, kSettingsActive, id);
+    }
+
+    static int presets_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+    {
+	if (!strncmp(name, kSettingsActive, sizeof(kSettingsActive) - 1))
+	{
+	    const char *pId = name + sizeof(kSettingsActive) - 1;
+	    uint8_t id = 0;
+	    if (*pId)
+	    {
+		if (*pId < '1' || *pId >= ('0' + kSensors) || pId[1])
+		    return -ENOENT;
+		id = *pId - '0';
+	    }
+	    if (len != sizeof(g_active[id]))
+		return -EINVAL;
+	    return read_cb(cb_arg, &g_active[id], sizeof(g_active[id])) < 0 ? -EIO : 0;
+	}
+
+	if (name[0] == kSettingsPreset[0] && name[1] >= '0' && name[1] < ('0' + kMaxPresets) && !name[2])
+	{
+	    preset_t &p = g_presets[name[1] - '0'];
+	    if (len != sizeof(p))
+		return -EINVAL;
+	    if (read_cb(cb_arg, &p, sizeof(p)) < 0)
+	    {
+		p.valid = false;
+		return -EIO;
+	    }
+	    return 0;
+	}
+	return -ENOENT;
+    }
+
+    static bool render(preset_t &p, config_t const& cfg)
+    {
+	using C = dfr::C4001;
+	p.cfg = cfg;
+	p.valid = C::FormatRange(p.lines[0], cfg.range_from, cfg.range_to)
+	    && C::FormatTrigRange(p.lines[1], cfg.range_trig)
+	    && C::FormatLatency(p.lines[2], cfg.detect_delay, cfg.clear_delay)
+	    && C::FormatSensitivity(p.lines[3], cfg.sensitivity_detect, cfg.sensitivity_hold)
+	    && C::FormatInhibit(p.lines[4], cfg.inhibit_duration);
+	return p.valid;
+    }
+
+    bool store(uint8_t k, config_t const& cfg)
+    {
+	if (k >= kMaxPresets)
+	    return false;
+	preset_t &p = g_presets[k];
+	if (!render(p, cfg))
+	    return false;
+
+	char key[16];
+	snprintf(key, sizeof(key), "%s/%s%d", kSettingsRoot, kSettingsPreset, k);
+	if (int err = settings_save_one(key, &p, sizeof(p)); err != 0)
+	{
+	    printk("c4001::presets: failed to save %s: %d\r\n", key, err);
+	    return false;
+	}
+	return true;
+    }
+
+    const preset_t* get(uint8_t k)
+    {
+	if (k >= kMaxPresets || !g_presets[k].valid)
+	    return nullptr;
+	return &g_presets[k];
+    }
+
+    uint8_t active(uint8_t id)
+    {
+	return id < kSensors ? g_active[id] : kNone;
+    }
+
+    void set_active(uint8_t id, uint8_t k)
+    {
+	if (id >= kSensors || g_active[id] == k)
+	    return;
+	g_active[id] = k;
+	char key[16];
+	active_key(key, id);
+	if (int err = settings_save_one(key, &g_active[id], sizeof(g_active[id])); err != 0)
+	    printk("c4001::presets: failed to save %s: %d\r\n", key, err);
+    }
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(c4001_presets, c4001::presets::kSettingsRoot, nullptr, c4001::presets::presets_set, nullptr, nullptr);
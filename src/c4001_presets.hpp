@@ -0,0 +1,28 @@
+#ifndef C4001_PRESETS_HPP_
+#define C4001_PRESETS_HPP_
+#include "c4001_task.hpp"
+
+namespace c4001::presets
+{
+    constexpr uint8_t kMaxPresets = 4;
+    constexpr uint8_t kNone = 0xff;
+
+    //config together with the 'set' command lines rendered from it
+    //lines are streamed to the sensor as-is on activation
+    struct preset_t
+    {
+        config_t cfg;
+        dfr::C4001::CmdLine lines[5];
+        bool valid = false;
+    };
+
+    //renders and persists 'cfg' as preset 'k'
+    bool store(uint8_t k, config_t const& cfg);
+    const preset_t* get(uint8_t k);
+
+    //active preset of sensor 'id'
+    uint8_t active(uint8_t id);
+    void set_active(uint8_t id, uint8_t k);
+}
+
+#endif
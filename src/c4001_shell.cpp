@@ -0,0 +1,447 @@
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include "c4001_task.hpp"
+#include "metrics.hpp"
+#include "lib/lib_latency_hist.h"
+#include "lib/lib_coro.h"
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <algorithm>
+#include <utility>
+#include <optional>
+#include <zephyr/sys/crc.h>
+#if defined(C4001_BENCH)
+#include "bench.hpp"
+#endif
+
+//'c4001 ...' shell commands for inspecting a sensor in the field.
+//Everything that talks to the sensor runs on the c4001 worker through
+//c4001::run_diag, inside a regular Configurator session.
+namespace c4001_shell
+{
+    constexpr uint32_t kBenchMaxRuns = 1000;
+    constexpr size_t kHistBarWidth = 32;
+
+    //sensor the commands are about, see 'c4001 sensor'
+    static uint8_t g_sensor = 0;
+
+    static bool check_sensor(const struct shell *sh)
+    {
+	if (c4001::device(g_sensor))
+	    return true;
+	shell_error(sh, "c4001[%d] is not there", g_sensor);
+	return false;
+    }
+
+    //site and op are the enums in lib/lib_ret_err.h and dfr::C4001::Op
+    static void print_err(const struct shell *sh, const char *what, dfr::C4001::Err const& e)
+    {
+	shell_error(sh, "%s failed: site=0x%04x op=%u errno=%d (0x%08x)", what
+		, std::to_underlying(e.site), e.op, -e.Code(), e.Packed());
+    }
+
+    /**********************************************************************/
+    /* raw                                                                */
+    /**********************************************************************/
+    struct raw_t
+    {
+	std::string_view line;
+	char reply[128];
+	size_t got = 0;
+	uint32_t us = 0;
+	bool ok = false;
+	dfr::C4001::Err err{};
+    };
+
+    static void raw_on_worker(dfr::C4001 &dev, void *ctx)
+    {
+	auto &v = *static_cast<raw_t*>(ctx);
+	auto cfg = dev.GetConfigurator();
+	const uint32_t t0 = k_cycle_get_32();
+	auto r = cfg.Raw(v.line, v.reply, v.got);
+	v.us = metrics::cycles_to_us(t0, k_cycle_get_32());
+	v.ok = (bool)r;
+	if (!r)
+	    v.err = r.error();
+    }
+
+    static int cmd_raw(const struct shell *sh, size_t argc, char **argv)
+    {
+	if (argc < 2)
+	{
+	    shell_help(sh);
+	    return -EINVAL;
+	}
+	if (!check_sensor(sh))
+	    return -ENODEV;
+	raw_t v{.line = argv[1]};
+	c4001::run_diag(g_sensor, raw_on_worker, &v);
+	if (v.got)
+	    shell_fprintf(sh, SHELL_NORMAL, "%s%s", v.reply, v.got + 1 == sizeof(v.reply) ? "...\r\n" : "");
+	if (!v.ok)
+	{
+	    print_err(sh, "raw", v.err);
+	    return -EIO;
+	}
+	shell_print(sh, "took %u us", v.us);
+	return 0;
+    }
+
+    /**********************************************************************/
+    /* bench                                                              */
+    /**********************************************************************/
+    struct bench_t
+    {
+	std::string_view line;
+	uint32_t n;
+	LatencyHist hist;
+	uint32_t failed = 0;
+	dfr::C4001::Err err{};
+	char reply[32];
+	//transport cost over the whole run
+	uint32_t cycles = 0;
+	dfr::C4001::Stats before, after;
+    };
+
+    //all round trips within a single session: the sensor is stopped once
+    static void bench_on_worker(dfr::C4001 &dev, void *ctx)
+    {
+	auto &b = *static_cast<bench_t*>(ctx);
+	auto cfg = dev.GetConfigurator();
+	b.before = dev.GetStats();
+	const uint32_t start = k_cycle_get_32();
+	for(uint32_t i = 0; i < b.n; ++i)
+	{
+	    size_t got;
+	    const uint32_t t0 = k_cycle_get_32();
+	    auto r = cfg.Raw(b.line, b.reply, got);
+	    const uint32_t us = metrics::cycles_to_us(t0, k_cycle_get_32());
+	    if (r)
+		b.hist.Add(us);
+	    else
+	    {
+		++b.failed;
+		b.err = r.error();
+		if (dfr::C4001::IsCancelled(b.err))
+		    break;
+	    }
+	}
+	b.cycles = k_cycle_get_32() - start;
+	b.after = dev.GetStats();
+    }
+
+    static void print_hist(const struct shell *sh, LatencyHist const& h)
+    {
+	uint32_t most = *std::max_element(std::begin(h.m_Buckets), std::end(h.m_Buckets));
+	for(size_t b = 0; b < LatencyHist::kBuckets; ++b)
+	{
+	    if (!h.m_Buckets[b])
+		continue;
+	    char bar[kHistBarWidth + 1];
+	    size_t w = std::max<size_t>(1, (size_t)h.m_Buckets[b] * kHistBarWidth / most);
+	    memset(bar, '#', w);
+	    bar[w] = 0;
+	    if (b == LatencyHist::kBuckets - 1)
+		shell_print(sh, "  >=%7u us %6u %s", LatencyHist::bucket_limit(b - 1), h.m_Buckets[b], bar);
+	    else
+		shell_print(sh, "  < %7u us %6u %s", LatencyHist::bucket_limit(b), h.m_Buckets[b], bar);
+	}
+	shell_print(sh, "n=%u avg=%u p50<=%u p90<=%u p99<=%u max=%u us", h.m_Count
+		, h.AvgUs(), h.PercentileUs(50), h.PercentileUs(90), h.PercentileUs(99), h.m_MaxUs);
+    }
+
+#if defined(C4001_BENCH)
+    static void on_bench_result(void *ctx, bench::result_t const& r)
+    {
+	char json[320];
+	bench::to_json(r, json, sizeof(json));
+	shell_print(static_cast<const struct shell*>(ctx), "%s", json);
+    }
+#endif
+
+    static int cmd_bench(const struct shell *sh, size_t argc, char **argv)
+    {
+#if defined(C4001_BENCH)
+	//no sensor involved: the parsers on in-memory input
+	if (argc == 1)
+	{
+	    size_t bad = bench::run(on_bench_result, (void*)sh);
+	    shell_print(sh, "%u bad", (unsigned)bad);
+	    return bad ? -EIO : 0;
+	}
+	if (argc == 2 && !strcmp(argv[1], "baseline"))
+	    return bench::store_baseline() ? 0 : -EIO;
+#endif
+	if (argc != 3)
+	{
+	    shell_help(sh);
+	    return -EINVAL;
+	}
+	if (!check_sensor(sh))
+	    return -ENODEV;
+	long n = strtol(argv[2], nullptr, 10);
+	if (n < 1 || n > (long)kBenchMaxRuns)
+	{
+	    shell_error(sh, "n must be 1..%u", kBenchMaxRuns);
+	    return -EINVAL;
+	}
+	bench_t b{.line = argv[1], .n = (uint32_t)n};
+	c4001::run_diag(g_sensor, bench_on_worker, &b);
+	print_hist(sh, b.hist);
+	//CPU load of the transport: its ISRs against the wall time of the run
+	if constexpr (dfr::C4001::Trace::kCounters)
+	{
+	    uint32_t isr = b.after.m_IsrCycles - b.before.m_IsrCycles;
+	    uint32_t bytes = (b.after.m_RxBytes - b.before.m_RxBytes) + (b.after.m_TxBytes - b.before.m_TxBytes);
+	    uint32_t permille = b.cycles ? uint32_t(uint64_t(isr) * 1000 / b.cycles) : 0;
+	    shell_print(sh, "transport=%s isr=%u cycles (%u.%u%% cpu) events=%u bytes=%u cycles/byte=%u", dfr::C4001::TransportName()
+		    , isr, permille / 10, permille % 10, b.after.m_Events - b.before.m_Events, bytes, bytes ? isr / bytes : 0);
+	}
+	else
+	    shell_print(sh, "transport=%s", dfr::C4001::TransportName());
+	if (b.failed)
+	{
+	    shell_warn(sh, "%u of %u failed", b.failed, b.n);
+	    print_err(sh, "last", b.err);
+	}
+	return 0;
+    }
+
+    /**********************************************************************/
+    /* fw                                                                 */
+    /**********************************************************************/
+    static int cmd_fw_update(const struct shell *sh, size_t argc, char **argv)
+    {
+	if (!check_sensor(sh))
+	    return -ENODEV;
+	c4001::update_firmware(g_sensor);
+	shell_print(sh, "c4001[%d]: update queued, see 'c4001 fw status'", g_sensor);
+	return 0;
+    }
+
+    static void print_progress(const struct shell *sh, fwupd::progress_t const& p)
+    {
+	const uint32_t permille = p.Permille();
+	shell_print(sh, "  %u of %u bytes (%u.%u%%) blocks=%u resends=%u %u ms %u B/s", p.bytes, p.total
+		, permille / 10, permille % 10, p.blocks, p.resends, p.elapsed_ms, p.BytesPerSec());
+    }
+
+    static int cmd_fw_status(const struct shell *sh, size_t argc, char **argv)
+    {
+	using state_t = c4001::fw_status_t::state_t;
+	static constexpr const char *kStates[] = {"idle", "checking image", "uploading", "rebooting", "done", "failed"};
+	auto st = c4001::fw_status();
+	shell_print(sh, "c4001[%d] firmware update: %s", st.id, kStates[std::to_underlying(st.state)]);
+	if (st.state != state_t::Idle)
+	    print_progress(sh, st.progress);
+	if (st.state == state_t::Failed)
+	    print_err(sh, "update", st.err);
+	if (st.in_bootloader)
+	    shell_print(sh, "  sensor left in its bootloader, 'c4001 fw update' retries");
+	return 0;
+    }
+
+#if UART_TRANSPORT == UART_TRANSPORT_MEMORY
+    //synthetic image, the same bytes every run
+    static int sim_read(void *, size_t off, uint8_t *p, size_t len)
+    {
+	for(size_t i = 0; i < len; ++i)
+	    p[i] = uint8_t((off + i) * 31 + ((off + i) >> 8));
+	return 0;
+    }
+
+    //CRC-32 the bootloader should end up with: whole blocks, padded
+    static uint32_t sim_crc(size_t size)
+    {
+	uint8_t buf[64];
+	uint32_t crc = 0;
+	const size_t padded = (size + fwupd::kBlockSize - 1) / fwupd::kBlockSize * fwupd::kBlockSize;
+	for(size_t off = 0; off < padded; off += sizeof(buf))
+	{
+	    std::fill(std::begin(buf), std::end(buf), fwupd::kPad);
+	    if (off < size)
+		sim_read(nullptr, off, buf, std::min(sizeof(buf), size - off));
+	    crc = crc32_ieee_update(crc, buf, sizeof(buf));
+	}
+	return crc;
+    }
+
+    //The whole pipeline against fwupd::SimBootloader on a line of its own
+    //(the sensors aren't involved): bootloader entry, blocks, resends, EOT.
+    //Everything runs in the shell thread, so the time is the CPU cost.
+    static int cmd_fw_sim(const struct shell *sh, size_t argc, char **argv)
+    {
+	long size = strtol(argv[1], nullptr, 10);
+	long nak = argc > 2 ? strtol(argv[2], nullptr, 10) : 0;
+	if (size <= 0 || nak < 0)
+	{
+	    shell_help(sh);
+	    return -EINVAL;
+	}
+	static uart::Channel line(nullptr);
+	static uint8_t ring[32];
+	static uint8_t frame[fwupd::kFrameSize];
+	static std::optional<fwupd::SimBootloader> sim;
+	line.SetDefaultWait(100);
+	if (!line.Configure())
+	    return -EIO;
+	sim.emplace(line.GetTransport(), (uint32_t)nak);
+	if (!line.StartContinuousReading(ring, sizeof(ring)))
+	    return -EIO;
+	static const uint8_t kReset[] = "resetSystem 1\r\n";
+	(void)line.Send(kReset, sizeof(kReset) - 1);
+
+	fwupd::source_t src{.size = (size_t)size, .read = sim_read, .ctx = nullptr};
+	fwupd::Uploader up(line, frame);
+	const uint32_t t0 = k_cycle_get_32();
+	auto r = up.Run(src);
+	const uint32_t cycles = k_cycle_get_32() - t0;
+	line.StopContinuousReading();
+	if (!r)
+	{
+	    print_err(sh, "sim", r.error());
+	    return -EIO;
+	}
+	print_progress(sh, *r);
+	const bool match = sim->Done() && sim->Crc32() == sim_crc(size);
+	shell_print(sh, "  %u us, %u cycles/byte, receiver: %u bytes, %u NAKs, crc %s"
+		, metrics::cycles_to_us(t0, t0 + cycles), cycles / (uint32_t)size, sim->Bytes(), sim->Naks(), match ? "ok" : "MISMATCH");
+	return match ? 0 : -EIO;
+    }
+#endif
+
+    /**********************************************************************/
+    /* stats, errors, trace, sensor                                       */
+    /**********************************************************************/
+    static int cmd_stats(const struct shell *sh, size_t argc, char **argv)
+    {
+	if (!check_sensor(sh))
+	    return -ENODEV;
+	auto const& dev = *c4001::device(g_sensor);
+	if constexpr (dfr::C4001::Trace::kCounters)
+	{
+	    auto c = dev.GetStats();
+	    shell_print(sh, "channel: events=%u rx=%u tx=%u overflows=%u rx_restarts=%u dump_dropped=%u"
+		    , c.m_Events, c.m_RxBytes, c.m_TxBytes, c.m_Overflows, c.m_RxRestarts, c.m_DumpDropped);
+	    auto const& x = dev.GetExchangeStats();
+	    shell_print(sh, "exchanges: total=%u retries=%u timeouts=%u failures=%u cancels=%u"
+		    , x.m_Exchanges, x.m_Retries, x.m_Timeouts, x.m_Failures, x.m_Cancels);
+	}
+	else
+	    shell_print(sh, "channel/exchange counters not built in (UART_TRACE)");
+	static constexpr const char *kKinds[dfr::C4001::kCmdKinds] = {"stop", "start", "get", "set", "save", "reset"};
+	auto const& t = dev.GetTiming();
+	for(size_t k = 0; k < dfr::C4001::kCmdKinds; ++k)
+	{
+	    auto const& e = t.m_Kinds[k];
+	    shell_print(sh, "  %-5s srtt=%u rttvar=%u timeout=%d ms", kKinds[k]
+		    , (unsigned)e.m_SRtt, (unsigned)e.m_RttVar, dev.GetTimeout(dfr::C4001::CmdKind(k)));
+	}
+	auto const& h = metrics::sensor_health(g_sensor);
+	shell_print(sh, "health: probes=%u lost=%u restarts=%u recoveries=%u last=%u max=%u ms"
+		, h.probes, h.lost, h.restarts, h.recoveries, h.last_recovery_ms, h.max_recovery_ms);
+	//duty cycle of the sensor UART since boot
+	int64_t now = k_uptime_get();
+	auto p = dev.GetPowerStats(now);
+	uint32_t permille = now ? uint32_t(p.m_ActiveMs * 1000 / now) : 0;
+	shell_print(sh, "uart power: %s idle_suspend=%d ms resumes=%u suspends=%u failures=%u active=%u ms (%u.%u%%)"
+		, dev.IsAwake() ? "on" : "suspended", dev.GetIdleSuspend(), p.m_Resumes, p.m_Suspends, p.m_Failures
+		, (uint32_t)p.m_ActiveMs, permille / 10, permille % 10);
+	shell_print(sh, "hw=%s sw=%s", dev.GetHWVer().m_Version, dev.GetSWVer().m_Version);
+	if (int unused = c4001::worker_stack_unused(); unused >= 0)
+	    shell_print(sh, "worker stack: %d bytes never used", unused);
+	auto f = coro::g_Frames.GetStats();
+	shell_print(sh, "coroutine frames: %u of %u used, max %u, biggest %u of %u bytes, failures=%u"
+		, f.m_Used, (unsigned)coro::Frames::kSlots, f.m_MaxUsed, f.m_MaxSize, (unsigned)coro::Frames::kSize, f.m_Failures);
+	return 0;
+    }
+
+    static int cmd_errors(const struct shell *sh, size_t argc, char **argv)
+    {
+	auto log = c4001::error_log();
+	shell_print(sh, "%u errors, last %u:", log.total, (unsigned)log.size());
+	for(size_t i = 0; i < log.size(); ++i)
+	{
+	    auto const& e = log.newest(i);
+	    shell_print(sh, "  %9u ms c4001[%d] error=%d site=0x%04x op=%u errno=%d", e.at_ms, e.id, (int)e.what
+		    , std::to_underlying(e.err.site), e.err.op, -e.err.Code());
+	}
+	return 0;
+    }
+
+    //presence pin edge -> on/off command stages, see metrics::presence_t
+    static int cmd_latency(const struct shell *sh, size_t argc, char **argv)
+    {
+	auto const& p = metrics::presence(g_sensor);
+	shell_print(sh, "edges=%u forwarded=%u dropped=%u frames_dropped=%u predicted=%u aps_failed=%u"
+		, p.edges, p.forwarded, p.dropped, p.frames_dropped, p.predicted, p.aps_failed);
+	static constexpr std::pair<const char*, LatencyHist metrics::presence_t::*> kStages[] = {
+	    {"edge -> zigbee callback", &metrics::presence_t::edge_to_cb},
+	    {"edge -> command sent", &metrics::presence_t::edge_to_send},
+	    {"command sent -> APS confirm", &metrics::presence_t::send_to_ack},
+	    {"edge -> APS confirm", &metrics::presence_t::edge_to_ack},
+	};
+	for(auto [name, h] : kStages)
+	{
+	    shell_print(sh, "%s:", name);
+	    print_hist(sh, p.*h);
+	}
+	return 0;
+    }
+
+    static int cmd_trace(const struct shell *sh, size_t argc, char **argv)
+    {
+	if (!check_sensor(sh))
+	    return -ENODEV;
+	if (strcmp(argv[1], "on") && strcmp(argv[1], "off"))
+	{
+	    shell_help(sh);
+	    return -EINVAL;
+	}
+	if constexpr (!dfr::C4001::Trace::kDump)
+	{
+	    shell_error(sh, "byte dump not built in (UART_TRACE)");
+	    return -ENOTSUP;
+	}
+	c4001::set_trace(g_sensor, !strcmp(argv[1], "on"));
+	return 0;
+    }
+
+    static int cmd_sensor(const struct shell *sh, size_t argc, char **argv)
+    {
+	if (argc == 2)
+	{
+	    long id = strtol(argv[1], nullptr, 10);
+	    if (id < 0 || id >= c4001::kSensors)
+	    {
+		shell_error(sh, "id must be 0..%d", c4001::kSensors - 1);
+		return -EINVAL;
+	    }
+	    g_sensor = (uint8_t)id;
+	}
+	shell_print(sh, "c4001[%d]%s", g_sensor, c4001::device(g_sensor) ? "" : " (not there)");
+	return 0;
+    }
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_c4001_fw,
+	SHELL_CMD_ARG(update, NULL, "update the sensor firmware from the c4001_image partition", c4001_shell::cmd_fw_update, 1, 0),
+	SHELL_CMD_ARG(status, NULL, "state, progress and throughput of the last update", c4001_shell::cmd_fw_status, 1, 0),
+#if UART_TRANSPORT == UART_TRANSPORT_MEMORY
+	SHELL_CMD_ARG(sim, NULL, "<bytes> [nak_every] upload a synthetic image to a simulated bootloader", c4001_shell::cmd_fw_sim, 2, 1),
+#endif
+	SHELL_SUBCMD_SET_END
+);
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_c4001,
+	SHELL_CMD_ARG(sensor, NULL, "[id] select the sensor the other commands are about", c4001_shell::cmd_sensor, 1, 1),
+	SHELL_CMD_ARG(bench, NULL, "<cmd> <n> time n round trips of cmd (e.g. getRange) within one session", c4001_shell::cmd_bench, 1, 2),
+	SHELL_CMD_ARG(raw, NULL, "<line> send line as-is within one session, print the reply and its time", c4001_shell::cmd_raw, 1, SHELL_OPT_ARG_RAW),
+	SHELL_CMD_ARG(stats, NULL, "channel, exchange, supervision and UART power counters", c4001_shell::cmd_stats, 1, 0),
+	SHELL_CMD_ARG(errors, NULL, "last errors of all sensors, newest first", c4001_shell::cmd_errors, 1, 0),
+	SHELL_CMD_ARG(latency, NULL, "presence pin edge to on/off command timing, up to the APS confirm", c4001_shell::cmd_latency, 1, 0),
+	SHELL_CMD_ARG(trace, NULL, "on|off print the bytes exchanged with the sensor", c4001_shell::cmd_trace, 2, 0),
+	SHELL_CMD(fw, &sub_c4001_fw, "sensor firmware update", NULL),
+	SHELL_SUBCMD_SET_END
+);
+SHELL_CMD_REGISTER(c4001, &sub_c4001, "DFRobot C4001 diagnostics", NULL);
@@ -1,15 +1,35 @@
 #define FORCE_FMT
 #define PRINTF_FUNC(...) printk(__VA_ARGS__)
+#define DT_DRV_COMPAT dfr_c4001
 
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/crc.h>
+#if defined(CONFIG_C4001_FW_UPDATE)
+#include <zephyr/storage/flash_map.h>
+#if FIXED_PARTITION_EXISTS(c4001_image)
+#define C4001_FW_IMAGE 1
+#endif
+#endif
 #include "c4001_task.hpp"
+#include "c4001_presets.hpp"
+#include "sensitivity_sweep.hpp"
+#include "sensor_health.hpp"
+#include "metrics.hpp"
+#include "lib/lib_dlog.h"
+#include "lib/lib_coro.h"
 #include <variant>
+#include <atomic>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include <nrf_general/lib_msgq_typed.hpp>
 
-#define DFR_UART_NODE DT_ALIAS(dfr_uart)
-
 namespace c4001
 {
     namespace{
@@ -21,9 +41,6 @@ namespace c4001
 	template<class... O>
 	overloaded(O... o)->overloaded<O...>;
     };
-    constinit const struct device *c4001_uart = DEVICE_DT_GET(DFR_UART_NODE);
-    static dfr::C4001 c4001(c4001_uart);
-
     /**********************************************************************/
     /* Message Queue definitions + commands                               */
     /**********************************************************************/
@@ -50,10 +67,39 @@ namespace c4001
     {
 	float duration;
     };
+    struct apply_cfg_t
+    {
+	config_t cfg;
+	cfg_id_t ids;
+    };
+    struct store_preset_t
+    {
+	uint8_t k;
+    };
+    struct activate_preset_t
+    {
+	uint8_t k;
+    };
+    struct run_mode_t
+    {
+	uint8_t mode;
+    };
+    struct calibrate_t
+    {
+	uint8_t step_s;
+	uint8_t run_mode;
+    };
     struct save_cfg_t{};
     struct reset_cfg_t{};
     struct restart_cfg_t{};
     struct reload_cfg_t{};
+    struct fw_update_t{};
+    struct diag_t
+    {
+	diag_fn_t fn;
+	void *ctx;
+	struct k_sem *done;
+    };
 
     using QueueItem = std::variant<
 			      range_t
@@ -61,214 +107,1141 @@ namespace c4001
 			    , delay_t
 			    , sensitivity_t
 			    , inhibit_duration_t
+			    , apply_cfg_t
+			    , store_preset_t
+			    , activate_preset_t
+			    , run_mode_t
+			    , calibrate_t
 			    , save_cfg_t
 			    , reset_cfg_t
 			    , restart_cfg_t
 			    , reload_cfg_t
+			    , fw_update_t
+			    , diag_t
 			>;
 
-    using C4001Q = msgq::Queue<QueueItem,4>;
-    K_MSGQ_DEFINE_TYPED(C4001Q, c4001q);
+    /**********************************************************************/
+    /* c4001 worker                                                       */
+    /**********************************************************************/
+    //all sensor conversations run as work items on this one queue
+    //so they share a single stack and never preempt each other.
+    //Config requests, the supervisor and the stream are coroutines on one
+    //fiber per sensor (lib_coro.h, frames in coro::g_Frames): while one waits
+    //for its sensor the queue serves the others.
+    //Calibration, firmware update, reset, restart, reload and diag still block
+    //it; deepest chain (config exchange: request -> session -> Exchange ->
+    //QueryAttempt -> ReadSome -> WaitFor -> k_poll + exception frame)
+    //~1.1K by tools/stack_usage.py, 25% on top (C4001_WQ_STACK_SIZE in CMakeLists.txt)
+#ifndef C4001_WQ_STACK_SIZE
+#define C4001_WQ_STACK_SIZE 1408
+#endif
+    constexpr int C4001_WQ_PRIORITY = 7;
+    K_THREAD_STACK_DEFINE(c4001_wq_stack, C4001_WQ_STACK_SIZE);
+    static struct k_work_q c4001_wq;
+
+    static void on_sensor_work(struct k_work *);
+    static void on_fiber_done(coro::Fiber &);
+    static void on_idle_work(struct k_work *);
 
-    void c4001_thread_entry(void *, void *, void *);
-    constexpr size_t C4001_THREAD_STACK_SIZE = 1024 * 2;
-    constexpr size_t C4001_THREAD_PRIORITY=7;
+    //sensor output is read in slices so the supervisor gets its turn;
+    //a request cancels the slice running
+    constexpr int kStreamSliceMs = 1000;
+    //after a failed slice or with no coroutine frame free
+    constexpr int kRetryMs = 1000;
 
-K_THREAD_DEFINE(c4001_thread, C4001_THREAD_STACK_SIZE,
-	c4001_thread_entry, NULL, NULL, NULL,
-	C4001_THREAD_PRIORITY, 0, -1);
+    constexpr size_t kQueueDepth = 4;
+    //per sensor, one for each DT instance
+    using C4001Q = msgq::Queue<QueueItem, kQueueDepth>;
+
+    //the sensor UART is suspended after this long without an exchange,
+    //negative - never (C4001_UART_IDLE_MS in CMakeLists.txt)
+#ifndef C4001_UART_IDLE_MS
+#define C4001_UART_IDLE_MS -1
+#endif
+    constexpr int kUartIdleMs = C4001_UART_IDLE_MS;
+
+    //learned reply timeouts are saved when one of them moved by more than
+    //a quarter, but not more often than this to spare the flash
+    constexpr int64_t kTimingSaveMinMs = 10 * 60 * 1000;
+
+    //a session sends one line per parameter at most, as a preset does
+    constexpr size_t kSessionLines = std::extent_v<decltype(presets::preset_t::lines)>;
+
+    //Per sensor state on top of the shared worker; no thread, no stack.
+    //RAM per sensor, roughly:
+    // - dev: channel state + 128B RX buffer + 64B frame decoder + two config
+    //   and two version copies (4 x 32B strings) + reply time estimates (~660B)
+    // - q: kQueueDepth requests in its own typed queue (~130B + k_msgq)
+    // - work, fiber, calibration result, supervisor, saved timeouts (~250B)
+    // - the request on the fiber and the lines of its session (~210B)
+    struct sensor_t
+    {
+	dfr::C4001 dev;
+	C4001Q &q;
+	//put and not taken yet: the worker never blocks on an empty queue
+	std::atomic<uint8_t> queued{0};
+	//what the sensor does next, see on_sensor_work
+	struct k_work_delayable work;
+	//its conversation in flight, one at a time
+	coro::Fiber fiber;
+	//worker only: numbers the requests, see op_tag
+	uint32_t seq = 0;
+	//worker only: the request on the fiber and what its session sends
+	//and reads back (config_session), here rather than in the frames
+	QueueItem request;
+	dfr::C4001::CmdLine lines[kSessionLines];
+	dfr::C4001::Op line_ops[kSessionLines];
+	uint8_t line_count = 0;
+	cfg_id_t read_back{};
+	//written by the worker only
+	SeqLocked<calibration_t> calibration;
+	//worker only: liveness and recovery
+	health::supervisor_t health;
+	//last run mode set, -1 - unknown; re-applied by a resync
+	int8_t run_mode = -1;
+	//SensorLost reported, Ok is due once it is back
+	bool lost = false;
+	//a failed update left it in its bootloader: not supervised, the next
+	//update retries the upload without the restart
+	bool in_bootloader = false;
+	//something looks at the frames (set_frames_wanted): streamed when idle
+	std::atomic<bool> frames_wanted{true};
+	//worker only: reply timeouts as last saved
+	dfr::C4001::Timing saved_timing;
+	int64_t timing_saved_at = -kTimingSaveMinMs;
+	std::atomic<bool> ready{false};
+    };
+
+#define C4001_QUEUE_DEFINE(inst) K_MSGQ_DEFINE_TYPED(C4001Q, c4001q_##inst);
+    DT_INST_FOREACH_STATUS_OKAY(C4001_QUEUE_DEFINE)
+#undef C4001_QUEUE_DEFINE
+
+#define C4001_SENSOR_INIT(inst) {.dev{DEVICE_DT_GET(DT_INST_PHANDLE(inst, uart))}, .q = c4001q_##inst},
+    static sensor_t g_sensors[kSensors] = { DT_INST_FOREACH_STATUS_OKAY(C4001_SENSOR_INIT) };
+#undef C4001_SENSOR_INIT
+
+    //a single work suspending idle UARTs, see on_idle_work
+    K_WORK_DELAYABLE_DEFINE(g_idle_work, on_idle_work);
 
     constinit err_callback_t g_err = nullptr;
     constinit upd_callback_t g_upd = nullptr;
-    dfr::C4001* setup(err_callback_t err, upd_callback_t upd)
+    constinit frame_callback_t g_frame = nullptr;
+
+    //worker only: what error_log() hands out
+    static error_log_t g_errors;
+    static SeqLocked<error_log_t> g_published_errors;
+
+    static uint8_t id_of(sensor_t const& s)
+    {
+	return uint8_t(&s - g_sensors);
+    }
+
+    static sensor_t* sensor(uint8_t id)
     {
-	auto r = c4001.Init();
+	return id < kSensors && g_sensors[id].ready ? &g_sensors[id] : nullptr;
+    }
+
+    //a calibration gives way to any request, for whichever sensor
+    static bool requests_pending()
+    {
+	for(auto &s : g_sensors)
+	{
+	    if (s.ready && s.queued)
+		return true;
+	}
+	return false;
+    }
+
+    /**********************************************************************/
+    /* Reply timeouts persistence                                         */
+    /**********************************************************************/
+    constexpr const char kSettingsTiming[] = "c4001/lat";
+
+    static int timing_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+    {
+	//"<id>"
+	if (name[0] < '0' || name[0] >= ('0' + kSensors) || name[1])
+	    return -ENOENT;
+	auto &t = g_sensors[name[0] - '0'].saved_timing;
+	if (len != sizeof(t))
+	    return -EINVAL;
+	if (read_cb(cb_arg, &t, sizeof(t)) < 0)
+	{
+	    t = {};
+	    return -EIO;
+	}
+	return 0;
+    }
+
+    static bool timing_drifted(sensor_t const& s)
+    {
+	for(size_t k = 0; k < dfr::C4001::kCmdKinds; ++k)
+	{
+	    auto kind = dfr::C4001::CmdKind(k);
+	    int now = s.dev.GetTimeout(kind), was = s.saved_timing.Timeout(kind);
+	    if (std::abs(now - was) * 4 > was)
+		return true;
+	}
+	return false;
+    }
+
+    static void save_timing(sensor_t &s)
+    {
+	int64_t now = k_uptime_get();
+	if (now - s.timing_saved_at < kTimingSaveMinMs || !timing_drifted(s))
+	    return;
+	s.saved_timing = s.dev.GetTiming();
+	s.timing_saved_at = now;
+	char key[16];
+	snprintf(key, sizeof(key), "%s/%d", kSettingsTiming, id_of(s));
+	if (int err = settings_save_one(key, &s.saved_timing, sizeof(s.saved_timing)); err != 0)
+	    printk("c4001: failed to save %s: %d\r\n", key, err);
+    }
+
+    //its frames are looked at: streamed whenever it has nothing else to do
+    static bool streamed(sensor_t const& s)
+    {
+	return g_frame && s.frames_wanted && !s.in_bootloader;
+    }
+
+    //on_sensor_work as soon as the worker gets to it; a retry already
+    //scheduled keeps its delay
+    static void kick(sensor_t &s)
+    {
+	k_work_schedule_for_queue(&c4001_wq, &s.work, K_NO_WAIT);
+    }
+
+    static void start_worker()
+    {
+	static bool started = false;
+	if (started)
+	    return;
+	started = true;
+	k_work_queue_start(&c4001_wq, c4001_wq_stack, K_THREAD_STACK_SIZEOF(c4001_wq_stack), C4001_WQ_PRIORITY, nullptr);
+	k_thread_name_set(&c4001_wq.thread, "c4001");
+    }
+
+    dfr::C4001* setup(uint8_t id, err_callback_t err, upd_callback_t upd, frame_callback_t frame)
+    {
+	if (id >= kSensors)
+	    return nullptr;
+	auto &s = g_sensors[id];
+	//loaded by settings_load() if there is anything
+	s.dev.SetTiming(s.saved_timing);
+	s.dev.SetIdleSuspend(kUartIdleMs);
+	auto r = s.dev.Init();
 	if (!r)
 	    return nullptr;
+	k_work_init_delayable(&s.work, on_sensor_work);
+	s.fiber.Init(&c4001_wq, on_fiber_done);
+	save_timing(s);
 	g_err = err;
 	g_upd = upd;
-	k_thread_start(c4001_thread);
-	return &c4001;
+	g_frame = frame;
+	start_worker();
+	s.health.OnProbe(true, k_uptime_get());
+	s.ready = true;
+	kick(s);
+	return &s.dev;
     }
 
-    void set_range(float from, float to)
+    //The request in flight is the channel operation (Channel::BeginOp):
+    //sequence number << 8 | queue item index + 1, 0 between requests.
+    //The number tells apart two requests of the same kind. A stream slice
+    //is one as well, with the index after the last queue item.
+    static constexpr uint32_t kIdleOp = 0;
+    static constexpr size_t kStreamIndex = std::variant_size_v<QueueItem>;
+    static uint32_t op_tag(uint32_t seq, size_t index)
     {
-	c4001q << range_t{.from = from, .to = to};
+	return ((seq << 8) | (index + 1)) & dfr::C4001::kOpMask;
     }
+    static size_t op_index(uint32_t op) { return (op & 0xff) - 1; }
 
-    void set_range_from(float v)
+    //a newer value for the same parameter makes the in-flight exchange obsolete
+    static bool supersedes(QueueItem const& newer)
     {
-	c4001q << range_t{.from = v, .to = c4001.GetRangeTo()};
+	return std::visit(overloaded{
+		[](range_t const&){ return true; }
+		,[](range_trig_t const&){ return true; }
+		,[](delay_t const&){ return true; }
+		,[](inhibit_duration_t const&){ return true; }
+		//partial updates (255 - keep) must not drop the other half
+		,[](sensitivity_t const& v){ return v.detect != 255 && v.hold != 255; }
+		,[](activate_preset_t const&){ return true; }
+		,[](run_mode_t const&){ return true; }
+		,[](auto const&){ return false; }
+	    }, newer);
     }
 
-    void set_range_to(float v)
+    static void post(sensor_t &s, QueueItem const& item)
     {
-	c4001q << range_t{.from = c4001.GetRangeFrom(), .to = v};
+	//cancels only the request seen here: by now the worker may be done
+	//with it, then the cancel doesn't touch the next one; a stream
+	//slice always gives way
+	if (uint32_t op = s.dev.CurrentOp(); op != kIdleOp
+		&& (op_index(op) == kStreamIndex || (op_index(op) == item.index() && supersedes(item))))
+	    (void)s.dev.Cancel(op);
+	s.q << item;
+	++s.queued;
+	k_work_reschedule_for_queue(&c4001_wq, &s.work, K_NO_WAIT);
     }
 
-    void set_range_trig(float trig)
+    //requests for a sensor that failed to initialize are dropped
+    static void post(uint8_t id, QueueItem const& item)
     {
-	c4001q << range_trig_t{.trig = trig};
+	if (auto *s = sensor(id))
+	    post(*s, item);
     }
 
-    void set_detect_delay(float v)
+    void set_range(uint8_t id, float from, float to)
     {
-	c4001q << delay_t{.detect = v, .clear = c4001.GetClearLatency()};
+	post(id, range_t{.from = from, .to = to});
     }
 
-    void set_clear_delay(float v)
+    void set_range_from(uint8_t id, float v)
     {
-	c4001q << delay_t{.detect = c4001.GetDetectLatency(), .clear = v};
+	if (auto *s = sensor(id))
+	    post(*s, range_t{.from = v, .to = s->dev.GetRangeTo()});
     }
 
-    void set_detect_clear_delay(float detect, float clear)
+    void set_range_to(uint8_t id, float v)
     {
-	c4001q << delay_t{.detect = detect, .clear = clear};
+	if (auto *s = sensor(id))
+	    post(*s, range_t{.from = s->dev.GetRangeFrom(), .to = v});
     }
 
-    void set_detect_sensitivity(uint8_t s)
+    void set_range_trig(uint8_t id, float trig)
     {
-	c4001q << sensitivity_t{.detect = s, .hold = 255};
+	post(id, range_trig_t{.trig = trig});
     }
 
-    void set_hold_sensitivity(uint8_t s)
+    void set_detect_delay(uint8_t id, float v)
     {
-	c4001q << sensitivity_t{.detect = 255, .hold = s};
+	if (auto *s = sensor(id))
+	    post(*s, delay_t{.detect = v, .clear = s->dev.GetClearLatency()});
     }
 
-    void set_sensitivity(uint8_t detect, uint8_t hold)
+    void set_clear_delay(uint8_t id, float v)
     {
-	c4001q << sensitivity_t{.detect = detect, .hold = hold};
+	if (auto *s = sensor(id))
+	    post(*s, delay_t{.detect = s->dev.GetDetectLatency(), .clear = v});
     }
 
-    void set_inhibit_duration(float dur)
+    void set_detect_clear_delay(uint8_t id, float detect, float clear)
     {
-	c4001q << inhibit_duration_t{.duration = dur};
+	post(id, delay_t{.detect = detect, .clear = clear});
     }
 
-    void save_config()
+    void set_detect_sensitivity(uint8_t id, uint8_t s)
     {
-	c4001q << save_cfg_t{};
+	post(id, sensitivity_t{.detect = s, .hold = 255});
     }
 
-    void reset_config()
+    void set_hold_sensitivity(uint8_t id, uint8_t s)
     {
-	c4001q << reset_cfg_t{};
+	post(id, sensitivity_t{.detect = 255, .hold = s});
     }
 
-    void restart()
+    void set_sensitivity(uint8_t id, uint8_t detect, uint8_t hold)
     {
-	c4001q << restart_cfg_t{};
+	post(id, sensitivity_t{.detect = detect, .hold = hold});
     }
 
-    void c4001_thread_entry(void *, void *, void *)
+    void set_inhibit_duration(uint8_t id, float dur)
     {
-	QueueItem q;
-	using Cfg = dfr::C4001::Configurator;
-	while(1)
+	post(id, inhibit_duration_t{.duration = dur});
+    }
+
+    void apply_config(uint8_t id, config_t const& cfg, cfg_id_t ids)
+    {
+	post(id, apply_cfg_t{.cfg = cfg, .ids = ids});
+    }
+
+    void store_preset(uint8_t id, uint8_t k)
+    {
+	post(id, store_preset_t{.k = k});
+    }
+
+    void activate_preset(uint8_t id, uint8_t k)
+    {
+	post(id, activate_preset_t{.k = k});
+    }
+
+    void set_run_mode(uint8_t id, uint8_t mode)
+    {
+	post(id, run_mode_t{.mode = mode});
+    }
+
+    void set_frames_wanted(uint8_t id, bool wanted)
+    {
+	if (id >= kSensors || g_sensors[id].frames_wanted.exchange(wanted) == wanted)
+	    return;
+	auto &s = g_sensors[id];
+	if (!s.ready)
+	    return;
+	if (wanted)
+	    kick(s);
+	//the slice running ends
+	else if (uint32_t op = s.dev.CurrentOp(); op != kIdleOp && op_index(op) == kStreamIndex)
+	    (void)s.dev.Cancel(op);
+    }
+
+    void calibrate(uint8_t id, uint8_t step_s, uint8_t run_mode)
+    {
+	post(id, calibrate_t{.step_s = step_s, .run_mode = run_mode});
+    }
+
+    void save_config(uint8_t id)
+    {
+	post(id, save_cfg_t{});
+    }
+
+    void reset_config(uint8_t id)
+    {
+	post(id, reset_cfg_t{});
+    }
+
+    void restart(uint8_t id)
+    {
+	post(id, restart_cfg_t{});
+    }
+
+    bool run_diag(uint8_t id, diag_fn_t fn, void *ctx)
+    {
+	auto *s = sensor(id);
+	if (!s)
+	    return false;
+	struct k_sem done;
+	k_sem_init(&done, 0, 1);
+	post(*s, diag_t{.fn = fn, .ctx = ctx, .done = &done});
+	k_sem_take(&done, K_FOREVER);
+	return true;
+    }
+
+    dfr::C4001 const* device(uint8_t id)
+    {
+	auto *s = sensor(id);
+	return s ? &s->dev : nullptr;
+    }
+
+    int worker_stack_unused()
+    {
+#if defined(CONFIG_THREAD_STACK_INFO)
+	size_t unused;
+	if (int r = k_thread_stack_space_get(&c4001_wq.thread, &unused); r != 0)
+	    return r;
+	return (int)unused;
+#else
+	return -ENOTSUP;
+#endif
+    }
+
+    void set_trace(uint8_t id, bool on)
+    {
+	if (auto *s = sensor(id))
+	    s->dev.SetTrace(on);
+    }
+
+    error_log_t error_log()
+    {
+	return g_published_errors.Load();
+    }
+
+    //logs an error and passes it on; 'why' is the failed exchange, if there was one
+    static void notify_err(uint8_t id, err_t e, Err const& why = {})
+    {
+	if (e != err_t::Ok)
 	{
-	    c4001q >> q;
-	    std::visit(
-		overloaded{
-		    [](range_t const& v){ 
-			if (auto r = c4001
-				.GetConfigurator()
-				.SetRange(v.from, v.to)
-				.and_then([](Cfg &cfg){ return cfg.SaveConfig(); })
-				.and_then([](Cfg &cfg){ return cfg.UpdateRange(); }); !r)
-			{
-			    if (g_err) g_err(err_t::Range);
-			}
-			else if (g_upd)
-			    g_upd(cfg_id_t::Range);
-		    }
-		    ,[](range_trig_t const& v){  
-			if (auto r = c4001
-				.GetConfigurator()
-				.SetTrigRange(v.trig)
-				.and_then([](Cfg &cfg){ return cfg.SaveConfig(); })
-				.and_then([](Cfg &cfg){ return cfg.UpdateTrigRange(); }); !r)
-			{
-			    if (g_err) g_err(err_t::RangeTrig);
-			}
-			else if (g_upd)
-			    g_upd(cfg_id_t::RangeTrig);
-		    }
-		    ,[](delay_t const& v){  
-			if (auto r = c4001
-				.GetConfigurator()
-				.SetLatency(v.detect, v.clear)
-				.and_then([](Cfg &cfg){ return cfg.SaveConfig(); })
-				.and_then([](Cfg &cfg){ return cfg.UpdateLatency(); }); !r)
-			{
-			    if (g_err) g_err(err_t::Delay);
-			}
-			else if (g_upd)
-			    g_upd(cfg_id_t::Delay);
-		    }
-		    ,[](sensitivity_t const& v){  
-			if (auto r = c4001
-				.GetConfigurator()
-				.SetSensitivity(v.detect, v.hold)
-				.and_then([](Cfg &cfg){ return cfg.SaveConfig(); })
-				.and_then([](Cfg &cfg){ return cfg.UpdateSensitivity(); }); !r)
-			{
-			    if (g_err) g_err(err_t::Sensitivity);
-			}
-			else if (g_upd)
-			    g_upd(cfg_id_t::Sensitivity);
-		    }
-		    ,[](inhibit_duration_t const& v){  
-			if (auto r = c4001
-				.GetConfigurator()
-				.SetInhibit(v.duration)
-				.and_then([](Cfg &cfg){ return cfg.SaveConfig(); })
-				.and_then([](Cfg &cfg){ return cfg.UpdateInhibit(); }); !r)
-			{
-			    if (g_err) g_err(err_t::InhibitDuration);
-			}
-			else if (g_upd)
-			    g_upd(cfg_id_t::InhibitDuration);
+	    DLOG("c4001[{}]: error {}: {:x}", id, e, why.Packed());
+	    g_errors.entries[g_errors.total % kErrorLog] = {.at_ms = k_uptime_get_32(), .err = why, .id = id, .what = e};
+	    ++g_errors.total;
+	    g_published_errors.Store(g_errors);
+	}
+	if (g_err)
+	    g_err(id, e, why);
+    }
+
+    using Cfg = dfr::C4001::Configurator;
+
+    //reports a sensor the resync couldn't bring back; a suspect one that
+    //answers the resync is not worth an error
+    static void check_lost(sensor_t &s)
+    {
+	if (s.lost || !s.health.Lost())
+	    return;
+	s.lost = true;
+	++metrics::sensor_health(id_of(s)).lost;
+	notify_err(id_of(s), err_t::SensorLost, Err{err::site_t::SensorLost});
+    }
+
+    static void schedule_idle();
+
+    static void report_err(sensor_t &s, Err const& why, err_t e)
+    {
+	//a cancelled exchange was superseded by a newer request, nothing to report;
+	//cancelled otherwise it's a failure like any other
+	if (dfr::C4001::IsCancelled(why) && s.dev.WasCancelled())
+	    return;
+	notify_err(id_of(s), e, why);
+	//an 'Error' reply to a bad value is the sensor answering: a resync
+	//(and its flash write) is only for one that went quiet; it is up
+	//once on_sensor_work is back for the sensor
+	if (!dfr::C4001::IsTimeout(why))
+	    return;
+	s.health.OnFailure(k_uptime_get());
+    }
+
+    static config_t current_config(sensor_t const& s)
+    {
+	auto c = s.dev.GetConfig();
+	return {
+	    .range_from = c.m_MinRange,
+	    .range_to = c.m_MaxRange,
+	    .range_trig = c.m_TrigRange,
+	    .inhibit_duration = c.m_Inhibit,
+	    .detect_delay = c.m_DetectLatency,
+	    .clear_delay = c.m_ClearLatency,
+	    .sensitivity_detect = c.m_SensitivityTrigger,
+	    .sensitivity_hold = c.m_SensitivityHold,
+	};
+    }
+
+    /**********************************************************************/
+    /* Conversations on the fiber                                         */
+    /**********************************************************************/
+    using CoTask = dfr::C4001::CoTask;
+    using Op = dfr::C4001::Op;
+    using Param = dfr::C4001::Param;
+
+    //the requests that are a config session, see co_request
+    static bool on_fiber(QueueItem const& q)
+    {
+	return std::visit(overloaded{
+		[](range_t const&){ return true; }
+		,[](range_trig_t const&){ return true; }
+		,[](delay_t const&){ return true; }
+		,[](sensitivity_t const&){ return true; }
+		,[](inhibit_duration_t const&){ return true; }
+		,[](apply_cfg_t const&){ return true; }
+		,[](activate_preset_t const&){ return true; }
+		,[](run_mode_t const&){ return true; }
+		,[](save_cfg_t const&){ return true; }
+		,[](auto const&){ return false; }
+	    }, q);
+    }
+
+    //what a failed request is reported as
+    static err_t err_of(QueueItem const& q)
+    {
+	return std::visit(overloaded{
+		[](range_t const&){ return err_t::Range; }
+		,[](range_trig_t const&){ return err_t::RangeTrig; }
+		,[](delay_t const&){ return err_t::Delay; }
+		,[](sensitivity_t const&){ return err_t::Sensitivity; }
+		,[](inhibit_duration_t const&){ return err_t::InhibitDuration; }
+		,[](apply_cfg_t const&){ return err_t::ApplyConfig; }
+		,[](store_preset_t const&){ return err_t::StorePreset; }
+		,[](activate_preset_t const&){ return err_t::ActivatePreset; }
+		,[](run_mode_t const&){ return err_t::RunMode; }
+		,[](calibrate_t const&){ return err_t::Calibrate; }
+		,[](save_cfg_t const&){ return err_t::SaveConfig; }
+		,[](reset_cfg_t const&){ return err_t::ResetConfig; }
+		,[](restart_cfg_t const&){ return err_t::Restart; }
+		,[](reload_cfg_t const&){ return err_t::ReloadConfig; }
+		,[](fw_update_t const&){ return err_t::FwUpdate; }
+		,[](diag_t const&){ return err_t::Ok; }
+	    }, q);
+    }
+
+    //the 'set' lines for the parts 'ids' of 'c', all of them read back
+    static Err format_lines(sensor_t &s, config_t const& c, cfg_id_t ids)
+    {
+	using C4001 = dfr::C4001;
+	s.line_count = 0;
+	s.read_back = ids;
+	auto line = [&](Op op) -> C4001::CmdLine& {
+	    s.line_ops[s.line_count] = op;
+	    return s.lines[s.line_count++];
+	};
+	bool ok = true;
+	if (ids & cfg_id_t::Range)
+	    ok = ok && C4001::FormatRange(line(Op::SetRange), c.range_from, c.range_to);
+	if (ids & cfg_id_t::RangeTrig)
+	    ok = ok && C4001::FormatTrigRange(line(Op::SetTrigRange), c.range_trig);
+	if (ids & cfg_id_t::Delay)
+	    ok = ok && C4001::FormatLatency(line(Op::SetLatency), c.detect_delay, c.clear_delay);
+	if (ids & cfg_id_t::Sensitivity)
+	    ok = ok && C4001::FormatSensitivity(line(Op::SetSensitivity), c.sensitivity_detect, c.sensitivity_hold);
+	if (ids & cfg_id_t::InhibitDuration)
+	    ok = ok && C4001::FormatInhibit(line(Op::SetInhibit), c.inhibit_duration);
+	if (!ok)
+	    return Err{err::site_t::FormatArgs}.In(s.line_ops[s.line_count - 1]);
+	return {};
+    }
+
+    //what the session of 'q' sends and reads back
+    static Err prepare_session(sensor_t &s, QueueItem const& q)
+    {
+	s.line_count = 0;
+	s.read_back = {};
+	return std::visit(overloaded{
+		[&](range_t const& v){ return format_lines(s, {.range_from = v.from, .range_to = v.to}, cfg_id_t::Range); }
+		,[&](range_trig_t const& v){ return format_lines(s, {.range_trig = v.trig}, cfg_id_t::RangeTrig); }
+		,[&](delay_t const& v){ return format_lines(s, {.detect_delay = v.detect, .clear_delay = v.clear}, cfg_id_t::Delay); }
+		//255 - keep, passed on as is
+		,[&](sensitivity_t const& v){
+		    return format_lines(s, {.sensitivity_detect = v.detect, .sensitivity_hold = v.hold}, cfg_id_t::Sensitivity);
+		}
+		,[&](inhibit_duration_t const& v){ return format_lines(s, {.inhibit_duration = v.duration}, cfg_id_t::InhibitDuration); }
+		,[&](apply_cfg_t const& v){ return format_lines(s, v.cfg, v.ids); }
+		,[&](activate_preset_t const& v){
+		    auto *pPreset = presets::get(v.k);
+		    if (!pPreset)
+			return Err{err::site_t::PresetMissing};
+		    //copied: the session outlives this run of the worker,
+		    //a store_preset for another sensor may come in between
+		    for(auto const& l : pPreset->lines)
+		    {
+			s.line_ops[s.line_count] = Op::SendLine;
+			s.lines[s.line_count++] = l;
 		    }
-		    ,[](save_cfg_t const& v){  
-			if (auto r = c4001
-				.GetConfigurator()
-				.SaveConfig(); !r && g_err)
-			    g_err(err_t::SaveConfig);
+		    s.read_back = cfg_id_t::All;
+		    return Err{};
+		}
+		//run mode, save: no lines
+		,[](auto const&){ return Err{}; }
+	    }, q);
+    }
+
+    //One session as the Configurator chains had it: the run mode (-1 - as
+    //it is), the lines prepared, a save, then what they set read back
+    static CoTask config_session(sensor_t &s, int8_t runMode)
+    {
+	static constexpr std::pair<cfg_id_t, Param> kReadBack[] = {
+	    {cfg_id_t::Range, Param::Range}
+	    , {cfg_id_t::RangeTrig, Param::TrigRange}
+	    , {cfg_id_t::Delay, Param::Latency}
+	    , {cfg_id_t::Sensitivity, Param::Sensitivity}
+	    , {cfg_id_t::InhibitDuration, Param::Inhibit}
+	};
+	dfr::C4001::CoSession cs(s.dev);
+	auto r = co_await cs.Begin();
+	if (r && runMode >= 0)
+	    r = co_await cs.RunMode(uint8_t(runMode));
+	for(uint8_t i = 0; r && i < s.line_count; ++i)
+	    r = co_await cs.SendLine(s.lines[i], s.line_ops[i]);
+	if (r)
+	    r = co_await cs.SaveConfig();
+	for(auto const& [id, p] : kReadBack)
+	{
+	    if (r && (s.read_back & id))
+		r = co_await cs.Update(p);
+	}
+	auto e = co_await cs.End();
+	co_return r ? e : r;
+    }
+
+    //a request on the fiber: its session, then what handle_request does for the others
+    static CoTask co_request(sensor_t &s)
+    {
+	const uint8_t id = id_of(s);
+	auto const *pMode = std::get_if<run_mode_t>(&s.request);
+	auto r = co_await config_session(s, pMode ? int8_t(pMode->mode) : -1);
+	if (!r)
+	    report_err(s, r.error(), err_of(s.request));
+	else
+	{
+	    std::visit(overloaded{
+		    [&](apply_cfg_t const& v){ if (g_upd) g_upd(id, v.ids | cfg_id_t::Response); }
+		    ,[&](activate_preset_t const& v){
+			presets::set_active(id, v.k);
+			if (g_upd) g_upd(id, cfg_id_t::All | cfg_id_t::Preset);
 		    }
-		    ,[](reset_cfg_t const& v){  
-			if (auto r = c4001
-				.GetConfigurator()
-				.ResetConfig(); !r)
-			{
-			    if (g_err) g_err(err_t::ResetConfig);
-			}
-			else if (g_upd)
-			    g_upd(cfg_id_t::All);
+		    //there is no getter for the mode: the frames the sensor
+		    //sends afterwards tell which one is active
+		    ,[&](run_mode_t const& v){ s.run_mode = v.mode; }
+		    ,[](save_cfg_t const&){}
+		    ,[&](auto const&){ if (g_upd) g_upd(id, s.read_back); }
+		}, s.request);
+	}
+	s.dev.BeginOp(kIdleOp);
+	save_timing(s);
+	co_return r;
+    }
+
+    //what came of a supervisor action
+    static void supervised(sensor_t &s, health::supervisor_t::action_t a, bool ok)
+    {
+	using action_t = health::supervisor_t::action_t;
+	auto &m = metrics::sensor_health(id_of(s));
+	const uint8_t id = id_of(s);
+	switch(a)
+	{
+	    case action_t::None:
+		break;
+	    case action_t::Probe:
+		++m.probes;
+		s.health.OnProbe(ok, k_uptime_get());
+		break;
+	    case action_t::Resync:
+		if (auto ms = s.health.OnResync(ok, k_uptime_get()); ms != health::supervisor_t::kNone)
+		{
+		    ++m.recoveries;
+		    m.last_recovery_ms = (uint32_t)ms;
+		    m.max_recovery_ms = std::max(m.max_recovery_ms, m.last_recovery_ms);
+		    //clears the error the loss was reported with
+		    if (std::exchange(s.lost, false))
+			notify_err(id, err_t::Ok);
+		    if (g_upd)
+			g_upd(id, cfg_id_t::All);
+		}
+		break;
+	    case action_t::Restart:
+		++m.restarts;
+		s.health.OnRestart(k_uptime_get());
+		break;
+	}
+	check_lost(s);
+	save_timing(s);
+    }
+
+    //the resync is one session: the last run mode set and the whole cached
+    //config, saved and read back (lines prepared by supervise)
+    static CoTask co_supervise(sensor_t &s, health::supervisor_t::action_t a)
+    {
+	using action_t = health::supervisor_t::action_t;
+	dfr::C4001::ExpectedResult r(std::ref(s.dev));
+	if (a == action_t::Probe)
+	    r = co_await s.dev.CoProbe();
+	else if (a == action_t::Resync)
+	    r = co_await config_session(s, s.run_mode);
+	else
+	    r = co_await s.dev.CoRestart();
+	supervised(s, a, (bool)r);
+	co_return r;
+    }
+
+    //One slice of the sensor output, up to a request (post cancels it) or
+    //until nothing looks at the frames any more
+    static CoTask co_stream(sensor_t &s)
+    {
+	const uint8_t id = id_of(s);
+	dfr::C4001::ExpectedResult r(std::ref(s.dev));
+	{
+	    dfr::C4001::FrameStream fs(s.dev);
+	    s.health.OnStream(true, k_uptime_get());
+	    const int64_t end = k_uptime_get() + kStreamSliceMs;
+	    while(r && k_uptime_get() < end && !s.queued && s.frames_wanted)
+	    {
+		auto got = fs.Poll([&](dfr::frames::frame_t const& f){
+			s.health.OnAlive(k_uptime_get());
+			g_frame(id, f);
+		    }, 0);
+		if (!got)
+		    r = std::unexpected(got.error());
+		else if (!got->v)
+		{
+		    if (int e = co_await s.dev.BytesAvailable(int(end - k_uptime_get())); e != 0 && e != -EAGAIN)
+			r = std::unexpected(Err{err::site_t::ChannelReadSome, e}.In(Op::Stream));
+		}
+	    }
+	}
+	//given way to a request: no error
+	if (!r && dfr::C4001::IsCancelled(r.error()))
+	    r = std::ref(s.dev);
+	//silence is only judged while the output is read
+	if (!r || s.queued || !s.frames_wanted)
+	    s.health.OnStream(false, k_uptime_get());
+	s.dev.BeginOp(kIdleOp);
+	//an error here is a broken line or a sensor restart: don't spin on it
+	if (!r)
+	    k_work_reschedule_for_queue(&c4001_wq, &s.work, K_MSEC(kRetryMs));
+	co_return r;
+    }
+
+    /**********************************************************************/
+    /* Calibration                                                        */
+    /**********************************************************************/
+    //the sensor output right after sensorStart is not representative
+    constexpr int kCalibSettleMs = 1000;
+
+    calibration_t calibration_result(uint8_t id)
+    {
+	return id < kSensors ? g_sensors[id].calibration.Load() : calibration_t{};
+    }
+
+    static void run_calibration(sensor_t &s, calibrate_t const& v)
+    {
+	using state_t = calibration_t::state_t;
+	calibration_t res{.state = state_t::Running};
+	s.calibration.Store(res);
+
+	const uint8_t id = id_of(s);
+	auto forward = [id](dfr::frames::frame_t const& f){ if (g_frame) g_frame(id, f); };
+	calib::sweep_t sweep;
+	bool ok = true;
+	//reported if the sweep fails
+	Err why{err::site_t::CalibNoCleanLevel};
+	//the levels tried are not saved: the sensor flash is written once,
+	//for the levels chosen, and an aborted sweep leaves it as it was
+	for(bool more = true; more && ok;)
+	{
+	    const uint8_t level = sweep.Level();
+	    {
+		auto cfg = s.dev.GetConfigurator();
+		auto r = cfg.SwitchToSpeedDistanceMode()
+		    .and_then([&](Cfg &cfg){ return cfg.SetSensitivity(level, level); });
+		ok = (bool)r;
+		if (!ok)
+		    why = r.error();
+	    }
+	    if (!ok)
+		break;
+	    auto collect = [&](dfr::frames::frame_t const& f){
+		forward(f);
+		if (f.kind == dfr::frames::kind_t::Target)
+		    sweep.OnTargetFrame(f.targets, f.energy);
+	    };
+	    //any new request aborts the calibration: it may take minutes
+	    auto r = s.dev.StreamFrames(kCalibSettleMs, forward, requests_pending)
+		.and_then([&](dfr::C4001 &c){ return c.StreamFrames(v.step_s * 1000, collect, requests_pending); });
+	    if (!r)
+		why = r.error();
+	    else if (requests_pending())
+		why = Err{err::site_t::CalibAborted};
+	    ok = r.has_value() && !requests_pending();
+	    if (ok)
+		more = sweep.Next();
+	}
+
+	res.frames = (uint16_t)std::min<uint32_t>(sweep.Frames(), UINT16_MAX);
+	res.ghosts = (uint16_t)std::min<uint32_t>(sweep.Ghosts(), UINT16_MAX);
+	res.energy_mean = sweep.Floor().m_Mean;
+	res.energy_std = sweep.Floor().StdDev();
+	res.energy_max = sweep.Floor().m_Max;
+
+	//keep the previous sensitivity unless a quiet level was found
+	auto prev = current_config(s);
+	ok = ok && sweep.Found();
+	uint8_t hold = ok ? sweep.Hold() : prev.sensitivity_hold;
+	uint8_t detect = ok ? sweep.Detect() : prev.sensitivity_detect;
+	auto cfg = s.dev.GetConfigurator();
+	auto r = v.run_mode ? cfg.SwitchToSpeedDistanceMode() : cfg.SwitchToPresenceMode();
+	r = r.and_then([&](Cfg &cfg){ return cfg.SetSensitivity(detect, hold); });
+	//restoring the previous levels needs no save, they still are in flash
+	if (ok)
+	    r = r.and_then([](Cfg &cfg){ return cfg.SaveConfig(); });
+	r = r.and_then([](Cfg &cfg){ return cfg.UpdateSensitivity(); });
+	if (r)
+	    s.run_mode = v.run_mode;
+	ok = ok && r;
+
+	auto applied = s.dev.GetConfig();
+	res.sensitivity_detect = applied.m_SensitivityTrigger;
+	res.sensitivity_hold = applied.m_SensitivityHold;
+	res.state = ok ? state_t::Done : state_t::Failed;
+	s.calibration.Store(res);
+	if (!ok)
+	{
+	    notify_err(id, err_t::Calibrate, r ? why : r.error());
+	}
+	else if (g_upd)
+	    g_upd(id, cfg_id_t::Sensitivity | cfg_id_t::Calibration);
+    }
+
+    /**********************************************************************/
+    /* Firmware update                                                    */
+    /**********************************************************************/
+    //one update at a time, whichever sensor it is for; worker only
+    static fw_status_t g_fw;
+    static SeqLocked<fw_status_t> g_published_fw;
+    //the frame being sent, too big for the worker stack
+    static uint8_t g_fw_frame[fwupd::kFrameSize];
+
+    void update_firmware(uint8_t id)
+    {
+	post(id, fw_update_t{});
+    }
+
+    fw_status_t fw_status()
+    {
+	return g_published_fw.Load();
+    }
+
+#if defined(C4001_FW_IMAGE)
+    static int image_read(void *ctx, size_t off, uint8_t *p, size_t len)
+    {
+	return flash_area_read(static_cast<const struct flash_area*>(ctx), sizeof(fw_image_t) + off, p, len);
+    }
+
+    //header sane and the CRC over the image right: a broken image must not
+    //get as far as the bootloader. Read in small chunks, never all of it.
+    static Err open_image(fwupd::source_t &src)
+    {
+	const struct flash_area *fa;
+	if (int r = flash_area_open(FIXED_PARTITION_ID(c4001_image), &fa); r != 0)
+	    return Err{err::site_t::FwSourceRead, r};
+	fw_image_t h;
+	if (int r = flash_area_read(fa, 0, &h, sizeof(h)); r != 0)
+	    return Err{err::site_t::FwSourceRead, r};
+	if (h.magic != kFwImageMagic || !h.size || h.size > fa->fa_size - sizeof(h))
+	    return Err{err::site_t::FwImageInvalid};
+	uint32_t crc = 0;
+	uint8_t buf[64];
+	for(size_t off = 0; off < h.size; off += sizeof(buf))
+	{
+	    size_t n = std::min<size_t>(sizeof(buf), h.size - off);
+	    if (int r = image_read((void*)fa, off, buf, n); r != 0)
+		return Err{err::site_t::FwSourceRead, r};
+	    crc = crc32_ieee_update(crc, buf, n);
+	}
+	if (crc != h.crc32)
+	    return Err{err::site_t::FwImageInvalid};
+	src = fwupd::source_t{.size = h.size, .read = image_read, .ctx = (void*)fa};
+	return {};
+    }
+#else
+    //updates not enabled (CONFIG_C4001_FW_UPDATE) or no 'c4001_image' partition
+    static Err open_image(fwupd::source_t &)
+    {
+	return Err{err::site_t::FwSourceRead, IS_ENABLED(CONFIG_C4001_FW_UPDATE) ? -ENODEV : -ENOTSUP};
+    }
+#endif
+
+    static void publish_fw(fw_status_t::state_t st)
+    {
+	g_fw.state = st;
+	g_published_fw.Store(g_fw);
+    }
+
+    static void on_fw_progress(void *, fwupd::progress_t const& p)
+    {
+	g_fw.progress = p;
+	g_published_fw.Store(g_fw);
+	if (p.blocks % 16 == 0)
+	    DLOG("c4001 fw: {} of {} bytes, {} B/s", p.bytes, p.total, p.BytesPerSec());
+    }
+
+    static void run_fw_update(sensor_t &s)
+    {
+	using state_t = fw_status_t::state_t;
+	const uint8_t id = id_of(s);
+	auto fail = [&](Err e){
+	    g_fw.err = e.In(dfr::C4001::Op::FwUpdate);
+	    publish_fw(state_t::Failed);
+	    notify_err(id, err_t::FwUpdate, g_fw.err);
+	};
+	g_fw = {.id = id};
+	publish_fw(state_t::Checking);
+	fwupd::source_t src;
+	if (Err e = open_image(src); e.site != err::site_t::None)
+	    return fail(e);
+
+	g_fw.progress.total = uint32_t(src.size);
+	publish_fw(state_t::Uploading);
+	//still there after a failed upload, asking for the image
+	if (!s.in_bootloader)
+	{
+	    if (auto r = s.dev.EnterBootloader(); !r)
+		return fail(r.error());
+	    s.in_bootloader = true;
+	}
+	fwupd::Uploader up(s.dev, g_fw_frame);
+	auto r = up.Run(src, on_fw_progress, nullptr);
+	if (!r)
+	{
+	    //bootloaders may start the old application once the upload is
+	    //cancelled; if not, the sensor is left alone until the next try
+	    (void)s.dev.Sleep(dfr::C4001::kRestartTimeout);
+	    if (s.dev.Probe())
+		s.in_bootloader = false;
+	    g_fw.in_bootloader = s.in_bootloader;
+	    return fail(r.error());
+	}
+	s.in_bootloader = false;
+	g_fw.progress = *r;
+	publish_fw(state_t::Rebooting);
+	DLOG("c4001[{}] fw: {} bytes in {} ms, {} resends", id, r->bytes, r->elapsed_ms, r->resends);
+
+	//the bootloader starts the application once it has the image
+	(void)s.dev.Sleep(dfr::C4001::kRestartTimeout);
+	if (auto r = s.dev.ReloadConfig(); !r)
+	    return fail(r.error());
+	publish_fw(state_t::Done);
+	if (g_upd)
+	    g_upd(id, cfg_id_t::All);
+    }
+
+    //The requests that block the worker: long (calibration, firmware
+    //update), rare (reset, restart, reload) or not talking to the sensor;
+    //the others are on the fiber, see co_request
+    static void handle_request(sensor_t &s, QueueItem const& q)
+    {
+	const uint8_t id = id_of(s);
+	std::visit(
+	    overloaded{
+		[&](store_preset_t const& v){  
+		    if (!presets::store(v.k, current_config(s)))
+			notify_err(id, err_t::StorePreset, Err{err::site_t::PresetStore});
+		}
+		,[&](calibrate_t const& v){  
+		    run_calibration(s, v);
+		}
+		,[&](reset_cfg_t const& v){  
+		    if (auto r = s.dev
+			    .GetConfigurator()
+			    .ResetConfig(); !r)
+		    {
+			report_err(s, r.error(), err_t::ResetConfig);
 		    }
-		    ,[](restart_cfg_t const& v){  
-			if (auto r = c4001
-				.GetConfigurator()
-				.Restart(); !r)
-			{
-			    if (g_err) g_err(err_t::Restart);
-			}
-			else if (g_upd)
-			    g_upd(cfg_id_t::All);
+		    else if (g_upd)
+			g_upd(id, cfg_id_t::All);
+		}
+		,[&](restart_cfg_t const& v){  
+		    if (auto r = s.dev
+			    .GetConfigurator()
+			    .Restart(); !r)
+		    {
+			report_err(s, r.error(), err_t::Restart);
 		    }
-		    ,[](reload_cfg_t const& v){  
-			if (auto r = c4001
-				.GetConfigurator()
-				.ReloadConfig(); !r)
-			{
-			    if (g_err) g_err(err_t::ReloadConfig);
-			}
-			else if (g_upd)
-			    g_upd(cfg_id_t::All);
+		    else if (g_upd)
+			g_upd(id, cfg_id_t::All);
+		}
+		,[&](reload_cfg_t const& v){  
+		    if (auto r = s.dev
+			    .GetConfigurator()
+			    .ReloadConfig(); !r)
+		    {
+			report_err(s, r.error(), err_t::ReloadConfig);
 		    }
-		},
-		q
-	    );
+		    else if (g_upd)
+			g_upd(id, cfg_id_t::All);
+		}
+		//supervised again by on_sensor_work if it left the bootloader
+		,[&](fw_update_t const&){  
+		    run_fw_update(s);
+		}
+		,[&](diag_t const& v){  
+		    v.fn(s.dev, v.ctx);
+		    k_sem_give(v.done);
+		}
+		,[](auto const&){}
+	    },
+	    q
+	);
+    }
+
+    /**********************************************************************/
+    /* Per sensor scheduling                                              */
+    /**********************************************************************/
+    static void next_request(sensor_t &s)
+    {
+	QueueItem q;
+	s.q >> q;
+	--s.queued;
+	s.dev.BeginOp(op_tag(++s.seq, q.index()));
+	if (on_fiber(q))
+	{
+	    s.request = q;
+	    Err e = prepare_session(s, q);
+	    if (e.site == err::site_t::None)
+	    {
+		//co_request ends the operation
+		if (s.fiber.Start(co_request(s)))
+		    return;
+		e = Err{err::site_t::CoroNoFrame};
+	    }
+	    notify_err(id_of(s), err_of(q), e);
+	}
+	else
+	    handle_request(s, q);
+	s.dev.BeginOp(kIdleOp);
+	save_timing(s);
+	kick(s);
+    }
+
+    //starts what the supervisor wants done, false if nothing is due
+    static bool supervise(sensor_t &s)
+    {
+	using action_t = health::supervisor_t::action_t;
+	auto a = s.health.Evaluate(k_uptime_get());
+	if (a == action_t::None)
+	    return false;
+	if (a == action_t::Resync)
+	    (void)format_lines(s, current_config(s), cfg_id_t::All);
+	if (!s.fiber.Start(co_supervise(s, a)))
+	    k_work_reschedule_for_queue(&c4001_wq, &s.work, K_MSEC(kRetryMs));
+	return true;
+    }
+
+    static void start_stream(sensor_t &s)
+    {
+	s.dev.BeginOp(op_tag(++s.seq, kStreamIndex));
+	//co_stream ends the operation
+	if (s.fiber.Start(co_stream(s)))
+	    return;
+	s.dev.BeginOp(kIdleOp);
+	k_work_reschedule_for_queue(&c4001_wq, &s.work, K_MSEC(kRetryMs));
+    }
+
+    //Whatever is next for the sensor, one thing per run so that the other
+    //sensors interleave: its queued requests, then the supervisor if it is
+    //due, then a slice of its output. Not while its fiber is busy: the end
+    //of the conversation (on_fiber_done) comes back here.
+    static void on_sensor_work(struct k_work *w)
+    {
+	auto &s = *CONTAINER_OF(k_work_delayable_from_work(w), sensor_t, work);
+	schedule_idle();
+	if (s.fiber.Busy())
+	    return;
+	if (s.queued)
+	    return next_request(s);
+	//a probe or resync would only talk to the bootloader
+	if (s.in_bootloader)
+	    return;
+	if (supervise(s))
+	    return;
+	if (streamed(s))
+	    return start_stream(s);
+	//nothing to do before the supervisor is due
+	if (int64_t at = s.health.Deadline(); at != health::supervisor_t::kNoDeadline)
+	    k_work_reschedule_for_queue(&c4001_wq, &s.work, K_MSEC(std::max<int64_t>(at - k_uptime_get(), 0)));
+    }
+
+    static void on_fiber_done(coro::Fiber &f)
+    {
+	kick(*CONTAINER_OF(&f, sensor_t, fiber));
+    }
+
+    /**********************************************************************/
+    /* UART power                                                         */
+    /**********************************************************************/
+    //Every exchange pushes the deadline out; streaming holds the UART for
+    //a whole slice, so only sensors nothing takes frames from (no frame
+    //callback, or set_frames_wanted(false)) get to suspend it between requests.
+    static void schedule_idle()
+    {
+	int64_t next = dfr::C4001::kNoDeadline;
+	for(auto &s : g_sensors)
+	{
+	    if (s.ready)
+		next = std::min(next, s.dev.IdleDeadline());
+	}
+	if (next == dfr::C4001::kNoDeadline)
+	    return;
+	k_work_reschedule_for_queue(&c4001_wq, &g_idle_work, K_MSEC(std::max<int64_t>(next - k_uptime_get(), 0)));
+    }
+
+    static void on_idle_work(struct k_work *)
+    {
+	int64_t now = k_uptime_get();
+	for(auto &s : g_sensors)
+	{
+	    if (s.ready && s.dev.SuspendIfIdle(now))
+		DLOG("c4001[{}]: UART suspended", id_of(s));
 	}
+	schedule_idle();
     }
 }
+
+SETTINGS_STATIC_HANDLER_DEFINE(c4001_timing, c4001::kSettingsTiming, nullptr, c4001::timing_set, nullptr, nullptr);
@@ -1,10 +1,21 @@
 #ifndef C4001_TASK_HPP_
 #define C4001_TASK_HPP_
+#include <zephyr/devicetree.h>
 #include "lib/lib_dfr_c4001.h"
+#include "lib/lib_fw_upload.h"
 #include <utility>
+#include <algorithm>
+
+//one per enabled 'dfr,c4001' devicetree node, see dts/bindings/dfr,c4001.yaml
+#define C4001_SENSORS DT_NUM_INST_STATUS_OKAY(dfr_c4001)
 
 namespace c4001
 {
+    //sensors are addressed by their devicetree instance number
+    constexpr uint8_t kSensors = C4001_SENSORS;
+    static_assert(kSensors > 0, "no 'dfr,c4001' node enabled in the devicetree");
+    static_assert(kSensors <= 9, "sensor ids are single digit settings keys");
+
     enum class cfg_id_t: uint8_t
     {
         Range           = 1 << 0,
@@ -13,11 +24,36 @@ namespace c4001
         Sensitivity     = 1 << 3,
         InhibitDuration = 1 << 4,
         All = Range | RangeTrig | Delay | Sensitivity | InhibitDuration,
+
+        //not a config part: active preset changed
+        Preset          = 1 << 5,
+
+        //not a config part: calibration finished, see calibration_result()
+        Calibration     = 1 << 6,
+
+        //not a config part: requests a config response to be sent after the update
+        Response        = 1 << 7,
     };
     constexpr bool operator&(cfg_id_t i1, cfg_id_t i2) { return (std::to_underlying(i1) & std::to_underlying(i2)) != 0; }
+    constexpr cfg_id_t operator|(cfg_id_t i1, cfg_id_t i2) { return cfg_id_t(std::to_underlying(i1) | std::to_underlying(i2)); }
+    constexpr cfg_id_t& operator|=(cfg_id_t &i1, cfg_id_t i2) { return i1 = i1 | i2; }
+
+    //full set of sensor parameters as applied in one go
+    struct config_t
+    {
+        float range_from;
+        float range_to;
+        float range_trig;
+        float inhibit_duration;
+        float detect_delay;
+        float clear_delay;
+        uint8_t sensitivity_detect;
+        uint8_t sensitivity_hold;
+    };
 
     enum class err_t
     {
+        //also reported once the supervisor has brought a lost sensor back
         Ok,
         Range,
         RangeTrig,
@@ -28,25 +64,173 @@ namespace c4001
         ResetConfig,
         Restart,
         ReloadConfig,
+        ApplyConfig,
+        StorePreset,
+        ActivatePreset,
+        RunMode,
+        Calibrate,
+        //not answering even to a resync; the supervisor keeps restarting it
+        SensorLost,
+        FwUpdate,
+    };
+
+    //outcome of the last calibrate()
+    struct calibration_t
+    {
+        enum class state_t: uint8_t
+        {
+            Idle,
+            Running,
+            Done,
+            Failed,
+        };
+        state_t state = state_t::Idle;
+        uint8_t sensitivity_detect = 0;
+        uint8_t sensitivity_hold = 0;
+        //over all steps: frames seen and those with a (ghost) target
+        uint16_t frames = 0;
+        uint16_t ghosts = 0;
+        //noise floor: energy of every target frame (0 without a target)
+        //at the most sensitive level, what the levels were chosen by
+        float energy_mean = 0;
+        float energy_std = 0;
+        float energy_max = 0;
+    };
+    //all callbacks get the id of the sensor they are about;
+    //'why' is what error_log() records for it (none for Ok)
+    using err_callback_t = void(*)(uint8_t id, err_t, Err why);
+    using upd_callback_t = void(*)(uint8_t id, cfg_id_t);
+    //called on the c4001 worker for every presence/target frame the sensor outputs,
+    //right after it is decoded
+    using frame_callback_t = void(*)(uint8_t id, dfr::frames::frame_t const&);
+    //Initializes sensor 'id'; all sensors share one worker and one set of callbacks.
+    //With 'frame' set the worker streams sensor output whenever it has no requests.
+    //Requests for a sensor that failed setup are dropped.
+    dfr::C4001* setup(uint8_t id, err_callback_t err, upd_callback_t upd, frame_callback_t frame = nullptr);
+
+    void set_range(uint8_t id, float from, float to);
+    void set_range_from(uint8_t id, float v);
+    void set_range_to(uint8_t id, float v);
+    void set_range_trig(uint8_t id, float trig);
+    void set_detect_delay(uint8_t id, float v);
+    void set_clear_delay(uint8_t id, float v);
+    void set_detect_clear_delay(uint8_t id, float detect, float clear);
+    void set_detect_sensitivity(uint8_t id, uint8_t s);
+    void set_hold_sensitivity(uint8_t id, uint8_t s);
+    void set_sensitivity(uint8_t id, uint8_t detect, uint8_t hold);
+    void set_inhibit_duration(uint8_t id, float dur);
+    //applies the parts of 'cfg' selected by 'ids' within one sensor stop/save/start cycle
+    void apply_config(uint8_t id, config_t const& cfg, cfg_id_t ids);
+    //stores the current sensor config as preset 'k'
+    void store_preset(uint8_t id, uint8_t k);
+    //streams preset 'k' to the sensor within one stop/save/start cycle
+    void activate_preset(uint8_t id, uint8_t k);
+    //0 - presence frames only, 1 - speed/distance (target) frames
+    void set_run_mode(uint8_t id, uint8_t mode);
+    //Whether anything looks at the frames of sensor 'id' (default: yes).
+    //Without a consumer its output isn't streamed, so its UART suspends when idle.
+    void set_frames_wanted(uint8_t id, bool wanted);
+    //Empty room calibration: steps the sensitivity down from the most
+    //sensitive level watching the target frames for 'step_s' each.
+    //Hold and detect back off by a margin each from the first level that
+    //keeps the energy noise (mean + k std) well below that of the most
+    //sensitive one, see calib::sweep_t. The sensor is left in 'run_mode'.
+    void calibrate(uint8_t id, uint8_t step_s, uint8_t run_mode);
+    calibration_t calibration_result(uint8_t id);
+    void save_config(uint8_t id);
+    void reset_config(uint8_t id);
+    void restart(uint8_t id);
+
+    //Sensor firmware image as stored at the start of the 'c4001_image' flash
+    //partition, the image right after it. Whoever fills the partition writes
+    //the header last.
+    struct fw_image_t
+    {
+        uint32_t magic;
+        uint32_t size;
+        uint32_t crc32;     //IEEE, over the image
+        uint32_t reserved;
+    };
+    constexpr uint32_t kFwImageMagic = 0x57463443; //"C4FW"
+
+    //progress of the last update_firmware()
+    struct fw_status_t
+    {
+        enum class state_t: uint8_t
+        {
+            Idle,
+            Checking,       //image CRC
+            Uploading,
+            Rebooting,      //image sent, waiting for the application
+            Done,
+            Failed,
+        };
+        state_t state = state_t::Idle;
+        uint8_t id = 0;
+        fwupd::progress_t progress;
+        Err err;            //Failed only
+        //Failed with the sensor still in its bootloader: not supervised
+        //until update_firmware gets an image through
+        bool in_bootloader = false;
+    };
+    //Checks the image in the 'c4001_image' partition, restarts sensor 'id'
+    //into its bootloader and streams the image to it, then reloads its
+    //config. Takes minutes at 9600 baud; requests queue up meanwhile.
+    //Fails with err_t::FwUpdate, also without the partition and, -ENOTSUP,
+    //unless built with CONFIG_C4001_FW_UPDATE (the bootloader protocol is
+    //assumed, see lib_fw_upload.h).
+    void update_firmware(uint8_t id);
+    //consistent snapshot, safe to call from any thread
+    fw_status_t fw_status();
+
+    //Diagnostics (shell).
+    //Runs fn on the c4001 worker in between requests, so it has the sensor
+    //line to itself, and waits for it to return. Waits behind whatever is
+    //queued, a calibration included. False if sensor 'id' is not there.
+    using diag_fn_t = void(*)(dfr::C4001 &dev, void *ctx);
+    bool run_diag(uint8_t id, diag_fn_t fn, void *ctx);
+    //read only access for the counters, nullptr if sensor 'id' is not there
+    dfr::C4001 const* device(uint8_t id);
+    //worker stack never touched so far, bytes; -ENOTSUP without CONFIG_THREAD_STACK_INFO
+    int worker_stack_unused();
+
+    //one error as reported through err_callback_t
+    struct error_entry_t
+    {
+        uint32_t at_ms;     //uptime
+        //the failed exchange (err.op is a dfr::C4001::Op), or for errors
+        //that aren't one (SensorLost, StorePreset, ...) a Worker site
+        Err err;
+        uint8_t id;
+        err_t what;
+    };
+    constexpr size_t kErrorLog = 16;
+
+    //last kErrorLog errors of all sensors (Ok is not an error)
+    struct error_log_t
+    {
+        uint32_t total = 0;     //ever logged, entries holds the last min(total, kErrorLog)
+        error_entry_t entries[kErrorLog]{};
+
+        size_t size() const { return std::min<size_t>(total, kErrorLog); }
+        //0 - newest
+        error_entry_t const& newest(size_t i) const { return entries[(total - 1 - i) % kErrorLog]; }
+        //newest entry of sensor 'id', nullptr if there is none
+        error_entry_t const* last(uint8_t id) const
+        {
+            for(size_t i = 0; i < size(); ++i)
+            {
+                if (newest(i).id == id)
+                    return &newest(i);
+            }
+            return nullptr;
+        }
     };
-    using err_callback_t = void(*)(err_t);
-    using upd_callback_t = void(*)(cfg_id_t);
-    dfr::C4001* setup(err_callback_t err, upd_callback_t upd);
-
-    void set_range(float from, float to);
-    void set_range_from(float v);
-    void set_range_to(float v);
-    void set_range_trig(float trig);
-    void set_detect_delay(float v);
-    void set_clear_delay(float v);
-    void set_detect_clear_delay(float detect, float clear);
-    void set_detect_sensitivity(uint8_t s);
-    void set_hold_sensitivity(uint8_t s);
-    void set_sensitivity(uint8_t detect, uint8_t hold);
-    void set_inhibit_duration(float dur);
-    void save_config();
-    void reset_config();
-    void restart();
+    //consistent snapshot, safe to call from any thread
+    error_log_t error_log();
+    //prints every byte sent to and received from the sensor
+    //(builds with the UART byte dump only, see lib/lib_uart_trace.h)
+    void set_trace(uint8_t id, bool on);
 }
 
 #endif
@@ -0,0 +1,26 @@
+#ifndef FRAME_USE_HPP_
+#define FRAME_USE_HPP_
+#include <cstdint>
+
+namespace frame_use
+{
+    //target_report_interval: no target reporting
+    static constexpr uint16_t kTargetReportOff = 0xffff;
+
+    //What reads the frames of a sensor: zones, the approach predictor and
+    //target reporting. With none of them the sensor isn't streamed and its
+    //UART suspends between requests, occupancy follows the pin alone.
+    //The defaults are those of a fresh device (zb_zcl_c4001_t): pin only.
+    struct cfg_t
+    {
+        bool zones = false;                                 //any zone enabled
+        uint16_t approach_lead = 0;                         //ms, 0 - off
+        uint16_t target_report_interval = kTargetReportOff; //ms
+    };
+
+    constexpr bool wanted(cfg_t const& c)
+    {
+        return c.zones || c.approach_lead > 0 || c.target_report_interval != kTargetReportOff;
+    }
+}
+#endif
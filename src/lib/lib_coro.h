@@ -0,0 +1,307 @@
+#ifndef LIB_CORO_H_
+#define LIB_CORO_H_
+
+//Conversations as C++20 coroutines on a Zephyr work queue.
+//A Fiber runs one chain of coroutines (Task) at a time. A coroutine that has
+//to wait suspends on an awaitable derived from Wait: the fiber hands its poll
+//events to k_work_poll and the queue thread is free for other fibers and
+//work items until one of them gets ready or the deadline comes, then the
+//chain is resumed on the queue. Several conversations interleave that way
+//on one stack, each at its own wait.
+//Frames never come from the heap: g_Frames hands out CORO_FRAME_SLOTS slots
+//of CORO_FRAME_SIZE bytes (set and reported by CMakeLists.txt). A coroutine
+//that gets no slot doesn't run, awaiting it gives Err{CoroNoFrame}.
+#include <zephyr/kernel.h>
+#include <atomic>
+#include <bit>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <utility>
+#include "lib_ret_err.h"
+
+#ifndef CORO_FRAME_SLOTS
+#define CORO_FRAME_SLOTS 12
+#endif
+#ifndef CORO_FRAME_SIZE
+#define CORO_FRAME_SIZE 384
+#endif
+
+namespace coro
+{
+    //Fixed size frame slots, lock free.
+    template<size_t Slots, size_t Size>
+    class FramePool
+    {
+        static_assert(Slots > 0 && Slots <= 32, "one bit per slot");
+    public:
+        static constexpr size_t kSlots = Slots;
+        static constexpr size_t kSize = Size;
+
+        struct Stats
+        {
+            uint32_t m_Used = 0;
+            uint32_t m_MaxUsed = 0;
+            uint32_t m_MaxSize = 0;     //biggest frame asked for, fitting or not
+            uint32_t m_Failures = 0;    //no slot free or the frame too big
+        };
+
+        void* Alloc(size_t n)
+        {
+            Raise(m_MaxSize, (uint32_t)n);
+            if (n <= Size)
+            {
+                uint32_t used = m_Used.load();
+                while(used != kAll)
+                {
+                    //lowest free slot
+                    uint32_t bit = ~used & (used + 1);
+                    if (m_Used.compare_exchange_weak(used, used | bit))
+                    {
+                        Raise(m_MaxUsed, (uint32_t)std::popcount(used | bit));
+                        return m_Slots[std::countr_zero(bit)].m_Data;
+                    }
+                }
+            }
+            ++m_Failures;
+            return nullptr;
+        }
+
+        void Free(void *p)
+        {
+            size_t i = (Slot*)p - m_Slots;
+            m_Used.fetch_and(~(1u << i));
+        }
+
+        Stats GetStats() const
+        {
+            return {.m_Used = (uint32_t)std::popcount(m_Used.load()), .m_MaxUsed = m_MaxUsed.load()
+                , .m_MaxSize = m_MaxSize.load(), .m_Failures = m_Failures.load()};
+        }
+    private:
+        static constexpr uint32_t kAll = Slots == 32 ? ~0u : (1u << Slots) - 1;
+
+        static void Raise(std::atomic<uint32_t> &a, uint32_t v)
+        {
+            for(uint32_t m = a.load(); v > m && !a.compare_exchange_weak(m, v);)
+                ;
+        }
+
+        struct alignas(std::max_align_t) Slot
+        {
+            std::byte m_Data[Size];
+        };
+        Slot m_Slots[Slots];
+        std::atomic<uint32_t> m_Used{0};
+        std::atomic<uint32_t> m_MaxUsed{0};
+        std::atomic<uint32_t> m_MaxSize{0};
+        std::atomic<uint32_t> m_Failures{0};
+    };
+
+    using Frames = FramePool<CORO_FRAME_SLOTS, CORO_FRAME_SIZE>;
+    inline Frames g_Frames;
+
+    class Fiber;
+
+    //what all promises share: frames from the pool, the fiber the chain runs
+    //on and who awaits the coroutine
+    struct PromiseBase
+    {
+        Fiber *m_pFiber = nullptr;
+        std::coroutine_handle<> m_Continuation;
+
+        static void* operator new(size_t n) noexcept { return g_Frames.Alloc(n); }
+        static void operator delete(void *p) noexcept { g_Frames.Free(p); }
+        static void operator delete(void *p, size_t) noexcept { g_Frames.Free(p); }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        //back to the awaiting coroutine; the root one stays suspended, Fiber destroys it
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+            template<class P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+            {
+                if (auto c = h.promise().m_Continuation)
+                    return c;
+                return std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        //built without exceptions
+        void unhandled_exception() noexcept {}
+    };
+
+    //Lazily started coroutine with result R, a std::expected with ::Err as
+    //its error. Awaiting it runs it on the fiber of the awaiting one.
+    template<class R>
+    class [[nodiscard]] Task
+    {
+    public:
+        struct promise_type: PromiseBase
+        {
+            R m_Result{std::unexpected(Err{})};
+
+            Task get_return_object() noexcept { return Task{handle_t::from_promise(*this)}; }
+            static Task get_return_object_on_allocation_failure() noexcept { return Task{}; }
+            void return_value(R r) noexcept { m_Result = std::move(r); }
+        };
+        using handle_t = std::coroutine_handle<promise_type>;
+
+        Task(Task &&t) noexcept: m_H(std::exchange(t.m_H, {})) {}
+        Task(Task const&) = delete;
+        Task& operator=(Task const&) = delete;
+        ~Task()
+        {
+            if (m_H)
+                m_H.destroy();
+        }
+
+        //false if it got no frame
+        explicit operator bool() const { return (bool)m_H; }
+
+        bool await_ready() const noexcept { return !m_H; }
+        template<class P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> caller) noexcept
+        {
+            m_H.promise().m_pFiber = caller.promise().m_pFiber;
+            m_H.promise().m_Continuation = caller;
+            return m_H;
+        }
+        R await_resume() noexcept
+        {
+            if (!m_H)
+                return std::unexpected(Err{err::site_t::CoroNoFrame});
+            return std::move(m_H.promise().m_Result);
+        }
+    private:
+        friend class Fiber;
+        Task() = default;
+        explicit Task(handle_t h): m_H(h) {}
+
+        handle_t m_H;
+    };
+
+    //Base of the awaitables. Check() decides: a result (0 or a negative errno)
+    //or kNotYet. It runs right away and then each time one of the events gets
+    //ready; the deadline ends the wait with -EAGAIN. The events only wake the
+    //fiber up, whatever they stand for is taken by Check().
+    class Wait
+    {
+    public:
+        static constexpr int kNotYet = 1;
+
+        bool await_ready() noexcept
+        {
+            m_Result = m_Check(*this);
+            if (m_Result == kNotYet && sys_timepoint_expired(m_End))
+                m_Result = -EAGAIN;
+            return m_Result != kNotYet;
+        }
+        template<class P>
+        void await_suspend(std::coroutine_handle<P> h) noexcept;
+        int await_resume() const noexcept { return m_Result; }
+    protected:
+        using check_t = int (*)(Wait &);
+        Wait(check_t check, k_timeout_t t): m_End(sys_timepoint_calc(t)), m_Check(check) {}
+
+        k_poll_event m_Events[2];
+        int m_N = 0;
+    private:
+        friend class Fiber;
+        k_timepoint_t m_End;
+        check_t m_Check;
+        int m_Result = kNotYet;
+    };
+
+    //Runs one coroutine chain at a time on a work queue. Start, the chain
+    //and the done callback all run on that queue, so does whatever else
+    //touches what the chain works on.
+    class Fiber
+    {
+    public:
+        using on_done_t = void (*)(Fiber &);
+
+        void Init(struct k_work_q *pQ, on_done_t onDone)
+        {
+            m_pQ = pQ;
+            m_OnDone = onDone;
+            k_work_poll_init(&m_Work, on_work);
+        }
+
+        //Runs 't' up to its first wait. Its result is dropped: the chain
+        //reports on its own. False if 't' got no frame or the fiber is busy.
+        template<class R>
+        bool Start(Task<R> &&t)
+        {
+            if (Busy() || !t)
+                return false;
+            auto h = std::exchange(t.m_H, {});
+            h.promise().m_pFiber = this;
+            m_Root = h;
+            Resume(h);
+            return true;
+        }
+
+        bool Busy() const { return (bool)m_Root; }
+    private:
+        friend class Wait;
+
+        void Suspend(Wait &w, std::coroutine_handle<> h)
+        {
+            m_pWait = &w;
+            m_Waiting = h;
+            Submit();
+        }
+
+        void Submit()
+        {
+            for(int i = 0; i < m_pWait->m_N; ++i)
+                m_pWait->m_Events[i].state = K_POLL_STATE_NOT_READY;
+            (void)k_work_poll_submit_to_queue(m_pQ, &m_Work, m_pWait->m_Events, m_pWait->m_N, sys_timepoint_timeout(m_pWait->m_End));
+        }
+
+        void Resume(std::coroutine_handle<> h)
+        {
+            h.resume();
+            if (!m_Root.done())
+                return;
+            std::exchange(m_Root, {}).destroy();
+            if (m_OnDone)
+                m_OnDone(*this);
+        }
+
+        static void on_work(struct k_work *pW)
+        {
+            auto &wp = *CONTAINER_OF(pW, struct k_work_poll, work);
+            auto &f = *CONTAINER_OF(&wp, Fiber, m_Work);
+            Wait &w = *f.m_pWait;
+            int r = wp.poll_result == 0 ? w.m_Check(w) : Wait::kNotYet;
+            if (r == Wait::kNotYet && sys_timepoint_expired(w.m_End))
+                r = -EAGAIN;
+            if (r == Wait::kNotYet)
+                return f.Submit();
+            w.m_Result = r;
+            f.Resume(std::exchange(f.m_Waiting, {}));
+        }
+
+        struct k_work_poll m_Work;
+        struct k_work_q *m_pQ = nullptr;
+        on_done_t m_OnDone = nullptr;
+        std::coroutine_handle<> m_Root;
+        std::coroutine_handle<> m_Waiting;
+        Wait *m_pWait = nullptr;
+    };
+
+    template<class P>
+    void Wait::await_suspend(std::coroutine_handle<P> h) noexcept
+    {
+        h.promise().m_pFiber->Suspend(*this, h);
+    }
+}
+
+#endif
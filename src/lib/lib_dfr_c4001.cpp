@@ -3,97 +3,221 @@
 
 #include <algorithm>
 #include <cstring>
-#include <cstdlib>
 #include "lib_dfr_c4001.h"
 
-#define DBG_UART Channel::DbgNow _dbg_uart{this}; 
-#define DBG_ME DbgNow _dbg_me{this}; 
-
-#define TRY_CFG(f, location) \
+#define TRY_CFG(f, op) \
             if (auto r = f; !r) \
-                return result<ExpectedResult>::to(r.error(), location)
+                return result<ExpectedResult>::to(r.error(), op)
 
-#define TRY_UART_CFG(f, location) \
+#define TRY_UART_CFG(f, op) \
             if (auto r = f; !r) \
-                return result<Configurator::ExpectedResult>::to(std::move(r), location)
+                return result<Configurator::ExpectedResult>::to(std::move(r), op)
 
 namespace dfr
 {
-    template<class T>
-    struct read_cfg_t
-    {
-        T min = 0;
-        T max = 0;
-    };
-    using read_float_cfg_t = read_cfg_t<float>;
-    using read_uint8_cfg_t = read_cfg_t<uint8_t>;
-
-    struct read_float_from_str_t
-    {
-        using functional_read_helper = void;
-        float &dstVar;
-        char until = ' ';
-        char dstStr[16];
-        bool consume_last = true;
-        read_float_cfg_t cfg{};
-
-        static constexpr size_t size() { return sizeof(dstStr); }
-        size_t rt_size() const { return sizeof(dstStr); }
-        auto run(uart::Channel &c) { 
-            using ExpectedResult = std::expected<uart::Channel::Ref, ::Err>;
-            auto r = uart::primitives::read_until_into(c, until, (uint8_t*)dstStr, sizeof(dstStr), consume_last, {}); 
-            if (!r) return r;
-            char *pEnd = dstStr;
-            dstVar = strtof(dstStr, &pEnd);
-            if (pEnd == dstStr)
-            {
-                return ExpectedResult(std::unexpected(::Err{"failed to convert"}));
-            }
-            if (cfg.min != cfg.max)
-            {
-                if (dstVar < cfg.min || dstVar > cfg.max)
-                    return ExpectedResult(std::unexpected(::Err{"failed validation"}));
-            }
-            return r;
-        } 
-    };
-
-    struct read_uint8_from_str_t
-    {
-        using functional_read_helper = void;
-        uint8_t &dstVar;
-        char until = ' ';
-        char dstStr[16];
-        bool consume_last = true;
-        read_uint8_cfg_t cfg{};
-
-        static constexpr size_t size() { return sizeof(dstStr); }
-        size_t rt_size() const { return sizeof(dstStr); }
-        auto run(uart::Channel &c) { 
-            using ExpectedResult = std::expected<uart::Channel::Ref, ::Err>;
-            auto r = uart::primitives::read_until_into(c, until, (uint8_t*)dstStr, sizeof(dstStr), consume_last, {}); 
-            if (!r) return r;
-            char *pEnd = dstStr;
-            dstVar = strtoul(dstStr, &pEnd, 10);
-            if (pEnd == dstStr)
-            {
-                return ExpectedResult(std::unexpected(::Err{"failed to convert"}));
-            }
-            if (cfg.min != cfg.max)
-            {
-                if (dstVar < cfg.min || dstVar > cfg.max)
-                    return ExpectedResult(std::unexpected(::Err{"failed validation"}));
-            }
-            return r;
-        } 
-    };
-
     template<size_t N>
     inline std::string_view to_sv(const uint8_t (&arr)[N])
     {
         return {(const char*)std::begin(arr), (const char*)std::end(arr) - 1};
     }
 
+    bool C4001::FormatInhibit(CmdLine &l, float v)
+    {
+        auto r = tools::format_to_sv(l.m_Line, "{} {:.1}", to_sv(kCmdSetInhibit), v);
+        l.m_Len = r.size();
+        return !r.empty();
+    }
+
+    bool C4001::FormatRange(CmdLine &l, float from, float to)
+    {
+        auto r = tools::format_to_sv(l.m_Line, "{} {:.2} {:.2}", to_sv(kCmdSetRange), from, to);
+        l.m_Len = r.size();
+        return !r.empty();
+    }
+
+    bool C4001::FormatTrigRange(CmdLine &l, float v)
+    {
+        auto r = tools::format_to_sv(l.m_Line, "{} {:.1}", to_sv(kCmdSetTrigRange), v);
+        l.m_Len = r.size();
+        return !r.empty();
+    }
+
+    bool C4001::FormatSensitivity(CmdLine &l, uint8_t trig, uint8_t hold)
+    {
+        auto r = tools::format_to_sv(l.m_Line, "{} {} {}", to_sv(kCmdSetSensitivity), hold, trig);
+        l.m_Len = r.size();
+        return !r.empty();
+    }
+
+    bool C4001::FormatLatency(CmdLine &l, float detect, float clear)
+    {
+        auto r = tools::format_to_sv(l.m_Line, "{} {:.1} {:.1}", to_sv(kCmdSetLatency), detect, clear);
+        l.m_Len = r.size();
+        return !r.empty();
+    }
+
+    auto C4001::Timing::Timeout(CmdKind k) const -> duration_ms_t
+    {
+        auto const& p = kCmdPolicies[std::to_underlying(k)];
+        return m_Kinds[std::to_underlying(k)].Timeout(p.m_Initial, kMinReplyWait, p.m_Max);
+    }
+
+    void C4001::SetTiming(Timing const& t)
+    {
+        for(size_t k = 0; k < kCmdKinds; ++k)
+            m_Timing.m_Kinds[k] = t.m_Kinds[k].Valid() ? t.m_Kinds[k] : RttEstimator{};
+    }
+
+    auto C4001::KindOf(std::string_view cmd) -> CmdKind
+    {
+        if (cmd == to_sv(kCmdSensorStop)) return CmdKind::Stop;
+        if (cmd == to_sv(kCmdSensorStart)) return CmdKind::Start;
+        if (cmd == to_sv(kCmdSaveConfig)) return CmdKind::Save;
+        if (cmd == to_sv(kCmdResetConfig)) return CmdKind::Reset;
+        if (cmd.starts_with("get")) return CmdKind::Get;
+        //pre-rendered lines carry their arguments
+        return CmdKind::Set;
+    }
+
+    bool C4001::AttemptDone(CmdKind k, ExpectedResult const& r, int64_t took, duration_ms_t timeout, uint8_t tries)
+    {
+	auto const& p = kCmdPolicies[std::to_underlying(k)];
+	auto &est = m_Timing.m_Kinds[std::to_underlying(k)];
+	if (r)
+	{
+	    est.Add((float)took);
+	    return true;
+	}
+	if (IsCancelled(r.error()))
+	{
+	    Count(m_ExchangeStats.m_Cancels);
+	    return true;
+	}
+	if (took < timeout)
+	{
+	    Count(m_ExchangeStats.m_Failures);
+	    return true;
+	}
+	Count(m_ExchangeStats.m_Timeouts);
+	est.OnTimeout((float)p.m_Max);
+	if (tries >= p.m_Retries)
+	{
+	    Count(m_ExchangeStats.m_Failures);
+	    return true;
+	}
+	Count(m_ExchangeStats.m_Retries);
+	//whatever is left of the late reply
+	(void)Drain(false);
+	return false;
+    }
+
+    template<class F>
+    auto C4001::WithReply(Param p, F &&f)
+    {
+	using namespace grammar;
+	switch(p)
+	{
+	    case Param::Range:
+		return f(to_sv(kCmdGetRange), find<kCmdGetRange> >> find<"Response ">
+			>> num<&Config::m_MinRange, 6, 250, 10> >> ws
+			>> num<&Config::m_MaxRange, 6, 250, 10> >> crlf >> done_or_error, Op::GetRange);
+	    case Param::TrigRange:
+		return f(to_sv(kCmdGetTrigRange), find<kCmdGetTrigRange> >> find<"Response ">
+			>> num<&Config::m_TrigRange, 6, 250, 10> >> crlf >> done_or_error, Op::GetTrigRange);
+	    case Param::Sensitivity:
+		return f(to_sv(kCmdGetSensitivity), find<kCmdGetSensitivity> >> find<"Response ">
+			>> num<&Config::m_SensitivityHold, 0, 9> >> ws
+			>> num<&Config::m_SensitivityTrigger, 0, 9> >> crlf >> done_or_error, Op::GetSensitivity);
+	    case Param::Latency:
+		return f(to_sv(kCmdGetLatency), find<kCmdGetLatency> >> find<"Response ">
+			>> num<&Config::m_DetectLatency, 0, 100> >> ws
+			>> num<&Config::m_ClearLatency, 0, 1500> >> crlf >> done_or_error, Op::GetLatency);
+	    case Param::Inhibit:
+	    default:
+		return f(to_sv(kCmdGetInhibit), find<kCmdGetInhibit> >> find<"Response ">
+			>> num<&Config::m_Inhibit, 0, 255> >> crlf >> done_or_error, Op::GetInhibit);
+	}
+    }
+
+    auto C4001::CoSendLine(std::string_view cmd, std::string_view arg) -> CoTask
+    {
+	if (auto r = Wake(); !r)
+	    co_return std::unexpected(r.error());
+	const std::string_view parts[] = {cmd, arg.empty() ? std::string_view{} : " ", arg, "\r\n"};
+	for(auto part : parts)
+	{
+	    if (part.empty())
+		continue;
+	    if (int e = co_await TxReady(); e != 0)
+		co_return std::unexpected(Err{err::site_t::ChannelSend, e});
+	    if (auto r = SendReady((const uint8_t*)part.data(), part.size()); !r)
+		co_return std::unexpected(r.error());
+	}
+	co_return std::ref(*this);
+    }
+
+    auto C4001::CoCmdAttempt(std::string_view line) -> CoTask
+    {
+	if (auto r = co_await CoSendLine(line); !r)
+	    co_return r;
+	//byte by byte as SendCmd: what follows Done (frames after sensorStart) stays
+	struct none_t{} none;
+	auto p = decltype(grammar::done_or_error)::parser();
+	const duration_ms_t wait = GetDefaultWait();
+	const int64_t start = k_uptime_get();
+	while(true)
+	{
+	    uint8_t b;
+	    if (ReadAvailable(&b, 1))
+	    {
+		switch(p.Feed(b, none))
+		{
+		    case grammar::step_t::More: continue;
+		    case grammar::step_t::Done: co_return std::ref(*this);
+		    default: co_return std::unexpected(Err{err::site_t::CmdErrorResp});
+		}
+	    }
+	    const duration_ms_t left = wait - duration_ms_t(k_uptime_get() - start);
+	    if (left <= 0)
+		co_return std::unexpected(Err{err::site_t::CmdTimeout});
+	    if (int e = co_await BytesAvailable(left); e != 0 && e != -EAGAIN)
+		co_return std::unexpected(Err{err::site_t::ChannelReadSome, e});
+	}
+    }
+
+    auto C4001::RawAttempt(std::string_view line, std::span<char> reply, size_t &got) -> ExpectedResult
+    {
+        got = 0;
+        TRY_UART_COMM(SendCmdNoResp(line), Op::None);
+        struct none_t{} none;
+        auto p = decltype(grammar::done_or_error)::parser();
+        const duration_ms_t wait = GetDefaultWait();
+        const int64_t start = k_uptime_get();
+        uint8_t buf[16];
+        while(true)
+        {
+            const duration_ms_t left = wait - duration_ms_t(k_uptime_get() - start);
+            if (left <= 0)
+                return std::unexpected(Err{err::site_t::RawTimeout});
+            auto r = ReadSome(buf, sizeof(buf), left);
+            if (!r)
+                return std::unexpected(r.error());
+            for(size_t i = 0; i < r->v; ++i)
+            {
+                if (got + 1 < reply.size())
+                    reply[got++] = (char)buf[i];
+                if (!reply.empty())
+                    reply[got] = 0;
+                switch(p.Feed(buf[i], none))
+                {
+                    case grammar::step_t::More: break;
+                    case grammar::step_t::Done: return std::ref(*this);
+                    default: return std::unexpected(Err{err::site_t::RawErrorResp});
+                }
+            }
+        }
+    }
+
     C4001::C4001(const struct device *pUART):
         uart::Channel(pUART)
     {
@@ -102,8 +226,10 @@ namespace dfr
     C4001::ExpectedResult C4001::Init()
     {
         SetDefaultWait(kDefaultWait);
-        TRY_UART_COMM(Configure(), "Init");
-        TRY_UART_COMM(Open(), "Init");
+        TRY_UART_COMM(Configure(), Op::Init);
+        TRY_UART_COMM(Open(), Op::Init);
+        if constexpr (kAlwaysOnRx)
+            TRY_UART_COMM(StartContinuousReading(m_recvBuf, sizeof(m_recvBuf)), Op::Init);
         return ReloadConfig();
     }
 
@@ -116,27 +242,59 @@ namespace dfr
     C4001::ExpectedResult C4001::ReloadConfig()
     {
         auto cfg = GetConfigurator();
-        TRY_CFG(cfg.UpdateHWVersion(), "ReloadConfig.HW");
-        TRY_CFG(cfg.UpdateSWVersion(), "ReloadConfig.SW");
-        TRY_CFG(cfg.UpdateInhibit(), "ReloadConfig.Inhibit");
-        TRY_CFG(cfg.UpdateRange(), "ReloadConfig.Range");
-        TRY_CFG(cfg.UpdateTrigRange(), "ReloadConfig.TrigRange");
-        TRY_CFG(cfg.UpdateSensitivity(), "ReloadConfig.Sensitivity");
-        TRY_CFG(cfg.UpdateLatency(), "ReloadConfig.Latency");
-        TRY_CFG(cfg.End(), "ReloadConfig.End");
+        TRY_CFG(cfg.UpdateHWVersion(), Op::Reload);
+        TRY_CFG(cfg.UpdateSWVersion(), Op::Reload);
+        TRY_CFG(cfg.UpdateInhibit(), Op::Reload);
+        TRY_CFG(cfg.UpdateRange(), Op::Reload);
+        TRY_CFG(cfg.UpdateTrigRange(), Op::Reload);
+        TRY_CFG(cfg.UpdateSensitivity(), Op::Reload);
+        TRY_CFG(cfg.UpdateLatency(), Op::Reload);
+        TRY_CFG(cfg.End(), Op::Reload);
         return std::ref(*this);
     }
 
     C4001::ExpectedResult C4001::Restart()
     {
-        using namespace uart::primitives;
+        //no Configurator: a hung sensor wouldn't answer its sensorStop
+        TRY_UART_COMM(SendCmdNoResp(to_sv(kCmdRestart), to_sv(kCmdRestartParamNormal)), Op::Restart);
+        TRY_UART_COMM(Sleep(kRestartTimeout), Op::Restart);
         return std::ref(*this);
     }
 
+    C4001::ExpectedResult C4001::EnterBootloader()
+    {
+        //no Configurator: sensorStart at its end would go to the bootloader
+        TRY_UART_COMM(SendCmdNoResp(to_sv(kCmdRestart), to_sv(kCmdRestartParamBootloader)), Op::Bootloader);
+        TRY_UART_COMM(WaitAllSent(), Op::Bootloader);
+        return std::ref(*this);
+    }
+
+    C4001::ExpectedResult C4001::Probe()
+    {
+        auto cfg = GetConfigurator();
+        TRY_CFG(cfg.End(), Op::Probe);
+        return std::ref(*this);
+    }
+
+    auto C4001::CoProbe() -> CoTask
+    {
+	CoSession cs(*this);
+	(void)co_await cs.Begin();
+	CO_TRY_UART_COMM(cs.End(), Op::Probe);
+	co_return std::ref(*this);
+    }
+
+    auto C4001::CoRestart() -> CoTask
+    {
+	CO_TRY_UART_COMM(CoSendLine(to_sv(kCmdRestart), to_sv(kCmdRestartParamNormal)), Op::Restart);
+	if (int e = co_await Deadline(kRestartTimeout); e != -EAGAIN)
+	    co_return std::unexpected(Err{err::site_t::ChannelSleep, e}.In(Op::Restart));
+	co_return std::ref(*this);
+    }
+
     C4001::ExpectedResult C4001::FactoryReset()
     {
-        using namespace uart::primitives;
-        SetDefaultWait(duration_ms_t(1000));
+        //the slow exchanges have a timeout of their own, see kCmdPolicies
         return ReloadConfig();
     }
 
@@ -146,7 +304,7 @@ namespace dfr
         m_CtrResult(std::ref(*this))
     {
         if (auto r = StopSensor(); !r)
-            m_CtrResult = result<ExpectedResult>::to(std::move(r),  "Configurator::Configurator");
+            m_CtrResult = result<ExpectedResult>::to(std::move(r), Op::StopSensor);
     }
 
     C4001::Configurator::~Configurator()
@@ -156,53 +314,31 @@ namespace dfr
 
     auto C4001::Configurator::UpdateLatency() -> ExpectedResult
     {
-        if (!m_CtrResult) return m_CtrResult;
-        using namespace uart::primitives;
-        read_float_from_str_t readDetect{m_C.m_DetectLatency, ' '};
-        readDetect.cfg = {.min = 0, .max = 100};
-        read_float_from_str_t readClear{m_C.m_ClearLatency, '\r'};
-        readClear.cfg = {.min = 0, .max = 1500};
-        TRY_UART_CFG(m_C.SendCmdWithParamsStd(
-                        to_sv(kCmdGetLatency),
-                        to_send(), 
-                        to_recv(readDetect, readClear)), "");
-        return std::ref(*this);
+	return Update(Param::Latency);
     }
 
     auto C4001::Configurator::SetLatency(float detect, float clear) -> ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        char buf[16]; 
-        auto arg = tools::format_to_sv(buf, "{:.1} {:.1}", detect, clear);
-        if (arg.empty())
-            return std::unexpected(Err{"Configurator::SetLatency fmt", 0});
-        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSetLatency), arg), "Configurator::SetLatency");
+        CmdLine l;
+        if (!FormatLatency(l, detect, clear))
+            return std::unexpected(Err{err::site_t::FormatArgs}.In(Op::SetLatency));
+        TRY_UART_CFG(m_C.SendCmd(l.sv()), Op::SetLatency);
 
         return std::ref(*this);
     }
 
     auto C4001::Configurator::UpdateSensitivity() -> ExpectedResult
     {
-        if (!m_CtrResult) return m_CtrResult;
-        using namespace uart::primitives;
-        read_uint8_from_str_t readHold{m_C.m_SensitivityHold, ' '};
-        read_uint8_from_str_t readTrig{m_C.m_SensitivityTrigger, '\r'};
-        readHold.cfg = readTrig.cfg = {.min = 0, .max = 9};
-
-        TRY_UART_CFG(m_C.SendCmdWithParamsStd(
-                        to_sv(kCmdGetSensitivity),
-                        to_send(), 
-                        to_recv(readHold, readTrig)), "");
-        return std::ref(*this);
+	return Update(Param::Sensitivity);
     }
 
     auto C4001::Configurator::SetSensitivity(uint8_t trig, uint8_t hold) -> ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        char buf[16]; 
-        auto arg = tools::format_to_sv(buf, "{} {}", hold, trig);
-        if (arg.empty()) return std::unexpected(Err{"Configurator::SetSensitivity fmt", 0});
-        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSetSensitivity), arg), "Configurator.SetSensitivity");
+        CmdLine l;
+        if (!FormatSensitivity(l, trig, hold)) return std::unexpected(Err{err::site_t::FormatArgs}.In(Op::SetSensitivity));
+        TRY_UART_CFG(m_C.SendCmd(l.sv()), Op::SetSensitivity);
 
         return std::ref(*this);
     }
@@ -212,8 +348,8 @@ namespace dfr
         if (!m_CtrResult) return m_CtrResult;
         char buf[16]; 
         auto arg = tools::format_to_sv(buf, "255 {}", val);
-        if (arg.empty()) return std::unexpected(Err{"Configurator::SetSensitivityTrig fmt", 0});
-        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSetSensitivity), arg), "Configurator.SetSensitivityTrig");
+        if (arg.empty()) return std::unexpected(Err{err::site_t::FormatArgs}.In(Op::SetSensitivity));
+        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSetSensitivity), arg), Op::SetSensitivity);
 
         return std::ref(*this);
     }
@@ -223,158 +359,165 @@ namespace dfr
         if (!m_CtrResult) return m_CtrResult;
         char buf[16]; 
         auto arg = tools::format_to_sv(buf, "{} 255", val);
-        if (arg.empty()) return std::unexpected(Err{"Configurator::SetSensitivityHold fmt", 0});
-        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSetSensitivity), arg), "Configurator::SetSensitivityHold");
+        if (arg.empty()) return std::unexpected(Err{err::site_t::FormatArgs}.In(Op::SetSensitivity));
+        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSetSensitivity), arg), Op::SetSensitivity);
 
         return std::ref(*this);
     }
 
     auto C4001::Configurator::UpdateTrigRange() -> ExpectedResult
     {
-        if (!m_CtrResult) return m_CtrResult;
-        using namespace uart::primitives;
-        read_float_from_str_t readTrig{m_C.m_TrigRange, '\r'};
-        readTrig.cfg = {.min = 0.6, .max = 25};
-        TRY_UART_CFG(m_C.SendCmdWithParamsStd(
-                        to_sv(kCmdGetTrigRange),
-                        to_send(), 
-                        to_recv(readTrig)), "");
-        return std::ref(*this);
+	return Update(Param::TrigRange);
     }
 
     auto C4001::Configurator::SetTrigRange(float v) -> ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        char buf[8]; 
-        auto arg = tools::format_to_sv(buf, "{:.1}", v);
-        if (arg.empty()) return std::unexpected(Err{"Configurator::SetTrigRange fmt", 0});
-        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSetTrigRange), arg), "Configurator.SetTrigRange");
+        CmdLine l;
+        if (!FormatTrigRange(l, v)) return std::unexpected(Err{err::site_t::FormatArgs}.In(Op::SetTrigRange));
+        TRY_UART_CFG(m_C.SendCmd(l.sv()), Op::SetTrigRange);
         return std::ref(*this);
     }
 
     auto C4001::Configurator::UpdateRange() noexcept -> ExpectedResult
     {
-        if (!m_CtrResult) return m_CtrResult;
-        using namespace uart::primitives;
-        read_float_from_str_t readFrom{m_C.m_MinRange, ' '};
-        read_float_from_str_t readTo{m_C.m_MaxRange, '\r'};
-        readFrom.cfg = readTo.cfg = {.min = 0.6, .max = 25};
-        TRY_UART_CFG(m_C.SendCmdWithParamsStd(
-                        to_sv(kCmdGetRange),
-                        to_send(), 
-                        to_recv(readFrom, readTo)), "");
-        return std::ref(*this);
+	return Update(Param::Range);
     }
 
     auto C4001::Configurator::SetRange(float from, float to) noexcept -> ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        char buf[16];
-        auto arg = tools::format_to_sv(buf, "{:.2} {:.2}", from, to);
-        if (arg.empty()) return std::unexpected(Err{"Configurator::SetRange fmt", 0});
-        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSetRange), arg), "Configurator.SetRange");
+        CmdLine l;
+        if (!FormatRange(l, from, to)) return std::unexpected(Err{err::site_t::FormatArgs}.In(Op::SetRange));
+        TRY_UART_CFG(m_C.SendCmd(l.sv()), Op::SetRange);
 
         return std::ref(*this);
     }
 
     auto C4001::Configurator::UpdateInhibit() noexcept -> ExpectedResult
+    {
+	return Update(Param::Inhibit);
+    }
+
+    auto C4001::Configurator::SetInhibit(float v) noexcept -> ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        using namespace uart::primitives;
-        read_float_from_str_t readInhibit{m_C.m_Inhibit, '\r'};
-        readInhibit.cfg = {.min = 0, .max = 255};
-        TRY_UART_CFG(m_C.SendCmdWithParamsStd(
-                        to_sv(kCmdGetInhibit),
-                        to_send(), 
-                        to_recv(readInhibit)), "");
+        CmdLine l;
+        if (!FormatInhibit(l, v)) return std::unexpected(Err{err::site_t::FormatArgs}.In(Op::SetInhibit));
+        TRY_UART_CFG(m_C.SendCmd(l.sv()), Op::SetInhibit);
+        return std::ref(*this);
+    }
+
+    auto C4001::Configurator::Update(Param p) -> ExpectedResult
+    {
+	if (!m_CtrResult) return m_CtrResult;
+	return m_C.WithReply(p, [&](std::string_view cmd, auto g, Op op) -> ExpectedResult {
+	    TRY_UART_CFG(m_C.Query(cmd, g, m_C.m_Cfg), op);
+	    m_C.PublishConfig();
+	    return std::ref(*this);
+	});
+    }
 
+    auto C4001::Configurator::SendLine(CmdLine const& l) -> ExpectedResult
+    {
+        if (!m_CtrResult) return m_CtrResult;
+        TRY_UART_CFG(m_C.SendCmd(l.sv()), Op::SendLine);
         return std::ref(*this);
     }
 
-    auto C4001::Configurator::SetInhibit(float v) noexcept -> ExpectedResult
+    auto C4001::Configurator::Raw(std::string_view line, std::span<char> reply, size_t &got) -> ExpectedResult
     {
+        got = 0;
         if (!m_CtrResult) return m_CtrResult;
-        char buf[8]; 
-        auto arg = tools::format_to_sv(buf, "{:.1}", v);
-        if (arg.empty()) return std::unexpected(Err{"Configurator::SetInhibit fmt", 0});
-        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSetInhibit), arg), "Configurator.SetInhibit");
+        TRY_UART_CFG(m_C.Exchange(KindOf(line.substr(0, line.find(' '))), [&]{ return m_C.RawAttempt(line, reply, got); }), Op::Raw);
         return std::ref(*this);
     }
 
     auto C4001::Configurator::SwitchToPresenceMode() noexcept -> ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        TRY_UART_CFG(m_C.SendCmdNoResp(to_sv(kCmdSetRunApp), to_sv(kCmdAppModePresence)), "");
-        k_msleep(500);
+        TRY_UART_CFG(m_C.SendCmdNoResp(to_sv(kCmdSetRunApp), to_sv(kCmdAppModePresence)), Op::RunMode);
+        TRY_UART_CFG(m_C.Sleep(kSwitchWait), Op::RunMode);
         return std::ref(*this);
     }
 
     auto C4001::Configurator::SwitchToSpeedDistanceMode() noexcept -> ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        TRY_UART_CFG(m_C.SendCmdNoResp(to_sv(kCmdSetRunApp), to_sv(kCmdAppModeSpeedDistance)), "");
-        k_msleep(500);
+        TRY_UART_CFG(m_C.SendCmdNoResp(to_sv(kCmdSetRunApp), to_sv(kCmdAppModeSpeedDistance)), Op::RunMode);
+        TRY_UART_CFG(m_C.Sleep(kSwitchWait), Op::RunMode);
         return std::ref(*this);
     }
 
     auto C4001::Configurator::Restart() noexcept -> ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        TRY_UART_CFG(m_C.SendCmdNoResp(to_sv(kCmdRestart), to_sv(kCmdRestartParamNormal)), "");
-        k_msleep(500);
+        TRY_UART_CFG(m_C.SendCmdNoResp(to_sv(kCmdRestart), to_sv(kCmdRestartParamNormal)), Op::Restart);
+        TRY_UART_CFG(m_C.Sleep(kSwitchWait), Op::Restart);
         return std::ref(*this);
     }
 
     void C4001::Configurator::StartDbg()
     {
-        m_C.m_Dbg = true;
+        m_C.SetTrace(true);
     }
 
     void C4001::Configurator::StopDbg()
     {
-        m_C.m_Dbg = false;
+        m_C.SetTrace(false);
     }
 
     auto C4001::Configurator::ReloadConfig() noexcept -> ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        return UpdateInhibit()
-            .and_then([](Configurator &cfg){ return cfg.UpdateSensitivity(); })
-            .and_then([](Configurator &cfg){ return cfg.UpdateLatency(); })
-            .and_then([](Configurator &cfg){ return cfg.UpdateRange(); })
-            .and_then([](Configurator &cfg){ return cfg.UpdateTrigRange(); })
-            .and_then([](Configurator &cfg){ return cfg.UpdateHWVersion(); })
-            .and_then([](Configurator &cfg){ return cfg.UpdateSWVersion(); });
+        //each Update* tags its own op
+        if (auto r = UpdateInhibit(); !r) return r;
+        if (auto r = UpdateSensitivity(); !r) return r;
+        if (auto r = UpdateLatency(); !r) return r;
+        if (auto r = UpdateRange(); !r) return r;
+        if (auto r = UpdateTrigRange(); !r) return r;
+        if (auto r = UpdateHWVersion(); !r) return r;
+        return UpdateSWVersion();
     }
 
     auto C4001::Configurator::SaveConfig() noexcept -> ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSaveConfig)), "");
+        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSaveConfig)), Op::SaveConfig);
         return std::ref(*this);
     }
 
     auto C4001::Configurator::ResetConfig() noexcept -> ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdResetConfig)), "");
+        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdResetConfig)), Op::ResetConfig);
         return std::ref(*this);
     }
 
     auto C4001::Configurator::End() -> ExpectedResult
     {
         if (m_Finished)
-            return std::unexpected(Err{"Configurator::End unexpected finish"});
+            return std::unexpected(Err{err::site_t::SessionFinished});
         m_Finished = true;
         if (!m_CtrResult) return m_CtrResult;
-        TRY_UART_CFG(StartSensor(), "Configurator::End");
+        //the sensor must be started again even if the session got cancelled:
+        //no more cancels from here
+        m_C.EndOp();
+        if (m_C.WasCancelled())
+        {
+            //let the reply of the aborted command arrive and drop it
+            //so it's not mistaken for the reply to sensorStart
+            (void)m_C.Sleep(kCancelSettleWait);
+            (void)m_C.Drain(false);
+        }
+        TRY_UART_CFG(StartSensor(), Op::StartSensor);
         return std::ref(*this);
     }
 
     auto C4001::Configurator::StopSensor()->ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSensorStop)), "");
+        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSensorStop)), Op::StopSensor);
         return std::ref(*this);
     }
 
@@ -382,33 +525,88 @@ namespace dfr
     {
         if (!m_CtrResult) return m_CtrResult;
         //ChangeWait longerWait(*this, 300);
-        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSensorStart)), "");
+        TRY_UART_CFG(m_C.SendCmd(to_sv(kCmdSensorStart)), Op::StartSensor);
         return std::ref(*this);
     }
 
     auto C4001::Configurator::UpdateHWVersion()->ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        using namespace uart::primitives;
-        std::fill(std::begin(m_C.m_HWVersion.m_Version), std::end(m_C.m_HWVersion.m_Version), 0);
-        TRY_UART_CFG(m_C.SendCmdWithParams(to_sv(kCmdGetHWVersion), to_send(), to_recv(
-                        find_sv_t{"HardwareVersion:"},
-                        read_until_t{m_C.m_HWVersion.m_Version, '\r'}
-                        )), "");
-        *(std::end(m_C.m_HWVersion.m_Version) - 1) = 0;
+        using namespace grammar;
+        constexpr auto g = find<"HardwareVersion:"> >> text<&Version::m_Version> >> crlf >> done_or_error;
+        TRY_UART_CFG(m_C.Query(to_sv(kCmdGetHWVersion), g, m_C.m_Ver.m_HW), Op::GetVersion);
+        m_C.PublishVersions();
         return std::ref(*this);
     }
 
     auto C4001::Configurator::UpdateSWVersion()->ExpectedResult
     {
         if (!m_CtrResult) return m_CtrResult;
-        using namespace uart::primitives;
-        std::fill(std::begin(m_C.m_SWVersion.m_Version), std::end(m_C.m_SWVersion.m_Version), 0);
-        TRY_UART_CFG(m_C.SendCmdWithParams(to_sv(kCmdGetSWVersion), to_send(), to_recv(
-                        find_sv_t{"SoftwareVersion:"},
-                        read_until_t{m_C.m_SWVersion.m_Version, '\r'}
-                        )), "");
-        *(std::end(m_C.m_SWVersion.m_Version) - 1) = 0;
+        using namespace grammar;
+        constexpr auto g = find<"SoftwareVersion:"> >> text<&Version::m_Version> >> crlf >> done_or_error;
+        TRY_UART_CFG(m_C.Query(to_sv(kCmdGetSWVersion), g, m_C.m_Ver.m_SW), Op::GetVersion);
+        m_C.PublishVersions();
         return std::ref(*this);
     }
+
+    auto C4001::CoSession::Begin() -> CoTask
+    {
+	if (auto r = co_await m_C.CoSendCmd(to_sv(kCmdSensorStop), Op::StopSensor); !r)
+	{
+	    m_Err = r.error();
+	    co_return r;
+	}
+	co_return std::ref(m_C);
+    }
+
+    auto C4001::CoSession::End() -> CoTask
+    {
+	if (m_Finished)
+	    co_return std::unexpected(Err{err::site_t::SessionFinished});
+	m_Finished = true;
+	if (Failed())
+	    co_return std::unexpected(m_Err);
+	//as Configurator::End
+	m_C.EndOp();
+	if (m_C.WasCancelled())
+	{
+	    (void)co_await m_C.Deadline(kCancelSettleWait);
+	    (void)m_C.Drain(false);
+	}
+	co_return co_await m_C.CoSendCmd(to_sv(kCmdSensorStart), Op::StartSensor);
+    }
+
+    auto C4001::CoSession::SendLine(CmdLine const& l, Op op) -> CoTask
+    {
+	if (Failed())
+	    co_return std::unexpected(m_Err);
+	co_return co_await m_C.CoSendCmd(l.sv(), op);
+    }
+
+    auto C4001::CoSession::SaveConfig() -> CoTask
+    {
+	if (Failed())
+	    co_return std::unexpected(m_Err);
+	co_return co_await m_C.CoSendCmd(to_sv(kCmdSaveConfig), Op::SaveConfig);
+    }
+
+    auto C4001::CoSession::Update(Param p) -> CoTask
+    {
+	if (Failed())
+	    co_return std::unexpected(m_Err);
+	auto r = co_await m_C.WithReply(p, [&](std::string_view cmd, auto g, Op op){ return m_C.CoQuery(cmd, g, m_C.m_Cfg, op); });
+	if (r)
+	    m_C.PublishConfig();
+	co_return r;
+    }
+
+    auto C4001::CoSession::RunMode(uint8_t mode) -> CoTask
+    {
+	if (Failed())
+	    co_return std::unexpected(m_Err);
+	CO_TRY_UART_COMM(m_C.CoSendLine(to_sv(kCmdSetRunApp), to_sv(mode ? kCmdAppModeSpeedDistance : kCmdAppModePresence)), Op::RunMode);
+	if (int e = co_await m_C.Deadline(kSwitchWait); e != -EAGAIN)
+	    co_return std::unexpected(Err{err::site_t::ChannelSleep, e}.In(Op::RunMode));
+	co_return std::ref(m_C);
+    }
 }
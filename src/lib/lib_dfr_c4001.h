@@ -3,8 +3,14 @@
 
 #include <zephyr/drivers/uart.h>
 #include "lib_uart.h"
+#include "lib_coro.h"
 #include <span>
+#include <utility>
 #include "lib_uart_primitives.h"
+#include "lib_seqlock.h"
+#include "lib_rtt_estimator.h"
+#include "lib_reply_grammar.h"
+#include "lib_dfr_c4001_frames.h"
 #include <lib_type_traits.hpp>
 
 namespace dfr
@@ -90,15 +96,59 @@ namespace dfr
             using duration_ms_t = uart::duration_ms_t;
             static const constexpr duration_ms_t kRestartTimeout{2000};
             static const constexpr duration_ms_t kDefaultWait{350};
+            static const constexpr duration_ms_t kSwitchWait{500};
+            static const constexpr duration_ms_t kCancelSettleWait{50};
+            //RX runs from Init on instead of per session: no enable/disable
+            //handshake per session and no sensor output lost in between
+            static const constexpr bool kAlwaysOnRx = true;
+            //learned reply timeouts never go below
+            static const constexpr duration_ms_t kMinReplyWait{60};
 
             using Ref = std::reference_wrapper<C4001>;
-            struct Err
+            //one word, see lib_ret_err.h; Err::op is an Op
+            using Err = ::Err;
+            static bool IsCancelled(Err const& e) { return Channel::IsCancelled(e); }
+            //no answer in time; any reply, 'Error' or malformed, proves the sensor is there
+            static bool IsTimeout(Err const& e)
             {
-                ::Err uartErr;
-                const char *pLocation;
+                return e.Code() == -EAGAIN || e.site == err::site_t::QueryTimeout || e.site == err::site_t::RawTimeout
+                    || e.site == err::site_t::CmdTimeout;
+            }
+
+            //what the sensor was asked to do when an exchange failed
+            enum class Op: uint8_t
+            {
+                None,
+                Init,
+                Reload,
+                Restart,
+                Probe,
+                Stream,
+                StopSensor,
+                StartSensor,
+                GetVersion,
+                GetInhibit,
+                SetInhibit,
+                GetRange,
+                SetRange,
+                GetTrigRange,
+                SetTrigRange,
+                GetSensitivity,
+                SetSensitivity,
+                GetLatency,
+                SetLatency,
+                SendLine,
+                Raw,
+                RunMode,
+                SaveConfig,
+                ResetConfig,
+                Bootloader,
+                FwUpdate,
             };
 
             using ExpectedResult = std::expected<Ref, Err>;
+            //a conversation step as a coroutine, see CoSession
+            using CoTask = coro::Task<ExpectedResult>;
             struct CmdErr
             {
                 Err e;
@@ -116,6 +166,77 @@ namespace dfr
                 char m_Version[32];
             };
 
+            //what the sensor reports about itself, read along with the config
+            struct Versions
+            {
+                Version m_HW{};
+                Version m_SW{};
+            };
+
+            //sensor parameters as last read back from the sensor
+            struct Config
+            {
+                float m_Inhibit = 2;
+                float m_MinRange = 1.6f;
+                float m_MaxRange = 25.f;
+                float m_TrigRange = 0.f;
+                float m_DetectLatency = 0.f;
+                float m_ClearLatency = 0.f;
+                uint8_t m_SensitivityTrigger = 0;
+                uint8_t m_SensitivityHold = 0;
+            };
+
+            //complete 'set' command line (without the line ending), pre-rendered
+            //so that it can be stored and later sent as-is via Configurator::SendLine
+            struct CmdLine
+            {
+                char m_Line[32];
+                uint8_t m_Len = 0;
+
+                std::string_view sv() const { return {m_Line, m_Len}; }
+            };
+
+            //exchanges with a reply time estimate of their own
+            enum class CmdKind: uint8_t
+            {
+                Stop,       //sensorStop
+                Start,      //sensorStart
+                Get,        //get*, version queries
+                Set,        //set* lines
+                Save,       //saveConfig, writes the sensor flash
+                Reset,      //resetCfg
+            };
+            static constexpr size_t kCmdKinds = 6;
+
+            //what a session reads back from the sensor
+            enum class Param: uint8_t
+            {
+                Inhibit,
+                Range,
+                TrigRange,
+                Sensitivity,
+                Latency,
+            };
+
+            //learned reply times, worth keeping across reboots
+            struct Timing
+            {
+                RttEstimator m_Kinds[kCmdKinds];
+
+                duration_ms_t Timeout(CmdKind k) const;
+            };
+
+            //outcomes of Exchange, c4001 worker writes, anybody may read;
+            //all zero unless Trace::kCounters
+            struct ExchangeStats
+            {
+                uint32_t m_Exchanges = 0;
+                uint32_t m_Retries = 0;
+                uint32_t m_Timeouts = 0;    //attempts without a reply in time
+                uint32_t m_Failures = 0;    //final errors other than a cancel
+                uint32_t m_Cancels = 0;
+            };
+
         public:
 
             /**********************************************************************/
@@ -127,20 +248,66 @@ namespace dfr
             ExpectedResult Init();
             ExpectedResult ReloadConfig();
 
+            //sends resetSystem right away and waits for the sensor to boot
             ExpectedResult Restart();
+            //resetSystem 1: the sensor restarts into its serial bootloader, which
+            //then asks for an image (fwupd::Uploader, lib_fw_upload.h); RX keeps
+            //running so its first request isn't lost
+            ExpectedResult EnterBootloader();
             ExpectedResult FactoryReset();
-
-            const Version& GetHWVer() const { return m_HWVersion; }
-            const Version& GetSWVer() const { return m_SWVersion; }
-            auto GetInhibitDuration() const { return m_Inhibit; }
-            auto GetRangeFrom() const { return m_MinRange; }
-            auto GetRangeTo() const { return m_MaxRange; }
-            auto GetTriggerDistance() const { return m_TrigRange; }
-            auto GetDetectLatency() const { return m_DetectLatency; }
-            auto GetClearLatency() const { return m_ClearLatency; }
-            auto GetSensitivityHold() const { return m_SensitivityHold; }
-            auto GetSensitivityTrig() const { return m_SensitivityTrigger; }
+            //cheapest exchange the sensor has to answer: sensorStop + sensorStart
+            ExpectedResult Probe();
+            //Probe and Restart as coroutines, see CoSession
+            CoTask CoProbe();
+            CoTask CoRestart();
+
+            //consistent snapshots, safe to call from any thread
+            Version GetHWVer() const { return m_PublishedVer.Load().m_HW; }
+            Version GetSWVer() const { return m_PublishedVer.Load().m_SW; }
+            //version changes only when some value actually changed
+            Config GetConfig(uint32_t *pVersion = nullptr) const { return m_PublishedCfg.Load(pVersion); }
+            uint32_t GetConfigVersion() const { return m_PublishedCfg.Version(); }
+
+            auto GetInhibitDuration() const { return GetConfig().m_Inhibit; }
+            auto GetRangeFrom() const { return GetConfig().m_MinRange; }
+            auto GetRangeTo() const { return GetConfig().m_MaxRange; }
+            auto GetTriggerDistance() const { return GetConfig().m_TrigRange; }
+            auto GetDetectLatency() const { return GetConfig().m_DetectLatency; }
+            auto GetClearLatency() const { return GetConfig().m_ClearLatency; }
+            auto GetSensitivityHold() const { return GetConfig().m_SensitivityHold; }
+            auto GetSensitivityTrig() const { return GetConfig().m_SensitivityTrigger; }
+
+            //c4001 worker only
+            Timing const& GetTiming() const { return m_Timing; }
+            //entries that don't make sense start over
+            void SetTiming(Timing const& t);
+            duration_ms_t GetTimeout(CmdKind k) const { return m_Timing.Timeout(k); }
+            ExchangeStats const& GetExchangeStats() const { return m_ExchangeStats; }
+
+            static bool FormatInhibit(CmdLine &l, float v);
+            static bool FormatRange(CmdLine &l, float from, float to);
+            static bool FormatTrigRange(CmdLine &l, float v);
+            static bool FormatSensitivity(CmdLine &l, uint8_t trig, uint8_t hold);
+            static bool FormatLatency(CmdLine &l, float detect, float clear);
+
+            //Decodes the unsolicited sensor output for up to 'slice' ms.
+            //onFrame(frames::frame_t const&) is called for every complete frame,
+            //stop() is polled between reads and ends the slice early.
+            template<class OnFrame, class Stop>
+            ExpectedResult StreamFrames(duration_ms_t slice, OnFrame &&onFrame, Stop &&stop)
+            {
+                FrameStream s(*this);
+                k_timepoint_t end = sys_timepoint_calc(K_MSEC(slice));
+                while(!sys_timepoint_expired(end) && !stop())
+                {
+                    if (auto r = s.Poll(onFrame, kStreamPollWait); !r)
+                        return std::unexpected(r.error());
+                }
+                return std::ref(*this);
+            }
         private:
+            //how long a stream read waits before checking stop()
+            static const constexpr duration_ms_t kStreamPollWait{20};
 
             constexpr static const uint8_t kCmdSensorStop[] = "sensorStop";
             constexpr static const uint8_t kCmdSensorStart[] = "sensorStart";
@@ -172,25 +339,88 @@ namespace dfr
             constexpr static const uint8_t kCmdSetLatency[] = "setLatency";
             constexpr static const uint8_t kCmdGetLatency[] = "getLatency";
 
+            struct CmdPolicy
+            {
+                duration_ms_t m_Initial;    //until the first reply was timed
+                duration_ms_t m_Max;
+                uint8_t m_Retries;          //idempotent commands only
+            };
+            //indexed by CmdKind
+            static constexpr CmdPolicy kCmdPolicies[kCmdKinds] = {
+                {.m_Initial = kDefaultWait, .m_Max = 1000, .m_Retries = 1},    //Stop
+                {.m_Initial = kDefaultWait, .m_Max = 1000, .m_Retries = 1},    //Start
+                {.m_Initial = kDefaultWait, .m_Max = 1000, .m_Retries = 1},    //Get
+                {.m_Initial = kDefaultWait, .m_Max = 1000, .m_Retries = 1},    //Set: absolute values
+                {.m_Initial = 1000, .m_Max = 3000, .m_Retries = 0},            //Save
+                {.m_Initial = 1000, .m_Max = 3000, .m_Retries = 0},            //Reset
+            };
+
+            static CmdKind KindOf(std::string_view cmd);
+
+            static void Count(uint32_t &c)
+            {
+                if constexpr (Trace::kCounters)
+                    ++c;
+            }
+
+            //Runs attempt() with the reply timeout of its kind and feeds the
+            //time it took into the estimate. Only a reply that didn't come in
+            //time is retried: a cancel or an 'Error' reply is final.
+            template<class Attempt>
+            ExpectedResult Exchange(CmdKind k, Attempt &&attempt)
+            {
+                Count(m_ExchangeStats.m_Exchanges);
+                for(uint8_t tries = 0;; ++tries)
+                {
+                    const duration_ms_t timeout = m_Timing.Timeout(k);
+                    const int64_t start = k_uptime_get();
+                    ExpectedResult r = [&]{ ChangeWait w(*this, timeout); return attempt(); }();
+                    if (AttemptDone(k, r, k_uptime_get() - start, timeout, tries))
+                        return r;
+                }
+            }
+
+            //Exchange as a coroutine, attempt() being one as well; the final
+            //error is tagged with 'op'
+            template<class Attempt>
+            CoTask CoExchange(CmdKind k, Op op, Attempt attempt)
+            {
+                Count(m_ExchangeStats.m_Exchanges);
+                for(uint8_t tries = 0;; ++tries)
+                {
+                    const duration_ms_t timeout = m_Timing.Timeout(k);
+                    const int64_t start = k_uptime_get();
+                    ChangeWait w(*this, timeout);
+                    ExpectedResult r = co_await attempt();
+                    if (!AttemptDone(k, r, k_uptime_get() - start, timeout, tries))
+                        continue;
+                    if (!r)
+                        co_return result<ExpectedResult>::to(std::move(r), op);
+                    co_return r;
+                }
+            }
+
+            //one attempt of an exchange is over, 'took' ms after it started:
+            //counts it, true if 'r' is final
+            bool AttemptDone(CmdKind k, ExpectedResult const& r, int64_t took, duration_ms_t timeout, uint8_t tries);
+
             template<class Ret>
             struct result
             {
+                //the error travels as is, only tagged with 'op' unless an inner layer did
                 template<class E>
-                static Ret to(E &&e, const char* pLocation)
+                static Ret to(E &&e, Op op)
                 {
                     using PureE = std::remove_cvref_t<E>;
                     if constexpr(is_expected_type_v<PureE>)
-                    {
-                        if constexpr (std::is_same_v<PureE, Ret>)
-                            return std::move(e);
-                        else
-                            return to(e.error(), pLocation);
-                    }else if constexpr (std::is_same_v<PureE,::Err>)
-                        return Ret(std::unexpected(Err{e, pLocation}));
+                        return to(e.error(), op);
                     else if constexpr (std::is_same_v<PureE,Err>)
-                        return Ret(std::unexpected(e));
+                    {
+                        Err r = e;
+                        return Ret(std::unexpected(r.In(op)));
+                    }
                     else if constexpr (std::is_same_v<PureE,CmdErr>)
-                        return Ret(std::unexpected(e.e));
+                        return to(e.e, op);
                     else
                     {
                         static_assert(std::is_same_v<PureE,Err>, "Don't know how to convert passed type");
@@ -199,17 +429,18 @@ namespace dfr
                 }
             };
 
-#define TRY_UART_COMM(f, location) \
+#define TRY_UART_COMM(f, op) \
             if (auto r = f; !r) \
-                return result<ExpectedResult>::to(std::move(r), location)
+                return result<ExpectedResult>::to(std::move(r), op)
 
-            template<class... ToSend> static auto to_send(ToSend&&...args) { return std::forward_as_tuple(std::forward<ToSend>(args)...); }
-            template<class... ToRecv> static auto to_recv(ToRecv&&...args) { return std::forward_as_tuple(std::forward<ToRecv>(args)...); }
+#define CO_TRY_UART_COMM(f, op) \
+            if (auto r = co_await f; !r) \
+                co_return result<ExpectedResult>::to(std::move(r), op)
 
             template<class ToSend> 
             ExpectedResult SendTpl(ToSend &&arg) 
             {
-                TRY_UART_COMM(Sendable<ToSend>::send(*this, arg), "SendTpl");
+                TRY_UART_COMM(Sendable<ToSend>::send(*this, arg), Op::None);
                 return std::ref(*this);
             }
 
@@ -231,8 +462,8 @@ namespace dfr
                 };
                 send_one(cmd);
                 (send_one(std::forward<ToSend>(args)),...);
-                TRY_UART_COMM(_r, "SendArgs");
-                TRY_UART_COMM(Sendable<decltype("\r\n")>::send(*this, "\r\n"), "<endl>");
+                TRY_UART_COMM(_r, Op::None);
+                TRY_UART_COMM(Sendable<decltype("\r\n")>::send(*this, "\r\n"), Op::None);
                 //TRY_UART_COMM(uart::primitives::drain(*this, {.maxWait = 50}), "SendCmdNoResp.drain");
                 return std::ref(*this);
             }
@@ -242,6 +473,12 @@ namespace dfr
             ExpectedResult SendCmd(std::string_view cmd, ToSend&&...args) 
             { 
                 static_assert((Sendable<std::remove_cvref_t<ToSend>>::value && ... && true), "All arguments must be sendable");
+                return Exchange(KindOf(cmd), [&]{ return SendCmdAttempt(cmd, args...); });
+            }
+
+            template<class... ToSend> 
+            ExpectedResult SendCmdAttempt(std::string_view cmd, ToSend&&...args) 
+            { 
                 Channel::ExpectedResult _r(std::ref(*this));
                 bool first = true;
                 auto send_one = [&]<class SendArg>(SendArg &&a)
@@ -256,107 +493,154 @@ namespace dfr
                 };
                 send_one(cmd);
                 (send_one(std::forward<ToSend>(args)),...);
-                TRY_UART_COMM(_r, "SendArgs");
+                TRY_UART_COMM(_r, Op::None);
 
-                TRY_UART_COMM(Sendable<decltype("\r\n")>::send(*this, "\r\n"), "<endl>");
+                TRY_UART_COMM(Sendable<decltype("\r\n")>::send(*this, "\r\n"), Op::None);
 
                 //wait for an answer
                 using namespace uart::primitives;
                 if (auto r = find_any_str({}, *this, "Done\r\n", "Error\r\n"); !r)
-                    return std::unexpected(Err{r.error()});
+                    return std::unexpected(r.error());
                 else if (r->v != 0)//not 'Done', but 'Error'
-                    return std::unexpected(Err{{"SendCmd Error resp"}});
+                    return std::unexpected(Err{err::site_t::CmdErrorResp});
                 return std::ref(*this);
             }
 
-            template<class... ToSend, class... ToRecv> 
-            ExpectedResult SendCmdWithParams(std::string_view cmd, std::tuple<ToSend...> tosend, std::tuple<ToRecv...> torecv, bool dbg = false) 
-            { 
-                static_assert((Sendable<std::remove_cvref_t<ToSend>>::value && ... && true), "All arguments must be sendable");
-                Channel::ExpectedResult _r(std::ref(*this));
-                bool first = true;
-                auto send_one = [&]<class SendArg>(SendArg &&a)
+            //Sends 'cmd' and parses the reply with the grammar G (see lib_reply_grammar.h)
+            //into a copy of 't' that replaces 't' only once the reply is complete:
+            //a reply that breaks off or turns malformed halfway leaves 't' as it
+            //was. Reads in chunks and feeds every byte once; what follows the
+            //final 'Done' in the same chunk is dropped (nothing does while the
+            //sensor is stopped).
+            template<class G, class T>
+            ExpectedResult Query(std::string_view cmd, G, T &t)
+            {
+                return Exchange(CmdKind::Get, [&]{ return QueryAttempt<G>(cmd, t); });
+            }
+
+            template<class G, class T>
+            ExpectedResult QueryAttempt(std::string_view cmd, T &t)
+            {
+                TRY_UART_COMM(SendCmdNoResp(cmd), Op::None);
+                auto p = G::parser();
+                T parsed = t;
+                const duration_ms_t wait = GetDefaultWait();
+                const int64_t start = k_uptime_get();
+                uint8_t buf[16];
+                while(true)
                 {
-                    if (!_r.has_value())
-                        return;
-                    if (first)
-                        first = false;
-                    else
-                        _r = Sendable<decltype(" ")>::send(*this, " ");
-                    _r = std::move(Sendable<std::remove_cvref_t<SendArg>>::send(*this, std::forward<SendArg>(a)));
-                };
-                auto send_tuple = [&]<size_t... idx>(std::index_sequence<idx...>)
+                    const duration_ms_t left = wait - duration_ms_t(k_uptime_get() - start);
+                    if (left <= 0)
+                        return std::unexpected(Err{err::site_t::QueryTimeout});
+                    auto r = ReadSome(buf, sizeof(buf), left);
+                    if (!r)
+                        return std::unexpected(r.error());
+                    if (auto step = FeedReply(p, {buf, r->v}, parsed); step != grammar::step_t::More)
+                        return QueryResult(step, parsed, t);
+                }
+            }
+
+            //feeds a chunk of the reply to the parser up to the step that ends it, More if none did
+            template<class P, class T>
+            static grammar::step_t FeedReply(P &p, std::span<const uint8_t> chunk, T &parsed)
+            {
+                for(uint8_t b : chunk)
                 {
-                    (send_one(std::get<idx>(tosend)),...);
-                };
-                send_one(cmd);
-                send_tuple(std::make_index_sequence<sizeof...(ToSend)>());
-                TRY_UART_COMM(_r, "SendArgs");
-                TRY_UART_COMM(SendTpl("\r\n"), "<endl>");
+                    if (auto step = p.Feed(b, parsed); step != grammar::step_t::More)
+                        return step;
+                }
+                return grammar::step_t::More;
+            }
 
-                auto recv_tuple = [&]<size_t... idx>(std::index_sequence<idx...>)
+            template<class T>
+            ExpectedResult QueryResult(grammar::step_t step, T const& parsed, T &t)
+            {
+                switch(step)
                 {
-                    return uart::primitives::read_any(*this, std::get<idx>(torecv)...);
-                };
+                    case grammar::step_t::Done: t = parsed; return std::ref(*this);
+                    case grammar::step_t::Error: return std::unexpected(Err{err::site_t::QueryErrorResp});
+                    default: return std::unexpected(Err{err::site_t::QueryMalformed});
+                }
+            }
 
-                if (m_Dbg)
-                    printk("Receiving params\r\n");
-                TRY_UART_COMM(recv_tuple(std::make_index_sequence<sizeof...(ToRecv)>()), "SendCmdWithParams");
+            //Coroutine counterparts of SendCmdNoResp, SendCmd and Query: same
+            //replies, timeouts and error sites, the waits suspend
+            //'cmd' and 'arg' as one line, no reply awaited
+            CoTask CoSendLine(std::string_view cmd, std::string_view arg = {});
+            CoTask CoCmdAttempt(std::string_view line);
 
-                if (m_Dbg)
-                    printk("Received. Receiving Done or Error\r\n");
-                //wait for a final 'Done'
-                using namespace uart::primitives;
-                if (auto r = find_any_str({}, *this, "Done\r\n", "Error\r\n"); !r)
-                    return std::unexpected(Err{r.error()});
-                else if (r->v != 0)//not 'Done', but 'Error'
-                    return std::unexpected(Err{{"SendCmd Error"}});
-                if (m_Dbg)
-                    printk("Done\r\n");
-                return std::ref(*this);
+            CoTask CoSendCmd(std::string_view line, Op op)
+            {
+                return CoExchange(KindOf(line), op, [this, line]{ return CoCmdAttempt(line); });
             }
 
-            template<class... ToSend, class... ToRecv> 
-            ExpectedResult SendCmdWithParamsStd(std::string_view cmd, std::tuple<ToSend...> tosend, std::tuple<ToRecv...> torecv, bool dbg = false) 
-            { 
-                using namespace uart::primitives;
-                return SendCmdWithParams(
-                        cmd,
-                        std::move(tosend),
-                        std::tuple_cat(to_recv(
-                                    find_sv_t{cmd},
-                                    find_sv_t{"Response "})
-                                , torecv)
-                    );
+            template<class G, class T>
+            CoTask CoQuery(std::string_view cmd, G, T &t, Op op)
+            {
+                return CoExchange(CmdKind::Get, op, [this, cmd, &t]{ return CoQueryAttempt<G>(cmd, t); });
             }
 
-            ExpectedResult ReadFrame();
-            
+            template<class G, class T>
+            CoTask CoQueryAttempt(std::string_view cmd, T &t)
+            {
+                if (auto r = co_await CoSendLine(cmd); !r)
+                    co_return r;
+                auto p = G::parser();
+                T parsed = t;
+                const duration_ms_t wait = GetDefaultWait();
+                const int64_t start = k_uptime_get();
+                uint8_t buf[16];
+                while(true)
+                {
+                    if (size_t n = ReadAvailable(buf, sizeof(buf)); n)
+                    {
+                        if (auto step = FeedReply(p, {buf, n}, parsed); step != grammar::step_t::More)
+                            co_return QueryResult(step, parsed, t);
+                        continue;
+                    }
+                    const duration_ms_t left = wait - duration_ms_t(k_uptime_get() - start);
+                    if (left <= 0)
+                        co_return std::unexpected(Err{err::site_t::QueryTimeout});
+                    if (int e = co_await BytesAvailable(left); e != 0 && e != -EAGAIN)
+                        co_return std::unexpected(Err{err::site_t::ChannelReadSome, e});
+                }
+            }
+
+            //the reply grammar of every Param: f(cmd, grammar, op)
+            template<class F>
+            auto WithReply(Param p, F &&f);
+
+            //sends 'line' as-is, collects the reply up to the final Done/Error
+            ExpectedResult RawAttempt(std::string_view line, std::span<char> reply, size_t &got);
+
             //data
             //Version m_Version;
             //Configuration m_Configuration;
-            Version m_HWVersion;
-            Version m_SWVersion;
 
             class RxBlock: public Channel::RxBlock
             {
             public:
-                RxBlock(C4001 &c):Channel::RxBlock(c, c.m_recvBuf, sizeof(c.m_recvBuf)){}
+                RxBlock(C4001 &c, bool keepPending = false):Channel::RxBlock(c, c.m_recvBuf, sizeof(c.m_recvBuf), keepPending){}
             private:
             };
 
             uint8_t m_recvBuf[128];
+            frames::Decoder m_Frames;
+            Timing m_Timing;
+            ExchangeStats m_ExchangeStats;
+
+            //working copy, written by the reply parsers on the c4001 worker only
+            Config m_Cfg;
+            //what everybody else reads
+            SeqLocked<Config> m_PublishedCfg{m_Cfg};
 
-            float m_Inhibit = 2;
-            float m_MinRange = 1.6f;
-            float m_MaxRange = 25.f;
-            float m_TrigRange = 0.f;
+            void PublishConfig() { m_PublishedCfg.Store(m_Cfg); }
 
-            uint8_t m_SensitivityTrigger = 0;
-            uint8_t m_SensitivityHold = 0;
+            //same for the versions
+            Versions m_Ver;
+            SeqLocked<Versions> m_PublishedVer;
 
-            float m_DetectLatency = 0.f;
-            float m_ClearLatency = 0.f;
+            void PublishVersions() { m_PublishedVer.Store(m_Ver); }
         public:
             class Configurator
             {
@@ -393,6 +677,15 @@ namespace dfr
 
                 ExpectedResult UpdateLatency();
                 ExpectedResult SetLatency(float detect, float clear);
+
+                ExpectedResult Update(Param p);
+
+                ExpectedResult SendLine(CmdLine const& l);
+                //Diagnostics passthrough: sends 'line' as typed and copies the
+                //reply up to and including the final Done/Error into 'reply'
+                //(truncated to fit, zero terminated). Times out and retries
+                //like the command it starts with; an 'Error' reply fails.
+                ExpectedResult Raw(std::string_view line, std::span<char> reply, size_t &got);
             private:
                 Configurator(C4001 &c);
 
@@ -411,27 +704,79 @@ namespace dfr
             };
 
             Configurator GetConfigurator();
+
+            //Configurator for a coroutine (lib_coro.h), so that the session
+            //shares the work queue with the conversations of other sensors.
+            //Begin stops the sensor and End starts it again; End has to be
+            //awaited whatever happened in between, nothing does it on
+            //destruction. A failed Begin fails every step, End included.
+            class CoSession
+            {
+            public:
+                CoSession(C4001 &c):m_C(c), m_RxBlock(c) {}
+
+                CoTask Begin();
+                CoTask End();
+
+                CoTask SendLine(CmdLine const& l, Op op = Op::SendLine);
+                CoTask SaveConfig();
+                //reads 'p' back and publishes it
+                CoTask Update(Param p);
+                //0 - presence, 1 - speed/distance (SwitchToPresenceMode etc.)
+                CoTask RunMode(uint8_t mode);
+            private:
+                bool Failed() const { return m_Err.site != err::site_t::None; }
+
+                C4001 &m_C;
+                RxBlock m_RxBlock;
+                Err m_Err;
+                bool m_Finished = false;
+            };
+
+            //Keeps the receiver running for the unsolicited sensor output.
+            //Unlike StreamFrames it doesn't own the loop, so one thread can
+            //serve several sensors by polling their streams in turn.
+            //With kAlwaysOnRx it also gets what arrived since the last session.
+            class FrameStream
+            {
+            public:
+                FrameStream(C4001 &c):m_C(c), m_RxBlock(c, true) { c.StartReading(); }
+
+                //reads what arrived within 'wait' (0 - don't block) and calls
+                //onFrame for every frame completed by it; returns the byte count
+                template<class OnFrame>
+                ExpectedValue<size_t> Poll(OnFrame &&onFrame, duration_ms_t wait)
+                {
+                    uint8_t buf[16];
+                    auto r = m_C.ReadSome(buf, sizeof(buf), wait);
+                    if (!r)
+                    {
+                        Err e = r.error();
+                        return std::unexpected(e.In(Op::Stream));
+                    }
+                    for(size_t i = 0; i < r->v; ++i)
+                    {
+                        if (m_C.m_Frames.Feed(buf[i]) != frames::kind_t::None)
+                            onFrame(m_C.m_Frames.Frame());
+                    }
+                    return RetVal<size_t>{std::ref(m_C), r->v};
+                }
+            private:
+                C4001 &m_C;
+                RxBlock m_RxBlock;
+            };
         private:
     };
 }
 
+//site/op/errno, decoded with the enums in lib_ret_err.h and dfr::C4001::Op
 template<>
-struct ::tools::formatter_t<::Err>
+struct tools::formatter_t<::Err>
 {
     template<FormatDestination Dest>
     static std::expected<size_t, FormatError> format_to(Dest &&dst, std::string_view const& fmtStr, ::Err const& e)
     {
-        return tools::format_to(std::forward<Dest>(dst), "E<{} at {}>", e.code, e.pLocation);
-    }
-};
-
-template<>
-struct ::tools::formatter_t<dfr::C4001::Err>
-{
-    template<FormatDestination Dest>
-    static std::expected<size_t, FormatError> format_to(Dest &&dst, std::string_view const& fmtStr, dfr::C4001::Err const& e)
-    {
-        return tools::format_to(std::forward<Dest>(dst), "Err\\{uart=[{}] at {} }", e.uartErr, e.pLocation);
+        return tools::format_to(std::forward<Dest>(dst), "E<{}/{}/{}>", std::to_underlying(e.site), e.op, -e.Code());
     }
 };
 
@@ -0,0 +1,141 @@
+#ifndef LIB_DFR_C4001_FRAMES_H_
+#define LIB_DFR_C4001_FRAMES_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+namespace dfr::frames
+{
+    enum class kind_t: uint8_t
+    {
+        None,
+        Presence,   //$DFHPD,<present>, , , *
+        Target,     //$DFDMD,<status>,<targets>,<range>,<speed>,<energy>, , *
+    };
+
+    //latest decoded frame; only the fields of 'kind' are meaningful
+    struct frame_t
+    {
+        kind_t kind = kind_t::None;
+        bool present = false;
+        uint8_t status = 0;
+        uint8_t targets = 0;
+        float range = 0;    //m
+        float speed = 0;    //m/s, negative - approaching
+        float energy = 0;
+    };
+
+    //Byte-at-a-time decoder of the unsolicited sensor output.
+    //Anything that is not a known frame (command replies, noise) is skipped.
+    class Decoder
+    {
+    public:
+        //returns the kind of the frame completed by 'b', kind_t::None otherwise
+        kind_t Feed(uint8_t b)
+        {
+            if (b == '$')
+            {
+                m_Len = 0;
+                m_InFrame = true;
+                return kind_t::None;
+            }
+            if (!m_InFrame)
+                return kind_t::None;
+            if (b == '*')
+            {
+                m_InFrame = false;
+                m_Line[m_Len] = 0;
+                return Parse();
+            }
+            if (b == '\r' || b == '\n' || m_Len == (sizeof(m_Line) - 1))
+            {
+                //broken frame
+                m_InFrame = false;
+                return kind_t::None;
+            }
+            m_Line[m_Len++] = b;
+            return kind_t::None;
+        }
+
+        frame_t const& Frame() const { return m_Frame; }
+    private:
+        static constexpr const char kPresenceTag[] = "DFHPD";
+        static constexpr const char kTargetTag[] = "DFDMD";
+
+        //splits the next comma separated field in place; nullptr at the end
+        char* NextField(char *&p)
+        {
+            if (!p) return nullptr;
+            char *f = p;
+            if (char *c = strchr(p, ','))
+            {
+                *c = 0;
+                p = c + 1;
+            }else
+                p = nullptr;
+            return f;
+        }
+
+        static bool to_float(const char *f, float &dst)
+        {
+            char *pEnd;
+            dst = strtof(f, &pEnd);
+            return pEnd != f;
+        }
+
+        static bool to_u8(const char *f, uint8_t &dst)
+        {
+            char *pEnd;
+            dst = (uint8_t)strtoul(f, &pEnd, 10);
+            return pEnd != f;
+        }
+
+        kind_t Parse()
+        {
+            char *p = m_Line;
+            const char *tag = NextField(p);
+            if (!tag)
+                return kind_t::None;
+            frame_t f;
+            if (!strcmp(tag, kPresenceTag))
+            {
+                uint8_t v;
+                const char *pv = NextField(p);
+                if (!pv || !to_u8(pv, v))
+                    return kind_t::None;
+                f.kind = kind_t::Presence;
+                f.present = v != 0;
+            }
+            else if (!strcmp(tag, kTargetTag))
+            {
+                const char *pStatus = NextField(p);
+                const char *pTargets = NextField(p);
+                const char *pRange = NextField(p);
+                const char *pSpeed = NextField(p);
+                const char *pEnergy = NextField(p);
+                if (!pEnergy
+                        || !to_u8(pStatus, f.status)
+                        || !to_u8(pTargets, f.targets)
+                        || !to_float(pRange, f.range)
+                        || !to_float(pSpeed, f.speed)
+                        || !to_float(pEnergy, f.energy))
+                    return kind_t::None;
+                f.kind = kind_t::Target;
+                f.present = f.targets != 0;
+            }
+            else
+                return kind_t::None;
+            m_Frame = f;
+            return f.kind;
+        }
+
+        char m_Line[64];
+        size_t m_Len = 0;
+        bool m_InFrame = false;
+        frame_t m_Frame;
+    };
+}
+
+#endif
@@ -0,0 +1,42 @@
+#include "lib_dlog.h"
+
+#if DLOG_ENABLED
+namespace dlog
+{
+    std::atomic<uint32_t> g_Dropped{0};
+    MPSCRing<record_t, kSlots> g_Ring;
+
+    //low enough to never delay a sensor exchange or the Zigbee stack
+    constexpr int kFlushPriority = K_LOWEST_APPLICATION_THREAD_PRIO;
+    constexpr int kFlushPeriodMs = 100;
+    constexpr size_t kFlushStackSize = 768;
+
+    static void print(record_t const& r)
+    {
+	printk("#D %08x %08x %02x", r.id, r.cycles, r.types);
+	for(uint8_t i = 0; i < r.n; ++i)
+	    printk(" %x", r.args[i]);
+	printk("\r\n");
+    }
+
+    static void flush_loop(void *, void *, void *)
+    {
+	//lets the decoder turn cycles into time
+	printk("#DH %u\r\n", sys_clock_hw_cycles_per_sec());
+	uint32_t reported = 0;
+	while(true)
+	{
+	    for(record_t r; g_Ring.Pop(r);)
+		print(r);
+	    if (uint32_t d = g_Dropped.load(std::memory_order_relaxed); d != reported)
+	    {
+		reported = d;
+		printk("#DL %u\r\n", d);
+	    }
+	    k_msleep(kFlushPeriodMs);
+	}
+    }
+
+    K_THREAD_DEFINE(dlog_flush, kFlushStackSize, flush_loop, nullptr, nullptr, nullptr, kFlushPriority, 0, 0);
+}
+#endif
@@ -0,0 +1,128 @@
+#ifndef LIB_DLOG_H_
+#define LIB_DLOG_H_
+
+#include <zephyr/kernel.h>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "lib_mpsc_ring.h"
+
+//Deferred binary log for paths that must not wait for the console.
+//  DLOG("Read failed; write pos: {}; read pos: {}", w, r);
+//records a 32 bit id of the format string (FNV-1a, computed at compile time)
+//and the raw arguments into a RAM ring: a few dozen cycles, callable from
+//ISRs, no format string in the image. A low priority thread prints the
+//records as '#D ...' hex lines; dlog_decode.py maps them back to text using
+//the format strings found in the sources.
+//Arguments: up to kMaxArgs integers, enums, bools, pointers or floats.
+//Format: '{}' per argument, '{:x}' for hex, '{:.N}' for N decimals.
+#ifndef DLOG_ENABLED
+#define DLOG_ENABLED 1
+#endif
+
+namespace dlog
+{
+    constexpr size_t kMaxArgs = 4;
+    constexpr size_t kSlots = 64;
+
+    enum class type_t: uint8_t
+    {
+        Int,
+        Uint,
+        Float,
+    };
+
+    //one entry of the ring, 28 bytes
+    struct record_t
+    {
+        uint32_t id;
+        uint32_t cycles;        //k_cycle_get_32() at the call
+        uint8_t n;
+        uint8_t types;          //2 bits type_t per argument
+        uint32_t args[kMaxArgs];
+    };
+
+    constexpr uint32_t hash(std::string_view s)
+    {
+        uint32_t h = 2166136261u;
+        for(char c : s)
+        {
+            h ^= (uint8_t)c;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    //'{' that open a placeholder ('{{' is a literal brace)
+    constexpr size_t placeholders(std::string_view s)
+    {
+        size_t n = 0;
+        for(size_t i = 0; i < s.size(); ++i)
+        {
+            if (s[i] != '{')
+                continue;
+            if (i + 1 < s.size() && s[i + 1] == '{')
+                ++i;
+            else
+                ++n;
+        }
+        return n;
+    }
+
+    template<class A>
+    constexpr type_t type_of()
+    {
+        using T = std::remove_cvref_t<A>;
+        if constexpr (std::is_floating_point_v<T>)
+            return type_t::Float;
+        else if constexpr (std::is_enum_v<T>)
+            return type_of<std::underlying_type_t<T>>();
+        else if constexpr (std::is_pointer_v<T> || std::is_unsigned_v<T>)
+            return type_t::Uint;
+        else
+        {
+            static_assert(std::is_integral_v<T>, "DLOG takes integers, enums, pointers and floats only");
+            return type_t::Int;
+        }
+    }
+
+    template<class A>
+    inline uint32_t encode(A a)
+    {
+        using T = std::remove_cvref_t<A>;
+        if constexpr (std::is_floating_point_v<T>)
+            return std::bit_cast<uint32_t>((float)a);
+        else if constexpr (std::is_pointer_v<T>)
+            return (uint32_t)(uintptr_t)a;
+        else
+            return (uint32_t)a;
+    }
+
+    //records lost to a full ring
+    extern std::atomic<uint32_t> g_Dropped;
+    extern MPSCRing<record_t, kSlots> g_Ring;
+
+    template<uint32_t Id, size_t N, class... A>
+    inline void write(A... a)
+    {
+        static_assert(sizeof...(A) == N, "DLOG: argument count doesn't match the format");
+        static_assert(sizeof...(A) <= kMaxArgs, "DLOG: too many arguments");
+        record_t r{.id = Id, .cycles = k_cycle_get_32(), .n = (uint8_t)sizeof...(A), .types = 0, .args = {}};
+        size_t i = 0;
+        ((r.types |= uint8_t(std::to_underlying(type_of<A>()) << (2 * i)), r.args[i++] = encode(a)), ...);
+        if (!g_Ring.Push(r))
+            g_Dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+#if DLOG_ENABLED
+#define DLOG(fmt, ...) ::dlog::write<::dlog::hash(fmt), ::dlog::placeholders(fmt)>(__VA_ARGS__)
+#else
+#define DLOG(fmt, ...) do {} while(0)
+#endif
+
+#endif
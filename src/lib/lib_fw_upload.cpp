@@ -0,0 +1,247 @@
+#include "lib_fw_upload.h"
+#include <zephyr/sys/crc.h>
+#include <algorithm>
+#include <string_view>
+
+namespace fwupd
+{
+    /**********************************************************************/
+    /* Uploader                                                           */
+    /**********************************************************************/
+    Uploader::ExpectedResult Uploader::Run(source_t const& src, on_progress_t onProgress, void *ctx)
+    {
+	uart::Channel::RxBlock rx(m_C, m_Rx, sizeof(m_Rx), true);
+	m_C.StartReading();
+	progress_t p{.total = uint32_t(src.size)};
+	if (auto r = Await(kCRC, kStartWait, err::site_t::FwStartTimeout); !r)
+	    return std::unexpected(r.error());
+
+	const int64_t start = k_uptime_get();
+	uint8_t n = 1;
+	for(size_t off = 0; off < src.size; off += kBlockSize, ++n)
+	{
+	    if (int r = Build(src, off, n); r != 0)
+	    {
+		Abort();
+		return std::unexpected(Err{err::site_t::FwSourceRead, r});
+	    }
+	    for(uint8_t tries = 0;; ++tries)
+	    {
+		if (tries > kRetries)
+		{
+		    Abort();
+		    return std::unexpected(Err{err::site_t::FwBlockRejected});
+		}
+		if (auto r = m_C.Send(m_Frame.data(), m_Frame.size()); !r)
+		    return std::unexpected(r.error());
+		auto r = Reply();
+		if (!r)
+		    return std::unexpected(r.error());
+		if (*r == kACK)
+		    break;
+		++p.resends;
+	    }
+	    p.bytes = uint32_t(std::min(off + kBlockSize, src.size));
+	    ++p.blocks;
+	    p.elapsed_ms = uint32_t(k_uptime_get() - start);
+	    if (onProgress)
+		onProgress(ctx, p);
+	}
+
+	//receivers may NAK the first EOT to be sure it wasn't line noise
+	//sent from m_Frame: the transport may still read it after Send returns
+	m_Frame[0] = kEOT;
+	for(uint8_t tries = 0;; ++tries)
+	{
+	    if (tries > kRetries)
+	    {
+		Abort();
+		return std::unexpected(Err{err::site_t::FwEotRejected});
+	    }
+	    if (auto r = m_C.Send(m_Frame.data(), 1); !r)
+		return std::unexpected(r.error());
+	    auto r = Reply();
+	    if (!r)
+		return std::unexpected(r.error());
+	    if (*r == kACK)
+		break;
+	}
+	p.elapsed_ms = uint32_t(k_uptime_get() - start);
+	return p;
+    }
+
+    std::expected<void, Err> Uploader::Await(uint8_t b, uart::duration_ms_t wait, err::site_t site)
+    {
+	const int64_t end = k_uptime_get() + wait;
+	while(true)
+	{
+	    int64_t left = end - k_uptime_get();
+	    if (left <= 0)
+		return std::unexpected(Err{site});
+	    auto r = m_C.ReadByte((uart::duration_ms_t)left);
+	    if (!r)
+	    {
+		if (r.error().Code() == -EAGAIN)
+		    return std::unexpected(Err{site});
+		return std::unexpected(r.error());
+	    }
+	    if (r->v == b)
+		return {};
+	}
+    }
+
+    std::expected<uint8_t, Err> Uploader::Reply()
+    {
+	const int64_t end = k_uptime_get() + kAckWait;
+	while(true)
+	{
+	    int64_t left = end - k_uptime_get();
+	    if (left <= 0)
+		return kNAK;
+	    auto r = m_C.ReadByte((uart::duration_ms_t)left);
+	    if (!r)
+	    {
+		//no reply in time: resent like a NAK
+		if (r.error().Code() == -EAGAIN)
+		    return kNAK;
+		return std::unexpected(r.error());
+	    }
+	    switch(r->v)
+	    {
+		case kACK:
+		case kNAK:
+		    return r->v;
+		case kCAN:
+		    return std::unexpected(Err{err::site_t::FwReceiverCancel});
+		default:
+		    //line noise, a bootloader message: not an answer
+		    break;
+	    }
+	}
+    }
+
+    int Uploader::Build(source_t const& src, size_t off, uint8_t n)
+    {
+	const size_t len = std::min(kBlockSize, src.size - off);
+	m_Frame[0] = kSTX;
+	m_Frame[1] = n;
+	m_Frame[2] = uint8_t(~n);
+	uint8_t *pData = m_Frame.data() + 3;
+	if (int r = src.read(src.ctx, off, pData, len); r != 0)
+	    return r;
+	std::fill(pData + len, pData + kBlockSize, kPad);
+	const uint16_t crc = crc16_itu_t(0, pData, kBlockSize);
+	m_Frame[3 + kBlockSize] = uint8_t(crc >> 8);
+	m_Frame[4 + kBlockSize] = uint8_t(crc);
+	return 0;
+    }
+
+    void Uploader::Abort()
+    {
+	if (m_C.IsCancelled())
+	    return;
+	m_Frame[0] = kCAN;
+	m_Frame[1] = kCAN;
+	(void)m_C.Send(m_Frame.data(), 2);
+	(void)m_C.WaitAllSent();
+    }
+
+#if UART_TRANSPORT == UART_TRANSPORT_MEMORY
+    /**********************************************************************/
+    /* SimBootloader                                                      */
+    /**********************************************************************/
+    SimBootloader::SimBootloader(uart::transport::Memory &t, uint32_t nakEvery):
+	m_T(t), m_NakEvery(nakEvery)
+    {
+	m_T.SetOnTx(on_tx, this);
+    }
+
+    void SimBootloader::on_tx(void *ctx, const uint8_t *pData, size_t len)
+    {
+	auto &s = *static_cast<SimBootloader*>(ctx);
+	for(size_t i = 0; i < len; ++i)
+	    s.OnByte(pData[i]);
+    }
+
+    void SimBootloader::OnByte(uint8_t b)
+    {
+	switch(m_State)
+	{
+	    case state_t::App:
+		if (b != '\n')
+		{
+		    if (m_LineLen < sizeof(m_Line))
+			m_Line[m_LineLen++] = (char)b;
+		    break;
+		}
+		if (std::string_view(m_Line, m_LineLen) == "resetSystem 1\r")
+		{
+		    m_State = state_t::Receiving;
+		    Reply(kCRC);
+		}
+		m_LineLen = 0;
+		break;
+	    case state_t::Receiving:
+		if (!m_Got)
+		{
+		    if (b == kEOT)
+		    {
+			m_State = state_t::Done;
+			Reply(kACK);
+			break;
+		    }
+		    if (b == kCAN)
+		    {
+			m_State = state_t::App;
+			break;
+		    }
+		    //line noise between frames
+		    if (b != kSTX)
+			break;
+		}
+		m_Frame[m_Got++] = b;
+		if (m_Got == kFrameSize)
+		{
+		    m_Got = 0;
+		    OnFrame();
+		}
+		break;
+	    case state_t::Done:
+		break;
+	}
+    }
+
+    void SimBootloader::OnFrame()
+    {
+	const uint8_t n = m_Frame[1];
+	const uint8_t *pData = m_Frame + 3;
+	const uint16_t crc = uint16_t((m_Frame[3 + kBlockSize] << 8) | m_Frame[4 + kBlockSize]);
+	const bool intact = m_Frame[2] == uint8_t(~n) && crc == crc16_itu_t(0, pData, kBlockSize);
+	//the block already taken again: its ACK got lost
+	if (intact && n == uint8_t(m_Expect - 1) && m_Blocks)
+	{
+	    Reply(kACK);
+	    return;
+	}
+	if (!intact || n != m_Expect)
+	{
+	    ++m_Naks;
+	    Reply(kNAK);
+	    return;
+	}
+	if (m_NakEvery && !m_Naked && (m_Blocks + 1) % m_NakEvery == 0)
+	{
+	    m_Naked = true;
+	    ++m_Naks;
+	    Reply(kNAK);
+	    return;
+	}
+	m_Naked = false;
+	++m_Blocks;
+	++m_Expect;
+	m_Bytes += kBlockSize;
+	m_Crc32 = crc32_ieee_update(m_Crc32, pData, kBlockSize);
+	Reply(kACK);
+    }
+#endif
+}
@@ -0,0 +1,134 @@
+#ifndef LIB_FW_UPLOAD_H_
+#define LIB_FW_UPLOAD_H_
+
+#include <zephyr/kernel.h>
+#include "lib_uart.h"
+#include <expected>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+//Streams a firmware image to a serial bootloader over a uart::Channel with
+//XMODEM-1K: the receiver asks with 'C', every 1024 byte block goes out with
+//its number and a CRC-16 and is resent until the receiver ACKs it. One block
+//in flight is the flow control, the receiver checking the CRC the per block
+//verification. The image is read block by block from a source_t (e.g. a
+//flash partition), only the frame being sent is ever in RAM.
+namespace fwupd
+{
+    constexpr size_t kBlockSize = 1024;
+    //STX, block number, its complement, data, CRC-16 big endian
+    constexpr size_t kFrameSize = 3 + kBlockSize + 2;
+
+    constexpr uint8_t kSTX = 0x02;
+    constexpr uint8_t kEOT = 0x04;
+    constexpr uint8_t kACK = 0x06;
+    constexpr uint8_t kNAK = 0x15;
+    constexpr uint8_t kCAN = 0x18;
+    constexpr uint8_t kCRC = 'C';
+    //fills the last block
+    constexpr uint8_t kPad = 0x1a;
+
+    //where the image comes from
+    struct source_t
+    {
+        size_t size;
+        //'len' bytes at 'off' into 'p'; 0 or a negative errno
+        int (*read)(void *ctx, size_t off, uint8_t *p, size_t len);
+        void *ctx;
+    };
+
+    struct progress_t
+    {
+        uint32_t bytes = 0;         //acknowledged by the receiver
+        uint32_t total = 0;
+        uint32_t blocks = 0;
+        uint32_t resends = 0;       //NAKed or not answered in time
+        uint32_t elapsed_ms = 0;    //since the receiver asked for the image
+
+        uint32_t BytesPerSec() const { return elapsed_ms ? uint32_t(uint64_t(bytes) * 1000 / elapsed_ms) : 0; }
+        uint32_t Permille() const { return total ? uint32_t(uint64_t(bytes) * 1000 / total) : 0; }
+    };
+    //after every acknowledged block, on the thread running the upload
+    using on_progress_t = void(*)(void *ctx, progress_t const&);
+
+    using frame_buf_t = std::span<uint8_t, kFrameSize>;
+
+    class Uploader
+    {
+    public:
+        using ExpectedResult = std::expected<progress_t, Err>;
+
+        //bootloader start up to its first 'C'
+        static constexpr uart::duration_ms_t kStartWait = 10'000;
+        //a whole frame takes ~1.1 s on the wire at 9600 baud
+        static constexpr uart::duration_ms_t kAckWait = 3'000;
+        //per block and for the final EOT
+        static constexpr uint8_t kRetries = 5;
+
+        //'frame' is where blocks are built: static storage rather than a worker stack
+        Uploader(uart::Channel &c, frame_buf_t frame):m_C(c), m_Frame(frame) {}
+
+        //Sends the whole image. Bytes the receiver sent since the last
+        //session count (its 'C' may already be there). Cancellable through
+        //the Channel; on any other error the receiver is told to give up.
+        ExpectedResult Run(source_t const& src, on_progress_t onProgress = nullptr, void *ctx = nullptr);
+    private:
+        //waits for 'b', skipping anything else, until 'wait' is over
+        std::expected<void, Err> Await(uint8_t b, uart::duration_ms_t wait, err::site_t site);
+        //the reply to the frame or EOT just sent: ACK, NAK (also for no reply in time) or CAN
+        std::expected<uint8_t, Err> Reply();
+        int Build(source_t const& src, size_t off, uint8_t n);
+        void Abort();
+
+        uart::Channel &m_C;
+        frame_buf_t m_Frame;
+        uint8_t m_Rx[16];
+    };
+
+#if UART_TRANSPORT == UART_TRANSPORT_MEMORY
+    //Stand-in for the sensor bootloader on the memory transport (native_sim,
+    //host): "resetSystem 1" makes it ask for an image, frames are checked as
+    //the real receiver would. 'nakEvery' > 0 NAKs every n-th block once to
+    //exercise the resend path. Runs in the context of the sender's Tx.
+    class SimBootloader
+    {
+    public:
+        SimBootloader(uart::transport::Memory &t, uint32_t nakEvery = 0);
+
+        bool Done() const { return m_State == state_t::Done; }
+        uint32_t Bytes() const { return m_Bytes; }
+        uint32_t Naks() const { return m_Naks; }
+        //CRC-32 (IEEE) over every block received, padding included
+        uint32_t Crc32() const { return m_Crc32; }
+    private:
+        enum class state_t: uint8_t
+        {
+            App,        //a line based application, only the reset line matters
+            Receiving,
+            Done,
+        };
+
+        static void on_tx(void *ctx, const uint8_t *pData, size_t len);
+        void OnByte(uint8_t b);
+        void OnFrame();
+        void Reply(uint8_t b) { m_T.Feed(&b, 1); }
+
+        uart::transport::Memory &m_T;
+        uint32_t m_NakEvery;
+        state_t m_State = state_t::App;
+        char m_Line[16];
+        size_t m_LineLen = 0;
+        uint8_t m_Frame[kFrameSize];
+        size_t m_Got = 0;
+        uint8_t m_Expect = 1;
+        uint32_t m_Blocks = 0;
+        uint32_t m_Bytes = 0;
+        uint32_t m_Naks = 0;
+        uint32_t m_Crc32 = 0;
+        bool m_Naked = false;
+    };
+#endif
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef LIB_LATENCY_HIST_H_
+#define LIB_LATENCY_HIST_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+
+//Log2 histogram of latencies in microseconds.
+//bucket 0: [0, 64us), bucket i: [2^(i+5), 2^(i+6))us, last bucket: everything from ~1s on
+//Single writer; readers may observe a slightly torn state which is fine for diagnostics.
+struct LatencyHist
+{
+    static constexpr size_t kBuckets = 16;
+    static constexpr uint32_t kFirstBucketBits = 6;
+
+    uint32_t m_Buckets[kBuckets]{};
+    uint32_t m_Count = 0;
+    uint32_t m_LastUs = 0;
+    uint32_t m_MaxUs = 0;
+    uint64_t m_SumUs = 0;
+
+    static constexpr size_t bucket_of(uint32_t us)
+    {
+        if (us < (1u << kFirstBucketBits))
+            return 0;
+        size_t b = std::bit_width(us) - kFirstBucketBits;
+        return b < kBuckets ? b : kBuckets - 1;
+    }
+
+    //exclusive upper bound of the bucket in us
+    static constexpr uint32_t bucket_limit(size_t b) { return 1u << (b + kFirstBucketBits); }
+
+    void Add(uint32_t us)
+    {
+        ++m_Buckets[bucket_of(us)];
+        ++m_Count;
+        m_LastUs = us;
+        m_SumUs += us;
+        if (us > m_MaxUs) m_MaxUs = us;
+    }
+
+    uint32_t AvgUs() const { return m_Count ? uint32_t(m_SumUs / m_Count) : 0; }
+
+    //upper bound of the bucket containing the p-th percentile
+    uint32_t PercentileUs(uint8_t p) const
+    {
+        if (!m_Count) return 0;
+        uint32_t target = (uint64_t(m_Count) * p + 99) / 100;
+        uint32_t acc = 0;
+        for(size_t b = 0; b < kBuckets; ++b)
+        {
+            acc += m_Buckets[b];
+            if (acc >= target)
+                return b == kBuckets - 1 ? m_MaxUs : bucket_limit(b);
+        }
+        return m_MaxUs;
+    }
+
+    void Reset() { *this = {}; }
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef LIB_MPSC_RING_H_
+#define LIB_MPSC_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//Lock-free multi producer/single consumer ring (bounded queue with a
+//sequence number per cell). Producers may be threads and ISRs alike; a
+//full ring makes Push fail instead of waiting.
+//A producer interrupted between claiming a cell and filling it holds up
+//the consumer (Pop returns false) until it resumes, never the other producers.
+//N must be a power of 2; capacity is N.
+template<class T, size_t N>
+class MPSCRing
+{
+    static_assert(N && (N & (N - 1)) == 0, "N must be a power of 2");
+public:
+    MPSCRing()
+    {
+        for(size_t i = 0; i < N; ++i)
+            m_Cells[i].m_Seq.store(i, std::memory_order_relaxed);
+    }
+
+    bool Push(T const& v)
+    {
+        uint32_t pos = m_Head.load(std::memory_order_relaxed);
+        Cell *c;
+        while(true)
+        {
+            c = &m_Cells[pos & (N - 1)];
+            int32_t d = int32_t(c->m_Seq.load(std::memory_order_acquire) - pos);
+            if (d == 0)
+            {
+                if (m_Head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (d < 0)
+                return false;
+            else
+                pos = m_Head.load(std::memory_order_relaxed);
+        }
+        c->m_V = v;
+        c->m_Seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T &v)
+    {
+        Cell &c = m_Cells[m_Tail & (N - 1)];
+        if (int32_t(c.m_Seq.load(std::memory_order_acquire) - (m_Tail + 1)) < 0)
+            return false;
+        v = c.m_V;
+        c.m_Seq.store(m_Tail + N, std::memory_order_release);
+        ++m_Tail;
+        return true;
+    }
+private:
+    struct Cell
+    {
+        std::atomic<uint32_t> m_Seq;
+        T m_V;
+    };
+    Cell m_Cells[N];
+    std::atomic<uint32_t> m_Head{0};
+    uint32_t m_Tail = 0;    //consumer only
+};
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef LIB_REPLY_GRAMMAR_H_
+#define LIB_REPLY_GRAMMAR_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+
+//Compile-time grammar for line based sensor replies, e.g.
+//  find<"getRange"> >> find<"Response "> >> num<&Config::m_MinRange, 6, 250, 10>
+//      >> ws >> num<&Config::m_MaxRange, 6, 250, 10> >> crlf >> done_or_error
+//The grammar is a type. Its Parser consumes every byte exactly once, validates
+//values as they complete and writes them straight into the target object.
+namespace grammar
+{
+    template<size_t N>
+    struct fixed_string
+    {
+        char m_S[N]{};
+
+        constexpr fixed_string(const char (&s)[N]) { for(size_t i = 0; i < N; ++i) m_S[i] = s[i]; }
+        constexpr fixed_string(const uint8_t (&s)[N]) { for(size_t i = 0; i < N; ++i) m_S[i] = (char)s[i]; }
+
+        static constexpr size_t size() { return N - 1; }
+        constexpr char operator[](size_t i) const { return m_S[i]; }
+    };
+    template<size_t N> fixed_string(const char (&)[N]) -> fixed_string<N>;
+    template<size_t N> fixed_string(const uint8_t (&)[N]) -> fixed_string<N>;
+
+    enum class step_t: uint8_t
+    {
+        More,   //byte consumed, element not complete yet
+        Done,   //byte consumed, element complete
+        Next,   //element complete, the byte belongs to the next one
+        Fail,   //malformed reply or value out of range
+        Error,  //the sensor replied 'Error'
+    };
+
+    template<class M> struct member_traits;
+    template<class C, class V> struct member_traits<V C::*>
+    {
+        using class_t = C;
+        using value_t = V;
+    };
+
+    //substring search state machine (KMP), the failure table is built at compile time
+    template<fixed_string S>
+    struct matcher
+    {
+        static_assert(S.size() > 0 && S.size() < 256);
+
+        static constexpr auto kFail = []{
+            std::array<uint8_t, S.size()> f{};
+            for(size_t i = 1, k = 0; i < S.size(); ++i)
+            {
+                while(k && S[i] != S[k]) k = f[k - 1];
+                if (S[i] == S[k]) ++k;
+                f[i] = k;
+            }
+            return f;
+        }();
+
+        //returns the number of chars of S matched after 'c'
+        static constexpr uint8_t advance(uint8_t k, char c)
+        {
+            if (k == S.size()) k = kFail[k - 1];
+            while(k && S[k] != c) k = kFail[k - 1];
+            return S[k] == c ? k + 1 : 0;
+        }
+        static constexpr bool complete(uint8_t k) { return k == S.size(); }
+    };
+
+    /**********************************************************************/
+    /* Elements                                                           */
+    /**********************************************************************/
+    //exactly S
+    template<fixed_string S>
+    struct lit_t
+    {
+        struct state_t { uint8_t n = 0; };
+
+        template<class T>
+        static constexpr step_t feed(state_t &s, uint8_t b, T&)
+        {
+            if ((char)b != S[s.n])
+                return step_t::Fail;
+            return ++s.n == S.size() ? step_t::Done : step_t::More;
+        }
+    };
+
+    //anything up to and including S
+    template<fixed_string S>
+    struct find_t
+    {
+        struct state_t { uint8_t n = 0; };
+
+        template<class T>
+        static constexpr step_t feed(state_t &s, uint8_t b, T&)
+        {
+            s.n = matcher<S>::advance(s.n, (char)b);
+            return matcher<S>::complete(s.n) ? step_t::Done : step_t::More;
+        }
+    };
+
+    //one or more spaces
+    struct ws_t
+    {
+        struct state_t { bool seen = false; };
+
+        template<class T>
+        static constexpr step_t feed(state_t &s, uint8_t b, T&)
+        {
+            if (b == ' ')
+            {
+                s.seen = true;
+                return step_t::More;
+            }
+            return s.seen ? step_t::Next : step_t::Fail;
+        }
+    };
+
+    //Decimal number into the member M of the target, valid in [Min/Scale, Max/Scale].
+    //A fraction is only accepted for floating point members.
+    template<auto M, int32_t Min, int32_t Max, int32_t Scale = 1>
+    struct num_t
+    {
+        using value_t = typename member_traits<decltype(M)>::value_t;
+        static_assert(std::is_arithmetic_v<value_t>);
+        static constexpr uint8_t kMaxDigits = 9;
+
+        struct state_t
+        {
+            uint32_t mant = 0;
+            uint8_t digits = 0;
+            uint8_t frac = 0;
+            bool neg = false;
+            bool dot = false;
+        };
+
+        template<class T>
+        static constexpr step_t feed(state_t &s, uint8_t b, T &t)
+        {
+            if (b >= '0' && b <= '9')
+            {
+                if (++s.digits > kMaxDigits)
+                    return step_t::Fail;
+                s.mant = s.mant * 10 + (b - '0');
+                s.frac += s.dot;
+                return step_t::More;
+            }
+            if (b == '-' && !s.digits && !s.neg && !s.dot)
+            {
+                s.neg = true;
+                return step_t::More;
+            }
+            if constexpr (std::is_floating_point_v<value_t>)
+            {
+                if (b == '.' && !s.dot)
+                {
+                    s.dot = true;
+                    return step_t::More;
+                }
+            }
+            if (!s.digits)
+                return step_t::Fail;
+            //exact range check: mant/10^frac vs Min/Scale
+            int64_t m = s.neg ? -(int64_t)s.mant : (int64_t)s.mant;
+            int64_t p = 1;
+            for(uint8_t i = 0; i < s.frac; ++i) p *= 10;
+            if (m * Scale < (int64_t)Min * p || m * Scale > (int64_t)Max * p)
+                return step_t::Fail;
+            t.*M = value_t(m) / value_t(p);
+            return step_t::Next;
+        }
+    };
+
+    //text up to (not including) '\r' into the char array member M, zero terminated
+    template<auto M>
+    struct text_t
+    {
+        using value_t = typename member_traits<decltype(M)>::value_t;
+        static_assert(std::is_array_v<value_t> && std::extent_v<value_t> > 1);
+        static constexpr size_t kMax = std::extent_v<value_t> - 1;
+
+        struct state_t { uint8_t n = 0; };
+
+        template<class T>
+        static constexpr step_t feed(state_t &s, uint8_t b, T &t)
+        {
+            if (b == '\r')
+            {
+                (t.*M)[s.n] = 0;
+                return step_t::Next;
+            }
+            if (s.n == kMax)
+                return step_t::Fail;
+            (t.*M)[s.n++] = (char)b;
+            return step_t::More;
+        }
+    };
+
+    //the final line of every command: 'Done' or 'Error'
+    struct done_or_error_t
+    {
+        using done = matcher<"Done\r\n">;
+        using error = matcher<"Error\r\n">;
+
+        struct state_t { uint8_t done = 0; uint8_t error = 0; };
+
+        template<class T>
+        static constexpr step_t feed(state_t &s, uint8_t b, T&)
+        {
+            s.done = done::advance(s.done, (char)b);
+            s.error = error::advance(s.error, (char)b);
+            if (done::complete(s.done))
+                return step_t::Done;
+            return error::complete(s.error) ? step_t::Error : step_t::More;
+        }
+    };
+
+    /**********************************************************************/
+    /* Sequence                                                           */
+    /**********************************************************************/
+    template<class... E>
+    struct seq_t
+    {
+        //one fused state machine: the index of the current element and the
+        //state of each one
+        class Parser
+        {
+        public:
+            //step_t::More until the whole grammar is matched (Done) or fails
+            template<class T>
+            constexpr step_t Feed(uint8_t b, T &t)
+            {
+                while(true)
+                {
+                    step_t r = Dispatch(b, t, std::index_sequence_for<E...>{});
+                    if (r != step_t::Done && r != step_t::Next)
+                        return r;
+                    if (++m_Idx == sizeof...(E))
+                        return step_t::Done;
+                    if (r == step_t::Done)
+                        return step_t::More;
+                }
+            }
+        private:
+            template<class T, size_t... I>
+            constexpr step_t Dispatch(uint8_t b, T &t, std::index_sequence<I...>)
+            {
+                step_t r = step_t::Fail;
+                (void)((m_Idx == I ? (r = E::feed(std::get<I>(m_States), b, t), true) : false) || ...);
+                return r;
+            }
+
+            std::tuple<typename E::state_t...> m_States{};
+            uint8_t m_Idx = 0;
+        };
+
+        static constexpr Parser parser() { return {}; }
+    };
+
+    template<class E> struct as_seq { using type = seq_t<E>; };
+    template<class... E> struct as_seq<seq_t<E...>> { using type = seq_t<E...>; };
+
+    template<class... A, class... B>
+    constexpr seq_t<A..., B...> concat(seq_t<A...>, seq_t<B...>) { return {}; }
+
+    template<class A, class B>
+    constexpr auto operator>>(A, B)
+    {
+        return concat(typename as_seq<A>::type{}, typename as_seq<B>::type{});
+    }
+
+    template<fixed_string S> inline constexpr seq_t<lit_t<S>> lit{};
+    template<fixed_string S> inline constexpr seq_t<find_t<S>> find{};
+    template<auto M, int32_t Min, int32_t Max, int32_t Scale = 1> inline constexpr seq_t<num_t<M, Min, Max, Scale>> num{};
+    template<auto M> inline constexpr seq_t<text_t<M>> text{};
+    inline constexpr seq_t<ws_t> ws{};
+    inline constexpr seq_t<lit_t<"\r\n">> crlf{};
+    inline constexpr seq_t<done_or_error_t> done_or_error{};
+}
+
+#endif
@@ -2,13 +2,126 @@
 #define LIB_RET_ERR_H_
 
 #include <cstddef>
+#include <cstdint>
 #include <tuple>
+#include <utility>
 
+namespace err
+{
+    //high byte of site_t
+    enum class subsys_t: uint8_t
+    {
+        None,
+        Channel,        //uart::Channel
+        Primitives,     //uart::primitives
+        C4001,          //dfr::C4001
+        FwUpload,       //fwupd::Uploader
+        Worker,         //c4001 worker, errors without a failed exchange
+        Coro,           //coro:: (lib_coro.h)
+    };
+
+    constexpr uint16_t site_base(subsys_t s) { return uint16_t(std::to_underlying(s) << 8); }
+
+    //where an error was raised, one value per return site that makes one
+    enum class site_t: uint16_t
+    {
+        None = 0,
+
+        ChannelSleep = site_base(subsys_t::Channel) + 1,
+        ChannelContinuousRx,
+        ChannelSend,
+        ChannelSendTx,
+        ChannelRead,
+        ChannelReadState,
+        ChannelReadSome,
+        ChannelReadSomeState,
+        ChannelReadByte,
+        ChannelWaitAllSent,
+        ChannelConfigure,
+        ChannelResume,
+
+        MatchBytes = site_base(subsys_t::Primitives) + 1,
+        MatchAnyBytes,
+        MatchAnyBytesTerm,
+        ReadUntil,
+        FindBytes,
+        FindAnyBytes,
+        ReadUntilInto,
+        ReadUntilIntoSize,
+        ReadInto,
+        ReadIntoBytes,
+        RecvForChecked,
+
+        CmdErrorResp = site_base(subsys_t::C4001) + 1,
+        QueryTimeout,
+        QueryErrorResp,
+        QueryMalformed,
+        RawTimeout,
+        RawErrorResp,
+        FormatArgs,
+        SessionFinished,
+        CmdTimeout,
+
+        FwStartTimeout = site_base(subsys_t::FwUpload) + 1,
+        FwSourceRead,
+        FwImageInvalid,
+        FwBlockRejected,
+        FwReceiverCancel,
+        FwEotRejected,
+
+        SensorLost = site_base(subsys_t::Worker) + 1,
+        PresetStore,
+        PresetMissing,
+        CalibNoCleanLevel,
+        CalibAborted,
+
+        CoroNoFrame = site_base(subsys_t::Coro) + 1,
+    };
+}
+
+//Error as it travels through the std::expected chains: fits in one register,
+//no strings. 'op' is what the caller was doing (subsystem defined, e.g.
+//dfr::C4001::Op), set by the innermost layer that knows it; 'errnum' is the
+//errno of the failed call (the magnitude of a positive return code, capped
+//at 255), 0 if there was none (timeout, bad reply).
 struct Err
 {
-    const char *pLocation = "";
-    int code = 0;
+    err::site_t site = err::site_t::None;
+    uint8_t op = 0;
+    uint8_t errnum = 0;
+
+    constexpr Err() = default;
+    constexpr Err(err::site_t s, int code = 0):
+        site(s), errnum(uint8_t(code < -255 || code > 255 ? 255 : code < 0 ? -code : code))
+    {}
+
+    //negative errno as returned by the failed call
+    constexpr int Code() const { return -int(errnum); }
+    constexpr err::subsys_t Subsys() const { return err::subsys_t(std::to_underlying(site) >> 8); }
+
+    template<class Op>
+    constexpr Err& In(Op o)
+    {
+        if (!op)
+            op = uint8_t(o);
+        return *this;
+    }
+
+    //site:16 | op:8 | errnum:8, as shown in the error log and over Zigbee
+    constexpr uint32_t Packed() const { return (uint32_t(std::to_underlying(site)) << 16) | (uint32_t(op) << 8) | errnum; }
+    static constexpr Err Unpack(uint32_t v)
+    {
+        Err e;
+        e.site = err::site_t(v >> 16);
+        e.op = uint8_t(v >> 8);
+        e.errnum = uint8_t(v);
+        return e;
+    }
+
+    constexpr bool operator==(Err const&) const = default;
 };
+static_assert(sizeof(Err) == 4);
+static_assert(Err(err::site_t::None, -5).errnum == 5 && Err(err::site_t::None, 5).errnum == 5 && Err(err::site_t::None, -300).errnum == 255);
 
 template<class Ref, class Val>
 struct RetValT
@@ -52,12 +165,12 @@ namespace std{
     }
 };
 
-#define CALL_WITH_EXPECTED(location, f) \
-    if (auto err = f; err != 0) \
-        return std::unexpected(Err{location, err})
+#define CALL_WITH_EXPECTED(site, f) \
+    if (auto rc = f; rc != 0) \
+        return std::unexpected(Err{site, rc})
 
-#define CALL_WITH_EXPECTED2(location, f) \
-    if (auto err = f; err < 0) \
-        return std::unexpected(Err{location, err})
+#define CALL_WITH_EXPECTED2(site, f) \
+    if (auto rc = f; rc < 0) \
+        return std::unexpected(Err{site, rc})
 
 #endif
@@ -0,0 +1,49 @@
+#ifndef LIB_RTT_ESTIMATOR_H_
+#define LIB_RTT_ESTIMATOR_H_
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+//Reply time estimate of one kind of exchange, the way TCP sizes its
+//retransmission timer (RFC 6298): smoothed mean and mean deviation as EWMAs
+//with gains 1/8 and 1/4, timeout = mean + 4 deviations.
+//Plain data so it can be stored as-is.
+struct RttEstimator
+{
+    float m_SRtt = 0;   //ms, 0 - no sample yet
+    float m_RttVar = 0; //ms
+
+    bool HasSamples() const { return m_SRtt > 0; }
+    bool Valid() const { return std::isfinite(m_SRtt) && std::isfinite(m_RttVar) && m_SRtt >= 0 && m_RttVar >= 0; }
+
+    void Add(float ms)
+    {
+        ms = std::max(ms, 1.f);
+        if (!HasSamples())
+        {
+            m_SRtt = ms;
+            m_RttVar = ms / 2;
+            return;
+        }
+        m_RttVar += (std::fabs(m_SRtt - ms) - m_RttVar) / 4;
+        m_SRtt += (ms - m_SRtt) / 8;
+    }
+
+    //no reply within Timeout(): widen the window, the mean stays
+    void OnTimeout(float maxMs)
+    {
+        if (HasSamples())
+            m_RttVar = std::min(m_RttVar * 2 + 1, maxMs);
+    }
+
+    //'initial' until the first sample
+    int32_t Timeout(int32_t initial, int32_t minMs, int32_t maxMs) const
+    {
+        if (!HasSamples())
+            return initial;
+        return std::clamp((int32_t)std::ceil(m_SRtt + 4 * m_RttVar), minMs, maxMs);
+    }
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef LIB_RUNNING_STATS_H_
+#define LIB_RUNNING_STATS_H_
+
+#include <cstdint>
+#include <cmath>
+
+//Mean/variance/max of a stream in constant memory (Welford's algorithm).
+struct RunningStats
+{
+    uint32_t m_Count = 0;
+    float m_Mean = 0;
+    float m_M2 = 0;
+    float m_Max = 0;
+
+    void Add(float x)
+    {
+        ++m_Count;
+        float d = x - m_Mean;
+        m_Mean += d / (float)m_Count;
+        m_M2 += d * (x - m_Mean);
+        if (m_Count == 1 || x > m_Max) m_Max = x;
+    }
+
+    //sample variance
+    float Variance() const { return m_Count > 1 ? m_M2 / float(m_Count - 1) : 0.f; }
+    float StdDev() const { return std::sqrt(Variance()); }
+
+    void Reset() { *this = RunningStats{}; }
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef LIB_SEQLOCK_H_
+#define LIB_SEQLOCK_H_
+
+#if defined(__ZEPHYR__)
+#include <zephyr/kernel.h>
+#endif
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+namespace seqlock
+{
+#if defined(__ZEPHYR__)
+    //keeps readers of the same core from preempting the writer mid-copy
+    struct WriterLock
+    {
+        WriterLock() { k_sched_lock(); }
+        ~WriterLock() { k_sched_unlock(); }
+    };
+#else
+    //host builds: readers spinning on another thread don't stall the writer
+    struct WriterLock {};
+#endif
+}
+
+//Single writer, many readers. Readers never block and always get a
+//consistent copy together with its version.
+//On Zephyr the writer holds the scheduler lock for the duration of the copy
+//so a higher priority reader can't spin on a half-written value.
+//Not for use from ISRs.
+template<class T> requires std::is_trivially_copyable_v<T>
+class SeqLocked
+{
+public:
+    constexpr SeqLocked() = default;
+    constexpr SeqLocked(T const& v): m_Data(v) {}
+
+    //returns true if the stored value has changed (and so has the version)
+    bool Store(T const& v)
+    {
+        if (std::memcmp(&v, &m_Data, sizeof(T)) == 0)
+            return false;
+        [[maybe_unused]] seqlock::WriterLock lock;
+        uint32_t s = m_Seq.load(std::memory_order_relaxed);
+        m_Seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&m_Data, &v, sizeof(T));
+        m_Seq.store(s + 2, std::memory_order_release);
+        return true;
+    }
+
+    T Load(uint32_t *pVersion = nullptr) const
+    {
+        T r;
+        uint32_t s1, s2;
+        do
+        {
+            s1 = m_Seq.load(std::memory_order_acquire);
+            std::memcpy(&r, &m_Data, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s2 = m_Seq.load(std::memory_order_relaxed);
+        }while((s1 & 1) || s1 != s2);
+        if (pVersion) *pVersion = s1 >> 1;
+        return r;
+    }
+
+    uint32_t Version() const { return m_Seq.load(std::memory_order_acquire) >> 1; }
+private:
+    std::atomic<uint32_t> m_Seq{0};
+    T m_Data{};
+};
+
+#endif
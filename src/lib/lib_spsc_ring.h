@@ -0,0 +1,43 @@
+#ifndef LIB_SPSC_RING_H_
+#define LIB_SPSC_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//Lock-free single producer/single consumer ring.
+//Producer may be an ISR, consumer a thread (or the other way around).
+//N must be a power of 2; capacity is N.
+template<class T, size_t N>
+class SPSCRing
+{
+    static_assert(N && (N & (N - 1)) == 0, "N must be a power of 2");
+public:
+    bool Push(T const& v)
+    {
+        uint32_t h = m_Head.load(std::memory_order_relaxed);
+        if (h - m_Tail.load(std::memory_order_acquire) == N)
+            return false;
+        m_Data[h & (N - 1)] = v;
+        m_Head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T &v)
+    {
+        uint32_t t = m_Tail.load(std::memory_order_relaxed);
+        if (t == m_Head.load(std::memory_order_acquire))
+            return false;
+        v = m_Data[t & (N - 1)];
+        m_Tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const { return m_Tail.load(std::memory_order_acquire) == m_Head.load(std::memory_order_acquire); }
+private:
+    T m_Data[N];
+    std::atomic<uint32_t> m_Head{0};
+    std::atomic<uint32_t> m_Tail{0};
+};
+
+#endif
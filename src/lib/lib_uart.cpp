@@ -3,13 +3,23 @@
 
 #include "lib_uart.h"
 #include <functional>
+#include <iterator>
 #include "lib_misc_helpers.hpp"
 
 namespace uart
 {
-    Channel::RxBlock::RxBlock(Channel &c, uint8_t *pData, size_t len):
+    Channel::RxBlock::RxBlock(Channel &c, uint8_t *pData, size_t len, bool keepPending):
 	m_C(c)
     {
+	//a failure shows in the Send that follows
+	(void)m_C.Wake();
+	++m_C.m_Holders;
+	if (m_C.m_Continuous)
+	{
+	    if (!keepPending)
+		(void)m_C.Drain(false);
+	    return;
+	}
 	m_C.AllowReadUpTo(pData, len);
     }
 
@@ -23,7 +33,9 @@ namespace uart
 	if (!m_Stopped)
 	{
 	    m_Stopped = true;
-	    m_C.StopReading();
+	    if (!m_C.m_Continuous)
+		m_C.StopReading();
+	    m_C.Release();
 	}
     }
 
@@ -40,7 +52,7 @@ namespace uart
     }
 
     Channel::Channel(const struct device *pUART):
-	m_pUART(pUART)
+	m_Transport(*this, pUART)
     {
     }
 
@@ -50,18 +62,11 @@ namespace uart
 
     Channel::ExpectedResult Channel::Configure()
     {
-	uart_config cfg;
-	uart_config_get(m_pUART, &cfg);
-	//m_UARTRxTimeoutUS = (1'000'000 * kUARTRxTimeoutBits) / cfg.baudrate;
-	m_UARTRxTimeoutUS = 1'000 * m_DefaultWait;
-	if (m_UARTRxTimeoutUS == 0) m_UARTRxTimeoutUS = 4;
-
 	k_sem_init(&m_rx_sem, 0, 1);
 	k_sem_init(&m_tx_sem, 1, 1);
-	k_sem_init(&m_rx_ctrl, 0, 1);
-
-	uart_callback_set(m_pUART, uart_async_callback, this);
+	k_poll_signal_init(&m_cancel);
 
+	CALL_WITH_EXPECTED(err::site_t::ChannelConfigure, m_Transport.Configure(m_DefaultWait));
 	return std::ref(*this);
     }
 
@@ -75,188 +80,303 @@ namespace uart
 	return std::ref(*this);
     }
 
-    void Channel::uart_async_callback(const struct device *dev, uart_event *evt, void *user_data)
+    Channel::ExpectedResult Channel::Wake()
     {
-	Channel *pC = (Channel *)user_data;
-	switch(evt->type)
+	m_IdleSince = k_uptime_get();
+	if (m_Awake)
+	    return std::ref(*this);
+	if (int r = m_Transport.Resume(); r < 0)
 	{
-	    case UART_TX_ABORTED:
-		break;
-	    case UART_TX_DONE:
-	    {
-		k_sem_give(&pC->m_tx_sem);
-		if (pC->m_rx_enable_request)
-		{
-		    pC->m_rx_enable_request = false;
-		    uart_rx_enable(pC->m_pUART, pC->m_UARTAsyncBufs[0], kUARTAsyncBufSize, pC->m_UARTRxTimeoutUS);
-		}
-	    }
-	    break;
-	    case UART_RX_BUF_REQUEST:
-	    {
-		if (pC->m_rx_disable_request)
-		{
-		    pC->m_rx_disable_request = false;
-		    uart_rx_disable(dev);
-		    break;
-		}
+	    ++m_Power.m_Failures;
+	    return std::unexpected(Err{err::site_t::ChannelResume, r});
+	}
+	m_Awake = true;
+	m_AwakeSince = m_IdleSince;
+	++m_Power.m_Resumes;
+	if (uint8_t *p = std::exchange(m_pResumeRxBuf, nullptr))
+	    return StartContinuousReading(p, m_ResumeRxLen);
+	return std::ref(*this);
+    }
 
-		if (pC->m_UARTAsyncBufNext != -1)
-		{
-		    pC->m_rx_state = true;
-		    pC->m_UARTAsyncBufNext ^= 1;
-		    uart_rx_buf_rsp(dev
-			    , pC->m_UARTAsyncBufs[pC->m_UARTAsyncBufNext]
-			    , kUARTAsyncBufSize);
-		}else
-		{
-		    //pC->m_rx_state = false;
-		}
+    void Channel::Release()
+    {
+	if (--m_Holders == 0)
+	    m_IdleSince = k_uptime_get();
+    }
+
+    int64_t Channel::IdleDeadline() const
+    {
+	if (!m_Awake || m_Holders || m_IdleSuspend < 0)
+	    return kNoDeadline;
+	return m_IdleSince + m_IdleSuspend;
+    }
+
+    bool Channel::SuspendIfIdle(int64_t now)
+    {
+	if (IdleDeadline() > now)
+	    return false;
+	uint8_t *pResume = m_Continuous ? m_pInternalRecvBuf : nullptr;
+	int resumeLen = m_InternalRecvBufLen;
+	if (m_Continuous)
+	    StopContinuousReading();
+	else if (m_pInternalRecvBuf)
+	    StopReading();
+	if (int r = m_Transport.Suspend(); r < 0)
+	{
+	    UART_DIAG("Channel::SuspendIfIdle: could not suspend: {}", r);
+	    ++m_Power.m_Failures;
+	    m_IdleSince = now;
+	    if (pResume)
+		(void)StartContinuousReading(pResume, resumeLen);
+	    return false;
+	}
+	m_pResumeRxBuf = pResume;
+	m_ResumeRxLen = resumeLen;
+	m_Awake = false;
+	++m_Power.m_Suspends;
+	m_Power.m_ActiveMs += now - m_AwakeSince;
+	return true;
+    }
+
+    Channel::PowerStats Channel::GetPowerStats(int64_t now) const
+    {
+	PowerStats s = m_Power;
+	if (m_Awake)
+	    s.m_ActiveMs += now - m_AwakeSince;
+	return s;
+    }
+
+    void Channel::OnRx(const uint8_t *pData, size_t len)
+    {
+	if (!m_pInternalRecvBuf)
+	    return;
+	int to_write = len;
+	m_Trace.OnRx(to_write);
+	int read_pos = m_InternalRecvBufNextRead;
+	int write_pos = m_InternalRecvBufNextWrite;
+	if (read_pos < write_pos) read_pos += m_InternalRecvBufLen;
+	if ((write_pos != read_pos) && ((write_pos + to_write) >= read_pos))
+	{
+	    m_Overflow = true;
+	    m_Trace.OnOverflow();
+	    m_InternalRecvBufNextRead = ((write_pos + to_write + 1) % m_InternalRecvBufLen);
+	}
+
+	int left = m_InternalRecvBufLen - m_InternalRecvBufNextWrite;
+	if (left <= to_write) 
+	    to_write = left;
+
+	if (to_write)
+	{
+	    memcpy(m_pInternalRecvBuf + m_InternalRecvBufNextWrite, pData, to_write);
+	    m_InternalRecvBufNextWrite += to_write;
+	    m_InternalRecvBufNextWrite %= m_InternalRecvBufLen;
+	    int orig = to_write;
+	    to_write = len - to_write;
+	    if (to_write)
+	    {
+		memcpy(m_pInternalRecvBuf + m_InternalRecvBufNextWrite, pData + orig, to_write);
+		m_InternalRecvBufNextWrite += to_write;
 	    }
-	    break;
-	    case UART_RX_BUF_RELEASED:
-		if (pC->m_rx_disable_request)
-		{
-		    pC->m_rx_disable_request = false;
-		    uart_rx_disable(dev);
-		}
-		break;
-	    case UART_RX_DISABLED:
-		pC->m_rx_state = false;
-		pC->m_UARTAsyncBufNext = -1;
-		k_sem_give(&pC->m_rx_ctrl);
-		break;
-	    case UART_RX_RDY:
-		{
-		    if (pC->m_pInternalRecvBuf)
-		    {
-			int to_write = evt->data.rx.len;
-			int read_pos = pC->m_InternalRecvBufNextRead;
-			int write_pos = pC->m_InternalRecvBufNextWrite;
-			if (read_pos < write_pos) read_pos += pC->m_InternalRecvBufLen;
-			if ((write_pos != read_pos) && ((write_pos + to_write) >= read_pos))
-			{
-			    pC->m_Overflow = true;
-			    pC->m_InternalRecvBufNextRead = ((write_pos + to_write + 1) % pC->m_InternalRecvBufLen);
-			}
-
-			int left = pC->m_InternalRecvBufLen - pC->m_InternalRecvBufNextWrite;
-			if (left <= to_write) 
-			    to_write = left;
-
-			if (to_write)
-			{
-			    memcpy(pC->m_pInternalRecvBuf + pC->m_InternalRecvBufNextWrite, 
-				    evt->data.rx.buf + evt->data.rx.offset,
-				    to_write);
-			    pC->m_InternalRecvBufNextWrite += to_write;
-			    pC->m_InternalRecvBufNextWrite %= pC->m_InternalRecvBufLen;
-			    int orig = to_write;
-			    to_write = evt->data.rx.len - to_write;
-			    if (to_write)
-			    {
-				memcpy(pC->m_pInternalRecvBuf + pC->m_InternalRecvBufNextWrite, 
-					evt->data.rx.buf + evt->data.rx.offset + orig,
-					to_write);
-				pC->m_InternalRecvBufNextWrite += to_write;
-			    }
-			    k_sem_give(&pC->m_rx_sem);
-			}else
-			{
-			}
-		    }
-		    else
-		    {
-		    }
-		}
-		break;
-	    case UART_RX_STOPPED:
-		if (!pC->m_rx_disable_request && pC->m_pInternalRecvBuf && pC->m_UARTAsyncBufNext != -1)
-		{
-		    pC->m_rx_state = false;
-		    pC->m_UARTAsyncBufNext = 0;
-		    uart_rx_enable(dev
-			    , pC->m_UARTAsyncBufs[0]
-			    , kUARTAsyncBufSize
-			    , pC->m_UARTRxTimeoutUS);
-		}
-		break;
+	    k_sem_give(&m_rx_sem);
 	}
     }
 
-    int Channel::uart_send()
+    static k_timeout_t to_timeout(duration_ms_t wait)
     {
-	if (!m_SendLen) return 0;
-	int b = uart_fifo_fill(m_pUART, m_pSendBuf, m_SendLen);
-	if (b < 0) return b;
-	m_pSendBuf += b;
-	m_SendLen -= b;
-	return b;
+	return wait < 0 ? K_FOREVER : K_MSEC(wait);
     }
 
-    int Channel::uart_recv()
+    void Channel::BeginOp(uint32_t tag)
     {
-	if (!m_RecvLen) return 0;
-	int b = uart_fifo_read(m_pUART, m_pRecvBuf, m_RecvLen);
-	if (b < 0) return b;
-	m_pRecvBuf += b;
-	m_RecvLen -= b;
-	return b;
+	m_Op.store(tag & kOpMask);
+	k_poll_signal_reset(&m_cancel);
     }
 
-    Channel::ExpectedResult Channel::Send(const uint8_t *pData, size_t len)
+    bool Channel::Cancel(uint32_t tag)
+    {
+	//only the exact operation, not cancelled nor ended yet
+	uint32_t op = tag & kOpMask;
+	if (!m_Op.compare_exchange_strong(op, op | kOpCancelled))
+	    return false;
+	k_poll_signal_raise(&m_cancel, 0);
+	return true;
+    }
+
+    void Channel::EndOp()
+    {
+	m_Op.fetch_or(kOpEnded);
+	k_poll_signal_reset(&m_cancel);
+    }
+
+    bool Channel::IsCancelled() const
     {
-	CALL_WITH_EXPECTED("Channel::Send", k_sem_take(&m_tx_sem, Z_TIMEOUT_MS(m_DefaultWait)));
-	if (m_Dbg)
+	uint32_t op = m_Op.load();
+	return (op & kOpCancelled) && !(op & kOpEnded);
+    }
+
+    int Channel::Ready(struct k_sem *pSem)
+    {
+	//the signal may be left raised by a cancel that came too late:
+	//reset it before checking, a cancel from now on raises it again
+	k_poll_signal_reset(&m_cancel);
+	if (IsCancelled())
+	    return -ECANCELED;
+	//sem may get available and taken by somebody else between k_poll and here
+	if (pSem && k_sem_take(pSem, K_NO_WAIT) == 0)
+	    return 0;
+	return coro::Wait::kNotYet;
+    }
+
+    int Channel::WaitFor(struct k_sem *pSem, duration_ms_t wait)
+    {
+	k_poll_event events[2] = {
+	    K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY, pSem),
+	    K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &m_cancel),
+	};
+	k_timepoint_t end = sys_timepoint_calc(to_timeout(wait));
+	while(true)
 	{
-	    FMT_PRINTLN("Channel::Send: {}", std::span<const char>{(const char*)pData, len});
+	    if (int r = Ready(pSem); r != coro::Wait::kNotYet)
+		return r;
+	    if (int r = k_poll(events, std::size(events), sys_timepoint_timeout(end)); r != 0)
+		return r;
+	    events[0].state = K_POLL_STATE_NOT_READY;
+	    events[1].state = K_POLL_STATE_NOT_READY;
 	}
-	m_pSendBuf = pData;
-	m_SendLen = len;
-	CALL_WITH_EXPECTED("Channel::Send (uart_tx)", uart_tx(m_pUART, pData, len, SYS_FOREVER_US));
+    }
+
+    Channel::ExpectedResult Channel::Sleep(duration_ms_t wait)
+    {
+	k_poll_event e = K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &m_cancel);
+	k_timepoint_t end = sys_timepoint_calc(to_timeout(wait));
+	while(true)
+	{
+	    if (Ready(nullptr) == -ECANCELED)
+		return std::unexpected(Err{err::site_t::ChannelSleep, -ECANCELED});
+	    if (k_poll(&e, 1, sys_timepoint_timeout(end)) != 0)
+		return std::ref(*this);
+	    e.state = K_POLL_STATE_NOT_READY;
+	}
+    }
+
+    Channel::SemWait::SemWait(Channel &c, struct k_sem *pSem, duration_ms_t wait):
+	coro::Wait(Check, to_timeout(wait == kDefaultWait ? c.m_DefaultWait : wait)),
+	m_C(c),
+	m_pSem(pSem)
+    {
+	k_poll_event_init(&m_Events[0], K_POLL_TYPE_SEM_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY, pSem);
+	k_poll_event_init(&m_Events[1], K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &c.m_cancel);
+	m_N = 2;
+    }
+
+    int Channel::SemWait::Check(coro::Wait &w)
+    {
+	auto &s = static_cast<SemWait&>(w);
+	return s.m_C.Ready(s.m_pSem);
+    }
+
+    Channel::SleepWait::SleepWait(Channel &c, duration_ms_t wait):
+	coro::Wait(Check, to_timeout(wait)),
+	m_C(c)
+    {
+	k_poll_event_init(&m_Events[0], K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &c.m_cancel);
+	m_N = 1;
+    }
+
+    int Channel::SleepWait::Check(coro::Wait &w)
+    {
+	return static_cast<SleepWait&>(w).m_C.Ready(nullptr);
+    }
+
+    Channel::ExpectedResult Channel::Send(const uint8_t *pData, size_t len)
+    {
+	if (auto r = Wake(); !r)
+	    return r;
+	CALL_WITH_EXPECTED(err::site_t::ChannelSend, WaitFor(&m_tx_sem, m_DefaultWait));
+	return SendReady(pData, len);
+    }
+
+    Channel::ExpectedResult Channel::SendReady(const uint8_t *pData, size_t len)
+    {
+	CALL_WITH_EXPECTED(err::site_t::ChannelSendTx, m_Transport.Tx(pData, len));
+	m_Trace.OnTx(pData, len);
 	return std::ref(*this);
     }
 
     void Channel::AllowReadUpTo(uint8_t *pData, size_t len)
     {
-	if (m_Dbg)
-	    FMT_PRINTLN("Channel::AllowReadUpTo: {}", len);
 	m_pInternalRecvBuf = pData;
         m_InternalRecvBufLen = len;
         m_InternalRecvBufNextWrite = 0;
         m_InternalRecvBufNextRead = 0;
-	m_UARTAsyncBufNext = 0;
-	m_rx_enable_request = true;
+	m_Transport.ArmRx();
     }
 
     void Channel::StopReading(bool dbg)
     {
-	m_rx_disable_request = true;
-	int r = k_sem_take(&m_rx_ctrl, Z_TIMEOUT_MS(m_DefaultWait));
+	//not a cancellation point: RX must be down before the buffer goes away
+	int r = m_Transport.StopRx(to_timeout(m_DefaultWait));
 
 	if (r < 0)
 	{
-	    FMT_PRINTLN("Channel::StopReading: could not disable RX: {}", r);
+	    UART_DIAG("Channel::StopReading: could not disable RX: {}", r);
 	}else
 	{
 	    if (m_pInternalRecvBuf && m_InternalRecvBufNextWrite)
 	    {
 		if (dbg)
-		{
-		    FMT_PRINTLN("Channel::StopReading: data in buf: {}", std::span<const uint8_t>{(const uint8_t*)m_pInternalRecvBuf, (size_t)m_InternalRecvBufNextWrite});
-		}
-		else if (m_InternalRecvBufNextWrite != m_InternalRecvBufNextRead)
-		{
-		    if (m_Dbg)
-			FMT_PRINTLN("Channel::StopReading: unread data in buf: {}", std::string_view{(const char*)m_pInternalRecvBuf + m_InternalRecvBufNextRead, (size_t)(m_InternalRecvBufNextWrite - m_InternalRecvBufNextRead)});
-		}
+		    m_Trace.OnDrop(m_pInternalRecvBuf, m_InternalRecvBufNextWrite);
+		else if (m_InternalRecvBufNextWrite > m_InternalRecvBufNextRead)
+		    m_Trace.OnDrop(m_pInternalRecvBuf + m_InternalRecvBufNextRead, m_InternalRecvBufNextWrite - m_InternalRecvBufNextRead);
 	    }
 	}
+	ReleaseRecvBuf();
+    }
+
+    void Channel::ReleaseRecvBuf()
+    {
 	m_pInternalRecvBuf = nullptr;
         m_InternalRecvBufLen = 0;
         m_InternalRecvBufNextWrite = 0;
         m_InternalRecvBufNextRead = 0;
-	m_UARTAsyncBufNext = -1;
+	m_Transport.ReleaseRx();
+    }
+
+    void Channel::StartReading()
+    {
+	m_Transport.StartRx();
+    }
+
+    Channel::ExpectedResult Channel::StartContinuousReading(uint8_t *pData, size_t len)
+    {
+	//may restart continuous reading itself
+	if (auto r = Wake(); !r)
+	    return r;
+	if (m_Continuous)
+	    return std::ref(*this);
+	AllowReadUpTo(pData, len);
+	m_Continuous = true;
+	if (int err = m_Transport.StartContinuousRx(); err != 0)
+	{
+	    m_Continuous = false;
+	    ReleaseRecvBuf();
+	    return std::unexpected(Err{err::site_t::ChannelContinuousRx, err});
+	}
+	return std::ref(*this);
+    }
+
+    void Channel::StopContinuousReading()
+    {
+	//not to be restarted by the next Wake either
+	m_pResumeRxBuf = nullptr;
+	if (!m_Continuous)
+	    return;
+	//first: the transport must not restart it
+	m_Continuous = false;
+	if (int r = m_Transport.StopContinuousRx(to_timeout(m_DefaultWait)); r != 0)
+	    UART_DIAG("Channel::StopContinuousReading: could not disable RX: {}", r);
+	ReleaseRecvBuf();
     }
 
     size_t Channel::ReadInternal(uint8_t *pBuf, size_t len)
@@ -267,10 +387,10 @@ namespace uart
 	    int avail = m_InternalRecvBufLen - m_InternalRecvBufNextRead;
 	    int n = std::min(avail, (int)len);
 	    memcpy(pBuf, m_pInternalRecvBuf + m_InternalRecvBufNextRead, n);
-	    if (m_Dbg) for(int i = 0; i < n; ++i) printk("%c", *(m_pInternalRecvBuf + m_InternalRecvBufNextRead + i));
+	    m_Trace.OnRead(pBuf, n);
 	    m_InternalRecvBufNextRead = (m_InternalRecvBufNextRead + n) % m_InternalRecvBufLen;
 	    read_bytes += n;
-	    if (read_bytes == len)
+	    if ((size_t)read_bytes == len)
 		return n;
 	}
 
@@ -278,7 +398,7 @@ namespace uart
 	int left = len - read_bytes;
 	int n = std::min(avail, left);
 	memcpy(pBuf + read_bytes, m_pInternalRecvBuf + m_InternalRecvBufNextRead, n);
-	if (m_Dbg) for(int i = 0; i < n; ++i) printk("%c", *(m_pInternalRecvBuf + m_InternalRecvBufNextRead + i));
+	m_Trace.OnRead(pBuf + read_bytes, n);
 	m_InternalRecvBufNextRead += n;
 	read_bytes += n;
 	return read_bytes;
@@ -289,11 +409,10 @@ namespace uart
 	m_Overflow = false;
 	if (!len) 
 	{
-	    printk("Channel::Read: len=0\r\n");
+	    UART_DIAG("Channel::Read: len=0");
 	    return RetVal<size_t>{*this, size_t(0)};
 	}
 	if (wait == kDefaultWait) wait = m_DefaultWait;
-	bool addedPeek = m_HasPeekByte;
 	if (m_HasPeekByte)
 	{
 	    //printk("Channel::Read: peek byte of=%d\r\n", m_PeekByte);
@@ -311,29 +430,22 @@ namespace uart
 	if (m_pInternalRecvBuf)
 	{
 	    int read = ReadInternal(pBuf, len);
-	    if (read == len)
+	    if ((size_t)read == len)
 		return RetVal<size_t>{*this, len};
 	    if (wait == 0)
 		return RetVal<size_t>{*this, size_t(read)};
 
-	    if (m_UARTAsyncBufNext == -1)
-	    {
-		printk("Read: restarting recv\r\n");
-		m_UARTAsyncBufNext = 0;
-		uart_rx_enable(m_pUART, m_UARTAsyncBufs[0], kUARTAsyncBufSize, m_UARTRxTimeoutUS);
-	    }
+	    m_Transport.EnsureRx();
 
 	    //FMT_PRINTLN("Read len: {}; read: {}", len, read);
 	    pBuf += read;
 	    int left = (int)len - read;
 	    while(left)
 	    {
-		//CALL_WITH_EXPECTED("Channel::Read(internal)", k_sem_take(&m_rx_sem, Z_TIMEOUT_MS(wait)));
-		if (auto err = k_sem_take(&m_rx_sem, Z_TIMEOUT_MS(wait)); err != 0)
+		if (auto err = WaitFor(&m_rx_sem, wait); err != 0)
 		{
-		    printk("Read failed. write pos: %d; read pos: %d; (buf idx=%d; state=%d)\r\n", m_InternalRecvBufNextWrite, m_InternalRecvBufNextRead, m_UARTAsyncBufNext, m_rx_state);
-		    //FMT_PRINTLN("Read failed. write pos: {}; read pos: {}; (buf idx={})", m_InternalRecvBufNextWrite, m_InternalRecvBufNextRead, m_UARTAsyncBufNext);
-		    return std::unexpected(Err{"Channel::Read(internal)", err});
+		    UART_DIAG("Read failed. write pos: {}; read pos: {}", m_InternalRecvBufNextWrite, m_InternalRecvBufNextRead);
+		    return std::unexpected(Err{err::site_t::ChannelRead, err});
 		}
 		int read = ReadInternal(pBuf, left);
 		pBuf += read;
@@ -341,17 +453,52 @@ namespace uart
 	    }
 	    return RetVal<size_t>{*this, len};
 	}
-	return std::unexpected(Err{"Channel::Read(wrong state)", 0});
+	return std::unexpected(Err{err::site_t::ChannelReadState});
+    }
+
+    Channel::ExpectedValue<size_t> Channel::ReadSome(uint8_t *pBuf, size_t len, duration_ms_t wait)
+    {
+	m_Overflow = false;
+	if (!len || !m_pInternalRecvBuf)
+	    return std::unexpected(Err{err::site_t::ChannelReadSomeState});
+	if (wait == kDefaultWait) wait = m_DefaultWait;
+	size_t read = ReadAvailable(pBuf, len);
+	if (read || wait == 0)
+	    return RetVal<size_t>{*this, read};
+
+	if (auto err = WaitFor(&m_rx_sem, wait); err == -EAGAIN)
+	    return RetVal<size_t>{*this, size_t(0)};
+	else if (err != 0)
+	    return std::unexpected(Err{err::site_t::ChannelReadSome, err});
+	return RetVal<size_t>{*this, ReadInternal(pBuf, len)};
+    }
+
+    size_t Channel::ReadAvailable(uint8_t *pBuf, size_t len)
+    {
+	if (!len || !m_pInternalRecvBuf)
+	    return 0;
+	size_t read = 0;
+	if (m_HasPeekByte)
+	{
+	    pBuf[read++] = m_PeekByte;
+	    m_HasPeekByte = false;
+	}
+	return read + ReadInternal(pBuf + read, len - read);
     }
 
     Channel::ExpectedResult Channel::Drain(bool stopAtEnd)
     {
 	uint8_t buf[8];
-	while(Read(buf, sizeof(buf), 0));
+	while(true)
+	{
+	    auto r = Read(buf, sizeof(buf), 0);
+	    if (!r || r->v < sizeof(buf))
+		break;
+	}
 
 	if (stopAtEnd)
 	{
-	    if (m_pInternalRecvBuf)
+	    if (m_pInternalRecvBuf && !m_Continuous)
 		StopReading();
 
 	    k_sem_reset(&m_rx_sem);
@@ -361,7 +508,7 @@ namespace uart
 
     Channel::ExpectedResult Channel::WaitAllSent()
     {
-	CALL_WITH_EXPECTED("Channel::WaitAllSent", k_sem_take(&m_tx_sem, Z_TIMEOUT_MS(m_DefaultWait)));
+	CALL_WITH_EXPECTED(err::site_t::ChannelWaitAllSent, WaitFor(&m_tx_sem, m_DefaultWait));
 	k_sem_give(&m_tx_sem);
 	return std::ref(*this);
     }
@@ -373,7 +520,7 @@ namespace uart
 	if (auto e = Read(&b, 1, wait); !e)
 	    return std::unexpected(e.error());
 	else if (auto l = e.value().v; !l)
-	    return std::unexpected(::Err{"Channel::ReadByte no data", 0});
+	    return std::unexpected(::Err{err::site_t::ChannelReadByte});
 	else
 	    return RetVal<uint8_t>{std::ref(*this), b};
     }
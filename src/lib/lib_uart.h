@@ -3,8 +3,13 @@
 
 #include <zephyr/kernel.h>
 #include "lib_ret_err.h"
+#include "lib_uart_trace.h"
+#include "lib_uart_transport.h"
+#include "lib_coro.h"
 #include <lib_formatter.hpp>
 #include <expected>
+#include <cstdint>
+#include <atomic>
 #include <zephyr/drivers/uart.h>
 
 namespace uart
@@ -19,8 +24,6 @@ namespace uart
     public:
         using Ref = std::reference_wrapper<Channel>;
         using ExpectedResult = std::expected<Ref, Err>;
-        static constexpr const int kUARTAsyncBufSize = 8;
-        static constexpr const int32_t kUARTRxTimeoutBits = 9 * 2;
 
         template<typename V>
         using RetVal = RetValT<Ref, V>;
@@ -30,10 +33,14 @@ namespace uart
 
         static const constexpr duration_ms_t kDefaultWait = duration_ms_t{-1};
 
+        //Receive session. With continuous reading RX is already running and the
+        //block only decides where reading starts: right after what is already
+        //in the buffer, or (keepPending) with it.
+        //Resumes the UART and keeps it resumed until Stop.
         class RxBlock
         {
         public:
-            RxBlock(Channel &c, uint8_t *pData, size_t len);
+            RxBlock(Channel &c, uint8_t *pData, size_t len, bool keepPending = false);
             ~RxBlock();
 
             void Stop();
@@ -65,64 +72,179 @@ namespace uart
 
         void AllowReadUpTo(uint8_t *pData, size_t len);
         void StopReading(bool dbg = false);
+        //enables RX right away instead of waiting for the next TX to complete
+        //(for unsolicited data); no-op if RX is not requested or already running
+        void StartReading();
+        //keeps RX running into pData from now on: sessions (RxBlock) become
+        //cursor moves and nothing the other side sends in between is dropped
+        ExpectedResult StartContinuousReading(uint8_t *pData, size_t len);
+        void StopContinuousReading();
+        bool IsReadingContinuously() const { return m_Continuous; }
 
         ExpectedResult Send(const uint8_t *pData, size_t len);
         ExpectedValue<size_t> Read(uint8_t *pBuf, size_t len, duration_ms_t wait=kDefaultWait);
+        //returns as soon as anything is available, up to 'len' bytes
+        //0 bytes on timeout is not an error
+        ExpectedValue<size_t> ReadSome(uint8_t *pBuf, size_t len, duration_ms_t wait=kDefaultWait);
         ExpectedResult Drain(bool stopAtEnd);
         ExpectedResult WaitAllSent();
 
         ExpectedValue<uint8_t> ReadByte(duration_ms_t wait=kDefaultWait);
         ExpectedValue<uint8_t> PeekByte(duration_ms_t wait=kDefaultWait);
 
+        //sleeps for 'wait' unless cancelled in the meantime
+        ExpectedResult Sleep(duration_ms_t wait);
+
+        //The waits above for a coroutine on a coro::Fiber (lib_coro.h): awaiting
+        //one suspends the coroutine instead of blocking the thread and gives
+        //0 once there, -ECANCELED if the operation is cancelled (same rules
+        //as the blocking calls), -EAGAIN once 'wait' is over.
+        class SemWait: public coro::Wait
+        {
+        public:
+            SemWait(Channel &c, struct k_sem *pSem, duration_ms_t wait);
+        private:
+            static int Check(coro::Wait &w);
+
+            Channel &m_C;
+            struct k_sem *m_pSem;
+        };
+
+        class SleepWait: public coro::Wait
+        {
+        public:
+            SleepWait(Channel &c, duration_ms_t wait);
+        private:
+            static int Check(coro::Wait &w);
+
+            Channel &m_C;
+        };
+
+        //something was received, ReadAvailable gets it
+        SemWait BytesAvailable(duration_ms_t wait = kDefaultWait) { return SemWait(*this, &m_rx_sem, wait); }
+        //the previous Tx is out, SendReady may start the next one
+        SemWait TxReady(duration_ms_t wait = kDefaultWait) { return SemWait(*this, &m_tx_sem, wait); }
+        //Sleep: -EAGAIN is its normal end
+        SleepWait Deadline(duration_ms_t wait) { return SleepWait(*this, wait); }
+        //up to 'len' bytes of what is there, without waiting
+        size_t ReadAvailable(uint8_t *pBuf, size_t len);
+        //Send once TxReady gave 0 (and Wake succeeded)
+        ExpectedResult SendReady(const uint8_t *pData, size_t len);
+
+        //Cancellation of the operation in progress. The owning thread tags
+        //each one it starts (BeginOp). Cancel(tag), from any context, aborts
+        //its current and upcoming blocking waits (Read/Send/Sleep) with
+        //-ECANCELED while it is still the one in progress: a late cancel of
+        //an earlier operation does nothing. In effect until ResetCancel,
+        //EndOp or the next BeginOp.
+        static constexpr uint32_t kOpMask = (1u << 30) - 1;
+        void BeginOp(uint32_t tag);
+        //tag of the operation in progress
+        uint32_t CurrentOp() const { return m_Op.load() & kOpMask; }
+        //true if it cancelled 'tag'
+        bool Cancel(uint32_t tag);
+        //whatever is in progress
+        void Cancel() { (void)Cancel(CurrentOp()); }
+        //the operation goes on, cancellable again
+        void ResetCancel() { BeginOp(CurrentOp()); }
+        //the operation goes on to its end and can't be cancelled any more,
+        //WasCancelled still tells whether it was
+        void EndOp();
+        bool IsCancelled() const;
+        bool WasCancelled() const { return m_Op.load() & kOpCancelled; }
+        static bool IsCancelled(Err const& e) { return e.Code() == -ECANCELED; }
+
         bool HasOverflow() const { return m_Overflow; }
 
-        //using EventCallback = GenericCallback<void(uart_event_type_t)>;
-        //void SetEventCallback(EventCallback cb) { m_EventCallback = std::move(cb); }
-        //bool HasEventCallback() const { return (bool)m_EventCallback; }
+        //Power (PM device runtime with CONFIG_PM_DEVICE_RUNTIME, only counted
+        //without). Send, StartContinuousReading and RxBlock resume the UART.
+        //Once nothing held it for the idle time the owning thread suspends it
+        //with SuspendIfIdle, continuous reading included: that one is
+        //restarted by the next resume, what the other side sends in between
+        //is lost.
+        struct PowerStats
+        {
+            uint32_t m_Resumes = 0;
+            uint32_t m_Suspends = 0;
+            uint32_t m_Failures = 0;    //PM get/put errors
+            int64_t m_ActiveMs = 0;     //resumed, up to 'now'
+        };
+        static constexpr int64_t kNoDeadline = INT64_MAX;
+        //kForever (default) - never suspended
+        void SetIdleSuspend(duration_ms_t idle) { m_IdleSuspend = idle; }
+        duration_ms_t GetIdleSuspend() const { return m_IdleSuspend; }
+        ExpectedResult Wake();
+        //uptime (ms) SuspendIfIdle is due at, kNoDeadline if not
+        int64_t IdleDeadline() const;
+        //true if it suspended the UART
+        bool SuspendIfIdle(int64_t now);
+        bool IsAwake() const { return m_Awake; }
+        PowerStats GetPowerStats(int64_t now) const;
+
+        //diagnostics built in, see lib_uart_trace.h
+        using Trace = trace::Policy;
+        using Stats = trace::Stats;
+        //all zero unless Trace::kCounters
+        Stats GetStats() const { return m_Trace.GetStats(); }
+        //dumps the bytes sent and read (Trace::kDump builds only)
+        void SetTrace(bool on) { m_Trace.SetDump(on); }
+        bool IsTracing() const { return m_Trace.Dumping(); }
+
+        //how bytes get to and from the hardware, see lib_uart_transport.h
+        using Transport = transport::Policy;
+        static constexpr const char* TransportName() { return Transport::kName; }
+        Transport& GetTransport() { return m_Transport; }
 
-        bool m_Dbg;
     private:
-        static void uart_async_callback(const struct device *dev, uart_event *evt, void *user_data);
-        int uart_send();
-        int uart_recv();
+        friend Transport;
+        //transport ISR side: bytes received, into the ring
+        void OnRx(const uint8_t *pData, size_t len);
+        //the last Tx is out
+        void OnTxDone() { k_sem_give(&m_tx_sem); }
 
         size_t ReadInternal(uint8_t *pBuf, size_t len);
+        void ReleaseRecvBuf();
+        //RxBlock done with the UART
+        void Release();
+        //takes pSem polling it together with the cancel signal
+        //0 - taken, -ECANCELED - cancelled, -EAGAIN - timeout
+        int WaitFor(struct k_sem *pSem, duration_ms_t wait);
+        //one check of a wait: -ECANCELED, 0 - pSem taken, coro::Wait::kNotYet;
+        //nullptr - only the cancel is checked
+        int Ready(struct k_sem *pSem);
 
-        const struct device *m_pUART = nullptr;
         struct k_sem m_tx_sem;
         struct k_sem m_rx_sem;
-        struct k_sem m_rx_ctrl;
+        //only wakes the owner up, m_Op tells whether it's cancelled
+        struct k_poll_signal m_cancel;
+        static constexpr uint32_t kOpCancelled = 1u << 30;
+        static constexpr uint32_t kOpEnded = 1u << 31;
+        std::atomic<uint32_t> m_Op{0};
         duration_ms_t m_DefaultWait{0};
-        bool m_rx_disable_request = false;
-        bool m_rx_enable_request = false;
-
-        bool m_rx_state = false;
-
-        uint8_t m_UARTAsyncBufs[2][kUARTAsyncBufSize];
-        int m_UARTAsyncBufNext = -1;
-        int32_t m_UARTRxTimeoutUS = 200;
-        //receive buf
-        uint8_t *m_pRecvBuf = nullptr;
-        int m_RecvLen = 0;
+        bool m_Continuous = false;
 
-        //target rcv
+        //target rcv, shared by all transports
         uint8_t *m_pInternalRecvBuf = nullptr;
         int m_InternalRecvBufLen = 0;
         int m_InternalRecvBufNextWrite = 0;
         int m_InternalRecvBufNextRead = 0;
         bool m_Overflow = false;
-
-        //transmitt buf
-        const uint8_t *m_pSendBuf = nullptr;
-        int m_SendLen = 0;
+        Trace m_Trace;
+        Transport m_Transport;
 
         bool m_HasPeekByte = false;
         uint8_t m_PeekByte = 0;
 
-        //std::atomic<bool> m_DataReady={false};
-        //EventCallback m_EventCallback;
-
-        //bool m_DbgPrintSend = false;
+        //power, owning thread only
+        duration_ms_t m_IdleSuspend = kForever;
+        int m_Holders = 0;
+        bool m_Awake = false;
+        int64_t m_IdleSince = 0;
+        int64_t m_AwakeSince = 0;
+        //continuous reading stopped by SuspendIfIdle
+        uint8_t *m_pResumeRxBuf = nullptr;
+        int m_ResumeRxLen = 0;
+        PowerStats m_Power;
     };
 }
 #endif
@@ -60,7 +60,7 @@ namespace uart
                 if (auto r = c.ReadByte(); !r)
                     return ExpectedResult(std::unexpected(r.error()));
                 else if (bytes[idx] != r.value().v)
-                    return ExpectedResult(std::unexpected(::Err{"match_bytes", ERR_OK}));
+                    return ExpectedResult(std::unexpected(::Err{err::site_t::MatchBytes}));
             }
             return ExpectedResult(std::ref(c));
         }
@@ -99,7 +99,7 @@ namespace uart
                     ++idx;
                 }
             }
-            return ExpectedResult(std::unexpected(::Err{"match_any_bytes", ERR_OK}));
+            return ExpectedResult(std::unexpected(::Err{err::site_t::MatchAnyBytes}));
         }
 
         inline auto match_bytes(Channel &c, const uint8_t *pBytes, uint8_t terminator, const char *pCtx = "")
@@ -110,7 +110,7 @@ namespace uart
                 if (auto r = c.ReadByte(); !r)
                     return ExpectedResult(std::unexpected(r.error()));
                 else if (r.value().v != *pBytes)
-                    return ExpectedResult(std::unexpected(::Err{"match_bytes", ERR_OK}));
+                    return ExpectedResult(std::unexpected(::Err{err::site_t::MatchBytes}));
                 ++pBytes;
             }
             return ExpectedResult(std::ref(c));
@@ -171,7 +171,7 @@ namespace uart
                     ++idx;
                 }
             }
-            return ExpectedResult(std::unexpected(::Err{"match_any_bytes_term", ERR_OK}));
+            return ExpectedResult(std::unexpected(::Err{err::site_t::MatchAnyBytesTerm}));
         }
 
         template<class C>
@@ -201,7 +201,7 @@ namespace uart
                 if (auto r = c.ReadByte(maxWait); !r)
                     return ExpectedResult(std::unexpected(r.error()));
             }
-            return ExpectedResult(std::unexpected(::Err{"read_until timeout", ERR_OK}));
+            return ExpectedResult(std::unexpected(::Err{err::site_t::ReadUntil}));
         }
 
         template<class... Byte>
@@ -239,7 +239,7 @@ namespace uart
                 if (auto r = c.ReadByte(cfg.maxWait); !r)
                     return ExpectedResult(std::unexpected(r.error()));
             }
-            return ExpectedResult(std::unexpected(::Err{"read_until timeout", ERR_OK}));
+            return ExpectedResult(std::unexpected(::Err{err::site_t::ReadUntil}));
         }
 
         inline auto find_bytes(Channel &c, std::span<const uint8_t> arr, duration_ms_t maxWait = kDefault, const char *pCtx = "")
@@ -256,11 +256,11 @@ namespace uart
                 if (auto r = read_until(c, arr[0], maxWait, pCtx); !r)
                     return ExpectedResult(std::unexpected(r.error()));
                 if (!check_timeout())
-                    return ExpectedResult(std::unexpected(::Err{"find_bytes timeout", ERR_OK}));
+                    return ExpectedResult(std::unexpected(::Err{err::site_t::FindBytes}));
                 if (auto r = match_bytes(c, arr, {.maxWait = maxWait, .pCtx = pCtx}); r)
                     return ExpectedResult(std::ref(c));
             }
-            return ExpectedResult(std::unexpected(::Err{"find_bytes timeout", ERR_OK}));
+            return ExpectedResult(std::unexpected(::Err{err::site_t::FindBytes}));
         }
 
         inline auto find_bytes(Channel &c, const uint8_t *arr, uint8_t term, duration_ms_t maxWait = kDefault, const char *pCtx = "")
@@ -279,15 +279,15 @@ namespace uart
                     return ExpectedResult(std::unexpected(r.error()));
                 if (!check_timeout())
                 {
-                    printk("find_bytes timeout; it=%d\r\n", it);
-                    return ExpectedResult(std::unexpected(::Err{"find_bytes timeout", ERR_OK}));
+                    UART_DIAG("find_bytes timeout; it={}", it);
+                    return ExpectedResult(std::unexpected(::Err{err::site_t::FindBytes}));
                 }
                 if (auto r = match_bytes(c, arr, term, pCtx); r)
                     return ExpectedResult(std::ref(c));
                 ++it;
             }
-            printk("find_bytes final timeout; it=%d\r\n", it);
-            return ExpectedResult(std::unexpected(::Err{"find_bytes timeout", ERR_OK}));
+            UART_DIAG("find_bytes final timeout; it={}", it);
+            return ExpectedResult(std::unexpected(::Err{err::site_t::FindBytes}));
         }
 
         [[gnu::always_inline]]inline auto find_bytes(Channel &c, const char *str, duration_ms_t maxWait = kDefault, const char *pCtx = "")
@@ -311,11 +311,11 @@ namespace uart
                 if (auto r = read_any_until(cfg, c, arr[0]...); !r)
                     return ExpectedResult(std::unexpected(r.error()));
                 if (!check_timeout())
-                    return ExpectedResult(std::unexpected(::Err{"find_any_bytes timeout", ERR_OK}));
+                    return ExpectedResult(std::unexpected(::Err{err::site_t::FindAnyBytes}));
                 if (auto r = match_any_bytes_term(c, term, arr...); r)
                     return ExpectedResult(FindAnyResult{std::ref(c), (*r).v});
             }
-            return ExpectedResult(std::unexpected(::Err{"find_any_bytes timeout", ERR_OK}));
+            return ExpectedResult(std::unexpected(::Err{err::site_t::FindAnyBytes}));
         }
 
         [[gnu::always_inline]]inline auto find_any_str_impl(cfg_t cfg, Channel &c, std::same_as<std::string_view> auto&&... str)
@@ -354,10 +354,10 @@ namespace uart
                 }
 
                 if (!check_timeout())
-                    return ExpectedResult(std::unexpected(::Err{"read_until_into timeout", ERR_OK}));
+                    return ExpectedResult(std::unexpected(::Err{err::site_t::ReadUntilInto}));
 
                 if (!dstSize)
-                    return ExpectedResult(std::unexpected(::Err{"read_until_into dst too small", ERR_OK}));
+                    return ExpectedResult(std::unexpected(::Err{err::site_t::ReadUntilIntoSize}));
 
                 if (auto r = c.ReadByte(cfg.maxWait); !r)
                     return ExpectedResult(std::unexpected(r.error()));
@@ -367,7 +367,7 @@ namespace uart
                     --dstSize;
                 }
             }
-            return ExpectedResult(std::unexpected(::Err{"read_until_into timeout", ERR_OK}));
+            return ExpectedResult(std::unexpected(::Err{err::site_t::ReadUntilInto}));
         }
 
         template<class T>
@@ -377,7 +377,7 @@ namespace uart
             if (auto r = c.Read((uint8_t*)&dst, sizeof(T)); !r)
                 return ExpectedResult(std::unexpected(r.error()));
             else if (r.value().v != sizeof(T))
-                return ExpectedResult(std::unexpected(::Err{"read_into wrong len", ERR_OK}));
+                return ExpectedResult(std::unexpected(::Err{err::site_t::ReadInto}));
 
             return ExpectedResult(std::ref(c));
         }
@@ -387,8 +387,8 @@ namespace uart
             using ExpectedResult = std::expected<Channel::Ref, ::Err>;
             if (auto r = c.Read(pDst, l); !r)
                 return ExpectedResult(std::unexpected(r.error()));
-            else if (r.value().v != l)
-                return ExpectedResult(std::unexpected(::Err{"read_into_bytes wrong len", ERR_OK}));
+            else if (r.value().v != (size_t)l)
+                return ExpectedResult(std::unexpected(::Err{err::site_t::ReadIntoBytes}));
 
             return ExpectedResult(std::ref(c));
         }
@@ -518,7 +518,7 @@ namespace uart
         {
             auto sz = uart::primitives::uart_rtsize(a);
             if (limit < sz)
-                return Channel::ExpectedResult(std::unexpected(::Err{"recv_for_checked: Insufficient length", ERR_OK})); 
+                return Channel::ExpectedResult(std::unexpected(::Err{err::site_t::RecvForChecked}));
             limit -= sz;
 
             using PureT = std::remove_cvref_t<T>;
@@ -0,0 +1,181 @@
+#ifndef LIB_UART_TRACE_H_
+#define LIB_UART_TRACE_H_
+
+#include <zephyr/kernel.h>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include "lib_spsc_ring.h"
+#include "lib_dlog.h"
+
+//Diagnostics built into uart::Channel (and so into dfr::C4001), chosen at build time:
+// UART_TRACE_OFF      - nothing: no counters, no byte dump, no diagnostic messages
+// UART_TRACE_COUNTERS - Stats counters and diagnostic messages
+// UART_TRACE_DUMP     - the above plus a byte dump switched on and off at runtime
+//                       (Channel::SetTrace); bytes sent, read and dropped unread go
+//                       into a ring printed later by the system work queue, never
+//                       printk per byte in the read path
+#define UART_TRACE_OFF      0
+#define UART_TRACE_COUNTERS 1
+#define UART_TRACE_DUMP     2
+
+#ifndef UART_TRACE
+#define UART_TRACE UART_TRACE_COUNTERS
+#endif
+
+//diagnostic messages: deferred (lib_dlog.h), compiled out below UART_TRACE_COUNTERS
+#if UART_TRACE >= UART_TRACE_COUNTERS
+#define UART_DIAG(...) DLOG(__VA_ARGS__)
+#else
+#define UART_DIAG(...) do {} while(0)
+#endif
+
+namespace uart::trace
+{
+    //counted from the UART callback and the owning thread without locking:
+    //a reader on another thread may see them slightly torn (diagnostics only)
+    struct Stats
+    {
+        uint32_t m_Events = 0;      //async UART callbacks
+        uint32_t m_RxBytes = 0;
+        uint32_t m_TxBytes = 0;
+        uint32_t m_Overflows = 0;   //RX chunks that overwrote unread data
+        uint32_t m_RxRestarts = 0;  //RX re-enabled after the driver stopped it
+        uint32_t m_DumpDropped = 0; //dump bytes lost to a full ring
+        uint32_t m_IsrCycles = 0;   //spent in the transport's ISRs
+    };
+
+    //every hook is empty: the hot paths compile to what they were without tracing
+    class Off
+    {
+    public:
+        static constexpr bool kCounters = false;
+        static constexpr bool kDump = false;
+
+        void OnEvent() {}
+        void OnRx(size_t) {}
+        void OnOverflow() {}
+        void OnRxRestart() {}
+        void OnTx(const uint8_t *, size_t) {}
+        void OnRead(const uint8_t *, size_t) {}
+        void OnDrop(const uint8_t *, size_t) {}
+        void OnIsr(uint32_t) {}
+
+        void SetDump(bool) {}
+        bool Dumping() const { return false; }
+        Stats GetStats() const { return {}; }
+    };
+
+    class Counters
+    {
+    public:
+        static constexpr bool kCounters = true;
+        static constexpr bool kDump = false;
+
+        void OnEvent() { ++m_Stats.m_Events; }
+        void OnRx(size_t n) { m_Stats.m_RxBytes += n; }
+        void OnOverflow() { ++m_Stats.m_Overflows; }
+        void OnRxRestart() { ++m_Stats.m_RxRestarts; }
+        void OnTx(const uint8_t *, size_t n) { m_Stats.m_TxBytes += n; }
+        void OnRead(const uint8_t *, size_t) {}
+        void OnDrop(const uint8_t *, size_t) {}
+        //start: k_cycle_get_32() on ISR entry
+        void OnIsr(uint32_t start) { m_Stats.m_IsrCycles += k_cycle_get_32() - start; }
+
+        void SetDump(bool) {}
+        bool Dumping() const { return false; }
+        Stats GetStats() const { return m_Stats; }
+    protected:
+        Stats m_Stats;
+    };
+
+    //Counters plus the bytes sent ('>'), read ('<') and dropped unread ('x')
+    //by the owning thread.
+    //The owning thread is the only producer, the system work queue the only consumer.
+    class Dump: public Counters
+    {
+    public:
+        static constexpr bool kDump = true;
+        static constexpr size_t kRingSize = 256;
+
+        Dump() { k_work_init(&m_Flush, on_flush); }
+
+        void OnTx(const uint8_t *p, size_t n) { Counters::OnTx(p, n); Record('>', p, n); }
+        void OnRead(const uint8_t *p, size_t n) { Record('<', p, n); }
+        void OnDrop(const uint8_t *p, size_t n) { Record('x', p, n); }
+
+        void SetDump(bool on) { m_On = on; }
+        bool Dumping() const { return m_On; }
+    private:
+        void Push(char c)
+        {
+            if (!m_Ring.Push(c))
+                ++m_Stats.m_DumpDropped;
+        }
+
+        void Record(char dir, const uint8_t *p, size_t n)
+        {
+            if (!m_On || !n)
+                return;
+            if (dir != m_Dir)
+            {
+                m_Dir = dir;
+                Push('\n');
+                Push(dir);
+                Push(' ');
+            }
+            for(size_t i = 0; i < n; ++i)
+            {
+                char c = (char)p[i];
+                //line endings are where the sensor protocol breaks its lines anyway
+                Push(c == '\r' || c == '\n' || (c >= ' ' && c < 0x7f) ? c : '.');
+            }
+            k_work_submit(&m_Flush);
+        }
+
+        static void on_flush(struct k_work *w)
+        {
+            auto &d = *CONTAINER_OF(w, Dump, m_Flush);
+            char buf[32];
+            size_t n = 0;
+            for(char c; d.m_Ring.Pop(c);)
+            {
+                buf[n++] = c;
+                if (n == sizeof(buf))
+                {
+                    printk("%.*s", (int)n, buf);
+                    n = 0;
+                }
+            }
+            if (n)
+                printk("%.*s", (int)n, buf);
+        }
+
+        SPSCRing<char, kRingSize> m_Ring;
+        struct k_work m_Flush;
+        std::atomic<bool> m_On{false};
+        char m_Dir = 0;
+    };
+
+    //times a transport ISR (Stats::m_IsrCycles), nothing without counters
+    template<class T>
+    class IsrTimer
+    {
+    public:
+        IsrTimer(T &t):m_T(t), m_Start(T::kCounters ? k_cycle_get_32() : 0) {}
+        ~IsrTimer() { m_T.OnIsr(m_Start); }
+    private:
+        T &m_T;
+        uint32_t m_Start;
+    };
+
+#if UART_TRACE == UART_TRACE_DUMP
+    using Policy = Dump;
+#elif UART_TRACE == UART_TRACE_COUNTERS
+    using Policy = Counters;
+#else
+    using Policy = Off;
+#endif
+}
+
+#endif
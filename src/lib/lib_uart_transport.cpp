@@ -0,0 +1,383 @@
+#include "lib_uart.h"
+#include <utility>
+#if defined(CONFIG_PM_DEVICE_RUNTIME)
+#include <zephyr/pm/device_runtime.h>
+#endif
+
+//only the transport selected by UART_TRANSPORT is built: the others may need
+//driver APIs this build doesn't have
+namespace uart::transport
+{
+    //a no-op unless the UART has runtime PM enabled (zephyr,pm-device-runtime-auto);
+    //the driver switches to the "sleep" pinctrl state while suspended
+    [[maybe_unused]] static int pm_get(const struct device *pUART)
+    {
+#if defined(CONFIG_PM_DEVICE_RUNTIME)
+	return pm_device_runtime_get(pUART);
+#else
+	return 0;
+#endif
+    }
+
+    [[maybe_unused]] static int pm_put(const struct device *pUART)
+    {
+#if defined(CONFIG_PM_DEVICE_RUNTIME)
+	return pm_device_runtime_put(pUART);
+#else
+	return 0;
+#endif
+    }
+
+#if UART_TRANSPORT == UART_TRANSPORT_ASYNC
+#if !defined(CONFIG_UART_ASYNC_API)
+#error "UART_TRANSPORT_ASYNC needs CONFIG_UART_ASYNC_API"
+#endif
+    /**********************************************************************/
+    /* Async                                                              */
+    /**********************************************************************/
+    int Async::Configure(duration_ms_t rxGap)
+    {
+	m_RxTimeoutUS = 1'000 * rxGap;
+	if (m_RxTimeoutUS == 0) m_RxTimeoutUS = 4;
+	k_sem_init(&m_RxCtrl, 0, 1);
+	return uart_callback_set(m_pUART, on_event, this);
+    }
+
+    int Async::Enable()
+    {
+	return uart_rx_enable(m_pUART, m_Bufs[0], kBufSize, m_RxTimeoutUS);
+    }
+
+    int Async::Tx(const uint8_t *pData, size_t len)
+    {
+	return uart_tx(m_pUART, pData, len, SYS_FOREVER_US);
+    }
+
+    void Async::StartRx()
+    {
+	unsigned int key = irq_lock();
+	bool requested = m_EnableRequest;
+	m_EnableRequest = false;
+	irq_unlock(key);
+	if (requested)
+	    Enable();
+    }
+
+    int Async::StartContinuousRx()
+    {
+	m_EnableRequest = false;
+	return Enable();
+    }
+
+    int Async::StopRx(k_timeout_t wait)
+    {
+	unsigned int key = irq_lock();
+	bool rx_never_enabled = m_EnableRequest;
+	m_EnableRequest = false;
+	irq_unlock(key);
+	//RX was requested but never enabled: nothing to wait for
+	if (rx_never_enabled)
+	    return 0;
+	//taken down on the next buffer request/release
+	m_DisableRequest = true;
+	return k_sem_take(&m_RxCtrl, wait);
+    }
+
+    int Async::StopContinuousRx(k_timeout_t wait)
+    {
+	//no need to wait for the next RX buffer request, nothing may be coming
+	if (int r = uart_rx_disable(m_pUART); r != 0)
+	    return r;
+	return k_sem_take(&m_RxCtrl, wait);
+    }
+
+    void Async::EnsureRx()
+    {
+	if (m_BufNext != -1)
+	    return;
+	UART_DIAG("Read: restarting recv");
+	m_BufNext = 0;
+	Enable();
+    }
+
+    int Async::Resume()
+    {
+	return pm_get(m_pUART);
+    }
+
+    int Async::Suspend()
+    {
+	return pm_put(m_pUART);
+    }
+
+    void Async::on_event(const struct device *dev, uart_event *evt, void *user_data)
+    {
+	Async &t = *(Async *)user_data;
+	Channel &c = t.m_C;
+	trace::IsrTimer timer(c.m_Trace);
+	c.m_Trace.OnEvent();
+	switch(evt->type)
+	{
+	    case UART_TX_ABORTED:
+		break;
+	    case UART_TX_DONE:
+	    {
+		c.OnTxDone();
+		if (t.m_EnableRequest)
+		{
+		    t.m_EnableRequest = false;
+		    t.Enable();
+		}
+	    }
+	    break;
+	    case UART_RX_BUF_REQUEST:
+	    {
+		if (t.m_DisableRequest)
+		{
+		    t.m_DisableRequest = false;
+		    uart_rx_disable(dev);
+		    break;
+		}
+
+		if (t.m_BufNext != -1)
+		{
+		    t.m_RxState = true;
+		    t.m_BufNext ^= 1;
+		    uart_rx_buf_rsp(dev, t.m_Bufs[t.m_BufNext], kBufSize);
+		}
+	    }
+	    break;
+	    case UART_RX_BUF_RELEASED:
+		if (t.m_DisableRequest)
+		{
+		    t.m_DisableRequest = false;
+		    uart_rx_disable(dev);
+		}
+		break;
+	    case UART_RX_DISABLED:
+		t.m_RxState = false;
+		if (c.m_Continuous)
+		{
+		    //the driver gave up on a line error: keep reading
+		    c.m_Trace.OnRxRestart();
+		    t.m_BufNext = 0;
+		    t.Enable();
+		    break;
+		}
+		t.m_BufNext = -1;
+		k_sem_give(&t.m_RxCtrl);
+		break;
+	    case UART_RX_RDY:
+		c.OnRx(evt->data.rx.buf + evt->data.rx.offset, evt->data.rx.len);
+		break;
+	    case UART_RX_STOPPED:
+		//continuous reading restarts once RX_DISABLED follows
+		if (!c.m_Continuous && !t.m_DisableRequest && c.m_pInternalRecvBuf && t.m_BufNext != -1)
+		{
+		    t.m_RxState = false;
+		    c.m_Trace.OnRxRestart();
+		    t.m_BufNext = 0;
+		    t.Enable();
+		}
+		break;
+	}
+    }
+
+#elif UART_TRANSPORT == UART_TRANSPORT_IRQ
+#if !defined(CONFIG_UART_INTERRUPT_DRIVEN)
+#error "UART_TRANSPORT_IRQ needs CONFIG_UART_INTERRUPT_DRIVEN (and CONFIG_UART_<n>_INTERRUPT_DRIVEN for the sensor UART)"
+#endif
+    /**********************************************************************/
+    /* Irq                                                                */
+    /**********************************************************************/
+    int Irq::Configure(duration_ms_t)
+    {
+	uart_irq_rx_disable(m_pUART);
+	uart_irq_tx_disable(m_pUART);
+	return uart_irq_callback_user_data_set(m_pUART, on_irq, this);
+    }
+
+    int Irq::Tx(const uint8_t *pData, size_t len)
+    {
+	m_pTx = pData;
+	m_TxLen = len;
+	uart_irq_tx_enable(m_pUART);
+	return 0;
+    }
+
+    void Irq::StartRx()
+    {
+	unsigned int key = irq_lock();
+	bool requested = m_Armed;
+	m_Armed = false;
+	irq_unlock(key);
+	if (requested)
+	    uart_irq_rx_enable(m_pUART);
+    }
+
+    int Irq::StartContinuousRx()
+    {
+	m_Armed = false;
+	uart_irq_rx_enable(m_pUART);
+	return 0;
+    }
+
+    int Irq::StopRx(k_timeout_t)
+    {
+	unsigned int key = irq_lock();
+	m_Armed = false;
+	irq_unlock(key);
+	uart_irq_rx_disable(m_pUART);
+	return 0;
+    }
+
+    int Irq::Resume()
+    {
+	return pm_get(m_pUART);
+    }
+
+    int Irq::Suspend()
+    {
+	return pm_put(m_pUART);
+    }
+
+    void Irq::on_irq(const struct device *dev, void *user_data)
+    {
+	Irq &t = *(Irq *)user_data;
+	Channel &c = t.m_C;
+	trace::IsrTimer timer(c.m_Trace);
+	c.m_Trace.OnEvent();
+	if (!uart_irq_update(dev))
+	    return;
+	if (uart_irq_rx_ready(dev))
+	{
+	    uint8_t buf[16];
+	    int n;
+	    while((n = uart_fifo_read(dev, buf, sizeof(buf))) > 0)
+		c.OnRx(buf, n);
+	}
+	if (uart_irq_tx_ready(dev))
+	{
+	    if (t.m_TxLen)
+	    {
+		if (int n = uart_fifo_fill(dev, t.m_pTx, t.m_TxLen); n > 0)
+		{
+		    t.m_pTx += n;
+		    t.m_TxLen -= n;
+		}
+	    }
+	    if (!t.m_TxLen)
+	    {
+		uart_irq_tx_disable(dev);
+		c.OnTxDone();
+		if (t.m_Armed)
+		{
+		    t.m_Armed = false;
+		    uart_irq_rx_enable(dev);
+		}
+	    }
+	}
+    }
+
+#elif UART_TRANSPORT == UART_TRANSPORT_POLL
+    /**********************************************************************/
+    /* Poll                                                               */
+    /**********************************************************************/
+    int Poll::Configure(duration_ms_t)
+    {
+	k_timer_init(&m_Timer, on_timer, nullptr);
+	k_timer_user_data_set(&m_Timer, this);
+	return 0;
+    }
+
+    int Poll::Tx(const uint8_t *pData, size_t len)
+    {
+	for(size_t i = 0; i < len; ++i)
+	    uart_poll_out(m_pUART, pData[i]);
+	m_C.OnTxDone();
+	if (std::exchange(m_Armed, false))
+	    k_timer_start(&m_Timer, K_USEC(kPollPeriodUs), K_USEC(kPollPeriodUs));
+	return 0;
+    }
+
+    void Poll::StartRx()
+    {
+	if (std::exchange(m_Armed, false))
+	    k_timer_start(&m_Timer, K_USEC(kPollPeriodUs), K_USEC(kPollPeriodUs));
+    }
+
+    int Poll::StartContinuousRx()
+    {
+	m_Armed = false;
+	k_timer_start(&m_Timer, K_USEC(kPollPeriodUs), K_USEC(kPollPeriodUs));
+	return 0;
+    }
+
+    int Poll::StopRx(k_timeout_t)
+    {
+	m_Armed = false;
+	k_timer_stop(&m_Timer);
+	return 0;
+    }
+
+    int Poll::Resume()
+    {
+	return pm_get(m_pUART);
+    }
+
+    int Poll::Suspend()
+    {
+	return pm_put(m_pUART);
+    }
+
+    void Poll::on_timer(struct k_timer *timer)
+    {
+	Poll &t = *(Poll *)k_timer_user_data_get(timer);
+	Channel &c = t.m_C;
+	trace::IsrTimer isr(c.m_Trace);
+	uint8_t buf[16];
+	size_t n = 0;
+	unsigned char b;
+	while(n < sizeof(buf) && uart_poll_in(t.m_pUART, &b) == 0)
+	    buf[n++] = b;
+	if (!n)
+	    return;
+	c.m_Trace.OnEvent();
+	c.OnRx(buf, n);
+    }
+
+#elif UART_TRANSPORT == UART_TRANSPORT_MEMORY
+#if defined(__ZEPHYR__) && !defined(CONFIG_ARCH_POSIX)
+#error "UART_TRANSPORT_MEMORY would leave the real sensor unconnected: native_sim and host tests only"
+#endif
+    /**********************************************************************/
+    /* Memory                                                             */
+    /**********************************************************************/
+    int Memory::Tx(const uint8_t *pData, size_t len)
+    {
+	m_C.OnTxDone();
+	if (std::exchange(m_Armed, false))
+	    m_Receiving = true;
+	//may answer right away through Feed
+	if (m_OnTx)
+	    m_OnTx(m_OnTxCtx, pData, len);
+	return 0;
+    }
+
+    void Memory::StartRx()
+    {
+	if (std::exchange(m_Armed, false))
+	    m_Receiving = true;
+    }
+
+    void Memory::Feed(const uint8_t *pData, size_t len)
+    {
+	if (!m_Receiving || !len)
+	    return;
+	//timed like an RX interrupt, so delivery sizes can be compared
+	trace::IsrTimer isr(m_C.m_Trace);
+	m_C.m_Trace.OnEvent();
+	m_C.OnRx(pData, len);
+    }
+#endif
+}
@@ -0,0 +1,193 @@
+#ifndef LIB_UART_TRANSPORT_H_
+#define LIB_UART_TRANSPORT_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/uart.h>
+#include <cstdint>
+#include <cstddef>
+
+//How uart::Channel moves bytes, chosen at build time. The Channel front end
+//(sessions, waits, cancel, the receive ring, tracing) is the same for all:
+//a transport only starts/stops the hardware and reports from its ISR through
+//Channel::OnRx (bytes received, into the shared ring) and Channel::OnTxDone
+//(the last Tx is out).
+// UART_TRANSPORT_ASYNC  - Zephyr async API (EasyDMA on nRF), CONFIG_UART_ASYNC_API
+// UART_TRANSPORT_IRQ    - interrupt driven FIFO, CONFIG_UART_INTERRUPT_DRIVEN
+// UART_TRANSPORT_POLL   - uart_poll_in/out, a timer polls RX every kPollPeriodUs
+// UART_TRANSPORT_MEMORY - no hardware: Tx goes to a callback, RX is fed by
+//                         Memory::Feed (native_sim, host tests)
+#define UART_TRANSPORT_ASYNC  0
+#define UART_TRANSPORT_IRQ    1
+#define UART_TRANSPORT_POLL   2
+#define UART_TRANSPORT_MEMORY 3
+
+#ifndef UART_TRANSPORT
+#define UART_TRANSPORT UART_TRANSPORT_ASYNC
+#endif
+
+namespace uart
+{
+    class Channel;
+    using duration_ms_t = int;
+}
+
+namespace uart::transport
+{
+    //Every transport, called from the owning thread:
+    //  int Configure(duration_ms_t rxGap)  - rxGap: silence that ends an RX chunk
+    //  int Tx(p, n)                 - starts sending, Channel::OnTxDone once it's out
+    //  void ArmRx()                 - RX wanted from the end of the next Tx on
+    //  void StartRx()               - armed RX right away
+    //  int StartContinuousRx()      - RX from now on, restarted after line errors
+    //  int StopRx(k_timeout_t)      - ends armed or running RX, waits until it's down
+    //  int StopContinuousRx(k_timeout_t)
+    //  void EnsureRx()              - restarts RX the driver gave up on
+    //  void ReleaseRx()             - the receive ring is gone
+    //  int Resume()                 - powers the UART up (PM device runtime)
+    //  int Suspend()                - powers it down, RX stopped before
+    class Async
+    {
+    public:
+        static constexpr const char kName[] = "async";
+        static constexpr int kBufSize = 8;
+
+        Async(Channel &c, const struct device *pUART):m_C(c), m_pUART(pUART) {}
+
+        int Configure(duration_ms_t rxGap);
+        int Tx(const uint8_t *pData, size_t len);
+        void ArmRx()
+        {
+            m_BufNext = 0;
+            m_EnableRequest = true;
+        }
+        void StartRx();
+        int StartContinuousRx();
+        int StopRx(k_timeout_t wait);
+        int StopContinuousRx(k_timeout_t wait);
+        void EnsureRx();
+        void ReleaseRx() { m_BufNext = -1; }
+        int Resume();
+        int Suspend();
+    private:
+        static void on_event(const struct device *dev, uart_event *evt, void *user_data);
+        int Enable();
+
+        Channel &m_C;
+        const struct device *m_pUART;
+        struct k_sem m_RxCtrl;
+        bool m_DisableRequest = false;
+        bool m_EnableRequest = false;
+        bool m_RxState = false;
+        uint8_t m_Bufs[2][kBufSize];
+        int m_BufNext = -1;
+        int32_t m_RxTimeoutUS = 200;
+    };
+
+    //The TX interrupt feeds the FIFO; OnTxDone comes once the last byte is
+    //in the FIFO, not on the wire.
+    class Irq
+    {
+    public:
+        static constexpr const char kName[] = "irq";
+
+        Irq(Channel &c, const struct device *pUART):m_C(c), m_pUART(pUART) {}
+
+        int Configure(duration_ms_t rxGap);
+        int Tx(const uint8_t *pData, size_t len);
+        void ArmRx() { m_Armed = true; }
+        void StartRx();
+        int StartContinuousRx();
+        int StopRx(k_timeout_t wait);
+        int StopContinuousRx(k_timeout_t wait) { return StopRx(wait); }
+        void EnsureRx() {}
+        void ReleaseRx() {}
+        int Resume();
+        int Suspend();
+    private:
+        static void on_irq(const struct device *dev, void *user_data);
+
+        Channel &m_C;
+        const struct device *m_pUART;
+        const uint8_t *m_pTx = nullptr;
+        size_t m_TxLen = 0;
+        bool m_Armed = false;
+    };
+
+    //Busy Tx, RX polled from a timer: for boards without async or IRQ
+    //support on the sensor UART. The hardware must buffer what arrives
+    //within kPollPeriodUs (a byte per ms at 9600 baud).
+    class Poll
+    {
+    public:
+        static constexpr const char kName[] = "poll";
+        static constexpr uint32_t kPollPeriodUs = 500;
+
+        Poll(Channel &c, const struct device *pUART):m_C(c), m_pUART(pUART) {}
+
+        int Configure(duration_ms_t rxGap);
+        int Tx(const uint8_t *pData, size_t len);
+        void ArmRx() { m_Armed = true; }
+        void StartRx();
+        int StartContinuousRx();
+        int StopRx(k_timeout_t wait);
+        int StopContinuousRx(k_timeout_t wait) { return StopRx(wait); }
+        void EnsureRx() {}
+        void ReleaseRx() {}
+        int Resume();
+        int Suspend();
+    private:
+        static void on_timer(struct k_timer *t);
+
+        Channel &m_C;
+        const struct device *m_pUART;
+        struct k_timer m_Timer;
+        bool m_Armed = false;
+    };
+
+    //No hardware at all: what the Channel sends goes to the OnTx callback
+    //(e.g. a simulated sensor that answers through Feed), RX is whatever Feed
+    //hands in while receiving. Everything runs in the caller's context.
+    class Memory
+    {
+    public:
+        static constexpr const char kName[] = "memory";
+        using on_tx_t = void(*)(void *ctx, const uint8_t *pData, size_t len);
+
+        Memory(Channel &c, const struct device *):m_C(c) {}
+
+        void SetOnTx(on_tx_t f, void *ctx) { m_OnTx = f; m_OnTxCtx = ctx; }
+        //as if received; dropped unless receiving
+        void Feed(const uint8_t *pData, size_t len);
+
+        int Configure(duration_ms_t) { return 0; }
+        int Tx(const uint8_t *pData, size_t len);
+        void ArmRx() { m_Armed = true; }
+        void StartRx();
+        int StartContinuousRx() { m_Receiving = true; return 0; }
+        int StopRx(k_timeout_t) { m_Armed = m_Receiving = false; return 0; }
+        int StopContinuousRx(k_timeout_t w) { return StopRx(w); }
+        void EnsureRx() {}
+        void ReleaseRx() {}
+        //nothing to power, Channel still counts the transitions
+        int Resume() { return 0; }
+        int Suspend() { return 0; }
+    private:
+        Channel &m_C;
+        on_tx_t m_OnTx = nullptr;
+        void *m_OnTxCtx = nullptr;
+        bool m_Armed = false;
+        bool m_Receiving = false;
+    };
+
+#if UART_TRANSPORT == UART_TRANSPORT_MEMORY
+    using Policy = Memory;
+#elif UART_TRANSPORT == UART_TRANSPORT_POLL
+    using Policy = Poll;
+#elif UART_TRANSPORT == UART_TRANSPORT_IRQ
+    using Policy = Irq;
+#else
+    using Policy = Async;
+#endif
+}
+
+#endif
@@ -10,7 +10,23 @@
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/settings/settings.h>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
 #include "c4001_task.hpp"
+#include "c4001_presets.hpp"
+#include "metrics.hpp"
+#include "presence_filter.hpp"
+#include "occupancy_fsm.hpp"
+#include "report_limiter.hpp"
+#include "approach_predictor.hpp"
+#include "zone_tracker.hpp"
+#include "frame_use.hpp"
+#include <array>
+#include "lib/lib_spsc_ring.h"
+#include "lib/lib_dlog.h"
 
 /**********************************************************************/
 /* Zigbee                                                             */
@@ -20,6 +36,7 @@
 #include <nrfzbcpp/zb_status_cluster_desc.hpp>
 #include <nrfzbcpp/zb_occupancy_sensing_cluster_desc.hpp>
 #include "zb/zb_c4001_cluster_desc.hpp"
+#include "zb/zb_c4001_zone_cluster_desc.hpp"
 
 /**********************************************************************/
 /* Zigbee Declarations and Definitions                                */
@@ -40,18 +57,53 @@ static bool g_ZigbeeReady = false;
 /* Button to start Factory Reset */
 #define FACTORY_RESET_BUTTON IDENTIFY_MODE_BUTTON
 
+#define DT_DRV_COMPAT dfr_c4001
+
 /* Device endpoint, used to receive light controlling commands. */
 constexpr uint8_t kMMW_EP = 1;
 constexpr uint16_t kDEV_ID = 0xBAAD;
+constexpr uint16_t kZONE_DEV_ID = 0xBAAE;
 
-struct device_ctx_t{
-    zb::zb_zcl_basic_names_t basic_attr;
+/* One endpoint per sensor ('dfr,c4001' instance), followed by the endpoints
+ * of its virtual zones (occupancy of a distance interval each):
+ * sensor 0 on kMMW_EP, its zones on 2..4, sensor 1 on 5, its zones on 6..8, ... */
+constexpr uint8_t kSensors = c4001::kSensors;
+constexpr size_t kZonesPerSensor = 3;
+constexpr size_t kZones = kSensors * kZonesPerSensor;
+
+constexpr uint8_t sensor_ep(size_t s) { return uint8_t(kMMW_EP + s * (kZonesPerSensor + 1)); }
+constexpr uint8_t zone_ep(size_t z) { return uint8_t(sensor_ep(z / kZonesPerSensor) + 1 + z % kZonesPerSensor); }
+constexpr uint8_t zone_sensor(size_t z) { return uint8_t(z / kZonesPerSensor); }
+
+template<size_t... I>
+constexpr auto make_eps(uint8_t(*ep)(size_t), std::index_sequence<I...>)
+{
+    return std::array<uint8_t, sizeof...(I)>{ep(I)...};
+}
+constexpr auto kSensorEPs = make_eps(sensor_ep, std::make_index_sequence<kSensors>());
+constexpr auto kZoneEPs = make_eps(zone_ep, std::make_index_sequence<kZones>());
+static_assert(zone_ep(kZones - 1) <= 240, "zigbee application endpoints end at 240");
+
+struct zone_ctx_t{
+    zb::zb_zcl_occupancy_pir_and_ultrasonic_t occupancy;
+    zb::zb_zcl_on_off_attrs_client_t on_off_client;
+    zb::zb_zcl_c4001_zone_t zone;
+};
+
+struct sensor_ctx_t{
     zb::zb_zcl_status_t status_attr;
     zb::zb_zcl_occupancy_pir_and_ultrasonic_t occupancy;
     zb::zb_zcl_on_off_attrs_client_t on_off_client;
     zb::zb_zcl_c4001_t c4001;
 };
 
+struct device_ctx_t{
+    zb::zb_zcl_basic_names_t basic_attr;
+    sensor_ctx_t sensors[kSensors];
+    //zones split the range of their sensor: zone z belongs to zone_sensor(z)
+    zone_ctx_t zones[kZones];
+};
+
 //attribute shortcuts for template arguments
 
 /**********************************************************************/
@@ -70,6 +122,37 @@ constexpr auto kAttrRTrig = &zb::zb_zcl_c4001_t::range_trig;
 constexpr auto kAttrInhibitDuration = &zb::zb_zcl_c4001_t::inhibit_duration;
 constexpr auto kAttrSTrig = &zb::zb_zcl_c4001_t::sensitivity_detect;
 constexpr auto kAttrSHold = &zb::zb_zcl_c4001_t::sensitivity_hold;
+constexpr auto kAttrSWVer = &zb::zb_zcl_c4001_t::sw_ver;
+constexpr auto kAttrHWVer = &zb::zb_zcl_c4001_t::hw_ver;
+constexpr auto kAttrActivePreset = &zb::zb_zcl_c4001_t::active_preset;
+constexpr auto kAttrPresenceGlitch = &zb::zb_zcl_c4001_t::presence_glitch;
+constexpr auto kAttrPresenceHold = &zb::zb_zcl_c4001_t::presence_hold;
+constexpr auto kAttrOccupancyHold = &zb::zb_zcl_c4001_t::occupancy_hold;
+constexpr auto kAttrRunMode = &zb::zb_zcl_c4001_t::run_mode;
+constexpr auto kAttrTargetDistance = &zb::zb_zcl_c4001_t::target_distance;
+constexpr auto kAttrTargetSpeed = &zb::zb_zcl_c4001_t::target_speed;
+constexpr auto kAttrTargetEnergy = &zb::zb_zcl_c4001_t::target_energy;
+constexpr auto kAttrTargetReportInterval = &zb::zb_zcl_c4001_t::target_report_interval;
+constexpr auto kAttrTargetDistanceChange = &zb::zb_zcl_c4001_t::target_distance_change;
+constexpr auto kAttrTargetSpeedChange = &zb::zb_zcl_c4001_t::target_speed_change;
+constexpr auto kAttrApproachLead = &zb::zb_zcl_c4001_t::approach_lead;
+constexpr auto kAttrCalibState = &zb::zb_zcl_c4001_t::calib_state;
+constexpr auto kAttrCalibFrames = &zb::zb_zcl_c4001_t::calib_frames;
+constexpr auto kAttrCalibGhosts = &zb::zb_zcl_c4001_t::calib_ghosts;
+constexpr auto kAttrCalibEnergyMean = &zb::zb_zcl_c4001_t::calib_energy_mean;
+constexpr auto kAttrCalibEnergyStd = &zb::zb_zcl_c4001_t::calib_energy_std;
+constexpr auto kAttrCalibEnergyMax = &zb::zb_zcl_c4001_t::calib_energy_max;
+constexpr auto kAttrRecoveries = &zb::zb_zcl_c4001_t::recoveries;
+constexpr auto kAttrRecoveryTime = &zb::zb_zcl_c4001_t::recovery_time;
+constexpr auto kAttrLastError = &zb::zb_zcl_c4001_t::last_error;
+constexpr auto kCmdConfigResp = &zb::zb_zcl_c4001_t::config_resp;
+
+/**********************************************************************/
+/* Zone attributes                                                    */
+/**********************************************************************/
+constexpr auto kAttrZoneFrom = &zb::zb_zcl_c4001_zone_t::zone_from;
+constexpr auto kAttrZoneTo = &zb::zb_zcl_c4001_zone_t::zone_to;
+constexpr auto kAttrZoneHysteresis = &zb::zb_zcl_c4001_zone_t::zone_hysteresis;
 
 /**********************************************************************/
 /* Occupancy attribute shortcuts                                      */
@@ -81,7 +164,30 @@ constexpr auto kAttrClearToDetectDelay = &zb::zb_zcl_c4001_t::detect_delay;//&zb
 constexpr auto kCmdOn = &zb::zb_zcl_on_off_attrs_client_t::on;
 constexpr auto kCmdOff = &zb::zb_zcl_on_off_attrs_client_t::off;
 
-zb::CmdHandlingResult on_cmd_restart();
+template<uint8_t S> zb::CmdHandlingResult on_cmd_restart();
+template<uint8_t S> zb::CmdHandlingResult on_cmd_apply_config(uint8_t mask, float range_min, float range_max, float range_trig, float inhibit, uint8_t s_detect, uint8_t s_hold, float detect_delay, float clear_delay);
+template<uint8_t S> zb::CmdHandlingResult on_cmd_read_config();
+template<uint8_t S> zb::CmdHandlingResult on_cmd_store_preset(uint8_t k);
+template<uint8_t S> zb::CmdHandlingResult on_cmd_activate_preset(uint8_t k);
+template<uint8_t S> zb::CmdHandlingResult on_cmd_calibrate(uint8_t step_s);
+
+//commands reach the sensor of the endpoint they were sent to
+template<uint8_t S>
+constexpr sensor_ctx_t make_sensor_ctx()
+{
+    return {
+	.c4001{
+	    .cmd_restart = {.cb = on_cmd_restart<S>},
+	    .cmd_apply_config = {.cb = on_cmd_apply_config<S>},
+	    .cmd_read_config = {.cb = on_cmd_read_config<S>},
+	    .cmd_store_preset = {.cb = on_cmd_store_preset<S>},
+	    .cmd_activate_preset = {.cb = on_cmd_activate_preset<S>},
+	    .cmd_calibrate = {.cb = on_cmd_calibrate<S>},
+	}
+    };
+}
+
+#define C4001_SENSOR_CTX_INIT(inst) make_sensor_ctx<inst>(),
 
 /* Zigbee device application context storage. */
 static constinit device_ctx_t dev_ctx{
@@ -93,20 +199,50 @@ static constinit device_ctx_t dev_ctx{
 	/*.manufacturer =*/ INIT_BASIC_MANUF_NAME,
 	/*.model =*/ INIT_BASIC_MODEL_ID,
     },
-    .c4001{
-	.cmd_restart = {.cb = on_cmd_restart}
-    }
+    .sensors{ DT_INST_FOREACH_STATUS_OKAY(C4001_SENSOR_CTX_INIT) }
 };
+#undef C4001_SENSOR_CTX_INIT
 
-constinit static auto zb_ctx = zb::make_device(
-	zb::make_ep_args<{.ep=kMMW_EP, .dev_id=kDEV_ID, .dev_ver=1}>(
+//the first sensor endpoint also carries the basic cluster
+template<uint8_t S>
+constexpr auto make_sensor_ep_args()
+{
+    auto &c = dev_ctx.sensors[S];
+    if constexpr (S == 0)
+	return zb::make_ep_args<{.ep=kSensorEPs[S], .dev_id=kDEV_ID, .dev_ver=1}>(
 	    dev_ctx.basic_attr
-	    , dev_ctx.status_attr
-	    , dev_ctx.occupancy
-	    , dev_ctx.c4001
-	    , dev_ctx.on_off_client
-	    )
-	);
+	    , c.status_attr
+	    , c.occupancy
+	    , c.c4001
+	    , c.on_off_client
+	    );
+    else
+	return zb::make_ep_args<{.ep=kSensorEPs[S], .dev_id=kDEV_ID, .dev_ver=1}>(
+	    c.status_attr
+	    , c.occupancy
+	    , c.c4001
+	    , c.on_off_client
+	    );
+}
+
+template<size_t Z>
+constexpr auto make_zone_ep_args()
+{
+    auto &c = dev_ctx.zones[Z];
+    return zb::make_ep_args<{.ep=kZoneEPs[Z], .dev_id=kZONE_DEV_ID, .dev_ver=1}>(
+	    c.occupancy
+	    , c.zone
+	    , c.on_off_client
+	    );
+}
+
+template<size_t... S, size_t... Z>
+constexpr auto make_zb_device(std::index_sequence<S...>, std::index_sequence<Z...>)
+{
+    return zb::make_device(make_sensor_ep_args<S>()..., make_zone_ep_args<Z>()...);
+}
+
+constinit static auto zb_ctx = make_zb_device(std::make_index_sequence<kSensors>(), std::make_index_sequence<kZones>());
 
 /**********************************************************************/
 /* Defining access to the global zigbee device context                */
@@ -117,8 +253,24 @@ struct zb::global_device
     static auto& get() { return zb_ctx; }
 };
 
-//a shortcut for a convenient access
-constinit static auto &zb_ep = zb_ctx.ep<kMMW_EP>();
+//calls f(ep) with the endpoint of sensor 's'
+template<class F>
+void with_sensor_ep(uint8_t s, F &&f)
+{
+    [&]<size_t... S>(std::index_sequence<S...>){
+	((s == S ? f(zb_ctx.ep<kSensorEPs[S]>()) : void()), ...);
+    }(std::make_index_sequence<kSensors>());
+}
+
+//binds a c4001:: setter to sensor S for handle_set_for
+template<uint8_t S, auto F>
+struct bind_sensor;
+
+template<uint8_t S, class... A, void(*F)(uint8_t, A...)>
+struct bind_sensor<S, F>
+{
+    static void call(A... a) { F(S, a...); }
+};
 
 /**********************************************************************/
 /* Device defines                                                     */
@@ -132,140 +284,852 @@ constinit static auto &zb_ep = zb_ctx.ep<kMMW_EP>();
  */
 static const struct gpio_dt_spec led = GPIO_DT_SPEC_GET(LED0_NODE, gpios);
 
-///* Get the node from the alias */
-#define SENSOR_NODE DT_ALIAS(presence)
+void send_on_off(uint8_t s, uint8_t val, bool pinEdge);
+void send_config_resp(uint8_t s, uint8_t status);
+
+/**********************************************************************/
+/* Per sensor state                                                   */
+/**********************************************************************/
+struct edge_t
+{
+    int64_t ticks;	//for the filter
+    uint32_t cycles;	//for latency metrics
+    uint8_t level;
+};
+
+//an error of the c4001 worker and the Err it was logged with
+struct sensor_err_t
+{
+    c4001::err_t what;
+    Err why;
+};
+
+//a sensor frame and when the c4001 worker decoded it (k_uptime_get):
+//frames wait for zigbee in bursts, their own time is what the occupancy
+//holds and the approach track go by
+struct timed_frame_t
+{
+    dfr::frames::frame_t f;
+    int64_t at;
+};
+
+//pinEdge: 1 if called for a filtered pin transition
+void evaluate_occupancy(uint8_t s, uint8_t pinEdge);
+
+void on_occupancy_deadline(uint8_t s);
+void on_occupancy_timer(struct k_timer *t);
+
+//RAM per sensor: ~0.8KB, most of it the edge and frame rings;
+//plus the zigbee attributes of its endpoint and kZonesPerSensor zone endpoints
+struct sensor_state_t
+{
+    //presence-gpios of the 'dfr,c4001' node
+    const gpio_dt_spec pin;
+    gpio_callback cb;
+    dfr::C4001 *pC4001 = nullptr;
+
+    //filled from the ISR, drained in zigbee context
+    SPSCRing<edge_t, 16> edges;
+    std::atomic<bool> edges_drain_scheduled{false};
+    std::atomic<uint32_t> edges_dropped{0};
+    //from the c4001 worker, drained in zigbee context in order
+    SPSCRing<sensor_err_t, 8> errors;
+    presence::filter_t presence_filter;
+    //cycle counter at the edge that produced the latest level
+    uint32_t edge_cycles = 0;
+    //the last on/off command a pin edge caused, until its APS confirm:
+    //the buffer it went out in, its edge and when it was handed over
+    zb_bufid_t aps_buf = ZB_BUF_INVALID;
+    uint32_t aps_edge_cycles = 0;
+    uint32_t aps_sent_cycles = 0;
 
-constinit static dfr::C4001 *pC4001 = nullptr;
+    //occupancy: filtered pin + sensor frames
+    occupancy::fsm_t occupancy;
+    //from the c4001 worker, drained in zigbee context: every frame counts
+    //(consecutive target frames, a presence frame between target ones)
+    SPSCRing<timed_frame_t, 8> frames;
+    std::atomic<bool> frames_drain_scheduled{false};
+    std::atomic<uint32_t> frames_dropped{0};
+    //distance, speed
+    reporting::limiter_t<2> target_report;
+    approach::predictor_t approach;
+    //ms resolution for the clear hold, ZBOSS alarms are too coarse for it
+    k_timer occupancy_timer;
+    //dev_ctx.zones[s * kZonesPerSensor + i], fed by this sensor's frames
+    zones::zone_t zones[kZonesPerSensor];
 
-/* Get the GPIO spec directly from the node */
-/* Note: We look for the property "gpios" inside the node */
-static const struct gpio_dt_spec presence = GPIO_DT_SPEC_GET(SENSOR_NODE, gpios);
+    //config version last pushed into the attributes
+    std::atomic<uint32_t> last_cfg_version{0};
+};
+
+#define C4001_SENSOR_STATE_INIT(inst) {.pin = GPIO_DT_SPEC_INST_GET(inst, presence_gpios)},
+static sensor_state_t g_Sensors[kSensors] = { DT_INST_FOREACH_STATUS_OKAY(C4001_SENSOR_STATE_INIT) };
+#undef C4001_SENSOR_STATE_INIT
 
-void send_on_off(uint8_t val);
+static uint8_t sensor_id(sensor_state_t const& st) { return uint8_t(&st - g_Sensors); }
 
-gpio_callback g_cb;
+void drain_presence_edges(uint8_t s);
+void evaluate_presence(uint8_t s);
+
+void on_occupancy_timer(struct k_timer *t)
+{
+    auto &st = *CONTAINER_OF(t, sensor_state_t, occupancy_timer);
+    zb_schedule_app_callback(&on_occupancy_deadline, sensor_id(st));
+}
 
 void presence_triggered(const struct device *port,
 					struct gpio_callback *cb,
 					gpio_port_pins_t pins)
 {
-    int val = gpio_pin_get_dt(&presence);
+    auto &st = *CONTAINER_OF(cb, sensor_state_t, cb);
+    edge_t e{.ticks = k_uptime_ticks(), .cycles = k_cycle_get_32(), .level = (uint8_t)gpio_pin_get_dt(&st.pin)};
     //TODO: remove me
-    gpio_pin_set_dt(&led, val);
+    gpio_pin_set_dt(&led, e.level);
 
+    uint8_t s = sensor_id(st);
     if (g_ZigbeeReady) //post to zigbee and shoot commands
-	zb_schedule_app_callback(&send_on_off, val);
+    {
+	if (!st.edges.Push(e))
+	    ++st.edges_dropped;
+	//one pending drain covers any number of edges
+	if (!st.edges_drain_scheduled.exchange(true))
+	    zb_schedule_app_callback(&drain_presence_edges, s);
+    }
     else
     {
 	//write latest state directly
-	dev_ctx.occupancy.occupancy = val;
+	dev_ctx.sensors[s].occupancy.occupancy = e.level;
+    }
+}
+
+void drain_presence_edges(uint8_t s)
+{
+    auto &st = g_Sensors[s];
+    st.edges_drain_scheduled = false;
+    edge_t e;
+    while(st.edges.Pop(e))
+    {
+	st.presence_filter.OnEdge(e.level, e.ticks);
+	st.edge_cycles = e.cycles;
+	++metrics::presence(s).edges;
+    }
+    evaluate_presence(s);
+}
+
+void evaluate_presence(uint8_t s)
+{
+    auto &st = g_Sensors[s];
+    ZB_SCHEDULE_APP_ALARM_CANCEL(evaluate_presence, s);
+    int64_t now = k_uptime_ticks();
+    if (int l = st.presence_filter.Evaluate(now); l != presence::filter_t::kNone)
+    {
+	st.occupancy.OnPin(l == 1, k_uptime_get());
+	evaluate_occupancy(s, 1);
+    }
+    if (auto d = st.presence_filter.Deadline(); d != presence::filter_t::kNoDeadline)
+	ZB_SCHEDULE_APP_ALARM(evaluate_presence, s, ZB_MILLISECONDS_TO_BEACON_INTERVAL(k_ticks_to_ms_ceil32(d - now)));
+}
+
+void evaluate_occupancy(uint8_t s, uint8_t pinEdge)
+{
+    auto &st = g_Sensors[s];
+    int64_t now = k_uptime_get();
+    if (int o = st.occupancy.Evaluate(now); o != occupancy::fsm_t::kNone)
+	send_on_off(s, o, pinEdge);
+    if (auto d = st.occupancy.Deadline(); d != occupancy::fsm_t::kNoDeadline)
+	k_timer_start(&st.occupancy_timer, K_MSEC(std::max<int64_t>(d - now, 0)), K_NO_WAIT);
+    else
+	k_timer_stop(&st.occupancy_timer);
+}
+
+void on_occupancy_deadline(uint8_t s)
+{
+    evaluate_occupancy(s, 0);
+}
+
+template<size_t Z>
+void send_zone_on_off(uint8_t val)
+{
+    auto &ep = zb_ctx.ep<kZoneEPs[Z]>();
+    if (val == 1)
+	ep.template send_cmd<kCmdOn>();
+    else
+	ep.template send_cmd<kCmdOff>();
+    ep.template attr<kAttrOccupancy>() = val == 1;
+}
+
+template<size_t... Z>
+constexpr auto make_zone_senders(std::index_sequence<Z...>)
+{
+    return std::array<void(*)(uint8_t), kZones>{&send_zone_on_off<Z>...};
+}
+constexpr auto kZoneSend = make_zone_senders(std::make_index_sequence<kZones>());
+
+//Zones clear on their own deadline, not on the next frame: the sensor may
+//go quiet, the stream stop or be paused by the supervisor.
+//Their holds are seconds, ZBOSS alarms are fine for them.
+void evaluate_zones(uint8_t s)
+{
+    auto &st = g_Sensors[s];
+    ZB_SCHEDULE_APP_ALARM_CANCEL(evaluate_zones, s);
+    int64_t now = k_uptime_get();
+    int64_t next = zones::zone_t::kNoDeadline;
+    for(size_t i = 0; i < kZonesPerSensor; ++i)
+    {
+	if (int o = st.zones[i].Evaluate(now); o != zones::zone_t::kNone)
+	    kZoneSend[s * kZonesPerSensor + i](o);
+	next = std::min(next, st.zones[i].Deadline());
+    }
+    if (next != zones::zone_t::kNoDeadline)
+	ZB_SCHEDULE_APP_ALARM(evaluate_zones, s, ZB_MILLISECONDS_TO_BEACON_INTERVAL(std::max<int64_t>(next - now, 0)));
+}
+
+void publish_target(uint8_t s, dfr::frames::frame_t const& f, int64_t now)
+{
+    if (dev_ctx.sensors[s].c4001.target_report_interval == zb::kTargetReportOff)
+	return;
+    float d = f.targets ? f.range : 0.f;
+    float v = f.targets ? f.speed : 0.f;
+    if (!g_Sensors[s].target_report.Offer({d, v}, now))
+	return;
+    with_sensor_ep(s, [&](auto &ep){
+	ep.template attr<kAttrTargetDistance>() = d;
+	ep.template attr<kAttrTargetSpeed>() = v;
+	ep.template attr<kAttrTargetEnergy>() = f.targets ? (uint32_t)f.energy : 0;
+    });
+}
+
+void on_frame(uint8_t s, timed_frame_t const& tf)
+{
+    auto &st = g_Sensors[s];
+    auto const& f = tf.f;
+    int64_t now = tf.at;
+    if (f.kind == dfr::frames::kind_t::Presence)
+	st.occupancy.OnPresenceFrame(f.present, now);
+    else if (f.kind == dfr::frames::kind_t::Target)
+    {
+	st.occupancy.OnTargetFrame(f.targets, f.range, now);
+	if (!f.targets)
+	    st.approach.Lost();
+	else if (st.approach.Update(f.range, f.speed, now))
+	{
+	    st.occupancy.OnApproach(now);
+	    ++metrics::presence(s).predicted;
+	}
+	publish_target(s, f, now);
+    }
+    //presence frames mean no target info: zones clear after their hold
+    bool hasTarget = f.kind == dfr::frames::kind_t::Target && f.targets;
+    for(size_t i = 0; i < kZonesPerSensor; ++i)
+    {
+	if (int o = st.zones[i].Update(hasTarget, f.range, now); o != zones::zone_t::kNone)
+	    kZoneSend[s * kZonesPerSensor + i](o);
+    }
+}
+
+void zb_c4001_frame(uint8_t s)
+{
+    auto &st = g_Sensors[s];
+    st.frames_drain_scheduled = false;
+    timed_frame_t tf;
+    bool any = false;
+    while(st.frames.Pop(tf))
+    {
+	on_frame(s, tf);
+	any = true;
+    }
+    if (!any)
+	return;
+    evaluate_zones(s);
+    //the latest frame tells the mode the sensor is in
+    uint8_t mode = tf.f.kind == dfr::frames::kind_t::Target;
+    with_sensor_ep(s, [&](auto &ep){
+	if (ep.template attr<kAttrRunMode>() != mode)
+	    ep.template attr<kAttrRunMode>() = mode;
+    });
+    evaluate_occupancy(s, 0);
+}
+
+//c4001 worker, right after the frame is decoded
+void on_c4001_frame(uint8_t s, dfr::frames::frame_t const& f)
+{
+    if (!g_ZigbeeReady)
+	return;
+    auto &st = g_Sensors[s];
+    if (!st.frames.Push({f, k_uptime_get()}))
+	++st.frames_dropped;
+    //one pending drain covers any number of frames
+    if (!st.frames_drain_scheduled.exchange(true))
+	zb_schedule_app_callback(&zb_c4001_frame, s);
+}
+
+//Frames feed the zones, the approach predictor and the target attributes.
+//With all of them off nothing is streamed: occupancy follows the pin alone
+//and the sensor UART suspends between requests.
+void update_frame_use(uint8_t s)
+{
+    auto const& zc4001 = dev_ctx.sensors[s].c4001;
+    bool zones = false;
+    for(auto const& z : g_Sensors[s].zones)
+	zones = zones || z.Enabled();
+    c4001::set_frames_wanted(s, frame_use::wanted({
+		.zones = zones,
+		.approach_lead = zc4001.approach_lead,
+		.target_report_interval = zc4001.target_report_interval,
+		}));
+}
+
+//both depend on range_trig: call again when it changes
+void update_occupancy_fsm(uint8_t s)
+{
+    auto &st = g_Sensors[s];
+    auto const& zc4001 = dev_ctx.sensors[s].c4001;
+    auto c = st.occupancy.GetConfig();
+    c.hold = zc4001.occupancy_hold;
+    c.trig_range = zc4001.range_trig;
+    st.occupancy.SetConfig(c);
+
+    auto a = st.approach.GetConfig();
+    a.lead = zc4001.approach_lead;
+    a.threshold = zc4001.range_trig;
+    st.approach.SetConfig(a);
+
+    //zones ride on target frames only, same clear semantics as the main occupancy
+    for(size_t i = 0; i < kZonesPerSensor; ++i)
+    {
+	auto const& zc = dev_ctx.zones[s * kZonesPerSensor + i].zone;
+	st.zones[i].SetConfig({
+		.from = zc.zone_from,
+		.to = zc.zone_to,
+		.hysteresis = zc.zone_hysteresis,
+		.hold = c.frame_ttl + c.hold,
+		});
+    }
+    update_frame_use(s);
+    //a zone disabled or with a shorter hold may have to clear now
+    if (g_ZigbeeReady)
+	evaluate_zones(s);
+}
+
+void update_target_report(uint8_t s)
+{
+    auto const& zc4001 = dev_ctx.sensors[s].c4001;
+    g_Sensors[s].target_report.SetConfig({
+	    .min_interval = zc4001.target_report_interval,
+	    .min_change = {zc4001.target_distance_change, zc4001.target_speed_change},
+	    });
+    update_frame_use(s);
+}
+
+void update_presence_filter(uint8_t s)
+{
+    auto const& zc4001 = dev_ctx.sensors[s].c4001;
+    g_Sensors[s].presence_filter.SetConfig({
+	    .glitch = (int64_t)k_ms_to_ticks_ceil64(zc4001.presence_glitch),
+	    .min_hold = (int64_t)k_ms_to_ticks_ceil64(zc4001.presence_hold),
+	    });
+}
+
+//"presence/<name>" for the first sensor (as before multi-sensor support), "presence/<s>/<name>" for the others
+template<class T>
+void save_presence(uint8_t s, const char *name, T const& v)
+{
+    char key[32];
+    if (!s)
+	snprintf(key, sizeof(key), "presence/%s", name);
+    else
+	snprintf(key, sizeof(key), "presence/%d/%s", s, name);
+    settings_save_one(key, &v, sizeof(v));
+}
+
+template<uint8_t S>
+void on_presence_glitch_changed(uint16_t ms)
+{
+    dev_ctx.sensors[S].c4001.presence_glitch = ms;
+    save_presence(S, "glitch", ms);
+    update_presence_filter(S);
+}
+
+template<uint8_t S>
+void on_presence_hold_changed(uint16_t ms)
+{
+    dev_ctx.sensors[S].c4001.presence_hold = ms;
+    save_presence(S, "hold", ms);
+    update_presence_filter(S);
+}
+
+template<uint8_t S>
+void on_occupancy_hold_changed(uint16_t ms)
+{
+    dev_ctx.sensors[S].c4001.occupancy_hold = ms;
+    save_presence(S, "occ_hold", ms);
+    update_occupancy_fsm(S);
+    evaluate_occupancy(S, 0);
+}
+
+template<uint8_t S>
+void on_run_mode_changed(uint8_t mode)
+{
+    //run_mode follows the frames once the sensor has switched
+    c4001::set_run_mode(S, mode);
+}
+
+template<uint8_t S>
+void on_target_report_interval_changed(uint16_t ms)
+{
+    dev_ctx.sensors[S].c4001.target_report_interval = ms;
+    save_presence(S, "tgt_int", ms);
+    update_target_report(S);
+}
+
+template<uint8_t S>
+void on_target_distance_change_changed(float v)
+{
+    dev_ctx.sensors[S].c4001.target_distance_change = v;
+    save_presence(S, "tgt_dist", v);
+    update_target_report(S);
+}
+
+template<uint8_t S>
+void on_target_speed_change_changed(float v)
+{
+    dev_ctx.sensors[S].c4001.target_speed_change = v;
+    save_presence(S, "tgt_speed", v);
+    update_target_report(S);
+}
+
+template<uint8_t S>
+void on_approach_lead_changed(uint16_t ms)
+{
+    dev_ctx.sensors[S].c4001.approach_lead = ms;
+    save_presence(S, "appr_lead", ms);
+    update_occupancy_fsm(S);
+}
+
+//"zone/<z>", z counts the zones of all sensors
+void save_zone(size_t z)
+{
+    char key[16];
+    snprintf(key, sizeof(key), "zone/%u", (unsigned)z);
+    settings_save_one(key, &dev_ctx.zones[z].zone, sizeof(dev_ctx.zones[z].zone));
+}
+
+template<size_t Z>
+void on_zone_from_changed(float v)
+{
+    dev_ctx.zones[Z].zone.zone_from = v;
+    save_zone(Z);
+    update_occupancy_fsm(zone_sensor(Z));
+}
+
+template<size_t Z>
+void on_zone_to_changed(float v)
+{
+    dev_ctx.zones[Z].zone.zone_to = v;
+    save_zone(Z);
+    update_occupancy_fsm(zone_sensor(Z));
+}
+
+template<size_t Z>
+void on_zone_hysteresis_changed(float v)
+{
+    dev_ctx.zones[Z].zone.zone_hysteresis = v;
+    save_zone(Z);
+    update_occupancy_fsm(zone_sensor(Z));
+}
+
+static int zone_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+    char *end;
+    unsigned long z = strtoul(name, &end, 10);
+    if (end == name || *end || z >= kZones)
+	return -ENOENT;
+    auto &dst = dev_ctx.zones[z].zone;
+    if (len != sizeof(dst))
+	return -EINVAL;
+    return read_cb(cb_arg, &dst, sizeof(dst)) < 0 ? -EIO : 0;
+}
+SETTINGS_STATIC_HANDLER_DEFINE(zone_cfg, "zone", nullptr, zone_settings_set, nullptr, nullptr);
+
+static int presence_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+    //see save_presence for the keys
+    uint8_t s = 0;
+    if (name[0] >= '1' && name[0] <= '9' && name[1] == '/')
+    {
+	s = name[0] - '0';
+	name += 2;
     }
+    if (s >= kSensors)
+	return -ENOENT;
+    auto &c = dev_ctx.sensors[s].c4001;
+    void *pDst = nullptr;
+    size_t sz = 0;
+    auto bind = [&](auto &v){ pDst = &v; sz = sizeof(v); };
+    if (!strcmp(name, "glitch"))
+	bind(c.presence_glitch);
+    else if (!strcmp(name, "hold"))
+	bind(c.presence_hold);
+    else if (!strcmp(name, "occ_hold"))
+	bind(c.occupancy_hold);
+    else if (!strcmp(name, "tgt_int"))
+	bind(c.target_report_interval);
+    else if (!strcmp(name, "tgt_dist"))
+	bind(c.target_distance_change);
+    else if (!strcmp(name, "tgt_speed"))
+	bind(c.target_speed_change);
+    else if (!strcmp(name, "appr_lead"))
+	bind(c.approach_lead);
+    else
+	return -ENOENT;
+    if (len != sz)
+	return -EINVAL;
+    return read_cb(cb_arg, pDst, sz) < 0 ? -EIO : 0;
 }
+SETTINGS_STATIC_HANDLER_DEFINE(presence_filter, "presence", nullptr, presence_settings_set, nullptr, nullptr);
+
+template<uint8_t S>
 zb::CmdHandlingResult on_cmd_restart()
 {
-    printk("c4001::restart\r\n");
-    c4001::restart();
+    DLOG("c4001[{}]::restart", S);
+    c4001::restart(S);
     return {};
 }
 
-void send_on_off(uint8_t val)
+template<uint8_t S>
+zb::CmdHandlingResult on_cmd_apply_config(uint8_t mask, float range_min, float range_max, float range_trig, float inhibit, uint8_t s_detect, uint8_t s_hold, float detect_delay, float clear_delay)
 {
-    zb_ep.attr<kAttrOccupancy>() = val == 1;
-    if (val == 1)
-	zb_ep.send_cmd<kCmdOn>();
+    using namespace c4001; 
+    using M = zb::c4001_cfg_mask_t;
+    DLOG("c4001[{}]::apply_config: {:x}", S, mask);
+    auto *pC4001 = g_Sensors[S].pC4001;
+    if (!pC4001)
+    {
+	//no sensor to apply it to: the caller waits for a response
+	send_config_resp(S, (uint8_t)err_t::ApplyConfig);
+	return {};
+    }
+    //parameters not in the mask keep their current values
+    config_t cfg{
+	.range_from = mask & M::RangeMin ? range_min : pC4001->GetRangeFrom(),
+	.range_to = mask & M::RangeMax ? range_max : pC4001->GetRangeTo(),
+	.range_trig = range_trig,
+	.inhibit_duration = inhibit,
+	.detect_delay = mask & M::DetectDelay ? detect_delay : pC4001->GetDetectLatency(),
+	.clear_delay = mask & M::ClearDelay ? clear_delay : pC4001->GetClearLatency(),
+	.sensitivity_detect = mask & M::SensitivityDetect ? s_detect : pC4001->GetSensitivityTrig(),
+	.sensitivity_hold = mask & M::SensitivityHold ? s_hold : pC4001->GetSensitivityHold(),
+    };
+    cfg_id_t ids{};
+    if ((mask & M::RangeMin) || (mask & M::RangeMax)) ids |= cfg_id_t::Range;
+    if (mask & M::RangeTrig) ids |= cfg_id_t::RangeTrig;
+    if (mask & M::InhibitDuration) ids |= cfg_id_t::InhibitDuration;
+    if ((mask & M::SensitivityDetect) || (mask & M::SensitivityHold)) ids |= cfg_id_t::Sensitivity;
+    if ((mask & M::DetectDelay) || (mask & M::ClearDelay)) ids |= cfg_id_t::Delay;
+
+    if (ids == cfg_id_t{})
+	send_config_resp(S, (uint8_t)err_t::Ok);
     else
-	zb_ep.send_cmd<kCmdOff>();
+	apply_config(S, cfg, ids);
+    return {};
+}
+
+template<uint8_t S>
+zb::CmdHandlingResult on_cmd_read_config()
+{
+    send_config_resp(S, (uint8_t)c4001::err_t::Ok);
+    return {};
+}
+
+template<uint8_t S>
+zb::CmdHandlingResult on_cmd_store_preset(uint8_t k)
+{
+    DLOG("c4001[{}]::store_preset: {}", S, k);
+    c4001::store_preset(S, k);
+    return {};
+}
+
+template<uint8_t S>
+zb::CmdHandlingResult on_cmd_activate_preset(uint8_t k)
+{
+    DLOG("c4001[{}]::activate_preset: {}", S, k);
+    c4001::activate_preset(S, k);
+    return {};
+}
+
+template<uint8_t S>
+zb::CmdHandlingResult on_cmd_calibrate(uint8_t step_s)
+{
+    DLOG("c4001[{}]::calibrate: {}s per step", S, step_s);
+    if (!step_s)
+	return {};
+    auto &ep = zb_ctx.ep<kSensorEPs[S]>();
+    ep.template attr<kAttrCalibState>() = std::to_underlying(c4001::calibration_t::state_t::Running);
+    c4001::calibrate(S, step_s, ep.template attr<kAttrRunMode>());
+    return {};
+}
+
+void send_config_resp(uint8_t s, uint8_t status)
+{
+    with_sensor_ep(s, [&](auto &ep){
+	ep.template send_cmd<kCmdConfigResp>(
+		status
+		, std::to_underlying(zb::c4001_cfg_mask_t::All)
+		, ep.template attr<kAttrRMin>()
+		, ep.template attr<kAttrRMax>()
+		, ep.template attr<kAttrRTrig>()
+		, ep.template attr<kAttrInhibitDuration>()
+		, ep.template attr<kAttrSTrig>()
+		, ep.template attr<kAttrSHold>()
+		, ep.template attr<kAttrClearToDetectDelay>()
+		, ep.template attr<kAttrDetectToClearDelay>()
+		, ep.template attr<kAttrSWVer>()
+		, ep.template attr<kAttrHWVer>()
+		);
+    });
+}
+
+//APS confirm of an on/off command: the last stage of the pin edge timing
+//(acked for a unicast binding, handed to the MAC for a group one)
+void on_on_off_confirm(zb_bufid_t bufid)
+{
+    auto const& r = *ZB_BUF_GET_PARAM(bufid, zb_zcl_command_send_status_t);
+    const uint32_t now = k_cycle_get_32();
+    for(uint8_t s = 0; s < kSensors; ++s)
+    {
+	auto &st = g_Sensors[s];
+	//a newer command replaced its timing, or not a pin edge one
+	if (st.aps_buf != bufid)
+	    continue;
+	st.aps_buf = ZB_BUF_INVALID;
+	auto &m = metrics::presence(s);
+	if (r.status != RET_OK)
+	{
+	    ++m.aps_failed;
+	    continue;
+	}
+	m.send_to_ack.Add(metrics::cycles_to_us(st.aps_sent_cycles, now));
+	m.edge_to_ack.Add(metrics::cycles_to_us(st.aps_edge_cycles, now));
+    }
+    zb_buf_free(bufid);
+}
+
+//On/off command to the bindings of the sensor endpoint. Built here rather
+//than with send_cmd, which has no confirm callback.
+//Returns the buffer it went out in, ZB_BUF_INVALID if none was free: then
+//it's queued by send_cmd, without a confirm.
+zb_bufid_t send_on_off_cmd(uint8_t s, uint8_t val)
+{
+    zb_bufid_t buf = zb_buf_get_out();
+    if (buf == ZB_BUF_INVALID)
+    {
+	with_sensor_ep(s, [&](auto &ep){
+	    if (val == 1)
+		ep.template send_cmd<kCmdOn>();
+	    else
+		ep.template send_cmd<kCmdOff>();
+	});
+	return ZB_BUF_INVALID;
+    }
+    //no address: the binding table has the destinations
+    zb_uint16_t bound = 0;
+    ZB_ZCL_ON_OFF_SEND_REQ(buf, bound, ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT, 0, kSensorEPs[s]
+	    , ZB_AF_HA_PROFILE_ID, ZB_ZCL_DISABLE_DEFAULT_RESPONSE
+	    , val == 1 ? ZB_ZCL_CMD_ON_OFF_ON_ID : ZB_ZCL_CMD_ON_OFF_OFF_ID, on_on_off_confirm);
+    return buf;
+}
+
+//Pin edge timing, metrics::presence_t: edge -> this callback -> command
+//handed to the stack -> its APS confirm (on_on_off_confirm)
+void send_on_off(uint8_t s, uint8_t val, bool pinEdge)
+{
+    auto &st = g_Sensors[s];
+    auto &m = metrics::presence(s);
+    m.dropped = st.edges_dropped;
+    m.frames_dropped = st.frames_dropped;
+    uint32_t edge = st.edge_cycles;
+    //edge latencies only make sense for transitions a pin edge caused
+    if (pinEdge)
+	m.edge_to_cb.Add(metrics::cycles_to_us(edge, k_cycle_get_32()));
+
+    //the command is what switches the lights: it goes first,
+    //the occupancy attribute report can follow
+    zb_bufid_t buf = send_on_off_cmd(s, val);
+    if (pinEdge)
+    {
+	const uint32_t sent = k_cycle_get_32();
+	m.edge_to_send.Add(metrics::cycles_to_us(edge, sent));
+	st.aps_buf = buf;
+	st.aps_edge_cycles = edge;
+	st.aps_sent_cycles = sent;
+    }
+    ++m.forwarded;
+
+    with_sensor_ep(s, [&](auto &ep){
+	ep.template attr<kAttrOccupancy>() = val == 1;
+    });
 }
 
 void on_dev_cb_error(int err)
 {
-    printk("on_dev_cb_error: %d\r\n", err);
+    DLOG("on_dev_cb_error: {}", err);
 }
 
+template<uint8_t S>
 void zb_c4001_update(uint8_t e)
 {
     using namespace c4001; 
     cfg_id_t id = (cfg_id_t)e;
+    auto &st = g_Sensors[S];
+    auto &ep = zb_ctx.ep<kSensorEPs[S]>();
+    //one consistent snapshot for all the attributes
+    uint32_t ver;
+    auto cfg = st.pC4001->GetConfig(&ver);
+    st.last_cfg_version = ver;
     if (id & cfg_id_t::Range)
     {
-	zb_ep.attr<kAttrRMin>() = pC4001->GetRangeFrom();
-	zb_ep.attr<kAttrRMax>() = pC4001->GetRangeTo();
+	ep.template attr<kAttrRMin>() = cfg.m_MinRange;
+	ep.template attr<kAttrRMax>() = cfg.m_MaxRange;
     }
     if (id & cfg_id_t::RangeTrig)
     {
-	zb_ep.attr<kAttrRTrig>() = pC4001->GetTriggerDistance();
+	ep.template attr<kAttrRTrig>() = cfg.m_TrigRange;
+	update_occupancy_fsm(S);
     }
     if (id & cfg_id_t::Delay)
     {
-	zb_ep.attr<kAttrClearToDetectDelay>() = pC4001->GetDetectLatency();
-	zb_ep.attr<kAttrDetectToClearDelay>() = pC4001->GetClearLatency();
+	ep.template attr<kAttrClearToDetectDelay>() = cfg.m_DetectLatency;
+	ep.template attr<kAttrDetectToClearDelay>() = cfg.m_ClearLatency;
     }
     if (id & cfg_id_t::InhibitDuration)
     {
-	zb_ep.attr<kAttrInhibitDuration>() = pC4001->GetInhibitDuration();
+	ep.template attr<kAttrInhibitDuration>() = cfg.m_Inhibit;
     }
     if (id & cfg_id_t::Sensitivity)
     {
-	zb_ep.attr<kAttrSTrig>() = pC4001->GetSensitivityTrig();
-	zb_ep.attr<kAttrSHold>() = pC4001->GetSensitivityHold();
+	ep.template attr<kAttrSTrig>() = cfg.m_SensitivityTrigger;
+	ep.template attr<kAttrSHold>() = cfg.m_SensitivityHold;
     }
+    if (id & cfg_id_t::Preset)
+    {
+	ep.template attr<kAttrActivePreset>() = presets::active(S);
+    }
+    if (id & cfg_id_t::Calibration)
+    {
+	auto c = calibration_result(S);
+	ep.template attr<kAttrCalibFrames>() = c.frames;
+	ep.template attr<kAttrCalibGhosts>() = c.ghosts;
+	ep.template attr<kAttrCalibEnergyMean>() = c.energy_mean;
+	ep.template attr<kAttrCalibEnergyStd>() = c.energy_std;
+	ep.template attr<kAttrCalibEnergyMax>() = c.energy_max;
+	//last: it's the one reported
+	ep.template attr<kAttrCalibState>() = std::to_underlying(c.state);
+    }
+    //each resync of the supervisor is followed by a full update
+    auto const& h = metrics::sensor_health(S);
+    ep.template attr<kAttrRecoveryTime>() = h.last_recovery_ms;
+    ep.template attr<kAttrRecoveries>() = (uint16_t)std::min<uint32_t>(h.recoveries, UINT16_MAX);
+    if (id & cfg_id_t::Response)
+	send_config_resp(S, (uint8_t)err_t::Ok);
 }
 
-void zb_c4001_error(uint8_t e)
+template<uint8_t S>
+void handle_c4001_error(c4001::err_t e, Err why)
 {
     using namespace c4001;
     //generally: set zb attributes to current values
-    switch(err_t(e))
+    switch(e)
     {
 	case err_t::Range:
-	    zb_c4001_update((uint8_t)cfg_id_t::Range);
+	    zb_c4001_update<S>((uint8_t)cfg_id_t::Range);
 	    break;
 	case err_t::RangeTrig:
-	    zb_c4001_update((uint8_t)cfg_id_t::RangeTrig);
+	    zb_c4001_update<S>((uint8_t)cfg_id_t::RangeTrig);
 	    break;
 	case err_t::Delay:
-	    zb_c4001_update((uint8_t)cfg_id_t::Delay);
+	    zb_c4001_update<S>((uint8_t)cfg_id_t::Delay);
 	    break;
 	case err_t::InhibitDuration:
-	    zb_c4001_update((uint8_t)cfg_id_t::InhibitDuration);
+	    zb_c4001_update<S>((uint8_t)cfg_id_t::InhibitDuration);
 	    break;
 	case err_t::Sensitivity:
-	    zb_c4001_update((uint8_t)cfg_id_t::Sensitivity);
+	    zb_c4001_update<S>((uint8_t)cfg_id_t::Sensitivity);
+	    break;
+	case err_t::ActivatePreset:
+	    zb_c4001_update<S>((uint8_t)cfg_id_t::All);
+	    break;
+	case err_t::Calibrate:
+	    zb_c4001_update<S>((uint8_t)(cfg_id_t::Sensitivity | cfg_id_t::Calibration));
+	    break;
+	case err_t::ApplyConfig:
+	    zb_c4001_update<S>((uint8_t)cfg_id_t::All);
+	    send_config_resp(S, (uint8_t)e);
 	    break;
 	default:
 	break;
     }
-    zb_ep.attr<kAttrStatus1>() = e;
+    if (e != err_t::Ok)
+	zb_ctx.ep<kSensorEPs[S]>().template attr<kAttrLastError>() = why.Packed();
+    zb_ctx.ep<kSensorEPs[S]>().template attr<kAttrStatus1>() = (uint8_t)e;
 }
 
-void on_c4001_error(c4001::err_t e)
+//one call per error reported, each drains whatever is queued by then
+template<uint8_t S>
+void zb_c4001_error(uint8_t)
 {
-    if (g_ZigbeeReady)
-	zb_schedule_app_callback(&zb_c4001_error, (uint8_t)e);
+    sensor_err_t e;
+    while(g_Sensors[S].errors.Pop(e))
+	handle_c4001_error<S>(e.what, e.why);
 }
 
-void on_c4001_upd(c4001::cfg_id_t id)
+//the zboss callback parameter carries the error/update: one callback per sensor
+template<size_t... S>
+constexpr auto make_c4001_callbacks(std::index_sequence<S...>)
 {
-    if (g_ZigbeeReady)
-	zb_schedule_app_callback(&zb_c4001_update, (uint8_t)id);
+    struct callbacks_t
+    {
+	std::array<zb_callback_t, kSensors> update;
+	std::array<zb_callback_t, kSensors> error;
+    };
+    return callbacks_t{{&zb_c4001_update<S>...}, {&zb_c4001_error<S>...}};
 }
+constexpr auto kC4001Callbacks = make_c4001_callbacks(std::make_index_sequence<kSensors>());
 
-void on_uto_delay_changed(uint16_t d)
+void on_c4001_error(uint8_t s, c4001::err_t e, Err why)
 {
-    c4001::set_detect_delay(d);
+    //errors come a few at a time at most: a full queue only drops the
+    //attribute update, the error log still has it
+    if (g_ZigbeeReady && g_Sensors[s].errors.Push({.what = e, .why = why}))
+	zb_schedule_app_callback(kC4001Callbacks.error[s], 0);
 }
 
-void on_otu_delay_changed(uint16_t d)
+void on_c4001_upd(uint8_t s, c4001::cfg_id_t id)
 {
-    c4001::set_clear_delay(d);
+    using namespace c4001; 
+    //full reloads (restart/reload/reset) that didn't change anything
+    //need no attribute update. single parameter writes are always
+    //answered: the attribute itself may hold a value the sensor rejected
+    auto &st = g_Sensors[s];
+    if (!st.pC4001 || (id == cfg_id_t::All && st.pC4001->GetConfigVersion() == st.last_cfg_version))
+	return;
+    if (g_ZigbeeReady)
+	zb_schedule_app_callback(kC4001Callbacks.update[s], (uint8_t)id);
 }
 
-
-int configure_c4001_out_pin();
+int configure_c4001_out_pin(uint8_t s);
 
 void on_zigbee_start()
 {
-    printk("on_zigbee_start\r\n");
+    DLOG("on_zigbee_start");
+    //edges so far went straight into the attribute
+    for(uint8_t s = 0; s < kSensors; ++s)
+    {
+	auto &st = g_Sensors[s];
+	auto occupied = dev_ctx.sensors[s].occupancy.occupancy;
+	st.presence_filter.Reset(occupied, k_uptime_ticks());
+	st.occupancy.Reset(occupied, k_uptime_get());
+	st.target_report.Reset();
+    }
     g_ZigbeeReady = true;
     //TODO: stuff...
 }
@@ -295,6 +1159,34 @@ void zboss_signal_handler(zb_bufid_t bufid)
     }							
 }
 
+//attribute writes of every sensor and zone endpoint
+template<size_t... S, size_t... Z>
+constexpr auto make_device_cb(std::index_sequence<S...>, std::index_sequence<Z...>)
+{
+    return zb::tpl_device_cb<
+	zb::dev_cb_handlers_desc{ .error_handler = on_dev_cb_error }
+	, zb::handle_set_for<kAttrDetectToClearDelay, bind_sensor<S, c4001::set_clear_delay>::call>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrClearToDetectDelay, bind_sensor<S, c4001::set_detect_delay>::call>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrRMin,               bind_sensor<S, c4001::set_range_from>::call>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrRMax,               bind_sensor<S, c4001::set_range_to>::call>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrRTrig,              bind_sensor<S, c4001::set_range_trig>::call>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrInhibitDuration,    bind_sensor<S, c4001::set_inhibit_duration>::call>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrSTrig,              bind_sensor<S, c4001::set_detect_sensitivity>::call>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrSHold,              bind_sensor<S, c4001::set_hold_sensitivity>::call>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrPresenceGlitch,     on_presence_glitch_changed<S>>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrPresenceHold,       on_presence_hold_changed<S>>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrOccupancyHold,      on_occupancy_hold_changed<S>>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrRunMode,            on_run_mode_changed<S>>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrTargetReportInterval, on_target_report_interval_changed<S>>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrTargetDistanceChange, on_target_distance_change_changed<S>>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrTargetSpeedChange,    on_target_speed_change_changed<S>>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrApproachLead,         on_approach_lead_changed<S>>(zb_ctx.ep<kSensorEPs[S]>())...
+	, zb::handle_set_for<kAttrZoneFrom,       on_zone_from_changed<Z>>(zb_ctx.ep<kZoneEPs[Z]>())...
+	, zb::handle_set_for<kAttrZoneTo,         on_zone_to_changed<Z>>(zb_ctx.ep<kZoneEPs[Z]>())...
+	, zb::handle_set_for<kAttrZoneHysteresis, on_zone_hysteresis_changed<Z>>(zb_ctx.ep<kZoneEPs[Z]>())...
+    >;
+}
+
 int main(void)
 {
     int err = settings_subsys_init();
@@ -303,59 +1195,65 @@ int main(void)
     printk("main\r\n");
     k_msleep(2000);
 
-    pC4001 = c4001::setup(&on_c4001_error, &on_c4001_upd);
-    printk("pC4001\r\n");
-    k_msleep(2000);
-    if (pC4001)
+    for(uint8_t s = 0; s < kSensors; ++s)
     {
-	dev_ctx.c4001.range_min = pC4001->GetRangeFrom();
-	dev_ctx.c4001.range_max = pC4001->GetRangeTo();
-	dev_ctx.c4001.range_trig = pC4001->GetTriggerDistance();
-	dev_ctx.c4001.inhibit_duration = pC4001->GetInhibitDuration();
-	dev_ctx.c4001.sensitivity_detect = pC4001->GetSensitivityTrig();
-	dev_ctx.c4001.sensitivity_hold = pC4001->GetSensitivityHold();
-	dev_ctx.c4001.sw_ver = pC4001->GetSWVer().m_Version;
-	dev_ctx.c4001.hw_ver = pC4001->GetHWVer().m_Version;
+	auto *pC4001 = g_Sensors[s].pC4001 = c4001::setup(s, &on_c4001_error, &on_c4001_upd, &on_c4001_frame);
+	printk("pC4001[%d]: %p\r\n", s, pC4001);
+	if (!pC4001)
+	    continue;
+	uint32_t ver;
+	auto cfg = pC4001->GetConfig(&ver);
+	g_Sensors[s].last_cfg_version = ver;
+	auto &c = dev_ctx.sensors[s].c4001;
+	c.range_min = cfg.m_MinRange;
+	c.range_max = cfg.m_MaxRange;
+	c.range_trig = cfg.m_TrigRange;
+	c.inhibit_duration = cfg.m_Inhibit;
+	c.sensitivity_detect = cfg.m_SensitivityTrigger;
+	c.sensitivity_hold = cfg.m_SensitivityHold;
+	c.detect_delay = cfg.m_DetectLatency;
+	c.clear_delay = cfg.m_ClearLatency;
+	c.sw_ver = pC4001->GetSWVer().m_Version;
+	c.hw_ver = pC4001->GetHWVer().m_Version;
+	c.active_preset = c4001::presets::active(s);
     }
+    k_msleep(2000);
 
     /* Register callback for handling ZCL commands. */
-    auto dev_cb = zb::tpl_device_cb<
-	zb::dev_cb_handlers_desc{ .error_handler = on_dev_cb_error }
-	, zb::handle_set_for<kAttrDetectToClearDelay, c4001::set_clear_delay>(zb_ep)
-	, zb::handle_set_for<kAttrClearToDetectDelay, c4001::set_detect_delay>(zb_ep)
-	, zb::handle_set_for<kAttrRMin,               c4001::set_range_from>(zb_ep)
-	, zb::handle_set_for<kAttrRMax,               c4001::set_range_to>(zb_ep)
-	, zb::handle_set_for<kAttrRTrig,              c4001::set_range_trig>(zb_ep)
-	, zb::handle_set_for<kAttrInhibitDuration,    c4001::set_inhibit_duration>(zb_ep)
-	, zb::handle_set_for<kAttrSTrig,              c4001::set_detect_sensitivity>(zb_ep)
-	, zb::handle_set_for<kAttrSHold,              c4001::set_hold_sensitivity>(zb_ep)
-    >;
+    auto dev_cb = make_device_cb(std::make_index_sequence<kSensors>(), std::make_index_sequence<kZones>());
 
     ZB_ZCL_REGISTER_DEVICE_CB(dev_cb);
 
     /* Register device context (endpoints). */
     ZB_AF_REGISTER_DEVICE_CTX(zb_ctx);
 
-    if (int err = configure_c4001_out_pin(); err != 0)
-    {
-	printk("Failed to configure c4001 out pin\r\n");
-    }
+    gpio_pin_configure_dt(&led, GPIO_OUTPUT_ACTIVE);
+    gpio_pin_set_dt(&led, 0);
+    for(uint8_t s = 0; s < kSensors; ++s)
     {
-	int val = gpio_pin_get_dt(&presence);
-	printk("Presence pin state: %d\r\n", val);
-	dev_ctx.occupancy.occupancy = val;
+	if (int err = configure_c4001_out_pin(s); err != 0)
+	{
+	    printk("Failed to configure c4001[%d] out pin\r\n", s);
+	}
+	int val = gpio_pin_get_dt(&g_Sensors[s].pin);
+	printk("Presence pin %d state: %d\r\n", s, val);
+	dev_ctx.sensors[s].occupancy.occupancy = val;
     }
     zigbee_enable();
 
     printk("Main: sleep forever\r\n");
+    for(uint8_t s = 0; s < kSensors; ++s)
     {
-	printk("C4001; HW=%s\r\n", pC4001->GetHWVer().m_Version);
-	printk("C4001; SW=%s\r\n", pC4001->GetSWVer().m_Version);
-	printk("C4001; Range=%.1f to %.1fm\r\n", (double)pC4001->GetRangeFrom(), (double)pC4001->GetRangeTo());
-	printk("C4001; Latency; to detect=%.1fs; to clear=%.1fs\r\n", (double)pC4001->GetDetectLatency(), (double)pC4001->GetClearLatency());
-	printk("C4001; Trig Range=%.1fm\r\n", (double)pC4001->GetTriggerDistance());
-	printk("C4001; Sensitivity Detect=%d; Hold=%d;\r\n", pC4001->GetSensitivityTrig(), pC4001->GetSensitivityHold());
-	printk("C4001; Inhibut Duration=%.1fs\r\n", (double)pC4001->GetInhibitDuration());
+	auto *pC4001 = g_Sensors[s].pC4001;
+	if (!pC4001)
+	    continue;
+	printk("C4001[%d]; HW=%s\r\n", s, pC4001->GetHWVer().m_Version);
+	printk("C4001[%d]; SW=%s\r\n", s, pC4001->GetSWVer().m_Version);
+	printk("C4001[%d]; Range=%.1f to %.1fm\r\n", s, (double)pC4001->GetRangeFrom(), (double)pC4001->GetRangeTo());
+	printk("C4001[%d]; Latency; to detect=%.1fs; to clear=%.1fs\r\n", s, (double)pC4001->GetDetectLatency(), (double)pC4001->GetClearLatency());
+	printk("C4001[%d]; Trig Range=%.1fm\r\n", s, (double)pC4001->GetTriggerDistance());
+	printk("C4001[%d]; Sensitivity Detect=%d; Hold=%d;\r\n", s, pC4001->GetSensitivityTrig(), pC4001->GetSensitivityHold());
+	printk("C4001[%d]; Inhibut Duration=%.1fs\r\n", s, (double)pC4001->GetInhibitDuration());
     }
     while (1) {
 	k_sleep(K_FOREVER);
@@ -364,24 +1262,26 @@ int main(void)
     return 0;
 }
 
-int configure_c4001_out_pin()
+int configure_c4001_out_pin(uint8_t s)
 {
-    gpio_pin_configure_dt(&led, GPIO_OUTPUT_ACTIVE);
-    int err = gpio_pin_configure_dt(&presence, GPIO_INPUT);
+    auto &st = g_Sensors[s];
+    k_timer_init(&st.occupancy_timer, on_occupancy_timer, nullptr);
+    int err = gpio_pin_configure_dt(&st.pin, GPIO_INPUT);
     if (err != 0)
     {
 	printk("gpio_pin_configure_dt: %d\r\n", err);
 	return err;
     }
-    gpio_pin_set_dt(&led, 0);
+    update_presence_filter(s);
+    update_occupancy_fsm(s);
+    update_target_report(s);
 
-    err = gpio_pin_interrupt_configure_dt(&presence, GPIO_INT_EDGE_BOTH);
+    err = gpio_pin_interrupt_configure_dt(&st.pin, GPIO_INT_EDGE_BOTH);
     if (err != 0)
     {
 	printk("gpio_pin_interrupt_configure_dt: %d\r\n", err);
 	return err;
     }
-    gpio_init_callback(&g_cb, presence_triggered, BIT(presence.pin));
-    return gpio_add_callback_dt(&presence, &g_cb);
+    gpio_init_callback(&st.cb, presence_triggered, BIT(st.pin.pin));
+    return gpio_add_callback_dt(&st.pin, &st.cb);
 }
-
@@ -0,0 +1,19 @@
+#include <zephyr/kernel.h>
+#include "metrics.hpp"
+#include "c4001_task.hpp"
+
+namespace metrics
+{
+    static presence_t g_presence[c4001::kSensors];
+
+    static sensor_health_t g_sensor_health[c4001::kSensors];
+
+    presence_t& presence(uint8_t id) { return g_presence[id]; }
+
+    sensor_health_t& sensor_health(uint8_t id) { return g_sensor_health[id]; }
+
+    uint32_t cycles_to_us(uint32_t from, uint32_t to)
+    {
+	return (uint32_t)k_cyc_to_us_floor64(to - from);
+    }
+}
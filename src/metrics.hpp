@@ -0,0 +1,41 @@
+#ifndef METRICS_HPP_
+#define METRICS_HPP_
+#include "lib/lib_latency_hist.h"
+
+namespace metrics
+{
+    //presence pin edge -> on/off command on air, per sensor
+    struct presence_t
+    {
+        LatencyHist edge_to_cb;     //edge (ISR) -> ZBOSS app callback
+        LatencyHist edge_to_send;   //edge (ISR) -> on/off command handed to the stack
+        LatencyHist send_to_ack;    //command handed to the stack -> its APS confirm
+        LatencyHist edge_to_ack;    //edge (ISR) -> APS confirm, what the user waits for
+        uint32_t aps_failed = 0;    //on/off commands the APS confirm reported failed
+        uint32_t edges = 0;         //pin edges seen
+        uint32_t forwarded = 0;     //transitions that made it through the filter
+        uint32_t dropped = 0;       //edges lost to a full edge ring
+        uint32_t frames_dropped = 0;//sensor frames lost to a full frame ring
+        uint32_t predicted = 0;     //occupancy raised early by the approach predictor
+    };
+
+    presence_t& presence(uint8_t id);
+
+    //c4001 supervision, see health::supervisor_t
+    struct sensor_health_t
+    {
+        uint32_t probes = 0;            //idle liveness probes sent
+        uint32_t lost = 0;              //outages a resync couldn't end
+        uint32_t restarts = 0;          //resetSystem sent by the supervisor
+        uint32_t recoveries = 0;        //resyncs after a silence or a failure
+        uint32_t last_recovery_ms = 0;  //problem detected -> config re-applied
+        uint32_t max_recovery_ms = 0;
+    };
+
+    sensor_health_t& sensor_health(uint8_t id);
+
+    //cycle counter delta in microseconds (wrap-safe for deltas < 2^32 cycles)
+    uint32_t cycles_to_us(uint32_t from, uint32_t to);
+}
+
+#endif
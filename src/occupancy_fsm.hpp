@@ -0,0 +1,118 @@
+#ifndef OCCUPANCY_FSM_HPP_
+#define OCCUPANCY_FSM_HPP_
+#include <cstdint>
+#include <algorithm>
+
+namespace occupancy
+{
+    //Fuses the (filtered) presence pin with the frames the sensor streams
+    //over UART into the occupancy that gets reported.
+    // - occupied: as soon as any source reports presence: the pin goes up,
+    //   a presence frame says so, target frames see somebody within
+    //   'trig_range' 'min_target_frames' times in a row, or an approach
+    //   towards it is predicted
+    // - clear: only once every source has been idle for 'hold'; a frame
+    //   counts as active for 'frame_ttl' after it's been received, so a
+    //   seated person the pin has given up on but the radar still tracks
+    //   keeps the room occupied
+    //All times are in the same (monotonic) unit, typically ms.
+    class fsm_t
+    {
+    public:
+        static constexpr int kNone = -1;
+        static constexpr int64_t kNoDeadline = INT64_MAX;
+
+        struct cfg_t
+        {
+            int64_t hold = 0;
+            int64_t frame_ttl = 1500;
+            uint8_t min_target_frames = 2;
+            float trig_range = 0;   //0 - any distance
+        };
+
+        void SetConfig(cfg_t const& c) { m_Cfg = c; }
+        cfg_t const& GetConfig() const { return m_Cfg; }
+
+        void OnPin(bool level, int64_t t)
+        {
+            if (level == m_Pin)
+                return;
+            m_Pin = level;
+            if (!level)
+                m_PinLowSince = t;
+        }
+
+        void OnPresenceFrame(bool present, int64_t t)
+        {
+            if (present)
+                m_FrameUntil = t + m_Cfg.frame_ttl;
+            else
+                m_FrameUntil = std::min(m_FrameUntil, t);
+        }
+
+        void OnTargetFrame(uint8_t targets, float range, int64_t t)
+        {
+            if (!targets || (m_Cfg.trig_range > 0 && range > m_Cfg.trig_range))
+            {
+                m_TargetRun = 0;
+                return;
+            }
+            if (m_TargetRun < m_Cfg.min_target_frames)
+                ++m_TargetRun;
+            if (m_TargetRun >= m_Cfg.min_target_frames)
+                m_FrameUntil = t + m_Cfg.frame_ttl;
+        }
+
+        //a predicted arrival counts like a presence frame
+        void OnApproach(int64_t t)
+        {
+            m_FrameUntil = std::max(m_FrameUntil, t + m_Cfg.frame_ttl);
+        }
+
+        //returns the occupancy to report now (0/1) or kNone
+        int Evaluate(int64_t now)
+        {
+            if (Active(now))
+            {
+                if (m_Occupied)
+                    return kNone;
+                m_Occupied = true;
+                return 1;
+            }
+            if (!m_Occupied || now < Deadline())
+                return kNone;
+            m_Occupied = false;
+            return 0;
+        }
+
+        //when Evaluate has to be called again, kNoDeadline if nothing is pending
+        int64_t Deadline() const
+        {
+            if (!m_Occupied || m_Pin)
+                return kNoDeadline;
+            return std::max(m_PinLowSince, m_FrameUntil) + m_Cfg.hold;
+        }
+
+        bool Occupied() const { return m_Occupied; }
+
+        //sync to an occupancy reported by other means (e.g. initial pin state)
+        void Reset(bool occupied, int64_t t)
+        {
+            m_Occupied = m_Pin = occupied;
+            m_PinLowSince = t;
+            m_FrameUntil = INT64_MIN / 2;
+            m_TargetRun = 0;
+        }
+    private:
+        bool Active(int64_t now) const { return m_Pin || now < m_FrameUntil; }
+
+        cfg_t m_Cfg;
+        bool m_Occupied = false;
+        bool m_Pin = false;
+        uint8_t m_TargetRun = 0;
+        int64_t m_PinLowSince = 0;
+        int64_t m_FrameUntil = INT64_MIN / 2;
+    };
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef PRESENCE_FILTER_HPP_
+#define PRESENCE_FILTER_HPP_
+#include <cstdint>
+#include <algorithm>
+
+namespace presence
+{
+    //Decides which presence pin transitions get forwarded.
+    //Edges are only recorded; Evaluate() compares the latest level with the
+    //last forwarded one, so a burst of edges drained at once collapses into
+    //at most one transition.
+    // - glitch:   a new level must persist this long before it's forwarded
+    //             (0 - forward right away, first edge latency unchanged)
+    // - min_hold: minimal time between two forwarded transitions
+    //All times are in the same (monotonic) unit, typically kernel ticks.
+    class filter_t
+    {
+    public:
+        static constexpr int kNone = -1;
+        static constexpr int64_t kNoDeadline = INT64_MAX;
+
+        struct cfg_t
+        {
+            int64_t glitch = 0;
+            int64_t min_hold = 0;
+        };
+
+        void SetConfig(cfg_t const& c) { m_Cfg = c; }
+        cfg_t const& GetConfig() const { return m_Cfg; }
+
+        void OnEdge(uint8_t level, int64_t t)
+        {
+            if (level == m_Level)
+                return;
+            m_Level = level;
+            m_LevelSince = t;
+        }
+
+        //returns the level to forward now or kNone
+        int Evaluate(int64_t now)
+        {
+            if (m_Level == m_Forwarded)
+                return kNone;
+            if (now < Deadline())
+                return kNone;
+            m_Forwarded = m_Level;
+            m_ForwardedAt = now;
+            return m_Level;
+        }
+
+        //when Evaluate has to be called again, kNoDeadline if nothing is pending
+        int64_t Deadline() const
+        {
+            if (m_Level == m_Forwarded)
+                return kNoDeadline;
+            return std::max(m_LevelSince + m_Cfg.glitch, m_ForwardedAt + m_Cfg.min_hold);
+        }
+
+        //sync to a level forwarded by other means (e.g. initial pin state)
+        void Reset(uint8_t level, int64_t t)
+        {
+            m_Level = m_Forwarded = level;
+            m_LevelSince = t;
+            m_ForwardedAt = INT64_MIN / 2;
+        }
+    private:
+        cfg_t m_Cfg;
+        int m_Level = kNone;
+        int m_Forwarded = kNone;
+        int64_t m_LevelSince = 0;
+        int64_t m_ForwardedAt = INT64_MIN / 2;
+    };
+}
+
+#endif
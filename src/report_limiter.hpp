@@ -0,0 +1,58 @@
+#ifndef REPORT_LIMITER_HPP_
+#define REPORT_LIMITER_HPP_
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <cmath>
+
+namespace reporting
+{
+    //Decides which samples of a fast stream get published.
+    //A sample goes out once 'min_interval' has passed since the last published
+    //one and it differs from it by at least 'min_change' in any channel.
+    //The first sample always goes out.
+    //All times are in the same (monotonic) unit, typically ms.
+    template<size_t N>
+    class limiter_t
+    {
+    public:
+        using sample_t = std::array<float, N>;
+
+        struct cfg_t
+        {
+            int64_t min_interval = 0;
+            sample_t min_change{};
+        };
+
+        void SetConfig(cfg_t const& c) { m_Cfg = c; }
+        cfg_t const& GetConfig() const { return m_Cfg; }
+
+        //true if 's' is to be published; it then becomes the new reference
+        bool Offer(sample_t const& s, int64_t now)
+        {
+            if (m_HasLast)
+            {
+                if (now - m_LastAt < m_Cfg.min_interval)
+                    return false;
+                bool changed = false;
+                for(size_t i = 0; i < N; ++i)
+                    changed = changed || std::fabs(s[i] - m_Last[i]) >= m_Cfg.min_change[i];
+                if (!changed)
+                    return false;
+            }
+            m_Last = s;
+            m_LastAt = now;
+            m_HasLast = true;
+            return true;
+        }
+
+        void Reset() { m_HasLast = false; }
+    private:
+        cfg_t m_Cfg;
+        sample_t m_Last{};
+        int64_t m_LastAt = 0;
+        bool m_HasLast = false;
+    };
+}
+
+#endif
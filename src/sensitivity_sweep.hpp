@@ -0,0 +1,81 @@
+#ifndef SENSITIVITY_SWEEP_HPP_
+#define SENSITIVITY_SWEEP_HPP_
+#include <cstdint>
+#include <algorithm>
+#include "lib/lib_running_stats.h"
+
+namespace calib
+{
+    //Empty room sensitivity calibration, the decision part (the sensor side
+    //is run_calibration in c4001_task.cpp).
+    //Levels are watched from the most sensitive down. The energy of every
+    //target frame, 0 for one without a target, goes into the stats of the
+    //level: mean + kSigma * std is the noise the sensor lets through there.
+    //The most sensitive level gives the noise floor of the room.
+    //The sweep stops at the first level letting through no more than kQuiet
+    //of the floor; hold and detect back off from it by their own margin,
+    //detect by more so it doesn't trigger on what hold tolerates.
+    //A level without any target frame tells nothing: the sweep fails.
+    class sweep_t
+    {
+    public:
+        static constexpr uint8_t kMaxLevel = 9;
+        static constexpr float kSigma = 3.f;
+        static constexpr float kQuiet = 0.1f;
+        static constexpr uint8_t kHoldMargin = 1;
+        static constexpr uint8_t kDetectMargin = 2;
+
+        //level to watch next
+        uint8_t Level() const { return m_Level; }
+
+        void OnTargetFrame(bool hasTarget, float energy)
+        {
+            ++m_Frames;
+            if (hasTarget)
+                ++m_Ghosts;
+            m_Stats.Add(hasTarget ? energy : 0.f);
+        }
+
+        //Level() watched long enough; true if the sweep goes on with the next one
+        bool Next()
+        {
+            if (!m_Stats.m_Count)
+                return false;
+            float noise = Noise(m_Stats);
+            if (m_Level == kMaxLevel)
+                m_Floor = m_Stats;
+            if (noise <= kQuiet * Noise(m_Floor))
+            {
+                m_Quiet = m_Level;
+                return false;
+            }
+            m_Stats.Reset();
+            return --m_Level > 0;
+        }
+
+        //a quiet level was found
+        bool Found() const { return m_Quiet != 0; }
+        uint8_t Quiet() const { return m_Quiet; }
+        uint8_t Hold() const { return BackOff(kHoldMargin); }
+        uint8_t Detect() const { return BackOff(kDetectMargin); }
+
+        //energy at the most sensitive level, what the room looks like
+        RunningStats const& Floor() const { return m_Floor; }
+        //over all levels watched
+        uint32_t Frames() const { return m_Frames; }
+        uint32_t Ghosts() const { return m_Ghosts; }
+
+        static float Noise(RunningStats const& s) { return s.m_Mean + kSigma * s.StdDev(); }
+    private:
+        uint8_t BackOff(uint8_t margin) const { return (uint8_t)std::max(m_Quiet - margin, 1); }
+
+        uint8_t m_Level = kMaxLevel;
+        uint8_t m_Quiet = 0;
+        RunningStats m_Stats;
+        RunningStats m_Floor;
+        uint32_t m_Frames = 0;
+        uint32_t m_Ghosts = 0;
+    };
+}
+
+#endif
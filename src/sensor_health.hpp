@@ -0,0 +1,165 @@
+#ifndef SENSOR_HEALTH_HPP_
+#define SENSOR_HEALTH_HPP_
+#include <cstdint>
+#include <algorithm>
+
+namespace health
+{
+    //Decides when the c4001 worker has to check on a sensor and what to do
+    //about one that stopped answering.
+    // - healthy: frames or probe replies keep coming. While streaming, the
+    //   frames prove the sensor is alive. Otherwise a probe is due every
+    //   probe interval. The interval doubles after each good probe, from
+    //   'probe_min' up to 'probe_max'.
+    // - suspect: no frame for 'silence' while streaming, or a failed probe
+    //   or exchange. The cached config gets re-applied (resync) right away:
+    //   a sensor that rebooted may have come up with other settings.
+    // - lost: the resync failed. The sensor gets restarted with a backoff:
+    //   the first restart is immediate, the later ones wait from
+    //   'backoff_min' doubling up to 'backoff_max'. Each restart is followed
+    //   by a resync once 'restart_settle' has passed.
+    //All times are in ms.
+    class supervisor_t
+    {
+    public:
+        static constexpr int64_t kNoDeadline = INT64_MAX;
+        static constexpr int64_t kNone = -1;
+
+        enum class action_t: uint8_t
+        {
+            None,
+            Probe,
+            Resync,
+            Restart,
+        };
+
+        struct cfg_t
+        {
+            int64_t silence = 5000;
+            int64_t probe_min = 10000;
+            int64_t probe_max = 300000;
+            int64_t backoff_min = 2000;
+            int64_t backoff_max = 60000;
+            int64_t restart_settle = 2000;
+        };
+
+        void SetConfig(cfg_t const& c) { m_Cfg = c; }
+        cfg_t const& GetConfig() const { return m_Cfg; }
+
+        //frames are only expected while streaming
+        void OnStream(bool on, int64_t now)
+        {
+            if (on && !m_Streaming)
+                m_LastAlive = std::max(m_LastAlive, now);
+            m_Streaming = on;
+        }
+
+        //a frame arrived
+        void OnAlive(int64_t now)
+        {
+            if (m_State == state_t::Healthy)
+                m_LastAlive = now;
+        }
+
+        //an exchange with the sensor failed (not cancelled)
+        void OnFailure(int64_t now)
+        {
+            if (m_State == state_t::Healthy)
+                Suspect(now);
+        }
+
+        void OnProbe(bool ok, int64_t now)
+        {
+            if (!ok)
+                return OnFailure(now);
+            m_LastAlive = now;
+            m_ProbeInterval = std::min(m_ProbeInterval * 2, m_Cfg.probe_max);
+        }
+
+        //returns how long the sensor was out if the resync ended an outage, kNone otherwise
+        int64_t OnResync(bool ok, int64_t now)
+        {
+            if (!ok)
+            {
+                m_State = state_t::Lost;
+                m_RestartAt = now + m_Backoff;
+                m_Backoff = m_Backoff ? std::min(m_Backoff * 2, m_Cfg.backoff_max) : m_Cfg.backoff_min;
+                return kNone;
+            }
+            m_State = state_t::Healthy;
+            m_LastAlive = now;
+            m_Backoff = 0;
+            m_ProbeInterval = m_Cfg.probe_min;
+            return now - m_ProblemSince;
+        }
+
+        void OnRestart(int64_t now)
+        {
+            m_State = state_t::Suspect;
+            m_ResyncAt = now + m_Cfg.restart_settle;
+        }
+
+        //returns what has to be done now
+        action_t Evaluate(int64_t now)
+        {
+            switch(m_State)
+            {
+                case state_t::Healthy:
+                    if (now < Deadline())
+                        return action_t::None;
+                    if (!m_Streaming)
+                        return action_t::Probe;
+                    Suspect(now);
+                    return action_t::Resync;
+                case state_t::Suspect:
+                    return now >= m_ResyncAt ? action_t::Resync : action_t::None;
+                case state_t::Lost:
+                    return now >= m_RestartAt ? action_t::Restart : action_t::None;
+            }
+            return action_t::None;
+        }
+
+        //when Evaluate has to be called again
+        int64_t Deadline() const
+        {
+            switch(m_State)
+            {
+                case state_t::Healthy:
+                    return m_LastAlive + (m_Streaming ? m_Cfg.silence : m_ProbeInterval);
+                case state_t::Suspect:
+                    return m_ResyncAt;
+                case state_t::Lost:
+                    return m_RestartAt;
+            }
+            return kNoDeadline;
+        }
+
+        bool Healthy() const { return m_State == state_t::Healthy; }
+        bool Lost() const { return m_State == state_t::Lost; }
+    private:
+        enum class state_t: uint8_t
+        {
+            Healthy,
+            Suspect,
+            Lost,
+        };
+
+        void Suspect(int64_t now)
+        {
+            m_State = state_t::Suspect;
+            m_ProblemSince = m_ResyncAt = now;
+        }
+
+        cfg_t m_Cfg;
+        state_t m_State = state_t::Healthy;
+        bool m_Streaming = false;
+        int64_t m_LastAlive = 0;
+        int64_t m_ProbeInterval = cfg_t{}.probe_min;
+        int64_t m_ProblemSince = 0;
+        int64_t m_ResyncAt = 0;
+        int64_t m_RestartAt = 0;
+        int64_t m_Backoff = 0;
+    };
+}
+
+#endif
@@ -2,6 +2,8 @@
 #define ZB_C4001_CLUSTER_DESC_HPP_
 
 #include <nrfzbcpp/zb_main.hpp>
+#include "../frame_use.hpp"
+#include <utility>
 
 extern "C"
 {
@@ -13,6 +15,25 @@ extern "C"
 namespace zb
 {
     static constexpr uint16_t kZB_ZCL_CLUSTER_ID_C4001 = 0xfc81;
+    //target_report_interval: no target reporting
+    static constexpr uint16_t kTargetReportOff = frame_use::kTargetReportOff;
+
+    //bits of the 'mask' argument of cmd_apply_config/config_resp
+    //order follows the attribute ids
+    enum class c4001_cfg_mask_t: uint8_t
+    {
+        RangeMin          = 1 << 0,
+        RangeMax          = 1 << 1,
+        RangeTrig         = 1 << 2,
+        InhibitDuration   = 1 << 3,
+        SensitivityDetect = 1 << 4,
+        SensitivityHold   = 1 << 5,
+        DetectDelay       = 1 << 6,
+        ClearDelay        = 1 << 7,
+        All = 0xff,
+    };
+    constexpr bool operator&(uint8_t m, c4001_cfg_mask_t b) { return (m & std::to_underlying(b)) != 0; }
+
     struct zb_zcl_c4001_t
     {
         float range_min = 0.6f;
@@ -25,7 +46,44 @@ namespace zb
         uint8_t sensitivity_hold = 5;
         ZigbeeStr<32> sw_ver;
         ZigbeeStr<32> hw_ver;
+        uint8_t active_preset = 0xff;
+        uint16_t presence_glitch = 0;   //ms, presence pin level must persist that long
+        uint16_t presence_hold = 500;   //ms, minimal time between two on/off commands
+        uint16_t occupancy_hold = 0;    //ms, pin and frames must be idle that long to clear
+        uint8_t run_mode = 0;           //0 - presence, 1 - speed/distance; follows the frames received
+        //nearest target, published at most every target_report_interval and
+        //only when distance or speed moved by at least the *_change below
+        float target_distance = 0;      //m, 0 - no target
+        float target_speed = 0;         //m/s, negative - approaching
+        uint32_t target_energy = 0;
+        //ms, 0xffff - off; off by default, the frames would keep the sensor UART awake
+        uint16_t target_report_interval = frame_use::cfg_t{}.target_report_interval;
+        float target_distance_change = 0.25f;   //m
+        float target_speed_change = 0.2f;       //m/s
+        uint16_t approach_lead = frame_use::cfg_t{}.approach_lead; //ms, raise occupancy that long before a target reaches range_trig, 0 - off
+        //last calibration: 0 - idle, 1 - running, 2 - done, 3 - failed
+        uint8_t calib_state = 0;
+        uint16_t calib_frames = 0;
+        uint16_t calib_ghosts = 0;
+        //noise floor: target frame energy at the most sensitive level
+        float calib_energy_mean = 0;
+        float calib_energy_std = 0;
+        float calib_energy_max = 0;
+        //sensor supervision: outages recovered and how long the last one took
+        uint16_t recoveries = 0;
+        uint32_t recovery_time = 0;     //ms
+        //last error of this sensor: site:16 | op:8 | errno:8 (see lib_ret_err.h), 0 - none
+        uint32_t last_error = 0;
         cmd_in_t<1> cmd_restart;
+        //mask, range_min, range_max, range_trig, inhibit_duration, sensitivity_detect, sensitivity_hold, detect_delay, clear_delay
+        cmd_in_t<2, uint8_t, float, float, float, float, uint8_t, uint8_t, float, float> cmd_apply_config;
+        cmd_in_t<3> cmd_read_config;
+        cmd_in_t<4, uint8_t> cmd_store_preset;
+        cmd_in_t<5, uint8_t> cmd_activate_preset;
+        //seconds per sensitivity step, room must be empty
+        cmd_in_t<6, uint8_t> cmd_calibrate;
+        //status, mask, <same values as cmd_apply_config>, sw_ver, hw_ver
+        cmd_out_t<0, uint8_t, uint8_t, float, float, float, float, uint8_t, uint8_t, float, float, ZigbeeStr<32>, ZigbeeStr<32>> config_resp;
     };
 
     template<> struct zcl_description_t<zb_zcl_c4001_t> {
@@ -45,9 +103,36 @@ namespace zb
                     ,attribute_t{.m = &T::hw_ver,             .id = 0x0007, .a=Access::Read}
                     ,attribute_t{.m = &T::detect_delay,       .id = 0x0008, .a=Access::RW}
                     ,attribute_t{.m = &T::clear_delay,        .id = 0x0009, .a=Access::RW}
+                    ,attribute_t{.m = &T::active_preset,      .id = 0x000a, .a=Access::Read}
+                    ,attribute_t{.m = &T::presence_glitch,    .id = 0x000b, .a=Access::RW}
+                    ,attribute_t{.m = &T::presence_hold,      .id = 0x000c, .a=Access::RW}
+                    ,attribute_t{.m = &T::occupancy_hold,     .id = 0x000d, .a=Access::RW}
+                    ,attribute_t{.m = &T::run_mode,           .id = 0x000e, .a=Access::RW}
+                    ,attribute_t{.m = &T::target_distance,    .id = 0x000f, .a=Access::RP}
+                    ,attribute_t{.m = &T::target_speed,       .id = 0x0010, .a=Access::RP}
+                    ,attribute_t{.m = &T::target_energy,      .id = 0x0011, .a=Access::RP}
+                    ,attribute_t{.m = &T::target_report_interval, .id = 0x0012, .a=Access::RW}
+                    ,attribute_t{.m = &T::target_distance_change, .id = 0x0013, .a=Access::RW}
+                    ,attribute_t{.m = &T::target_speed_change,    .id = 0x0014, .a=Access::RW}
+                    ,attribute_t{.m = &T::approach_lead,      .id = 0x0015, .a=Access::RW}
+                    ,attribute_t{.m = &T::calib_state,        .id = 0x0016, .a=Access::RP}
+                    ,attribute_t{.m = &T::calib_frames,       .id = 0x0017, .a=Access::Read}
+                    ,attribute_t{.m = &T::calib_ghosts,       .id = 0x0018, .a=Access::Read}
+                    ,attribute_t{.m = &T::calib_energy_mean,  .id = 0x0019, .a=Access::Read}
+                    ,attribute_t{.m = &T::calib_energy_std,   .id = 0x001a, .a=Access::Read}
+                    ,attribute_t{.m = &T::calib_energy_max,   .id = 0x001b, .a=Access::Read}
+                    ,attribute_t{.m = &T::recoveries,         .id = 0x001c, .a=Access::RP}
+                    ,attribute_t{.m = &T::recovery_time,      .id = 0x001d, .a=Access::Read}
+                    ,attribute_t{.m = &T::last_error,         .id = 0x001e, .a=Access::RP}
                 >{},
                 commands_t<
                     &T::cmd_restart
+                    ,&T::cmd_apply_config
+                    ,&T::cmd_read_config
+                    ,&T::cmd_store_preset
+                    ,&T::cmd_activate_preset
+                    ,&T::cmd_calibrate
+                    ,&T::config_resp
                 >{}
             >{};
         }
@@ -0,0 +1,41 @@
+#ifndef ZB_C4001_ZONE_CLUSTER_DESC_HPP_
+#define ZB_C4001_ZONE_CLUSTER_DESC_HPP_
+
+#include <nrfzbcpp/zb_main.hpp>
+
+extern "C"
+{
+#include <zboss_api_addons.h>
+#include <zb_mem_config_med.h>
+#include <zb_nrf_platform.h>
+}
+
+namespace zb
+{
+    static constexpr uint16_t kZB_ZCL_CLUSTER_ID_C4001_ZONE = 0xfc82;
+
+    //distance interval of a virtual occupancy zone
+    struct zb_zcl_c4001_zone_t
+    {
+        float zone_from = 0;        //m
+        float zone_to = 0;          //m, not above zone_from - zone disabled
+        float zone_hysteresis = 0.2f;//m, an occupied zone stretches by that much on both ends
+    };
+
+    template<> struct zcl_description_t<zb_zcl_c4001_zone_t> {
+        static constexpr auto get()
+        {
+            using T = zb_zcl_c4001_zone_t;
+            return cluster_t<
+                cluster_info_t{.id = kZB_ZCL_CLUSTER_ID_C4001_ZONE},
+                attributes_t<
+                     attribute_t{.m = &T::zone_from,          .id = 0x0000, .a=Access::RW}
+                    ,attribute_t{.m = &T::zone_to,            .id = 0x0001, .a=Access::RW}
+                    ,attribute_t{.m = &T::zone_hysteresis,    .id = 0x0002, .a=Access::RW}
+                >{},
+                commands_t<>{}
+            >{};
+        }
+    };
+}
+#endif
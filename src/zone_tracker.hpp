@@ -0,0 +1,80 @@
+#ifndef ZONE_TRACKER_HPP_
+#define ZONE_TRACKER_HPP_
+#include <cstdint>
+
+namespace zones
+{
+    //Occupancy of one distance interval, fed with the nearest target of
+    //every target frame.
+    // - enter: a target inside [from, to]
+    // - leave: no target inside [from - hysteresis, to + hysteresis] for 'hold';
+    //   a silent sensor counts as nobody inside, Evaluate() at Deadline()
+    //   clears the zone without waiting for another frame
+    //A zone with to <= from is disabled and never occupied.
+    //Distances in m, times in ms.
+    class zone_t
+    {
+    public:
+        static constexpr int kNone = -1;
+        static constexpr int64_t kNoDeadline = INT64_MAX;
+
+        struct cfg_t
+        {
+            float from = 0;
+            float to = 0;
+            float hysteresis = 0;
+            int64_t hold = 0;
+        };
+
+        void SetConfig(cfg_t const& c) { m_Cfg = c; }
+        cfg_t const& GetConfig() const { return m_Cfg; }
+
+        bool Enabled() const { return m_Cfg.to > m_Cfg.from; }
+
+        //a target frame; returns the occupancy to report now (0/1) or kNone
+        int Update(bool hasTarget, float range, int64_t now)
+        {
+            if (Enabled() && hasTarget && Inside(range))
+            {
+                m_LastIn = now;
+                if (m_Occupied)
+                    return kNone;
+                m_Occupied = true;
+                return 1;
+            }
+            return Evaluate(now);
+        }
+
+        //returns the occupancy to report now (0/1) or kNone
+        int Evaluate(int64_t now)
+        {
+            if (!m_Occupied || now < Deadline())
+                return kNone;
+            m_Occupied = false;
+            return 0;
+        }
+
+        //when Evaluate has to be called again, kNoDeadline if nothing is pending
+        int64_t Deadline() const
+        {
+            if (!m_Occupied)
+                return kNoDeadline;
+            //disabled while occupied: clears right away
+            return Enabled() ? m_LastIn + m_Cfg.hold : INT64_MIN;
+        }
+
+        bool Occupied() const { return m_Occupied; }
+    private:
+        bool Inside(float range) const
+        {
+            float h = m_Occupied ? m_Cfg.hysteresis : 0.f;
+            return range >= (m_Cfg.from - h) && range <= (m_Cfg.to + h);
+        }
+
+        cfg_t m_Cfg;
+        bool m_Occupied = false;
+        int64_t m_LastIn = 0;
+    };
+}
+
+#endif
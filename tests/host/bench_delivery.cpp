@@ -0,0 +1,63 @@
+#include "sim_sensor.h"
+#include "lib_dfr_c4001.h"
+#include <cstdio>
+
+//What the Channel front end and the driver cost per delivery size, the one
+//thing that differs between transports as far as the front end is
+//concerned: irq and poll hand over about a byte per interrupt or poll at
+//9600 baud, async a DMA buffer (Async::kBufSize) or what the RX timeout
+//cut, memory whole lines. The hardware side (ISR entry, DMA, FIFO) is not
+//in it: that takes 'c4001 bench' on the board with each transport built.
+//Times are real ns; waits run on the simulated clock and cost nothing.
+//   bench_delivery [probes]
+
+namespace
+{
+    struct row_t
+    {
+        const char *what;
+        size_t chunk;
+    };
+
+    constexpr row_t kRows[] = {
+        {"1 B   (irq, poll)", 1},
+        {"8 B   (async buffer)", uart::transport::Async::kBufSize},
+        {"64 B  (line, memory)", 64},
+    };
+}
+
+int main(int argc, char **argv)
+{
+    const int probes = argc > 1 ? atoi(argv[1]) : 2000;
+    printf("%-22s %10s %10s %10s %10s\n", "delivery", "ns/probe", "rx ns/B", "events/pr", "bytes/pr");
+    for(auto const& row : kRows)
+    {
+        host::reset();
+        device d{"sim"};
+        dfr::C4001 dev{&d};
+        host::SimSensor sim{dev.GetTransport()};
+        sim.chunk = row.chunk;
+        if (!dev.Init())
+        {
+            printf("%s: init failed\n", row.what);
+            return 1;
+        }
+        auto s0 = dev.GetStats();
+        const uint32_t start = k_cycle_get_32();
+        for(int i = 0; i < probes; ++i)
+            if (!dev.Probe())
+            {
+                printf("%s: probe %d failed\n", row.what, i);
+                return 1;
+            }
+        const uint32_t ns = k_cycle_get_32() - start;
+        auto s = dev.GetStats();
+        const uint32_t bytes = s.m_RxBytes - s0.m_RxBytes;
+        printf("%-22s %10u %10.1f %10.1f %10.1f\n", row.what,
+                ns / probes,
+                bytes ? double(s.m_IsrCycles - s0.m_IsrCycles) / bytes : 0.,
+                double(s.m_Events - s0.m_Events) / probes,
+                double(bytes) / probes);
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "lib_reply_grammar.h"
+#include <zephyr/kernel.h>
+#include <cstdio>
+#include <cstring>
+
+//Parse cost of the getRange reply grammar per byte, next to sscanf on the
+//same line for scale. Code size: nm -SC bench_grammar | grep parse_range.
+//   bench_grammar [rounds]
+
+namespace
+{
+    struct cfg_t
+    {
+        float lo, hi;
+    };
+
+    constexpr char kReply[] = "getRange\r\nResponse 0.6 25.0\r\nDone\r\n";
+
+    [[gnu::noinline]] grammar::step_t parse_range(const uint8_t *p, size_t n, cfg_t &c)
+    {
+        using namespace grammar;
+        constexpr auto g = find<"getRange"> >> find<"Response ">
+            >> num<&cfg_t::lo, 6, 250, 10> >> ws >> num<&cfg_t::hi, 6, 250, 10> >> crlf >> done_or_error;
+        auto parser = g.parser();
+        for(size_t i = 0; i < n; ++i)
+            if (auto r = parser.Feed(p[i], c); r != step_t::More)
+                return r;
+        return step_t::More;
+    }
+
+    [[gnu::noinline]] bool scanf_range(const char *p, cfg_t &c)
+    {
+        return sscanf(p, "getRange\r\nResponse %f %f\r\nDone\r\n", &c.lo, &c.hi) == 2;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const int rounds = argc > 1 ? atoi(argv[1]) : 1000000;
+    const size_t n = sizeof(kReply) - 1;
+    volatile float sink = 0;
+    cfg_t c{};
+
+    uint32_t start = k_cycle_get_32();
+    for(int i = 0; i < rounds; ++i)
+    {
+        if (parse_range((const uint8_t *)kReply, n, c) != grammar::step_t::Done)
+            return 1;
+        sink = sink + c.lo;
+    }
+    const double grammar_ns = double(k_cycle_get_32() - start) / rounds;
+
+    start = k_cycle_get_32();
+    for(int i = 0; i < rounds; ++i)
+    {
+        if (!scanf_range(kReply, c))
+            return 1;
+        sink = sink + c.lo;
+    }
+    const double scanf_ns = double(k_cycle_get_32() - start) / rounds;
+
+    printf("reply %zu B\n", n);
+    printf("%-8s %8.1f ns/reply %6.2f ns/B\n", "grammar", grammar_ns, grammar_ns / n);
+    printf("%-8s %8.1f ns/reply %6.2f ns/B\n", "sscanf", scanf_ns, scanf_ns / n);
+    return 0;
+}
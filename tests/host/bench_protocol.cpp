@@ -0,0 +1,131 @@
+#include "bench.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+//Host runner of the protocol benchmarks (src/bench.cpp) on the memory
+//transport: one JSON line per case on stdout, heap allocations counted by
+//the operator new below. The suite runs several rounds and reports each
+//case's median, a host clock being much noisier than a cycle counter.
+//   bench_protocol                      - fails if a case is wrong or allocates
+//   bench_protocol --save FILE          - also writes the results as the new baseline
+//   bench_protocol --baseline FILE      - fails if a case got kRegressionPct slower
+//   bench_protocol --rounds N           - default 7
+//Cycles are ns on the host. Baselines only compare runs on the same machine.
+
+namespace
+{
+    std::atomic<uint32_t> g_allocs{0};
+
+    uint32_t alloc_count() { return g_allocs.load(std::memory_order_relaxed); }
+
+    //"key":"value" or "key":number out of one to_json line
+    std::string field(std::string const& l, const char *key)
+    {
+        std::string k = std::string("\"") + key + "\":";
+        size_t p = l.find(k);
+        if (p == std::string::npos)
+            return {};
+        p += k.size();
+        if (l[p] == '"')
+            return l.substr(p + 1, l.find('"', p + 1) - p - 1);
+        return l.substr(p, l.find_first_of(",}", p) - p);
+    }
+
+    std::string key(bench::result_t const& r) { return std::string(r.name) + "/" + r.input; }
+
+    //case/input -> cycles
+    std::map<std::string, uint32_t> g_baseline;
+
+    bool load_baseline(const char *path)
+    {
+        FILE *f = fopen(path, "r");
+        if (!f)
+        {
+            fprintf(stderr, "can't open %s\n", path);
+            return false;
+        }
+        char buf[512];
+        while(fgets(buf, sizeof(buf), f))
+        {
+            std::string l(buf);
+            if (auto cycles = field(l, "cycles"); !cycles.empty())
+                g_baseline[field(l, "case") + "/" + field(l, "input")] = (uint32_t)std::stoul(cycles);
+        }
+        fclose(f);
+        return true;
+    }
+
+    //every round's result of each case, in case order
+    std::vector<std::vector<bench::result_t>> g_rounds;
+
+    void on_result(void *, bench::result_t const& r)
+    {
+        g_rounds.back().push_back(r);
+    }
+}
+
+void *operator new(size_t n)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+int main(int argc, char **argv)
+{
+    FILE *save = nullptr;
+    int rounds = 7;
+    for(int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--baseline") && !load_baseline(argv[i + 1]))
+            return 2;
+        if (!strcmp(argv[i], "--save") && !(save = fopen(argv[i + 1], "w")))
+            return 2;
+        if (!strcmp(argv[i], "--rounds"))
+            rounds = std::max(1, atoi(argv[i + 1]));
+    }
+    bench::set_alloc_counter(alloc_count);
+    g_rounds.reserve(rounds);
+    for(int i = 0; i < rounds; ++i)
+    {
+        g_rounds.emplace_back();
+        g_rounds.back().reserve(64);
+        bench::run(on_result, nullptr);
+    }
+
+    size_t bad = 0, allocating = 0;
+    for(size_t c = 0; c < g_rounds[0].size(); ++c)
+    {
+        std::vector<bench::result_t> all;
+        for(auto const& round : g_rounds)
+            all.push_back(round[c]);
+        std::sort(all.begin(), all.end(), [](auto const& a, auto const& b){ return a.cycles < b.cycles; });
+        bench::result_t r = all[all.size() / 2];
+        r.ok = std::all_of(all.begin(), all.end(), [](auto const& x){ return x.ok; });
+        auto b = g_baseline.find(key(r));
+        r.baseline = b == g_baseline.end() ? 0 : b->second;
+        r.regressed = r.baseline && uint64_t(r.cycles) * 100 > uint64_t(r.baseline) * (100 + bench::kRegressionPct);
+        bad += !r.ok || r.regressed;
+        allocating += r.allocs != 0 && r.allocs != bench::kNotCounted;
+
+        char json[320];
+        bench::to_json(r, json, sizeof(json));
+        printf("%s\n", json);
+        if (save)
+            fprintf(save, "%s\n", json);
+    }
+    if (save)
+        fclose(save);
+    fprintf(stderr, "%zu bad, %zu allocating\n", bad, allocating);
+    return bad || allocating ? 1 : 0;
+}
@@ -0,0 +1,45 @@
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+//Minimal checks for the host tests: a failed CHECK reports and carries on,
+//the test binary exits non-zero if any failed.
+#include <cstdio>
+#include <zephyr/kernel.h>
+
+namespace host
+{
+    inline int g_failed = 0;
+    inline int g_checks = 0;
+
+    inline bool check(bool ok, const char *expr, const char *file, int line)
+    {
+        ++g_checks;
+        if (!ok)
+        {
+            ++g_failed;
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expr);
+        }
+        return ok;
+    }
+
+    //every test starts at t=0 with nothing scheduled
+    template<class F>
+    inline void run(const char *name, F &&f)
+    {
+        reset();
+        int failed = g_failed;
+        f();
+        printf("%-40s %s\n", name, g_failed == failed ? "ok" : "FAILED");
+    }
+
+    inline int result()
+    {
+        printf("%d checks, %d failed\n", g_checks, g_failed);
+        return g_failed ? 1 : 0;
+    }
+}
+
+#define CHECK(e) ::host::check((e), #e, __FILE__, __LINE__)
+#define RUN(f) ::host::run(#f, f)
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef HOST_SHIM_ZEPHYR_DRIVERS_UART_H_
+#define HOST_SHIM_ZEPHYR_DRIVERS_UART_H_
+
+//Declarations the transport classes mention; only the memory transport is built on the host.
+#include <cstddef>
+#include <cstdint>
+
+struct device { const char *name; };
+
+struct uart_event
+{
+    int type;
+    union
+    {
+        struct { uint8_t *buf; size_t offset; size_t len; } rx;
+    } data;
+};
+
+#endif
@@ -0,0 +1,269 @@
+#ifndef HOST_SHIM_ZEPHYR_KERNEL_H_
+#define HOST_SHIM_ZEPHYR_KERNEL_H_
+
+//The part of the Zephyr kernel API the libraries use, for host builds.
+//Single threaded with a simulated clock: a wait that can't be satisfied
+//runs the events scheduled with host::after() up to its deadline (advancing
+//the clock to each) and times out once none is left that could satisfy it.
+//Work polling for events (k_work_poll) runs its handler from the wait of the
+//test (host::run_until) as soon as an event is ready or its timeout passed;
+//never from a blocking call inside some work, the queue is held up by it.
+//k_cycle_get_32() is real time in ns, so cycle counts are ns on the host.
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#define printk printf
+#define CONTAINER_OF(ptr, type, field) ((type *)(((char *)(ptr)) - offsetof(type, field)))
+#define BIT(n) (1UL << (n))
+
+namespace host
+{
+    inline int64_t g_now_ms = 0;
+
+    struct event_t
+    {
+        int64_t at;
+        std::function<void()> fn;
+    };
+    inline std::vector<event_t> g_events;
+
+    //fn runs 'ms' from now, inside whatever wait is pending then
+    inline void after(int64_t ms, std::function<void()> fn)
+    {
+        g_events.push_back({g_now_ms + ms, std::move(fn)});
+    }
+
+    //k_work_poll submitted and waiting for one of its events or its timeout
+    struct poller_t
+    {
+        void *key;
+        std::function<bool()> ready;
+        std::function<void(int)> fire;
+        bool expired = false;
+    };
+    inline std::vector<poller_t> g_pollers;
+
+    //hands the first ready or expired poller its work, true if there was one
+    inline bool run_pollers()
+    {
+        for(auto i = g_pollers.begin(); i != g_pollers.end(); ++i)
+        {
+            if (!i->expired && !i->ready())
+                continue;
+            int r = i->expired ? -EAGAIN : 0;
+            auto fire = std::move(i->fire);
+            g_pollers.erase(i);
+            fire(r);
+            return true;
+        }
+        return false;
+    }
+
+    //runs the events due until 'deadline' (-1: any) in time order until ready() holds;
+    //the work of the pollers only with 'pollers', a blocking wait inside some work
+    //holds up the queue
+    template<class Ready>
+    inline bool run_until(int64_t deadline, Ready &&ready, bool pollers = true)
+    {
+        while(!ready())
+        {
+            if (pollers && run_pollers())
+                continue;
+            auto next = g_events.end();
+            for(auto i = g_events.begin(); i != g_events.end(); ++i)
+                if (next == g_events.end() || i->at < next->at)
+                    next = i;
+            if (next == g_events.end() || (deadline >= 0 && next->at > deadline))
+                return false;
+            auto e = std::move(*next);
+            g_events.erase(next);
+            if (e.at > g_now_ms)
+                g_now_ms = e.at;
+            e.fn();
+        }
+        return true;
+    }
+
+    inline void reset()
+    {
+        g_now_ms = 0;
+        g_events.clear();
+        g_pollers.clear();
+    }
+}
+
+/**********************************************************************/
+/* Time                                                               */
+/**********************************************************************/
+struct k_timeout_t { int64_t ms; };
+#define K_FOREVER k_timeout_t{-1}
+#define K_NO_WAIT k_timeout_t{0}
+#define K_MSEC(x) k_timeout_t{(int64_t)(x)}
+#define K_USEC(x) k_timeout_t{((int64_t)(x) + 999) / 1000}
+#define K_SECONDS(x) k_timeout_t{(int64_t)(x) * 1000}
+#define SYS_FOREVER_US (-1)
+#define SYS_FOREVER_MS (-1)
+
+//ticks are ms
+inline int64_t k_uptime_get() { return host::g_now_ms; }
+inline int64_t k_uptime_ticks() { return host::g_now_ms; }
+inline uint64_t k_ms_to_ticks_ceil64(uint64_t ms) { return ms; }
+inline uint32_t k_ticks_to_ms_ceil32(uint64_t t) { return (uint32_t)t; }
+
+inline uint32_t k_cycle_get_32()
+{
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+inline uint32_t sys_clock_hw_cycles_per_sec() { return 1'000'000'000; }
+inline uint64_t k_cyc_to_ns_floor64(uint64_t c) { return c; }
+inline uint32_t k_cyc_to_us_floor32(uint64_t c) { return (uint32_t)(c / 1000); }
+
+inline int64_t host_deadline(k_timeout_t t) { return t.ms < 0 ? -1 : host::g_now_ms + t.ms; }
+
+inline int32_t k_sleep(k_timeout_t t)
+{
+    int64_t end = host_deadline(t);
+    host::run_until(end, []{ return false; }, false);
+    if (end >= 0)
+        host::g_now_ms = end;
+    return 0;
+}
+inline int32_t k_msleep(int32_t ms) { return k_sleep(K_MSEC(ms)); }
+
+struct k_timepoint_t { int64_t at; };
+inline k_timepoint_t sys_timepoint_calc(k_timeout_t t) { return {host_deadline(t)}; }
+inline k_timeout_t sys_timepoint_timeout(k_timepoint_t t)
+{
+    if (t.at < 0)
+        return K_FOREVER;
+    return {t.at > host::g_now_ms ? t.at - host::g_now_ms : 0};
+}
+inline bool sys_timepoint_expired(k_timepoint_t t) { return t.at >= 0 && host::g_now_ms >= t.at; }
+
+//blocks until ready() or the timeout; forever with nothing left to run is a test bug
+template<class Ready>
+inline bool host_wait(k_timeout_t t, Ready &&ready)
+{
+    int64_t end = host_deadline(t);
+    if (host::run_until(end, ready, false))
+        return true;
+    if (end < 0)
+    {
+        fprintf(stderr, "host: waiting forever with no event pending\n");
+        abort();
+    }
+    host::g_now_ms = end;
+    return false;
+}
+
+/**********************************************************************/
+/* Interrupts, scheduling                                             */
+/**********************************************************************/
+inline unsigned int irq_lock() { return 0; }
+inline void irq_unlock(unsigned int) {}
+
+struct k_work;
+using k_work_handler_t = void (*)(struct k_work *);
+struct k_work { k_work_handler_t handler; };
+inline void k_work_init(k_work *w, k_work_handler_t h) { w->handler = h; }
+inline int k_work_submit(k_work *w) { w->handler(w); return 0; }
+//a single queue: work runs right away, work polls from the waits
+struct k_work_q {};
+inline int k_work_submit_to_queue(k_work_q *, k_work *w) { return k_work_submit(w); }
+
+struct k_timer {};
+
+/**********************************************************************/
+/* Semaphores, polling                                                */
+/**********************************************************************/
+struct k_sem { unsigned int count, limit; };
+inline int k_sem_init(k_sem *s, unsigned int c, unsigned int l) { s->count = c; s->limit = l; return 0; }
+inline void k_sem_give(k_sem *s) { if (s->count < s->limit) ++s->count; }
+inline void k_sem_reset(k_sem *s) { s->count = 0; }
+inline unsigned int k_sem_count_get(k_sem *s) { return s->count; }
+inline int k_sem_take(k_sem *s, k_timeout_t t)
+{
+    if (!host_wait(t, [s]{ return s->count != 0; }))
+        return -EAGAIN;
+    --s->count;
+    return 0;
+}
+
+struct k_poll_signal { unsigned int signaled; int result; };
+inline void k_poll_signal_init(k_poll_signal *s) { s->signaled = 0; s->result = 0; }
+inline int k_poll_signal_raise(k_poll_signal *s, int r) { s->signaled = 1; s->result = r; return 0; }
+inline void k_poll_signal_reset(k_poll_signal *s) { s->signaled = 0; }
+inline void k_poll_signal_check(k_poll_signal *s, unsigned int *signaled, int *r) { *signaled = s->signaled; *r = s->result; }
+
+enum { K_POLL_TYPE_SEM_AVAILABLE, K_POLL_TYPE_SIGNAL };
+enum { K_POLL_MODE_NOTIFY_ONLY };
+enum { K_POLL_STATE_NOT_READY, K_POLL_STATE_READY };
+struct k_poll_event { int type; int mode; void *obj; int state; };
+#define K_POLL_EVENT_INITIALIZER(_type, _mode, _obj) k_poll_event{(_type), (_mode), (void *)(_obj), K_POLL_STATE_NOT_READY}
+
+inline void k_poll_event_init(k_poll_event *e, int type, int mode, void *obj) { *e = {type, mode, obj, K_POLL_STATE_NOT_READY}; }
+
+//sets the states, true if any is ready
+inline bool host_poll_ready(k_poll_event *e, int n)
+{
+    bool any = false;
+    for(int i = 0; i < n; ++i)
+    {
+        bool r = e[i].type == K_POLL_TYPE_SEM_AVAILABLE
+            ? ((k_sem *)e[i].obj)->count != 0
+            : ((k_poll_signal *)e[i].obj)->signaled != 0;
+        e[i].state = r ? K_POLL_STATE_READY : K_POLL_STATE_NOT_READY;
+        any = any || r;
+    }
+    return any;
+}
+
+inline int k_poll(k_poll_event *e, int n, k_timeout_t t)
+{
+    return host_wait(t, [&]{ return host_poll_ready(e, n); }) ? 0 : -EAGAIN;
+}
+
+//the handler gets &work; 'gen' tells a timeout from an earlier submission
+struct k_work_poll
+{
+    struct k_work work;
+    int poll_result;
+    uint32_t gen;
+};
+inline void k_work_poll_init(k_work_poll *w, k_work_handler_t h) { *w = {}; w->work.handler = h; }
+inline int k_work_poll_cancel(k_work_poll *w)
+{
+    ++w->gen;
+    std::erase_if(host::g_pollers, [w](auto const& p){ return p.key == w; });
+    return 0;
+}
+inline int k_work_poll_submit_to_queue(k_work_q *, k_work_poll *w, k_poll_event *e, int n, k_timeout_t t)
+{
+    k_work_poll_cancel(w);
+    uint32_t gen = w->gen;
+    host::g_pollers.push_back({w, [=]{ return host_poll_ready(e, n); }, [=](int r){
+        w->poll_result = r;
+        w->work.handler(&w->work);
+    }});
+    if (t.ms >= 0)
+    {
+        host::after(t.ms, [=]{
+            if (w->gen != gen)
+                return;
+            for(auto &p : host::g_pollers)
+                if (p.key == w)
+                    p.expired = true;
+        });
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef HOST_SHIM_ZEPHYR_SYS_CRC_H_
+#define HOST_SHIM_ZEPHYR_SYS_CRC_H_
+
+//Same algorithms as zephyr/lib/crc (bitwise, not table driven).
+#include <cstddef>
+#include <cstdint>
+
+inline uint16_t crc16_itu_t(uint16_t seed, const uint8_t *src, size_t len)
+{
+    for(; len > 0; len--)
+    {
+        seed = (seed >> 8U) | (seed << 8U);
+        seed ^= *src++;
+        seed ^= (seed & 0xffU) >> 4U;
+        seed ^= seed << 12U;
+        seed ^= (seed & 0xffU) << 5U;
+    }
+    return seed;
+}
+
+inline uint32_t crc32_ieee_update(uint32_t crc, const uint8_t *data, size_t len)
+{
+    crc = ~crc;
+    for(size_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for(int b = 0; b < 8; b++)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+inline uint32_t crc32_ieee(const uint8_t *data, size_t len) { return crc32_ieee_update(0, data, len); }
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef HOST_SHIM_LIB_FORMATTER_HPP_
+#define HOST_SHIM_LIB_FORMATTER_HPP_
+
+//Stand-in for the esp_generic_lib formatter, used only when the submodule
+//isn't checked out: "{}" and "{:.N}" (N decimals) for integers, floats and
+//strings, formatter_t<T> for anything else.
+#include <cstddef>
+#include <cstdio>
+#include <expected>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+namespace tools
+{
+    struct FormatError {};
+
+    template<class T>
+    struct formatter_t;
+
+    //where the output goes: a char span, advanced as it fills
+    struct span_dest_t
+    {
+        std::span<char> m_Buf;
+        size_t m_Len = 0;
+
+        bool put(std::string_view s)
+        {
+            if (m_Len + s.size() > m_Buf.size())
+                return false;
+            for(char c : s) m_Buf[m_Len++] = c;
+            return true;
+        }
+    };
+
+    template<class D>
+    concept FormatDestination = std::is_same_v<std::remove_cvref_t<D>, span_dest_t>;
+
+    namespace detail
+    {
+        template<class A>
+        inline bool put_arg(span_dest_t &d, std::string_view spec, A const& a)
+        {
+            using T = std::remove_cvref_t<A>;
+            char buf[48];
+            int n = -1;
+            int prec = spec.starts_with(":.") ? spec[2] - '0' : -1;
+            if constexpr (std::is_same_v<T, bool>)
+                return d.put(a ? "true" : "false");
+            else if constexpr (std::is_floating_point_v<T>)
+                n = prec >= 0 ? snprintf(buf, sizeof(buf), "%.*f", prec, (double)a) : snprintf(buf, sizeof(buf), "%g", (double)a);
+            else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+                n = snprintf(buf, sizeof(buf), "%lld", (long long)a);
+            else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+                n = snprintf(buf, sizeof(buf), "%llu", (unsigned long long)a);
+            else if constexpr (std::is_convertible_v<T const&, std::string_view>)
+                return d.put(std::string_view(a));
+            else
+                return (bool)formatter_t<T>::format_to(d, spec, a);
+            return n >= 0 && (size_t)n < sizeof(buf) && d.put({buf, (size_t)n});
+        }
+
+        inline bool format(span_dest_t &d, std::string_view f)
+        {
+            return d.put(f);
+        }
+
+        template<class A, class... Rest>
+        inline bool format(span_dest_t &d, std::string_view f, A const& a, Rest const&... rest)
+        {
+            size_t open = f.find('{');
+            size_t close = f.find('}', open);
+            if (open == std::string_view::npos || close == std::string_view::npos)
+                return false;
+            return d.put(f.substr(0, open))
+                && put_arg(d, f.substr(open + 1, close - open - 1), a)
+                && format(d, f.substr(close + 1), rest...);
+        }
+    }
+
+    template<FormatDestination Dest, class... A>
+    inline std::expected<size_t, FormatError> format_to(Dest &&dst, std::string_view f, A const&... a)
+    {
+        size_t start = dst.m_Len;
+        if (!detail::format(dst, f, a...))
+            return std::unexpected(FormatError{});
+        return dst.m_Len - start;
+    }
+
+    //into 'buf', zero terminated; empty if it doesn't fit
+    template<size_t N, class... A>
+    inline std::string_view format_to_sv(char (&buf)[N], std::string_view f, A const&... a)
+    {
+        span_dest_t d{std::span<char>(buf, N - 1)};
+        if (!detail::format(d, f, a...))
+            return {};
+        buf[d.m_Len] = 0;
+        return {buf, d.m_Len};
+    }
+}
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef HOST_SHIM_LIB_MISC_HELPERS_HPP_
+#define HOST_SHIM_LIB_MISC_HELPERS_HPP_
+
+//Stand-in for the esp_generic_lib helpers: nothing of it is needed by the host builds.
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef HOST_SHIM_LIB_TYPE_TRAITS_HPP_
+#define HOST_SHIM_LIB_TYPE_TRAITS_HPP_
+
+//Stand-in for the esp_generic_lib traits the drivers use.
+#include <expected>
+#include <type_traits>
+
+template<class T>
+struct is_expected_type: std::false_type {};
+
+template<class V, class E>
+struct is_expected_type<std::expected<V, E>>: std::true_type {};
+
+template<class T>
+constexpr bool is_expected_type_v = is_expected_type<T>::value;
+
+#endif
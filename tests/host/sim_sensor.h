@@ -0,0 +1,138 @@
+#ifndef HOST_SIM_SENSOR_H_
+#define HOST_SIM_SENSOR_H_
+
+//The C4001 as seen over its UART, on the memory transport: every command
+//line is echoed and answered 'reply_ms' later the way the sensor does
+//(get*: a Response line, everything: Done/Error), in chunks of 'chunk'
+//bytes as a transport would deliver them. Frames go out while started.
+#include <zephyr/kernel.h>
+#include "lib_uart.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace host
+{
+    class SimSensor
+    {
+    public:
+        //sensor state, as get* reports it
+        float inhibit = 1.f;
+        float range_min = 0.6f;
+        float range_max = 25.f;
+        float trig = 6.f;
+        float detect = 0.f;
+        float clear = 5.f;
+        int s_hold = 7;
+        int s_trig = 7;
+        bool started = true;
+
+        //behaviour
+        int64_t reply_ms = 5;
+        size_t chunk = 64;
+        std::string fail_prefix;    //lines starting with it get 'Error'
+        std::string mute_prefix;    //lines starting with it get no reply at all
+        std::string noise;          //sent ahead of every reply
+
+        //what it got
+        std::vector<std::string> lines;
+        uint32_t saves = 0;
+
+        SimSensor(uart::transport::Memory &t):m_T(t) { t.SetOnTx(on_tx, this); }
+
+        size_t Count(std::string_view prefix) const
+        {
+            size_t n = 0;
+            for(auto const& l : lines)
+                n += l.starts_with(prefix);
+            return n;
+        }
+
+        //sends right away (if started), e.g. "$DFHPD,1, , , *"
+        void Frame(std::string_view f)
+        {
+            if (started)
+                Send(std::string(f) + "\r\n");
+        }
+
+        void Send(std::string const& s)
+        {
+            for(size_t i = 0; i < s.size(); i += chunk)
+                m_T.Feed((const uint8_t *)s.data() + i, std::min(chunk, s.size() - i));
+        }
+    private:
+        static void on_tx(void *ctx, const uint8_t *p, size_t n)
+        {
+            auto &s = *(SimSensor *)ctx;
+            s.m_Line.append((const char *)p, n);
+            for(size_t e; (e = s.m_Line.find("\r\n")) != std::string::npos;)
+            {
+                std::string l = s.m_Line.substr(0, e);
+                s.m_Line.erase(0, e + 2);
+                s.OnLine(l);
+            }
+        }
+
+        static std::string num(float v)
+        {
+            char b[16];
+            snprintf(b, sizeof(b), "%.1f", (double)v);
+            return b;
+        }
+
+        std::string Answer(std::string const& l)
+        {
+            auto arg = [&](int i) -> std::string {
+                size_t p = 0;
+                for(int k = 0; k <= i && p != std::string::npos; ++k)
+                    p = l.find(' ', p ? p + 1 : 0);
+                if (p == std::string::npos)
+                    return {};
+                return l.substr(p + 1, l.find(' ', p + 1) - p - 1);
+            };
+            auto f = [&](int i) { return strtof(arg(i).c_str(), nullptr); };
+            if (l.starts_with("sensorStop")) { started = false; return {}; }
+            if (l.starts_with("sensorStart")) { started = true; return {}; }
+            if (l.starts_with("saveConfig")) { ++saves; return {}; }
+            if (l.starts_with("getRange")) return "Response " + num(range_min) + " " + num(range_max) + "\r\n";
+            if (l.starts_with("getTrigRange")) return "Response " + num(trig) + "\r\n";
+            if (l.starts_with("getInhibit")) return "Response " + num(inhibit) + "\r\n";
+            if (l.starts_with("getLatency")) return "Response " + num(detect) + " " + num(clear) + "\r\n";
+            if (l.starts_with("getSensitivity")) return "Response " + std::to_string(s_hold) + " " + std::to_string(s_trig) + "\r\n";
+            if (l.starts_with("getHWV")) return "HardwareVersion:SIM-HW\r\n";
+            if (l.starts_with("getSWV")) return "SoftwareVersion:SIM-SW 1.0\r\n";
+            if (l.starts_with("setRange ")) { range_min = f(0); range_max = f(1); }
+            else if (l.starts_with("setTrigRange ")) trig = f(0);
+            else if (l.starts_with("setInhibit ")) inhibit = f(0);
+            else if (l.starts_with("setLatency ")) { detect = f(0); clear = f(1); }
+            else if (l.starts_with("setSensitivity "))
+            {
+                int h = atoi(arg(0).c_str()), t = atoi(arg(1).c_str());
+                if (h != 255) s_hold = h;
+                if (t != 255) s_trig = t;
+            }
+            return {};
+        }
+
+        void OnLine(std::string const& l)
+        {
+            lines.push_back(l);
+            if (!mute_prefix.empty() && l.starts_with(mute_prefix))
+                return;
+            if (l.starts_with("resetSystem"))
+                return;
+            std::string r = noise + l + "\r\n";
+            if (!fail_prefix.empty() && l.starts_with(fail_prefix))
+                r += "Error\r\n";
+            else
+                r += Answer(l) + "Done\r\n";
+            host::after(reply_ms, [this, r]{ Send(r); });
+        }
+
+        uart::transport::Memory &m_T;
+        std::string m_Line;
+    };
+}
+
+#endif
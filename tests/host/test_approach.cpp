@@ -0,0 +1,173 @@
+#include "host_test.h"
+#include "lib_dfr_c4001_frames.h"
+#include "lib_spsc_ring.h"
+#include "approach_predictor.hpp"
+#include <cmath>
+#include <vector>
+
+//approach::predictor_t on replayed walks: target frames as the sensor prints
+//them (with noise), decoded and queued the way src/main.cpp does it, drained
+//by zigbee in bursts; the track goes by the time each frame was decoded
+
+using frame_t = dfr::frames::frame_t;
+using kind_t = dfr::frames::kind_t;
+using predictor_t = approach::predictor_t;
+
+namespace
+{
+    constexpr int64_t kFramePeriod = 100;
+    constexpr int64_t kDrainPeriod = 300;
+
+    constexpr predictor_t::cfg_t kCfg{.lead = 1000, .threshold = 2.f};
+
+    struct timed_frame_t
+    {
+        frame_t f;
+        int64_t at;
+    };
+
+    //same noise every run, uniform in [-1, 1]
+    struct noise_t
+    {
+        uint32_t s = 12345;
+        float operator()()
+        {
+            s = s * 1103515245u + 12345u;
+            return float((s >> 8) & 0xffff) / 32767.5f - 1.f;
+        }
+    };
+
+    struct track_t
+    {
+        predictor_t p;
+        dfr::frames::Decoder dec;
+        SPSCRing<timed_frame_t, 8> frames;
+        std::vector<int64_t> fired;
+        //stamp frames when zigbee gets to them instead (what not to do)
+        bool drainTime = false;
+
+        track_t() { p.SetConfig(kCfg); }
+
+        //c4001 worker
+        void Receive(float range, float speed, int64_t now)
+        {
+            char line[64];
+            if (range > 0)
+                snprintf(line, sizeof(line), "$DFDMD,1,1,%.2f,%.2f,900, , *\r\n", range, speed);
+            else
+                snprintf(line, sizeof(line), "$DFDMD,0,0,0,0,0, , *\r\n");
+            for(const char *c = line; *c; ++c)
+            {
+                if (dec.Feed(*c) != kind_t::None)
+                    CHECK(frames.Push({dec.Frame(), now}));
+            }
+        }
+
+        //zigbee
+        void Drain(int64_t now)
+        {
+            timed_frame_t tf;
+            while(frames.Pop(tf))
+            {
+                int64_t t = drainTime ? now : tf.at;
+                if (!tf.f.targets)
+                    p.Lost();
+                else if (p.Update(tf.f.range, tf.f.speed, t))
+                    fired.push_back(tf.at);
+            }
+        }
+
+        //range(t) in m (<= 0: nobody), a frame every kFramePeriod until 'to'
+        template<class Range>
+        void Walk(int64_t from, int64_t to, Range range, float noise = 0.05f)
+        {
+            noise_t n;
+            for(int64_t t = from; t < to; t += kFramePeriod)
+            {
+                float r = range(t);
+                float v = (range(t + kFramePeriod) - r) * 1000.f / kFramePeriod;
+                Receive(r > 0 ? r + noise * n() : 0, v + 2 * noise * n(), t);
+                if ((t + kFramePeriod) % kDrainPeriod == 0)
+                    Drain(t + kFramePeriod);
+            }
+            Drain(to);
+        }
+    };
+
+    //7 m out, 1.2 m/s straight at the sensor: crosses 2 m at ~4167 ms
+    float walk_in(int64_t t) { return 7.f - 1.2f * float(t) / 1000.f; }
+
+    void walking_in_fires_ahead()
+    {
+        track_t k;
+        k.Walk(0, 6000, walk_in);
+        CHECK(k.fired.size() == 1);
+        //within the lead of the crossing, give or take a frame or two
+        constexpr int64_t kCross = 4167;
+        CHECK(!k.fired.empty() && k.fired[0] < kCross && k.fired[0] >= kCross - kCfg.lead - 2 * kFramePeriod);
+    }
+
+    //a burst of frames drained at once would share a time: every frame
+    //restarts the track and the gate never opens
+    void burst_needs_frame_time()
+    {
+        track_t k;
+        k.drainTime = true;
+        k.Walk(0, 6000, walk_in);
+        CHECK(k.fired.empty());
+    }
+
+    void walking_away_never_fires()
+    {
+        track_t k;
+        k.Walk(0, 6000, [](int64_t t){ return 1.f + 1.2f * float(t) / 1000.f; });
+        CHECK(k.fired.empty());
+    }
+
+    //somebody at 2.5 m fidgeting: noisy range, speed of either sign
+    void standing_close_never_fires()
+    {
+        track_t k;
+        k.Walk(0, 10000, [](int64_t){ return 2.5f; }, 0.2f);
+        CHECK(k.fired.empty());
+    }
+
+    void every_approach_fires_once()
+    {
+        track_t k;
+        auto in_out_in = [](int64_t t) -> float {
+            if (t < 5000)
+                return walk_in(t);
+            if (t < 10000)
+                return 1.f + 1.2f * float(t - 5000) / 1000.f;
+            return walk_in(t - 10000);
+        };
+        k.Walk(0, 15000, in_out_in);
+        CHECK(k.fired.size() == 2);
+    }
+
+    //no frames for longer than max_gap: a new track has to earn
+    //min_updates again before it may fire
+    void gap_restarts_the_track()
+    {
+        track_t k;
+        k.Walk(0, 1500, walk_in);
+        CHECK(k.p.Tracking());
+        //nothing from the sensor for 1.6 s, then three frames within the lead
+        k.Walk(3100, 3400, walk_in);
+        CHECK(k.p.Tracking() && k.fired.empty());
+        k.Walk(3400, 4200, walk_in);
+        CHECK(k.fired.size() == 1);
+    }
+}
+
+int main()
+{
+    RUN(walking_in_fires_ahead);
+    RUN(burst_needs_frame_time);
+    RUN(walking_away_never_fires);
+    RUN(standing_close_never_fires);
+    RUN(every_approach_fires_once);
+    RUN(gap_restarts_the_track);
+    return host::result();
+}
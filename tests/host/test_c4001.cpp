@@ -0,0 +1,164 @@
+#include "host_test.h"
+#include "sim_sensor.h"
+#include "lib_dfr_c4001.h"
+#include <cmath>
+
+//dfr::C4001 against the simulated sensor: sessions, queries, set commands,
+//error replies, timeouts and retries, frames
+
+using C4001 = dfr::C4001;
+using Op = C4001::Op;
+
+namespace
+{
+    bool near(float a, float b) { return std::fabs(a - b) < 0.01f; }
+
+    struct sensor_t
+    {
+        device d{"sim"};
+        C4001 dev{&d};
+        host::SimSensor sim{dev.GetTransport()};
+    };
+
+    void init_reads_the_config()
+    {
+        sensor_t t;
+        t.sim.range_min = 1.2f;
+        t.sim.trig = 4.5f;
+        t.sim.s_hold = 3;
+        auto r = t.dev.Init();
+        CHECK((bool)r);
+        auto c = t.dev.GetConfig();
+        CHECK(near(c.m_MinRange, 1.2f) && near(c.m_MaxRange, 25.f));
+        CHECK(near(c.m_TrigRange, 4.5f));
+        CHECK(c.m_SensitivityHold == 3 && c.m_SensitivityTrigger == 7);
+        CHECK(near(c.m_ClearLatency, 5.f));
+        CHECK(!strcmp(t.dev.GetHWVer().m_Version, "SIM-HW"));
+        CHECK(!strcmp(t.dev.GetSWVer().m_Version, "SIM-SW 1.0"));
+        //one session: stopped once, started again at its end
+        CHECK(t.sim.Count("sensorStop") == 1 && t.sim.Count("sensorStart") == 1);
+        CHECK(t.sim.started);
+    }
+
+    void set_then_read_back()
+    {
+        sensor_t t;
+        CHECK((bool)t.dev.Init());
+        uint32_t ver = t.dev.GetConfigVersion();
+        {
+            auto cfg = t.dev.GetConfigurator();
+            CHECK((bool)cfg.SetRange(1.5f, 12.f));
+            CHECK((bool)cfg.UpdateRange());
+            CHECK((bool)cfg.SetSensitivity(2, 5));
+            CHECK((bool)cfg.UpdateSensitivity());
+            CHECK((bool)cfg.End());
+        }
+        CHECK(near(t.sim.range_min, 1.5f) && near(t.sim.range_max, 12.f));
+        CHECK(near(t.dev.GetRangeFrom(), 1.5f) && near(t.dev.GetRangeTo(), 12.f));
+        CHECK(t.dev.GetSensitivityTrig() == 2 && t.dev.GetSensitivityHold() == 5);
+        CHECK(t.dev.GetConfigVersion() != ver);
+    }
+
+    void error_reply_is_final()
+    {
+        sensor_t t;
+        CHECK((bool)t.dev.Init());
+        t.sim.fail_prefix = "setTrigRange";
+        auto cfg = t.dev.GetConfigurator();
+        auto r = cfg.SetTrigRange(3.f);
+        CHECK(!r && r.error().site == err::site_t::CmdErrorResp && r.error().op == (uint8_t)Op::SetTrigRange);
+        //the sensor answered: not a liveness failure
+        CHECK(!C4001::IsTimeout(r.error()));
+        //an answer, even 'Error', is not retried
+        CHECK(t.sim.Count("setTrigRange") == 1);
+        CHECK((bool)cfg.End());
+    }
+
+    void missing_reply_times_out_and_retries()
+    {
+        sensor_t t;
+        CHECK((bool)t.dev.Init());
+        auto before = t.dev.GetExchangeStats();
+        size_t sent = t.sim.Count("getRange");
+        t.sim.mute_prefix = "getRange";
+        auto cfg = t.dev.GetConfigurator();
+        auto r = cfg.UpdateRange();
+        CHECK(!r && r.error().site == err::site_t::QueryTimeout && r.error().op == (uint8_t)Op::GetRange);
+        CHECK(C4001::IsTimeout(r.error()));
+        //idempotent: one retry
+        CHECK(t.sim.Count("getRange") - sent == 2);
+        auto after = t.dev.GetExchangeStats();
+        CHECK(after.m_Timeouts - before.m_Timeouts == 2);
+        CHECK(after.m_Retries - before.m_Retries == 1);
+        //the previous values stay
+        CHECK(near(t.dev.GetRangeFrom(), 0.6f));
+        CHECK((bool)cfg.End());
+    }
+
+    void unanswered_command_is_a_timeout()
+    {
+        sensor_t t;
+        CHECK((bool)t.dev.Init());
+        t.sim.mute_prefix = "setTrigRange";
+        auto cfg = t.dev.GetConfigurator();
+        auto r = cfg.SetTrigRange(3.f);
+        CHECK(!r && C4001::IsTimeout(r.error()));
+    }
+
+    void malformed_reply_leaves_the_config()
+    {
+        sensor_t t;
+        CHECK((bool)t.dev.Init());
+        //the first number is fine, the second out of range
+        t.sim.range_min = 1.5f;
+        t.sim.range_max = 99.f;
+        auto cfg = t.dev.GetConfigurator();
+        auto r = cfg.UpdateRange();
+        CHECK(!r && r.error().site == err::site_t::QueryMalformed);
+        CHECK(!C4001::IsTimeout(r.error()));
+        //nor is it published with the next good reply
+        CHECK((bool)cfg.UpdateTrigRange());
+        CHECK((bool)cfg.End());
+        CHECK(near(t.dev.GetRangeFrom(), 0.6f) && near(t.dev.GetRangeTo(), 25.f));
+    }
+
+    void reply_timeouts_are_learned()
+    {
+        sensor_t t;
+        t.sim.reply_ms = 8;
+        CHECK((bool)t.dev.Init());
+        for(int i = 0; i < 8; ++i)
+            CHECK((bool)t.dev.Probe());
+        auto to = t.dev.GetTimeout(C4001::CmdKind::Stop);
+        CHECK(to >= C4001::kMinReplyWait && to < C4001::kDefaultWait);
+    }
+
+    void frames_are_decoded_between_sessions()
+    {
+        sensor_t t;
+        CHECK((bool)t.dev.Init());
+        t.sim.Frame("$DFDMD,1,1,2.35,-0.12,1234, , *");
+        host::after(5, [&]{ t.sim.Frame("$DFHPD,1, , , *"); });
+        int targets = 0, presence = 0;
+        float range = 0;
+        auto r = t.dev.StreamFrames(30, [&](dfr::frames::frame_t const& f){
+            if (f.kind == dfr::frames::kind_t::Target) { ++targets; range = f.range; }
+            if (f.kind == dfr::frames::kind_t::Presence) presence += f.present;
+        }, []{ return false; });
+        CHECK((bool)r);
+        CHECK(targets == 1 && presence == 1 && near(range, 2.35f));
+    }
+}
+
+int main()
+{
+    RUN(init_reads_the_config);
+    RUN(set_then_read_back);
+    RUN(error_reply_is_final);
+    RUN(missing_reply_times_out_and_retries);
+    RUN(unanswered_command_is_a_timeout);
+    RUN(malformed_reply_leaves_the_config);
+    RUN(reply_timeouts_are_learned);
+    RUN(frames_are_decoded_between_sessions);
+    return host::result();
+}
@@ -0,0 +1,137 @@
+#include "host_test.h"
+#include "sensitivity_sweep.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+//calib::sweep_t on simulated empty rooms: which level the noise clears at,
+//the margins hold and detect keep from it, and the statistics it goes by
+
+using sweep_t = calib::sweep_t;
+
+namespace
+{
+    constexpr int kFramesPerLevel = 50;
+
+    //ghosts[l]: ghost targets out of kFramesPerLevel at level l, of energy[l]
+    struct room_t
+    {
+        int ghosts[sweep_t::kMaxLevel + 1]{};
+        float energy[sweep_t::kMaxLevel + 1];
+
+        room_t() { std::fill(std::begin(energy), std::end(energy), 900.f); }
+    };
+
+    //runs the sweep the way run_calibration does, returns the levels watched
+    int run(sweep_t &s, room_t const& r)
+    {
+        int watched = 0;
+        for(bool more = true; more;)
+        {
+            ++watched;
+            int g = r.ghosts[s.Level()];
+            for(int i = 0; i < kFramesPerLevel; ++i)
+                s.OnTargetFrame(i < g, r.energy[s.Level()]);
+            more = s.Next();
+        }
+        return watched;
+    }
+
+    void quiet_room_backs_off_from_the_top()
+    {
+        sweep_t s;
+        CHECK(run(s, {}) == 1);
+        CHECK(s.Found() && s.Quiet() == 9);
+        CHECK(s.Hold() == 9 - sweep_t::kHoldMargin && s.Detect() == 9 - sweep_t::kDetectMargin);
+        CHECK(s.Detect() < s.Hold());
+    }
+
+    void stops_where_the_noise_clears()
+    {
+        room_t r;
+        r.ghosts[9] = 25;
+        r.ghosts[8] = 15;
+        r.ghosts[7] = 6;
+        sweep_t s;
+        CHECK(run(s, r) == 4);
+        CHECK(s.Found() && s.Quiet() == 6);
+        CHECK(s.Hold() == 5 && s.Detect() == 4);
+        CHECK(s.Frames() == 4 * kFramesPerLevel && s.Ghosts() == 25 + 15 + 6);
+    }
+
+    //a rare, weak ghost is within the margin over the floor: not every level
+    //has to be free of ghosts
+    void rare_weak_ghost_is_quiet()
+    {
+        room_t r;
+        r.ghosts[9] = 25;
+        r.ghosts[8] = 1;
+        r.energy[8] = 200.f;
+        sweep_t s;
+        CHECK(run(s, r) == 2);
+        CHECK(s.Quiet() == 8);
+
+        //a strong one is not, nor are frequent weak ones
+        r.energy[8] = 900.f;
+        sweep_t t;
+        CHECK(run(t, r) == 3 && t.Quiet() == 7);
+        r.energy[8] = 200.f;
+        r.ghosts[8] = 20;
+        sweep_t u;
+        CHECK(run(u, r) == 3 && u.Quiet() == 7);
+    }
+
+    //the floor is every target frame at the most sensitive level, the
+    //empty ones too
+    void floor_counts_every_frame()
+    {
+        room_t r;
+        r.ghosts[9] = 10;
+        r.energy[9] = 500.f;
+        sweep_t s;
+        run(s, r);
+        auto const& f = s.Floor();
+        CHECK(f.m_Count == kFramesPerLevel);
+        CHECK(std::fabs(f.m_Mean - 500.f * 10 / kFramesPerLevel) < 0.01f);
+        CHECK(f.m_Max == 500.f && f.StdDev() > 0.f);
+    }
+
+    void noisy_everywhere_fails()
+    {
+        room_t r;
+        for(auto &g : r.ghosts)
+            g = 25;
+        sweep_t s;
+        CHECK(run(s, r) == sweep_t::kMaxLevel);
+        CHECK(!s.Found());
+    }
+
+    void margins_stop_at_the_least_sensitive_level()
+    {
+        room_t r;
+        for(int l = 3; l <= 9; ++l)
+            r.ghosts[l] = 25;
+        sweep_t s;
+        run(s, r);
+        CHECK(s.Quiet() == 2 && s.Hold() == 1 && s.Detect() == 1);
+    }
+
+    void no_frames_fails()
+    {
+        sweep_t s;
+        CHECK(!s.Next());
+        CHECK(!s.Found());
+    }
+}
+
+int main()
+{
+    RUN(quiet_room_backs_off_from_the_top);
+    RUN(stops_where_the_noise_clears);
+    RUN(rare_weak_ghost_is_quiet);
+    RUN(floor_counts_every_frame);
+    RUN(noisy_everywhere_fails);
+    RUN(margins_stop_at_the_least_sensitive_level);
+    RUN(no_frames_fails);
+    return host::result();
+}
@@ -0,0 +1,191 @@
+#include "host_test.h"
+#include "lib_uart.h"
+#include <cstring>
+#include <string>
+
+//uart::Channel front end on the memory transport: sessions, the receive
+//ring, waits against the simulated clock, cancel
+
+using namespace uart;
+
+namespace
+{
+    std::string g_sent;
+
+    void collect(void *, const uint8_t *p, size_t n) { g_sent.append((const char *)p, n); }
+
+    void feed(Channel &c, const char *s) { c.GetTransport().Feed((const uint8_t *)s, strlen(s)); }
+
+    struct channel_t
+    {
+        device d{"sim"};
+        Channel c{&d};
+        uint8_t ring[32];
+
+        channel_t()
+        {
+            g_sent.clear();
+            c.SetDefaultWait(50);
+            CHECK((bool)c.Configure());
+            c.GetTransport().SetOnTx(collect, nullptr);
+        }
+    };
+
+    void session_reads_what_follows_the_send()
+    {
+        channel_t t;
+        //not receiving: dropped
+        feed(t.c, "early");
+        Channel::RxBlock b(t.c, t.ring, sizeof(t.ring));
+        CHECK((bool)t.c.Send((const uint8_t *)"getRange\r\n", 10));
+        CHECK(g_sent == "getRange\r\n");
+        feed(t.c, "Response 0.6 25.0\r\n");
+        uint8_t buf[64];
+        auto r = t.c.ReadSome(buf, sizeof(buf));
+        CHECK(r && r->v == 19 && !memcmp(buf, "Response 0.6 25.0\r\n", 19));
+        //nothing more: 0 bytes without waiting is not an error
+        auto r2 = t.c.ReadSome(buf, sizeof(buf), 0);
+        CHECK(r2 && r2->v == 0);
+    }
+
+    void read_waits_for_late_bytes()
+    {
+        channel_t t;
+        Channel::RxBlock b(t.c, t.ring, sizeof(t.ring));
+        CHECK((bool)t.c.Send((const uint8_t *)"x", 1));
+        host::after(30, [&]{ feed(t.c, "abcd"); });
+        uint8_t buf[4];
+        auto r = t.c.Read(buf, 4);
+        CHECK(r && r->v == 4 && !memcmp(buf, "abcd", 4));
+        CHECK(k_uptime_get() == 30);
+    }
+
+    void read_times_out_with_the_default_wait()
+    {
+        channel_t t;
+        Channel::RxBlock b(t.c, t.ring, sizeof(t.ring));
+        CHECK((bool)t.c.Send((const uint8_t *)"x", 1));
+        auto r = t.c.ReadByte();
+        CHECK(!r && r.error().site == err::site_t::ChannelRead && r.error().Code() == -EAGAIN);
+        CHECK(k_uptime_get() == 50);
+        //a byte too late for a shorter wait
+        host::after(20, [&]{ feed(t.c, "z"); });
+        CHECK(!t.c.ReadByte(10));
+        auto r2 = t.c.ReadByte(20);
+        CHECK(r2 && r2->v == 'z');
+    }
+
+    void continuous_reading_keeps_bytes_between_sessions()
+    {
+        channel_t t;
+        CHECK((bool)t.c.StartContinuousReading(t.ring, sizeof(t.ring)));
+        feed(t.c, "$DFHPD,1, , , *\r\n");
+        uint8_t buf[32];
+        {
+            //keepPending: the session starts with what is already there
+            Channel::RxBlock b(t.c, t.ring, sizeof(t.ring), true);
+            auto r = t.c.ReadSome(buf, sizeof(buf), 0);
+            CHECK(r && r->v == 17);
+        }
+        feed(t.c, "stale");
+        {
+            //a new exchange: what was there before is dropped
+            Channel::RxBlock b(t.c, t.ring, sizeof(t.ring));
+            feed(t.c, "fresh");
+            auto r = t.c.ReadSome(buf, sizeof(buf), 0);
+            CHECK(r && r->v == 5 && !memcmp(buf, "fresh", 5));
+        }
+        t.c.StopContinuousReading();
+    }
+
+    void ring_overflow_keeps_the_newest_bytes()
+    {
+        channel_t t;
+        CHECK((bool)t.c.StartContinuousReading(t.ring, sizeof(t.ring)));
+        std::string all;
+        for(int i = 0; i < 10; ++i)
+            all += "0123456789"[i];
+        for(int i = 0; i < 5; ++i)
+            feed(t.c, all.c_str());
+        CHECK(t.c.HasOverflow());
+        CHECK(t.c.GetStats().m_Overflows > 0);
+        uint8_t buf[64];
+        auto r = t.c.ReadSome(buf, sizeof(buf), 0);
+        CHECK(r && r->v > 0 && r->v < sizeof(t.ring));
+        CHECK(r && buf[r->v - 1] == '9');
+        t.c.StopContinuousReading();
+    }
+
+    void cancel_aborts_waits_until_reset()
+    {
+        channel_t t;
+        Channel::RxBlock b(t.c, t.ring, sizeof(t.ring));
+        host::after(10, [&]{ t.c.Cancel(); });
+        auto r = t.c.ReadByte(1000);
+        CHECK(!r && Channel::IsCancelled(r.error()));
+        CHECK(k_uptime_get() == 10);
+        auto s = t.c.Sleep(100);
+        CHECK(!s && Channel::IsCancelled(s.error()));
+        t.c.ResetCancel();
+        CHECK((bool)t.c.Sleep(100));
+        CHECK(k_uptime_get() == 110);
+    }
+
+    void cancel_hits_only_the_operation_it_names()
+    {
+        channel_t t;
+        Channel::RxBlock b(t.c, t.ring, sizeof(t.ring));
+        t.c.BeginOp(1);
+        uint32_t seen = t.c.CurrentOp();
+        t.c.BeginOp(2);
+        //too late for 1: 2 runs to its timeout
+        host::after(10, [&]{ CHECK(!t.c.Cancel(seen)); });
+        auto r = t.c.ReadByte(100);
+        CHECK(!r && r.error().Code() == -EAGAIN);
+        CHECK(!t.c.WasCancelled());
+        host::after(10, [&]{ CHECK(t.c.Cancel(2)); });
+        r = t.c.ReadByte(1000);
+        CHECK(!r && Channel::IsCancelled(r.error()));
+        CHECK(k_uptime_get() == 110);
+    }
+
+    void ended_operation_is_not_cancelled()
+    {
+        channel_t t;
+        t.c.BeginOp(3);
+        CHECK(t.c.Cancel(3));
+        t.c.EndOp();
+        //runs to its end, the cancel is still known
+        CHECK((bool)t.c.Sleep(100));
+        CHECK(!t.c.Cancel(3));
+        CHECK(t.c.WasCancelled());
+        t.c.BeginOp(4);
+        CHECK(!t.c.WasCancelled());
+    }
+
+    void counters_follow_the_traffic()
+    {
+        channel_t t;
+        Channel::RxBlock b(t.c, t.ring, sizeof(t.ring));
+        CHECK((bool)t.c.Send((const uint8_t *)"abc", 3));
+        feed(t.c, "12");
+        feed(t.c, "345");
+        auto s = t.c.GetStats();
+        CHECK(s.m_TxBytes == 3 && s.m_RxBytes == 5 && s.m_Events == 2);
+        CHECK(std::string(Channel::TransportName()) == "memory");
+    }
+}
+
+int main()
+{
+    RUN(session_reads_what_follows_the_send);
+    RUN(read_waits_for_late_bytes);
+    RUN(read_times_out_with_the_default_wait);
+    RUN(continuous_reading_keeps_bytes_between_sessions);
+    RUN(ring_overflow_keeps_the_newest_bytes);
+    RUN(cancel_aborts_waits_until_reset);
+    RUN(cancel_hits_only_the_operation_it_names);
+    RUN(ended_operation_is_not_cancelled);
+    RUN(counters_follow_the_traffic);
+    return host::result();
+}
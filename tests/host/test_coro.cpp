@@ -0,0 +1,270 @@
+#include "host_test.h"
+#include "sim_sensor.h"
+#include "lib_dfr_c4001.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+//The C4001 conversations as coroutines (lib_coro.h) on one simulated work
+//queue: sessions interleaved with the frame stream of another sensor, the
+//same errors, timeouts and cancels as the blocking calls, frames from the
+//pool only and within its slot size
+
+using C4001 = dfr::C4001;
+using CoTask = C4001::CoTask;
+using Op = C4001::Op;
+using Param = C4001::Param;
+
+namespace
+{
+    bool near(float a, float b) { return std::fabs(a - b) < 0.01f; }
+
+    k_work_q g_q;
+
+    struct sensor_t
+    {
+        device d{"sim"};
+        C4001 dev{&d};
+        host::SimSensor sim{dev.GetTransport()};
+        coro::Fiber fiber;
+
+        sensor_t()
+        {
+            CHECK((bool)dev.Init());
+            fiber.Init(&g_q, nullptr);
+        }
+
+        //runs the fiber on the queue until it's done
+        bool Run(int64_t ms)
+        {
+            return host::run_until(host::g_now_ms + ms, [&]{ return !fiber.Busy(); });
+        }
+    };
+
+    //the range request of the worker: one session, set, save, read back
+    CoTask set_range(C4001 &dev, float from, float to, C4001::ExpectedResult &res)
+    {
+        C4001::CmdLine l;
+        CHECK(C4001::FormatRange(l, from, to));
+        C4001::CoSession cs(dev);
+        auto r = co_await cs.Begin();
+        if (r)
+            r = co_await cs.SendLine(l, Op::SetRange);
+        if (r)
+            r = co_await cs.SaveConfig();
+        if (r)
+            r = co_await cs.Update(Param::Range);
+        auto e = co_await cs.End();
+        res = r ? e : r;
+        co_return res;
+    }
+
+    //what arrives for 'ms', the time of every frame
+    CoTask stream(C4001 &dev, int64_t ms, std::vector<int64_t> &frames)
+    {
+        C4001::FrameStream fs(dev);
+        const int64_t end = k_uptime_get() + ms;
+        while(k_uptime_get() < end)
+        {
+            auto r = fs.Poll([&](dfr::frames::frame_t const&){ frames.push_back(k_uptime_get()); }, 0);
+            if (!r)
+                co_return std::unexpected(r.error());
+            if (r->v)
+                continue;
+            if (int e = co_await dev.BytesAvailable(int(end - k_uptime_get())); e != 0 && e != -EAGAIN)
+                co_return std::unexpected(Err{err::site_t::ChannelReadSome, e});
+        }
+        co_return std::ref(dev);
+    }
+
+    CoTask step(C4001 &dev, C4001::ExpectedResult &res, auto f)
+    {
+        C4001::CoSession cs(dev);
+        auto r = co_await cs.Begin();
+        if (r)
+            r = co_await f(cs);
+        auto e = co_await cs.End();
+        res = r ? e : r;
+        co_return res;
+    }
+
+    void session_runs_on_the_fiber()
+    {
+        sensor_t t;
+        t.sim.reply_ms = 10;
+        C4001::ExpectedResult r{std::unexpected(Err{})};
+        const int64_t start = k_uptime_get();
+        CHECK(t.fiber.Start(set_range(t.dev, 1.5f, 12.f, r)));
+        //suspended at its first reply, the queue is free
+        CHECK(t.fiber.Busy() && k_uptime_get() == start);
+        CHECK(coro::g_Frames.GetStats().m_Used > 0);
+        CHECK(t.Run(1000));
+        CHECK((bool)r);
+        CHECK(t.sim.Count("sensorStop") == 2 && t.sim.Count("setRange 1.50 12.00") == 1);
+        CHECK(t.sim.saves == 1 && t.sim.started);
+        CHECK(near(t.dev.GetRangeFrom(), 1.5f) && near(t.dev.GetRangeTo(), 12.f));
+        //stop, set, save, get, start: one reply each
+        CHECK(k_uptime_get() == start + 5 * 10);
+        CHECK(coro::g_Frames.GetStats().m_Used == 0);
+    }
+
+    void config_interleaves_with_streaming()
+    {
+        sensor_t a, b;
+        a.sim.reply_ms = 40;
+        const int64_t start = k_uptime_get();
+        //b outputs a frame every 20 ms
+        for(int64_t at = 20; at <= 400; at += 20)
+            host::after(at, [&]{ b.sim.Frame("$DFHPD,1, , , *"); });
+        std::vector<int64_t> frames;
+        C4001::ExpectedResult ra{std::unexpected(Err{})}, rb{std::unexpected(Err{})};
+        CHECK(b.fiber.Start(stream(b.dev, 420, frames)));
+        CHECK(a.fiber.Start(set_range(a.dev, 2.f, 10.f, ra)));
+        CHECK(host::run_until(start + 1000, [&]{ return !a.fiber.Busy() && !b.fiber.Busy(); }));
+        CHECK((bool)ra);
+        CHECK(near(a.dev.GetRangeFrom(), 2.f));
+        //every frame as it came, while a waited for its replies
+        CHECK(frames.size() == 20);
+        CHECK(!frames.empty() && frames.front() == start + 20);
+        size_t during = std::count_if(frames.begin(), frames.end(), [&](int64_t at){ return at < start + 5 * 40; });
+        CHECK(during == 9);
+    }
+
+    void errors_as_the_blocking_calls()
+    {
+        sensor_t t;
+        C4001::ExpectedResult r{std::unexpected(Err{})};
+        //'Error' is final, not a timeout
+        t.sim.fail_prefix = "setTrigRange";
+        C4001::CmdLine l;
+        CHECK(C4001::FormatTrigRange(l, 3.f));
+        CHECK(t.fiber.Start(step(t.dev, r, [&](C4001::CoSession &cs){ return cs.SendLine(l, Op::SetTrigRange); })));
+        CHECK(t.Run(5000));
+        CHECK(!r && r.error().site == err::site_t::CmdErrorResp && r.error().op == (uint8_t)Op::SetTrigRange);
+        CHECK(!C4001::IsTimeout(r.error()));
+        CHECK(t.sim.Count("setTrigRange") == 1 && t.sim.started);
+
+        //no reply to a get: a timeout, retried once
+        t.sim.fail_prefix.clear();
+        t.sim.mute_prefix = "getRange";
+        auto before = t.dev.GetExchangeStats();
+        const auto gets = t.sim.Count("getRange");
+        CHECK(t.fiber.Start(step(t.dev, r, [](C4001::CoSession &cs){ return cs.Update(Param::Range); })));
+        CHECK(t.Run(5000));
+        CHECK(!r && r.error().site == err::site_t::QueryTimeout && r.error().op == (uint8_t)Op::GetRange);
+        CHECK(C4001::IsTimeout(r.error()));
+        CHECK(t.sim.Count("getRange") == gets + 2);
+        auto after = t.dev.GetExchangeStats();
+        CHECK(after.m_Timeouts - before.m_Timeouts == 2 && after.m_Retries - before.m_Retries == 1);
+
+        //nor to a set
+        t.sim.mute_prefix = "setTrigRange";
+        CHECK(t.fiber.Start(step(t.dev, r, [&](C4001::CoSession &cs){ return cs.SendLine(l, Op::SetTrigRange); })));
+        CHECK(t.Run(5000));
+        CHECK(!r && r.error().site == err::site_t::CmdTimeout && C4001::IsTimeout(r.error()));
+        CHECK(t.sim.started);
+    }
+
+    void cancel_ends_the_wait()
+    {
+        sensor_t t;
+        t.sim.mute_prefix = "setTrigRange";
+        C4001::ExpectedResult r{std::unexpected(Err{})};
+        C4001::CmdLine l;
+        CHECK(C4001::FormatTrigRange(l, 3.f));
+        t.dev.BeginOp(7);
+        const int64_t start = k_uptime_get();
+        CHECK(t.fiber.Start(step(t.dev, r, [&](C4001::CoSession &cs){ return cs.SendLine(l, Op::SetTrigRange); })));
+        int64_t cancelled = 0;
+        host::after(20, [&]{ cancelled = k_uptime_get(); CHECK(t.dev.Cancel(7)); });
+        CHECK(t.Run(5000));
+        CHECK(!r && C4001::IsCancelled(r.error()) && r.error().op == (uint8_t)Op::SetTrigRange);
+        //not retried; started again after the settle time
+        CHECK(t.sim.Count("setTrigRange") == 1);
+        CHECK(t.sim.started && t.sim.Count("sensorStart") == 2);
+        CHECK(cancelled == start + 20 && k_uptime_get() >= cancelled + C4001::kCancelSettleWait);
+        t.dev.BeginOp(0);
+    }
+
+    void restart_sleeps_without_blocking()
+    {
+        sensor_t a, b;
+        C4001::ExpectedResult ra{std::unexpected(Err{})};
+        const int64_t start = k_uptime_get();
+        CHECK(a.fiber.Start([](C4001 &dev, C4001::ExpectedResult &res) -> CoTask {
+            res = co_await dev.CoRestart();
+            co_return res;
+        }(a.dev, ra)));
+        //b gets its probe through while a sleeps
+        C4001::ExpectedResult rb{std::unexpected(Err{})};
+        CHECK(b.fiber.Start([](C4001 &dev, C4001::ExpectedResult &res) -> CoTask {
+            res = co_await dev.CoProbe();
+            co_return res;
+        }(b.dev, rb)));
+        CHECK(host::run_until(start + 100, [&]{ return !b.fiber.Busy(); }));
+        CHECK((bool)rb && a.fiber.Busy());
+        CHECK(a.Run(5000));
+        CHECK((bool)ra && k_uptime_get() == start + C4001::kRestartTimeout);
+        CHECK(a.sim.Count("resetSystem 0") == 1);
+    }
+
+    void no_frame_no_start()
+    {
+        sensor_t t;
+        auto before = coro::g_Frames.GetStats();
+        //lazy: each holds its frame without running
+        std::vector<CoTask> held;
+        for(size_t i = 0; i < coro::Frames::kSlots; ++i)
+        {
+            held.push_back(t.dev.CoProbe());
+            CHECK((bool)held.back());
+        }
+        CoTask none = t.dev.CoProbe();
+        CHECK(!none);
+        CHECK(!t.fiber.Start(std::move(none)));
+        CHECK(coro::g_Frames.GetStats().m_Failures == before.m_Failures + 1);
+        held.clear();
+        CHECK(coro::g_Frames.GetStats().m_Used == 0);
+
+        //inside a chain: the step that got no frame fails, the chain goes on
+        C4001::ExpectedResult r{std::unexpected(Err{})};
+        CHECK(t.fiber.Start([](C4001 &dev, std::vector<CoTask> &held, C4001::ExpectedResult &res) -> CoTask {
+            while(true)
+            {
+                CoTask next = dev.CoProbe();
+                if (!next)
+                {
+                    res = co_await std::move(next);
+                    break;
+                }
+                held.push_back(std::move(next));
+            }
+            co_return res;
+        }(t.dev, held, r)));
+        CHECK(!r && r.error().site == err::site_t::CoroNoFrame);
+        held.clear();
+    }
+
+    //the budget CORO_FRAME_SIZE is checked against: every frame of the
+    //conversations above fit its slot
+    void frames_fit_their_slots()
+    {
+        auto s = coro::g_Frames.GetStats();
+        printf("coroutine frames: biggest %u of %zu bytes, %u of %zu slots used at most\n"
+                , s.m_MaxSize, coro::Frames::kSize, s.m_MaxUsed, coro::Frames::kSlots);
+        CHECK(s.m_MaxSize <= coro::Frames::kSize);
+        CHECK(s.m_Used == 0);
+    }
+}
+
+int main()
+{
+    RUN(session_runs_on_the_fiber);
+    RUN(config_interleaves_with_streaming);
+    RUN(errors_as_the_blocking_calls);
+    RUN(cancel_ends_the_wait);
+    RUN(restart_sleeps_without_blocking);
+    RUN(no_frame_no_start);
+    RUN(frames_fit_their_slots);
+    return host::result();
+}
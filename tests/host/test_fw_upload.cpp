@@ -0,0 +1,142 @@
+#include "host_test.h"
+#include "lib_fw_upload.h"
+#include "lib_dfr_c4001.h"
+#include "sim_sensor.h"
+#include <zephyr/sys/crc.h>
+#include <algorithm>
+#include <optional>
+
+//fwupd::Uploader against fwupd::SimBootloader: whole images, resends,
+//a failing source, a bootloader that never asks, the C4001 entry
+
+namespace
+{
+    uint8_t g_frame[fwupd::kFrameSize];
+
+    //synthetic image, the same bytes every run
+    int image_read(void *, size_t off, uint8_t *p, size_t len)
+    {
+        for(size_t i = 0; i < len; ++i)
+            p[i] = uint8_t((off + i) * 31 + ((off + i) >> 8));
+        return 0;
+    }
+
+    //fails from byte 'ctx' on
+    int failing_read(void *ctx, size_t off, uint8_t *p, size_t len)
+    {
+        if (off + len > (size_t)(uintptr_t)ctx)
+            return -EIO;
+        return image_read(nullptr, off, p, len);
+    }
+
+    //what the bootloader should end up with: whole blocks, padded
+    uint32_t image_crc(size_t size)
+    {
+        uint8_t buf[fwupd::kBlockSize];
+        uint32_t crc = 0;
+        for(size_t off = 0; off < size; off += sizeof(buf))
+        {
+            std::fill(std::begin(buf), std::end(buf), fwupd::kPad);
+            image_read(nullptr, off, buf, std::min(sizeof(buf), size - off));
+            crc = crc32_ieee_update(crc, buf, sizeof(buf));
+        }
+        return crc;
+    }
+
+    struct line_t
+    {
+        device d{"sim"};
+        uart::Channel c{&d};
+        uint8_t ring[32];
+        std::optional<fwupd::SimBootloader> boot;
+
+        line_t(uint32_t nakEvery = 0)
+        {
+            c.SetDefaultWait(100);
+            CHECK((bool)c.Configure());
+            boot.emplace(c.GetTransport(), nakEvery);
+            CHECK((bool)c.StartContinuousReading(ring, sizeof(ring)));
+        }
+
+        void Reset()
+        {
+            static const uint8_t kReset[] = "resetSystem 1\r\n";
+            CHECK((bool)c.Send(kReset, sizeof(kReset) - 1));
+        }
+    };
+
+    void whole_image()
+    {
+        line_t l;
+        l.Reset();
+        constexpr size_t kSize = 5000;
+        uint32_t calls = 0;
+        fwupd::Uploader up(l.c, g_frame);
+        auto r = up.Run({.size = kSize, .read = image_read, .ctx = nullptr}
+                , [](void *ctx, fwupd::progress_t const&){ ++*(uint32_t*)ctx; }, &calls);
+        CHECK((bool)r);
+        CHECK(r->bytes == kSize && r->total == kSize && r->blocks == 5 && r->resends == 0);
+        CHECK(calls == 5);
+        CHECK(l.boot->Done() && l.boot->Bytes() == 5 * fwupd::kBlockSize);
+        CHECK(l.boot->Crc32() == image_crc(kSize));
+    }
+
+    void naked_blocks_are_resent()
+    {
+        line_t l(2);
+        l.Reset();
+        constexpr size_t kSize = 8 * fwupd::kBlockSize;
+        fwupd::Uploader up(l.c, g_frame);
+        auto r = up.Run({.size = kSize, .read = image_read, .ctx = nullptr});
+        CHECK((bool)r);
+        CHECK(r->blocks == 8 && r->resends == l.boot->Naks() && r->resends == 4);
+        CHECK(l.boot->Done() && l.boot->Crc32() == image_crc(kSize));
+    }
+
+    void source_error_cancels()
+    {
+        line_t l;
+        l.Reset();
+        fwupd::Uploader up(l.c, g_frame);
+        auto r = up.Run({.size = 4 * fwupd::kBlockSize, .read = failing_read, .ctx = (void*)(2 * fwupd::kBlockSize)});
+        CHECK(!r && r.error().site == err::site_t::FwSourceRead && r.error().Code() == -EIO);
+        //two blocks in, then CAN: the receiver gave up on the image
+        CHECK(!l.boot->Done() && l.boot->Bytes() == 2 * fwupd::kBlockSize);
+    }
+
+    void no_bootloader_times_out()
+    {
+        line_t l;
+        fwupd::Uploader up(l.c, g_frame);
+        auto r = up.Run({.size = 1000, .read = image_read, .ctx = nullptr});
+        CHECK(!r && r.error().site == err::site_t::FwStartTimeout);
+        CHECK(host::g_now_ms >= fwupd::Uploader::kStartWait);
+        CHECK(l.boot->Bytes() == 0);
+    }
+
+    void through_the_sensor()
+    {
+        device d{"sim"};
+        dfr::C4001 dev{&d};
+        host::SimSensor app(dev.GetTransport());
+        CHECK((bool)dev.Init());
+        //takes the line over from the application
+        fwupd::SimBootloader boot(dev.GetTransport());
+        CHECK((bool)dev.EnterBootloader());
+        constexpr size_t kSize = 3 * fwupd::kBlockSize + 17;
+        fwupd::Uploader up(dev, g_frame);
+        auto r = up.Run({.size = kSize, .read = image_read, .ctx = nullptr});
+        CHECK((bool)r && r->blocks == 4);
+        CHECK(boot.Done() && boot.Crc32() == image_crc(kSize));
+    }
+}
+
+int main()
+{
+    RUN(whole_image);
+    RUN(naked_blocks_are_resent);
+    RUN(source_error_cancels);
+    RUN(no_bootloader_times_out);
+    RUN(through_the_sensor);
+    return host::result();
+}
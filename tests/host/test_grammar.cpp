@@ -0,0 +1,104 @@
+#include "host_test.h"
+#include "lib_reply_grammar.h"
+#include <cstring>
+#include <string_view>
+
+//grammar:: parsers on whole replies: well-formed, out of range, 'Error',
+//overlong, noise ahead
+
+using namespace grammar;
+
+namespace
+{
+    struct cfg_t
+    {
+        float lo = -1, hi = -1;
+        uint8_t sens = 0;
+        char ver[12]{};
+    };
+
+    constexpr auto kRange = find<"getRange"> >> find<"Response ">
+        >> num<&cfg_t::lo, 6, 250, 10> >> ws >> num<&cfg_t::hi, 6, 250, 10> >> crlf >> done_or_error;
+    constexpr auto kSens = find<"getSensitivity"> >> find<"Response ">
+        >> num<&cfg_t::sens, 0, 9> >> crlf >> done_or_error;
+    constexpr auto kVer = find<"SoftwareVersion:"> >> text<&cfg_t::ver> >> crlf >> done_or_error;
+
+    //the result of feeding all of 's' (More if it ran out before the end)
+    template<class G>
+    constexpr step_t parse(G, std::string_view s, cfg_t &c)
+    {
+        auto p = G::parser();
+        for(char ch : s)
+            if (auto r = p.Feed((uint8_t)ch, c); r != step_t::More)
+                return r;
+        return step_t::More;
+    }
+
+    //the parser works at compile time too
+    static_assert([]{
+        cfg_t c;
+        return parse(kRange, "getRange\r\nResponse 0.6 25.0\r\nDone\r\n", c) == step_t::Done
+            && c.lo == 0.6f && c.hi == 25.f;
+    }());
+    //getRange: 2 floats, 3 KMP matchers, index; small enough for the stack
+    static_assert(sizeof(decltype(kRange)::Parser) <= 32);
+
+    void well_formed()
+    {
+        cfg_t c;
+        CHECK(parse(kRange, "getRange\r\nResponse 1.5 12.0\r\nDone\r\n", c) == step_t::Done);
+        CHECK(c.lo == 1.5f && c.hi == 12.f);
+        CHECK(parse(kSens, "getSensitivity\r\nResponse 7\r\nDone\r\n", c) == step_t::Done && c.sens == 7);
+        CHECK(parse(kVer, "getSWV\r\nSoftwareVersion:V4.2.10\r\nDone\r\n", c) == step_t::Done);
+        CHECK(!strcmp(c.ver, "V4.2.10"));
+        //several spaces, no fraction
+        CHECK(parse(kRange, "getRange\r\nResponse 3   25\r\nDone\r\n", c) == step_t::Done && c.lo == 3.f);
+    }
+
+    void noise_ahead_and_between()
+    {
+        cfg_t c;
+        //a frame still in flight and a partial match of the command ahead of it
+        CHECK(parse(kRange, "$DFHPD,1, , , *\r\ngetRa getRange\r\nResp Response 0.8 9.5\r\n$DF\r\nDone\r\n", c) == step_t::Done);
+        CHECK(c.lo == 0.8f && c.hi == 9.5f);
+    }
+
+    void out_of_range_and_malformed()
+    {
+        cfg_t c;
+        CHECK(parse(kRange, "getRange\r\nResponse 0.5 25.0\r\n", c) == step_t::Fail);
+        CHECK(parse(kRange, "getRange\r\nResponse 0.6 25.01\r\n", c) == step_t::Fail);
+        CHECK(parse(kRange, "getRange\r\nResponse -1 25\r\n", c) == step_t::Fail);
+        CHECK(parse(kRange, "getRange\r\nResponse 1..2 25\r\n", c) == step_t::Fail);
+        CHECK(parse(kRange, "getRange\r\nResponse x\r\n", c) == step_t::Fail);
+        //integers take no fraction
+        CHECK(parse(kSens, "getSensitivity\r\nResponse 7.5\r\n", c) == step_t::Fail);
+        CHECK(parse(kSens, "getSensitivity\r\nResponse 10\r\n", c) == step_t::Fail);
+        //the line must end right after the value
+        CHECK(parse(kSens, "getSensitivity\r\nResponse 7 \r\n", c) == step_t::Fail);
+    }
+
+    void overlong()
+    {
+        cfg_t c;
+        CHECK(parse(kRange, "getRange\r\nResponse 1234567890 25\r\n", c) == step_t::Fail);
+        CHECK(parse(kVer, "getSWV\r\nSoftwareVersion:V4.2.10-long-tail\r\n", c) == step_t::Fail);
+    }
+
+    void error_reply()
+    {
+        cfg_t c;
+        CHECK(parse(kRange, "getRange\r\nResponse 1.0 12.0\r\nError\r\n", c) == step_t::Error);
+        CHECK(parse(kSens, "getSensitivity\r\nResponse 3\r\nError\r\n", c) == step_t::Error);
+    }
+}
+
+int main()
+{
+    RUN(well_formed);
+    RUN(noise_ahead_and_between);
+    RUN(out_of_range_and_malformed);
+    RUN(overlong);
+    RUN(error_reply);
+    return host::result();
+}
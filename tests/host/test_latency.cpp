@@ -0,0 +1,229 @@
+#include "host_test.h"
+#include "lib_spsc_ring.h"
+#include "lib_latency_hist.h"
+#include "presence_filter.hpp"
+#include "occupancy_fsm.hpp"
+#include <atomic>
+#include <vector>
+
+//The presence pin fast path of src/main.cpp on the simulated clock: ISR ->
+//edge ring -> zigbee callback (presence_triggered/drain_presence_edges) ->
+//presence filter -> occupancy -> on/off command (send_on_off) -> its APS
+//confirm (on_on_off_confirm), with the metrics::presence_t histograms.
+//The budget covers the device up to the command handed to the stack, the
+//radio and the APS ack are not part of it: their time is simulated.
+
+namespace
+{
+    //ZBOSS app callback latency assumed for the budget
+    constexpr int64_t kCallbackMs = 2;
+    //pin edge -> on/off command, glitch filter off
+    constexpr int64_t kBudgetMs = 5;
+    //command handed to the stack -> APS confirm, simulated
+    constexpr int64_t kAckMs = 20;
+
+    struct edge_t
+    {
+        int64_t ticks;
+        uint8_t level;
+    };
+
+    struct sent_t
+    {
+        int64_t t;
+        int val;
+    };
+
+    struct path_t
+    {
+        SPSCRing<edge_t, 16> edges;
+        std::atomic<bool> drain_scheduled{false};
+        presence::filter_t filter;
+        occupancy::fsm_t occupancy;
+        LatencyHist edge_to_send;
+        LatencyHist send_to_ack;
+        LatencyHist edge_to_ack;
+        int64_t edge_at = 0;
+        int64_t ack_ms = kAckMs;
+        //aps_buf/aps_edge_cycles/aps_sent_cycles, buffers numbered from 1
+        uint32_t next_buf = 0;
+        uint32_t aps_buf = 0;
+        int64_t aps_edge = 0;
+        int64_t aps_sent = 0;
+        std::vector<sent_t> sent;
+        //a newer alarm/timer start cancels the pending one
+        uint32_t presence_alarm = 0;
+        uint32_t occupancy_timer = 0;
+
+        path_t(presence::filter_t::cfg_t const& f, occupancy::fsm_t::cfg_t const& o)
+        {
+            filter.SetConfig(f);
+            filter.Reset(0, 0);
+            occupancy.SetConfig(o);
+            occupancy.Reset(false, 0);
+        }
+
+        //presence_triggered
+        void Edge(uint8_t level)
+        {
+            edges.Push({host::g_now_ms, level});
+            if (!drain_scheduled.exchange(true))
+                host::after(kCallbackMs, [this]{ Drain(); });
+        }
+
+        //drain_presence_edges
+        void Drain()
+        {
+            drain_scheduled = false;
+            edge_t e;
+            while(edges.Pop(e))
+            {
+                filter.OnEdge(e.level, e.ticks);
+                edge_at = e.ticks;
+            }
+            EvaluatePresence();
+        }
+
+        //evaluate_presence
+        void EvaluatePresence()
+        {
+            uint32_t gen = ++presence_alarm;
+            int64_t now = host::g_now_ms;
+            if (int l = filter.Evaluate(now); l != presence::filter_t::kNone)
+            {
+                occupancy.OnPin(l == 1, now);
+                EvaluateOccupancy(true);
+            }
+            if (auto d = filter.Deadline(); d != presence::filter_t::kNoDeadline)
+                host::after(d - now, [this, gen]{ if (gen == presence_alarm) EvaluatePresence(); });
+        }
+
+        //evaluate_occupancy
+        void EvaluateOccupancy(bool pinEdge)
+        {
+            uint32_t gen = ++occupancy_timer;
+            int64_t now = host::g_now_ms;
+            if (int o = occupancy.Evaluate(now); o != occupancy::fsm_t::kNone)
+                Send(o, pinEdge);
+            if (auto d = occupancy.Deadline(); d != occupancy::fsm_t::kNoDeadline)
+                host::after(std::max<int64_t>(d - now, 0), [this, gen]{ if (gen == occupancy_timer) EvaluateOccupancy(false); });
+        }
+
+        //send_on_off
+        void Send(int val, bool pinEdge)
+        {
+            sent.push_back({host::g_now_ms, val});
+            uint32_t buf = ++next_buf;
+            host::after(ack_ms, [this, buf]{ Confirm(buf); });
+            if (pinEdge)
+            {
+                edge_to_send.Add(uint32_t(host::g_now_ms - edge_at) * 1000);
+                aps_buf = buf;
+                aps_edge = edge_at;
+                aps_sent = host::g_now_ms;
+            }
+        }
+
+        //on_on_off_confirm
+        void Confirm(uint32_t buf)
+        {
+            if (aps_buf != buf)
+                return;
+            aps_buf = 0;
+            send_to_ack.Add(uint32_t(host::g_now_ms - aps_sent) * 1000);
+            edge_to_ack.Add(uint32_t(host::g_now_ms - aps_edge) * 1000);
+        }
+
+        void RunFor(int64_t ms)
+        {
+            int64_t end = host::g_now_ms + ms;
+            host::run_until(end, []{ return false; });
+            host::g_now_ms = end;
+        }
+    };
+
+    void edge_to_send_within_budget()
+    {
+        path_t p({}, {});
+        for(int i = 0; i < 20; ++i)
+        {
+            p.Edge(1);
+            p.RunFor(500 + 37 * i);
+            p.Edge(0);
+            p.RunFor(700);
+        }
+        CHECK(p.sent.size() == 40);
+        CHECK(p.edge_to_send.m_Count == 40);
+        CHECK(p.edge_to_send.m_MaxUs <= kBudgetMs * 1000);
+        //the p90 bucket bound is within the budget too
+        CHECK(p.edge_to_send.PercentileUs(90) <= kBudgetMs * 1000);
+        //every command confirmed, the radio adds its own time only
+        CHECK(p.send_to_ack.m_Count == 40 && p.send_to_ack.m_MaxUs == kAckMs * 1000);
+        CHECK(p.edge_to_ack.m_Count == 40 && p.edge_to_ack.m_MaxUs <= (kBudgetMs + kAckMs) * 1000);
+    }
+
+    //a command sent before the confirm of the previous one takes over the
+    //timing: the late confirm isn't put on the newer edge
+    void newer_command_takes_over_the_ack_timing()
+    {
+        path_t p({}, {});
+        p.ack_ms = 300;
+        p.Edge(1);
+        p.RunFor(100);
+        p.Edge(0);
+        p.RunFor(1000);
+        CHECK(p.sent.size() == 2);
+        CHECK(p.edge_to_send.m_Count == 2);
+        CHECK(p.send_to_ack.m_Count == 1 && p.send_to_ack.m_LastUs == 300 * 1000);
+        CHECK(p.edge_to_ack.m_Count == 1 && p.edge_to_ack.m_LastUs == (kCallbackMs + 300) * 1000);
+    }
+
+    //the glitch filter is the only thing allowed on top of the callback
+    void glitch_filter_adds_the_glitch_only()
+    {
+        constexpr int64_t kGlitch = 50;
+        path_t p({.glitch = kGlitch}, {});
+        p.Edge(1);
+        p.RunFor(1000);
+        CHECK(p.sent.size() == 1 && p.sent[0].val == 1);
+        CHECK(p.edge_to_send.m_LastUs == kGlitch * 1000);
+        CHECK(p.edge_to_send.m_MaxUs <= (kGlitch + kBudgetMs) * 1000);
+    }
+
+    //a bouncing pin drained in one callback sends one command, not three
+    void bounce_sends_once()
+    {
+        path_t p({}, {});
+        p.Edge(1);
+        p.Edge(0);
+        p.Edge(1);
+        p.RunFor(100);
+        CHECK(p.sent.size() == 1 && p.sent[0].val == 1 && p.sent[0].t <= kBudgetMs);
+    }
+
+    //clearing waits for the occupancy hold, then one callback at most
+    void clear_after_the_hold()
+    {
+        constexpr int64_t kHold = 300;
+        path_t p({}, {.hold = kHold});
+        p.Edge(1);
+        p.RunFor(1000);
+        int64_t low = host::g_now_ms;
+        p.Edge(0);
+        p.RunFor(1000);
+        CHECK(p.sent.size() == 2 && p.sent[1].val == 0);
+        CHECK(p.sent.size() == 2 && p.sent[1].t - low <= kHold + kBudgetMs);
+        //the deadline clear isn't a pin edge transition
+        CHECK(p.edge_to_send.m_Count == 1);
+    }
+}
+
+int main()
+{
+    RUN(edge_to_send_within_budget);
+    RUN(newer_command_takes_over_the_ack_timing);
+    RUN(glitch_filter_adds_the_glitch_only);
+    RUN(bounce_sends_once);
+    RUN(clear_after_the_hold);
+    return host::result();
+}
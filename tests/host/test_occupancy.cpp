@@ -0,0 +1,248 @@
+#include "host_test.h"
+#include "lib_dfr_c4001_frames.h"
+#include "lib_spsc_ring.h"
+#include "occupancy_fsm.hpp"
+#include <cstring>
+#include <vector>
+
+//occupancy::fsm_t on replayed traces: sensor output goes through the frame
+//decoder and the frame ring the way the c4001 worker hands it to zigbee
+//(src/main.cpp, on_c4001_frame/zb_c4001_frame): stamped when decoded,
+//judged by that time however late zigbee gets to them; the pin is fed filtered
+
+using frame_t = dfr::frames::frame_t;
+using kind_t = dfr::frames::kind_t;
+using fsm_t = occupancy::fsm_t;
+
+namespace
+{
+    //one line of a trace: sensor output, "pin 0"/"pin 1" or "drain"
+    //(the zigbee callback running)
+    struct step_t
+    {
+        int64_t t;
+        const char *what;
+    };
+
+    //as src/main.cpp queues them
+    struct timed_frame_t
+    {
+        frame_t f;
+        int64_t at;
+    };
+
+    struct report_t
+    {
+        int64_t t;
+        int occupied;
+    };
+
+    struct room_t
+    {
+        fsm_t fsm;
+        dfr::frames::Decoder dec;
+        SPSCRing<timed_frame_t, 8> frames;
+        uint32_t dropped = 0;
+        std::vector<report_t> reports;
+
+        explicit room_t(fsm_t::cfg_t const& c)
+        {
+            fsm.SetConfig(c);
+            fsm.Reset(false, 0);
+        }
+
+        //c4001 worker: decode, stamp and queue
+        void Receive(const char *line, int64_t now)
+        {
+            for(const char *p = line; *p; ++p)
+            {
+                if (dec.Feed(*p) != kind_t::None && !frames.Push({dec.Frame(), now}))
+                    ++dropped;
+            }
+        }
+
+        //zigbee: every queued frame, then one evaluation
+        void Drain(int64_t now)
+        {
+            timed_frame_t tf;
+            while(frames.Pop(tf))
+            {
+                if (tf.f.kind == kind_t::Presence)
+                    fsm.OnPresenceFrame(tf.f.present, tf.at);
+                else if (tf.f.kind == kind_t::Target)
+                    fsm.OnTargetFrame(tf.f.targets, tf.f.range, tf.at);
+            }
+            Evaluate(now);
+        }
+
+        void Pin(bool level, int64_t now)
+        {
+            fsm.OnPin(level, now);
+            Evaluate(now);
+        }
+
+        void Evaluate(int64_t now)
+        {
+            if (int o = fsm.Evaluate(now); o != fsm_t::kNone)
+                reports.push_back({now, o});
+        }
+
+        //the occupancy timer: fires at every deadline up to 'until'
+        void RunUntil(int64_t until)
+        {
+            while(fsm.Deadline() <= until)
+                Evaluate(fsm.Deadline());
+        }
+
+        template<size_t N>
+        void Replay(step_t const (&trace)[N])
+        {
+            for(auto const& s : trace)
+            {
+                RunUntil(s.t);
+                if (!strcmp(s.what, "pin 1"))
+                    Pin(true, s.t);
+                else if (!strcmp(s.what, "pin 0"))
+                    Pin(false, s.t);
+                else if (!strcmp(s.what, "drain"))
+                    Drain(s.t);
+                else
+                    Receive(s.what, s.t);
+            }
+        }
+
+        bool Reported(std::initializer_list<report_t> expected) const
+        {
+            if (reports.size() != expected.size())
+                return false;
+            size_t i = 0;
+            for(auto const& e : expected)
+            {
+                if (reports[i].t != e.t || reports[i].occupied != e.occupied)
+                    return false;
+                ++i;
+            }
+            return true;
+        }
+    };
+
+    constexpr fsm_t::cfg_t kCfg{.hold = 1000, .frame_ttl = 1500, .min_target_frames = 3, .trig_range = 3.f};
+
+    constexpr const char kNear[] = "$DFDMD,1,1,1.20,0.00,800, , *\r\n";
+    constexpr const char kFar[] = "$DFDMD,1,1,6.50,0.00,800, , *\r\n";
+    constexpr const char kEmpty[] = "$DFDMD,0,0,0,0,0, , *\r\n";
+
+    void pin_alone()
+    {
+        room_t r(kCfg);
+        constexpr step_t kTrace[] = {
+            {100, "pin 1"},
+            {2100, "pin 0"},
+            {5000, "drain"},
+        };
+        r.Replay(kTrace);
+        CHECK(r.Reported({{100, 1}, {3100, 0}}));
+    }
+
+    //the pin gives up on somebody sitting still, the radar still sees them
+    void seated_person_stays_occupied()
+    {
+        room_t r(kCfg);
+        r.Pin(true, 0);
+        for(int64_t t = 100; t <= 6000; t += 100)
+        {
+            r.RunUntil(t);
+            r.Receive(kNear, t);
+            r.Drain(t);
+            if (t == 1000)
+                r.Pin(false, t);
+        }
+        r.RunUntil(20000);
+        //the last frame counts for frame_ttl, then the hold
+        CHECK(r.Reported({{0, 1}, {6000 + 1500 + 1000, 0}}));
+    }
+
+    //frames queued between two zigbee callbacks are all looked at: three
+    //target frames in a row are three, not one
+    void target_frames_count_in_a_row()
+    {
+        room_t r(kCfg);
+        constexpr step_t kTrace[] = {
+            {100, kNear},
+            {200, kNear},
+            {300, "drain"},
+            {400, kNear},
+            {500, "drain"},
+        };
+        r.Replay(kTrace);
+        CHECK(r.Reported({{500, 1}}));
+
+        //a frame without targets breaks the run
+        room_t broken(kCfg);
+        constexpr step_t kBroken[] = {
+            {100, kNear},
+            {200, kEmpty},
+            {300, kNear},
+            {400, kNear},
+            {500, "drain"},
+        };
+        broken.Replay(kBroken);
+        CHECK(broken.reports.empty());
+    }
+
+    //a presence frame followed by target frames before zigbee gets to them
+    void presence_frame_is_not_overwritten()
+    {
+        room_t r(kCfg);
+        constexpr step_t kTrace[] = {
+            {100, "$DFHPD,1, , , *\r\n"},
+            {200, kFar},
+            {300, kFar},
+            {400, "drain"},
+            {10000, "drain"},
+        };
+        r.Replay(kTrace);
+        CHECK(r.Reported({{400, 1}, {100 + 1500 + 1000, 0}}));
+    }
+
+    //zigbee busy for a while: the frames still count from when they came,
+    //the clear isn't pushed out by the delay
+    void late_drain_keeps_frame_time()
+    {
+        room_t r(kCfg);
+        constexpr step_t kTrace[] = {
+            {0, "pin 1"},
+            {200, kNear},
+            {300, kNear},
+            {400, kNear},
+            {1000, "pin 0"},
+            {1500, "drain"},
+            {10000, "drain"},
+        };
+        r.Replay(kTrace);
+        CHECK(r.Reported({{0, 1}, {400 + 1500 + 1000, 0}}));
+    }
+
+    void full_ring_counts_drops()
+    {
+        room_t r(kCfg);
+        for(int i = 0; i < 10; ++i)
+            r.Receive(kFar, 0);
+        CHECK(r.dropped == 2);
+        r.Drain(100);
+        r.Receive("$DFHPD,1, , , *\r\n", 150);
+        r.Drain(200);
+        CHECK(r.dropped == 2 && r.Reported({{200, 1}}));
+    }
+}
+
+int main()
+{
+    RUN(pin_alone);
+    RUN(seated_person_stays_occupied);
+    RUN(target_frames_count_in_a_row);
+    RUN(presence_frame_is_not_overwritten);
+    RUN(late_drain_keeps_frame_time);
+    RUN(full_ring_counts_drops);
+    return host::result();
+}
@@ -0,0 +1,144 @@
+#include "host_test.h"
+#include "sim_sensor.h"
+#include "lib_dfr_c4001.h"
+#include "frame_use.hpp"
+
+//UART power on the memory transport: with nothing streaming the sensor
+//UART suspends once idle for SetIdleSuspend, the next request resumes it;
+//the counters are what native_sim reports for a setup without frame use
+
+using C4001 = dfr::C4001;
+
+namespace
+{
+    //C4001_UART_IDLE_MS, and the stream slice of the worker (kStreamSliceMs)
+    constexpr int64_t kIdleMs = 2000;
+    constexpr int64_t kSliceMs = 1000;
+
+    struct sensor_t
+    {
+        device d{"sim"};
+        C4001 dev{&d};
+        host::SimSensor sim{dev.GetTransport()};
+
+        sensor_t() { dev.SetIdleSuspend(kIdleMs); }
+    };
+
+    int frames(C4001 &dev)
+    {
+        int n = 0;
+        C4001::FrameStream s(dev);
+        while(true)
+        {
+            auto r = s.Poll([&](dfr::frames::frame_t const&){ ++n; }, 0);
+            if (!r || !r->v)
+                break;
+        }
+        return n;
+    }
+
+    void suspends_when_idle()
+    {
+        sensor_t t;
+        CHECK((bool)t.dev.Init());
+        CHECK(t.dev.IsAwake());
+        int64_t due = t.dev.IdleDeadline();
+        CHECK(due == host::g_now_ms + kIdleMs);
+        CHECK(!t.dev.SuspendIfIdle(due - 1));
+        CHECK(t.dev.IsAwake());
+        host::g_now_ms = due;
+        CHECK(t.dev.SuspendIfIdle(due));
+        CHECK(!t.dev.IsAwake());
+        CHECK(t.dev.IdleDeadline() == C4001::kNoDeadline);
+
+        auto p = t.dev.GetPowerStats(due + 5000);
+        CHECK(p.m_Resumes == 1 && p.m_Suspends == 1 && p.m_Failures == 0);
+        CHECK(p.m_ActiveMs == due);
+    }
+
+    void output_is_lost_while_suspended()
+    {
+        sensor_t t;
+        CHECK((bool)t.dev.Init());
+        host::g_now_ms = t.dev.IdleDeadline();
+        CHECK(t.dev.SuspendIfIdle(host::g_now_ms));
+        t.sim.Frame("$DFHPD,1, , , *");
+
+        //the next request resumes the UART and continuous reading with it
+        host::g_now_ms += 10000;
+        CHECK((bool)t.dev.Probe());
+        CHECK(t.dev.IsAwake());
+        auto p = t.dev.GetPowerStats(host::g_now_ms);
+        CHECK(p.m_Resumes == 2 && p.m_Suspends == 1 && p.m_Failures == 0);
+        CHECK(frames(t.dev) == 0);
+
+        t.sim.Frame("$DFHPD,1, , , *");
+        CHECK(frames(t.dev) == 1);
+    }
+
+    void streaming_holds_it_awake()
+    {
+        sensor_t t;
+        CHECK((bool)t.dev.Init());
+        {
+            C4001::FrameStream s(t.dev);
+            CHECK(t.dev.IdleDeadline() == C4001::kNoDeadline);
+            host::g_now_ms += 10 * kIdleMs;
+            CHECK(!t.dev.SuspendIfIdle(host::g_now_ms));
+        }
+        //idle from the end of the stream on
+        CHECK(t.dev.IdleDeadline() == host::g_now_ms + kIdleMs);
+        auto p = t.dev.GetPowerStats(host::g_now_ms);
+        CHECK(p.m_Resumes == 1 && p.m_Suspends == 0);
+        CHECK(p.m_ActiveMs == host::g_now_ms);
+    }
+
+    //the worker for one sensor with no requests (on_stream_work, on_idle_work):
+    //streams it slice by slice while its frames are wanted, otherwise leaves
+    //the UART to its idle deadline
+    void run_idle(sensor_t &t, frame_use::cfg_t const& use, int64_t ms)
+    {
+        int64_t end = host::g_now_ms + ms;
+        while(host::g_now_ms < end)
+        {
+            if (frame_use::wanted(use))
+            {
+                C4001::FrameStream s(t.dev);
+                host::g_now_ms += kSliceMs;
+            }
+            else
+                host::g_now_ms += kSliceMs;
+            (void)t.dev.SuspendIfIdle(host::g_now_ms);
+        }
+    }
+
+    //a fresh device (no zones, no approach lead, no target reports) goes by
+    //the pin: nothing streams and the UART suspends once setup is done with it
+    void default_config_suspends()
+    {
+        CHECK(!frame_use::wanted({}));
+        sensor_t t;
+        CHECK((bool)t.dev.Init());
+        int64_t start = host::g_now_ms;
+        run_idle(t, {}, 10 * kIdleMs);
+        CHECK(!t.dev.IsAwake());
+        auto p = t.dev.GetPowerStats(host::g_now_ms);
+        CHECK(p.m_Suspends == 1 && p.m_ActiveMs <= kIdleMs + kSliceMs);
+        CHECK(host::g_now_ms - start - p.m_ActiveMs >= 8 * kIdleMs);
+
+        //target reports turned on: streamed, never suspended
+        sensor_t r;
+        CHECK((bool)r.dev.Init());
+        run_idle(r, {.target_report_interval = 1000}, 10 * kIdleMs);
+        CHECK(r.dev.IsAwake() && r.dev.GetPowerStats(host::g_now_ms).m_Suspends == 0);
+    }
+}
+
+int main()
+{
+    RUN(suspends_when_idle);
+    RUN(output_is_lost_while_suspended);
+    RUN(streaming_holds_it_awake);
+    RUN(default_config_suspends);
+    return host::result();
+}
@@ -0,0 +1,108 @@
+#include "host_test.h"
+#include "lib_uart.h"
+#include "lib_uart_primitives.h"
+#include <cstring>
+#include <string_view>
+
+//uart::primitives on a continuously reading Channel fed by the test
+
+using namespace uart;
+using namespace uart::primitives;
+
+namespace
+{
+    struct channel_t
+    {
+        device d{"sim"};
+        Channel c{&d};
+        uint8_t ring[128];
+
+        channel_t()
+        {
+            c.SetDefaultWait(50);
+            CHECK((bool)c.Configure());
+            CHECK((bool)c.StartContinuousReading(ring, sizeof(ring)));
+        }
+        ~channel_t() { c.StopContinuousReading(); }
+
+        void feed(std::string_view s) { c.GetTransport().Feed((const uint8_t *)s.data(), s.size()); }
+    };
+
+    //zero terminated, as match_any_bytes_term expects with term 0
+    template<size_t N>
+    std::span<const uint8_t> bytes(const char (&s)[N]) { return {(const uint8_t *)s, N}; }
+
+    void match_bytes_exact_and_mismatch()
+    {
+        channel_t t;
+        t.feed("Done\r\nDona");
+        CHECK((bool)match_bytes(t.c, "Done\r\n"));
+        auto r = match_bytes(t.c, "Done");
+        CHECK(!r && r.error().site == err::site_t::MatchBytes);
+        //runs out of input: the read times out
+        auto r2 = match_bytes(t.c, "xyz");
+        CHECK(!r2 && r2.error().Code() == -EAGAIN);
+    }
+
+    void match_any_bytes_term_picks_the_sequence()
+    {
+        channel_t t;
+        t.feed("Error\r\n");
+        auto r = match_any_bytes_term(t.c, 0, bytes("Done\r\n"), bytes("Error\r\n"));
+        CHECK(r && r->v == 1);
+        t.feed("Dxne");
+        auto r2 = match_any_bytes_term(t.c, 0, bytes("Done"), bytes("Error"));
+        CHECK(!r2 && r2.error().site == err::site_t::MatchAnyBytesTerm);
+    }
+
+    void find_any_str_skips_noise()
+    {
+        channel_t t;
+        t.feed("$DFHPD,1, , , *\r\nsetRange 1 2\r\nDoErrDone\r\n");
+        auto r = find_any_str({}, t.c, "Done\r\n", "Error\r\n");
+        CHECK(r && r->v == 0);
+        //late reply within the wait
+        host::after(20, [&]{ t.feed("Error\r\n"); });
+        auto r2 = find_any_str({}, t.c, "Done\r\n", "Error\r\n");
+        CHECK(r2 && r2->v == 1);
+        //none at all
+        auto r3 = find_any_str({.maxWait = 30}, t.c, "Done\r\n", "Error\r\n");
+        CHECK(!r3);
+    }
+
+    void read_until_into_stops_at_the_terminator()
+    {
+        channel_t t;
+        t.feed("V4.2.10\r\nrest");
+        uint8_t buf[16]{};
+        CHECK((bool)read_until_into(t.c, '\r', buf, sizeof(buf), true, {}));
+        CHECK(!strcmp((const char *)buf, "V4.2.10"));
+        auto b = t.c.ReadByte(0);
+        CHECK(b && b->v == '\n');
+        //no room for what comes before the terminator
+        uint8_t small[2];
+        auto r = read_until_into(t.c, '\r', small, sizeof(small), true, {});
+        CHECK(!r && r.error().site == err::site_t::ReadUntilIntoSize);
+    }
+
+    void find_bytes_across_late_chunks()
+    {
+        channel_t t;
+        t.feed("noise Resp");
+        host::after(10, [&]{ t.feed("onse 1\r\n"); });
+        CHECK((bool)find_bytes(t.c, "Response "));
+        uint8_t buf[4]{};
+        CHECK((bool)read_until_into(t.c, '\r', buf, sizeof(buf), false, {}));
+        CHECK(buf[0] == '1');
+    }
+}
+
+int main()
+{
+    RUN(match_bytes_exact_and_mismatch);
+    RUN(match_any_bytes_term_picks_the_sequence);
+    RUN(find_any_str_skips_noise);
+    RUN(read_until_into_stops_at_the_terminator);
+    RUN(find_bytes_across_late_chunks);
+    return host::result();
+}
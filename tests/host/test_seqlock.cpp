@@ -0,0 +1,89 @@
+#include "host_test.h"
+#include "lib_seqlock.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//SeqLocked under real threads: one writer, several readers that must only
+//ever see whole values and versions that don't go back
+
+namespace
+{
+    //every field carries the same number: a torn copy mixes two
+    struct value_t
+    {
+        uint32_t n[16];
+    };
+
+    value_t make(uint32_t n)
+    {
+        value_t v;
+        for(auto &x : v.n)
+            x = n;
+        return v;
+    }
+
+    void store_reports_changes()
+    {
+        SeqLocked<value_t> s(make(1));
+        CHECK(s.Version() == 0);
+        CHECK(!s.Store(make(1)));
+        CHECK(s.Store(make(2)));
+        uint32_t ver;
+        auto v = s.Load(&ver);
+        CHECK(v.n[0] == 2 && ver == 1);
+    }
+
+    void readers_never_see_torn_values()
+    {
+        constexpr uint32_t kWrites = 200000;
+        constexpr int kReaders = 4;
+        SeqLocked<value_t> s(make(0));
+        std::atomic<bool> done{false};
+        std::atomic<uint32_t> torn{0}, backwards{0}, reads{0};
+        std::atomic<int> started{0};
+
+        std::vector<std::thread> readers;
+        for(int i = 0; i < kReaders; ++i)
+            readers.emplace_back([&]{
+                uint32_t last = 0;
+                ++started;
+                while(!done.load(std::memory_order_acquire))
+                {
+                    uint32_t ver;
+                    auto v = s.Load(&ver);
+                    for(auto x : v.n)
+                        if (x != v.n[0])
+                        {
+                            ++torn;
+                            break;
+                        }
+                    //one Store per number: version and value move together
+                    if (ver != v.n[0] || ver < last)
+                        ++backwards;
+                    last = ver;
+                    reads.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+
+        while(started != kReaders)
+            std::this_thread::yield();
+        for(uint32_t i = 1; i <= kWrites; ++i)
+            s.Store(make(i));
+        done.store(true, std::memory_order_release);
+        for(auto &t : readers)
+            t.join();
+
+        CHECK(torn == 0);
+        CHECK(backwards == 0);
+        CHECK(reads > 0);
+        CHECK(s.Version() == kWrites && s.Load().n[0] == kWrites);
+    }
+}
+
+int main()
+{
+    RUN(store_reports_changes);
+    RUN(readers_never_see_torn_values);
+    return host::result();
+}
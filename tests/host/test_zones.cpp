@@ -0,0 +1,113 @@
+#include "host_test.h"
+#include "zone_tracker.hpp"
+#include <algorithm>
+#include <vector>
+
+//zones::zone_t: entering, hysteresis at the edges, and clearing on the
+//deadline whether or not frames keep coming (src/main.cpp, evaluate_zones)
+
+using zone_t = zones::zone_t;
+
+namespace
+{
+    constexpr zone_t::cfg_t kDesk{.from = 1.f, .to = 2.f, .hysteresis = 0.3f, .hold = 2500};
+
+    struct report_t
+    {
+        int64_t t;
+        int occupied;
+    };
+
+    struct zone_run_t
+    {
+        zone_t z;
+        std::vector<report_t> reports;
+
+        explicit zone_run_t(zone_t::cfg_t const& c) { z.SetConfig(c); }
+
+        void Frame(bool hasTarget, float range, int64_t now)
+        {
+            if (int o = z.Update(hasTarget, range, now); o != zone_t::kNone)
+                reports.push_back({now, o});
+        }
+
+        //the zone alarm: fires at every deadline up to 'until'
+        void RunUntil(int64_t until)
+        {
+            while(z.Deadline() <= until)
+            {
+                int64_t t = std::max<int64_t>(z.Deadline(), 0);
+                if (int o = z.Evaluate(t); o != zone_t::kNone)
+                    reports.push_back({t, o});
+            }
+        }
+    };
+
+    void enters_and_leaves()
+    {
+        zone_run_t r(kDesk);
+        r.Frame(true, 3.f, 0);
+        CHECK(r.reports.empty());
+        r.Frame(true, 1.5f, 100);
+        CHECK(r.reports.size() == 1 && r.reports[0].occupied == 1);
+        //walked out: frames keep coming, the zone clears a hold after the last one inside
+        for(int64_t t = 200; t <= 5000; t += 100)
+        {
+            r.RunUntil(t);
+            r.Frame(true, 4.f, t);
+        }
+        CHECK(r.reports.size() == 2 && r.reports[1].t == 100 + 2500 && r.reports[1].occupied == 0);
+    }
+
+    void hysteresis_keeps_it()
+    {
+        zone_run_t r(kDesk);
+        r.Frame(true, 1.9f, 0);
+        //just past 'to', within the hysteresis
+        for(int64_t t = 100; t <= 10000; t += 100)
+        {
+            r.RunUntil(t);
+            r.Frame(true, 2.2f, t);
+        }
+        CHECK(r.reports.size() == 1 && r.z.Occupied());
+        //but not to enter with
+        zone_run_t e(kDesk);
+        e.Frame(true, 2.2f, 0);
+        CHECK(e.reports.empty());
+    }
+
+    //the sensor goes quiet with somebody inside: no frame comes to clear it
+    void silence_clears_on_the_deadline()
+    {
+        zone_run_t r(kDesk);
+        r.Frame(true, 1.5f, 0);
+        r.Frame(true, 1.5f, 100);
+        CHECK(r.z.Deadline() == 100 + 2500);
+        r.RunUntil(2599);
+        CHECK(r.z.Occupied());
+        r.RunUntil(60000);
+        CHECK(!r.z.Occupied() && r.reports.size() == 2 && r.reports[1].t == 2600);
+        CHECK(r.z.Deadline() == zone_t::kNoDeadline);
+    }
+
+    void disabled_clears_right_away()
+    {
+        zone_run_t r(kDesk);
+        r.Frame(true, 1.5f, 0);
+        r.z.SetConfig({});
+        CHECK(r.z.Deadline() <= 0);
+        r.RunUntil(0);
+        CHECK(!r.z.Occupied() && r.reports.size() == 2);
+        r.Frame(true, 1.5f, 100);
+        CHECK(r.reports.size() == 2);
+    }
+}
+
+int main()
+{
+    RUN(enters_and_leaves);
+    RUN(hysteresis_keeps_it);
+    RUN(silence_clears_on_the_deadline);
+    RUN(disabled_clears_right_away);
+    return host::result();
+}
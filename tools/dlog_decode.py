@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Decodes the deferred binary log (src/lib/lib_dlog.h) in a console capture.
+
+The ids are FNV-1a hashes of the format strings, so the table is rebuilt from
+the sources: every DLOG("...") / UART_DIAG("...") literal found under the given
+directories. Lines that are not '#D' records pass through unchanged.
+
+    dlog_decode.py [-s src] < console.log
+"""
+import argparse
+import re
+import struct
+import sys
+from pathlib import Path
+
+CALL = re.compile(r'\b(?:DLOG|UART_DIAG)\(\s*"((?:[^"\\]|\\.)*)"')
+FIELD = re.compile(r'\{\{|\}\}|\{(:[^}]*)?\}')
+
+
+def fnv1a(data: bytes) -> int:
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def unescape(s: str) -> bytes:
+    return s.encode('latin-1').decode('unicode_escape').encode('latin-1')
+
+
+def load_formats(dirs):
+    formats = {}
+    for d in dirs:
+        for p in Path(d).rglob('*'):
+            if p.suffix not in ('.h', '.hpp', '.cpp'):
+                continue
+            for m in CALL.finditer(p.read_text(errors='replace')):
+                fmt = unescape(m.group(1))
+                h = fnv1a(fmt)
+                if h in formats and formats[h] != fmt:
+                    print(f'dlog: id {h:08x} collides: {formats[h]!r} / {fmt!r}', file=sys.stderr)
+                formats[h] = fmt
+    return formats
+
+
+def value(raw: int, t: int):
+    if t == 2:
+        return struct.unpack('<f', struct.pack('<I', raw))[0]
+    if t == 0 and raw & 0x80000000:
+        return raw - (1 << 32)
+    return raw
+
+
+def render(fmt: str, args) -> str:
+    it = iter(args)
+
+    def one(m):
+        tok = m.group(0)
+        if tok in ('{{', '}}'):
+            return tok[0]
+        spec = m.group(1) or ''
+        v = next(it, '?')
+        if spec == ':x':
+            return f'{v:x}' if isinstance(v, int) else str(v)
+        if spec.startswith(':.') and isinstance(v, (int, float)):
+            return f'{float(v):.{int(spec[2:])}f}'
+        return str(v)
+    return FIELD.sub(one, fmt)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('-s', '--src', action='append', help='source directory (default: src next to this script)')
+    ap.add_argument('log', nargs='?', type=argparse.FileType('r', errors='replace'), default=sys.stdin)
+    a = ap.parse_args()
+    formats = load_formats(a.src or [Path(__file__).resolve().parent.parent / 'src'])
+
+    hz = 0
+    for line in a.log:
+        f = line.split()
+        if f[:1] == ['#DH'] and len(f) == 2:
+            hz = int(f[1])
+            continue
+        if f[:1] == ['#DL'] and len(f) == 2:
+            print(f'[dlog] {f[1]} records dropped so far')
+            continue
+        if f[:1] != ['#D'] or len(f) < 4:
+            sys.stdout.write(line)
+            continue
+        rid, cycles, types = int(f[1], 16), int(f[2], 16), int(f[3], 16)
+        args = [value(int(x, 16), (types >> (2 * i)) & 3) for i, x in enumerate(f[4:])]
+        ts = f'{cycles / hz:12.6f}' if hz else f'{cycles:>12}'
+        fmt = formats.get(rid)
+        text = render(fmt.decode('latin-1'), args) if fmt is not None else f'<unknown id {rid:08x}> {args}'
+        print(f'[{ts}] {text}')
+
+
+if __name__ == '__main__':
+    main()
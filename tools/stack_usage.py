@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""Worst case stack of the c4001 worker, from the -fstack-usage output.
+
+The c4001 sources are built with -fstack-usage (CMakeLists.txt), which puts
+a .su file with every function's frame next to each object. This adds up
+the frames along the deepest call chains the worker runs and suggests
+C4001_WQ_STACK_SIZE:
+
+    tools/stack_usage.py build52             # the west build directory
+    tools/stack_usage.py build52 --top 20    # also the biggest frames
+
+Functions inlined into their caller have no .su entry and count 0 (their
+frame is in the caller's). 'kernel' covers k_poll/k_sem_take under the
+last frame and the exception frame an interrupt stacks there (FPU
+context included).
+"""
+import argparse
+import os
+import re
+import sys
+
+# each chain: regexes of the frames on it, outermost first; a layer counts
+# its biggest match (e.g. any of the Configurator setters)
+CHAINS = {
+    'reload config': [r'on_sensor_work', r'next_request', r'handle_request',
+                      r'Configurator::(ResetConfig|ReloadConfig|Restart|Update)', r'C4001::Exchange',
+                      r'C4001::(SendCmd|QueryAttempt)', r'Channel::(ReadSome|Read|Send)\(',
+                      r'Channel::WaitFor'],
+    'calibration': [r'on_sensor_work', r'next_request', r'handle_request', r'run_calibration',
+                    r'C4001::StreamFrames', r'Channel::ReadSome', r'Channel::WaitFor'],
+    'fw update': [r'on_sensor_work', r'next_request', r'handle_request', r'run_fw_update', r'Uploader::Run',
+                  r'Uploader::(Reply|Await)', r'Channel::ReadByte', r'Channel::WaitFor'],
+    # the conversations on the fibers: their frames are in the coroutine frame
+    # pool, on the stack only the one resumed (symmetric transfer) and its calls
+    'coroutine': [r'on_sensor_work|Fiber::on_work', r'next_request|supervise|start_stream|Fiber::Resume',
+                  r'Fiber::(Start|Resume)', r'\.actor', r'FrameStream::Poll|Channel::(ReadAvailable|SendReady)',
+                  r'Channel::(ReadSome|ReadInternal|Tx)', r'Channel::WaitFor'],
+}
+
+
+def load(build):
+    frames = []
+    for root, _, files in os.walk(build):
+        for f in files:
+            if not f.endswith('.su'):
+                continue
+            with open(os.path.join(root, f)) as su:
+                for line in su:
+                    parts = line.rstrip('\n').split('\t')
+                    if len(parts) >= 2 and parts[1].isdigit():
+                        frames.append((parts[0], int(parts[1])))
+    return frames
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('build', help='build directory with the .su files')
+    ap.add_argument('--kernel', type=int, default=232, help='bytes below the last frame (default 232)')
+    ap.add_argument('--margin', type=int, default=25, help='percent on top of the worst chain (default 25)')
+    ap.add_argument('--top', type=int, default=0, help='also list the N biggest frames')
+    args = ap.parse_args()
+
+    frames = load(args.build)
+    if not frames:
+        sys.exit(f'no .su files under {args.build}')
+
+    worst = 0
+    for name, layers in CHAINS.items():
+        total = args.kernel
+        parts = []
+        for layer in layers:
+            rx = re.compile(layer)
+            size = max((s for fn, s in frames if rx.search(fn)), default=0)
+            parts.append(f'{layer}={size}')
+            total += size
+        worst = max(worst, total)
+        print(f'{name:13} {total:5} B  ' + ' '.join(parts) + f' kernel={args.kernel}')
+
+    suggested = (worst * (100 + args.margin) // 100 + 63) // 64 * 64
+    print(f'worst chain {worst} B, C4001_WQ_STACK_SIZE >= {suggested} with {args.margin}% margin')
+
+    if args.top:
+        print()
+        for fn, s in sorted(frames, key=lambda x: -x[1])[:args.top]:
+            print(f'{s:6}  {fn}')
+
+
+if __name__ == '__main__':
+    main()
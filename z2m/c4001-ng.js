@@ -1,7 +1,7 @@
 const { Buffer } = require('node:buffer');
 const util = require('node:util');
 const {Zcl} = require('zigbee-herdsman');
-const {enumLookup,numeric,deviceAddCustomCluster,onOff,binary,occupancy} = require('zigbee-herdsman-converters/lib/modernExtend');
+const {enumLookup,numeric,deviceAddCustomCluster,deviceEndpoints,onOff,binary,occupancy} = require('zigbee-herdsman-converters/lib/modernExtend');
 const fz = require('zigbee-herdsman-converters/converters/fromZigbee');
 const tz = require('zigbee-herdsman-converters/converters/toZigbee');
 const exposes = require('zigbee-herdsman-converters/lib/exposes');
@@ -17,9 +17,32 @@ const ea = exposes.access;
 
 const NS = 'zhc:orlangur';
 
+//one endpoint per sensor ('dfr,c4001' node), each followed by its zone endpoints;
+//the firmware numbers them the same way (main.cpp, sensor_ep/zone_ep)
+const kSensorEndpoints = {main: 1, sensor2: 5};
+const kZonesPerSensor = 3;
+const zoneEndpoints = () => {
+    const eps = {};
+    Object.values(kSensorEndpoints).forEach((ep, s) => {
+        for (let i = 0; i < kZonesPerSensor; ++i)
+            eps[`zone${s * kZonesPerSensor + i + 1}`] = ep + 1 + i;
+    });
+    return eps;
+};
+const isSensorEndpoint = (msg) => Object.values(kSensorEndpoints).includes(msg.endpoint.ID);
+//the first sensor keeps the plain names, the others get their endpoint appended
+const sensorKey = (attr, msg, model, meta) =>
+    msg.endpoint.ID === kSensorEndpoints.main ? attr : utils.postfixWithEndpointName(attr, msg, model, meta);
+//exposes of the first sensor, repeated for the endpoint of each other one
+const forEverySensor = (exposes) => [
+    ...exposes(),
+    ...Object.keys(kSensorEndpoints).filter((name) => name !== 'main')
+        .flatMap((name) => exposes().map((x) => x.withEndpoint(name))),
+];
+
 const orlangurC4001Extended = {
     c4001Config: () => {
-        const exposes = [
+        const exposes = forEverySensor(() => [
             e.numeric('range_min', ea.ALL)
                 .withLabel('Range From')
                 .withValueMin(0.6)
@@ -70,8 +93,135 @@ const orlangurC4001Extended = {
             e.enum("cmd_restart", ea.SET, ["Restart"])
                 .withDescription("Restart C4001")
                 .withCategory("config"),
-        ];
-        const attributes = ['range_min', 'range_max', 'range_trig', 'inhibit_duration', 'sensitivity_detect', 'sensitivity_hold', 'sw_ver', 'hw_ver', 'detect_delay', 'clear_delay'];
+            e.numeric('presence_glitch', ea.ALL)
+                .withLabel('Presence Glitch Filter')
+                .withDescription('Presence pin level must persist that long before it is reported')
+                .withUnit('ms')
+                .withValueMin(0)
+                .withValueMax(5000)
+                .withCategory('config'),
+            e.numeric('presence_hold', ea.ALL)
+                .withLabel('Presence Minimum Hold')
+                .withDescription('Minimal time between two occupancy changes sent out')
+                .withUnit('ms')
+                .withValueMin(0)
+                .withValueMax(60000)
+                .withCategory('config'),
+            e.numeric('occupancy_hold', ea.ALL)
+                .withLabel('Occupancy Clear Hold')
+                .withDescription('Presence pin and radar frames must both be idle that long before occupancy clears')
+                .withUnit('ms')
+                .withValueMin(0)
+                .withValueMax(60000)
+                .withCategory('config'),
+            e.numeric('run_mode', ea.ALL)
+                .withLabel('Run Mode')
+                .withDescription('0 - presence, 1 - speed/distance (needed for target_* values)')
+                .withValueMin(0)
+                .withValueMax(1)
+                .withCategory('config'),
+            e.numeric('target_distance', ea.STATE_GET)
+                .withLabel('Target Distance')
+                .withDescription('Nearest target, 0 - none')
+                .withUnit('m'),
+            e.numeric('target_speed', ea.STATE_GET)
+                .withLabel('Target Speed')
+                .withDescription('Negative - approaching')
+                .withUnit('m/s'),
+            e.numeric('target_energy', ea.STATE_GET)
+                .withLabel('Target Energy')
+                .withCategory('diagnostic'),
+            e.numeric('target_report_interval', ea.ALL)
+                .withLabel('Target Report Interval')
+                .withDescription('Minimal time between two target updates, 65535 - off (frames are then only read for zones and approach)')
+                .withUnit('ms')
+                .withValueMin(0)
+                .withValueMax(65535)
+                .withCategory('config'),
+            e.numeric('target_distance_change', ea.ALL)
+                .withLabel('Target Distance Change')
+                .withDescription('Minimal distance change to report')
+                .withUnit('m')
+                .withValueMin(0)
+                .withValueMax(25)
+                .withValueStep(0.05)
+                .withCategory('config'),
+            e.numeric('target_speed_change', ea.ALL)
+                .withLabel('Target Speed Change')
+                .withDescription('Minimal speed change to report')
+                .withUnit('m/s')
+                .withValueMin(0)
+                .withValueMax(10)
+                .withValueStep(0.05)
+                .withCategory('config'),
+            e.numeric('approach_lead', ea.ALL)
+                .withLabel('Approach Lead Time')
+                .withDescription('Report occupancy that long before an approaching target is predicted to reach the trigger distance (speed/distance mode), 0 - off')
+                .withUnit('ms')
+                .withValueMin(0)
+                .withValueMax(3000)
+                .withCategory('config'),
+            e.numeric('calibrate', ea.SET)
+                .withLabel('Calibrate Sensitivity')
+                .withDescription('Empty room calibration: seconds to watch each sensitivity level (up to 9 levels, switches to speed/distance mode meanwhile)')
+                .withUnit('s')
+                .withValueMin(5)
+                .withValueMax(120)
+                .withCategory('config'),
+            e.enum('calib_state', ea.STATE_GET, ['idle', 'running', 'done', 'failed'])
+                .withLabel('Calibration State')
+                .withCategory('diagnostic'),
+            e.numeric('calib_frames', ea.STATE_GET).withLabel('Calibration Frames').withCategory('diagnostic'),
+            e.numeric('calib_ghosts', ea.STATE_GET).withLabel('Calibration Ghost Frames').withCategory('diagnostic'),
+            e.numeric('calib_energy_mean', ea.STATE_GET).withLabel('Calibration Noise Energy Mean').withCategory('diagnostic'),
+            e.numeric('calib_energy_std', ea.STATE_GET).withLabel('Calibration Noise Energy Std').withCategory('diagnostic'),
+            e.numeric('calib_energy_max', ea.STATE_GET).withLabel('Calibration Noise Energy Max').withCategory('diagnostic'),
+            e.numeric('recoveries', ea.STATE_GET)
+                .withLabel('Sensor Recoveries')
+                .withDescription('How many times the sensor stopped answering and was brought back')
+                .withCategory('diagnostic'),
+            e.numeric('recovery_time', ea.STATE_GET)
+                .withLabel('Last Recovery Time')
+                .withUnit('ms')
+                .withCategory('diagnostic'),
+            e.numeric('last_error', ea.STATE_GET)
+                .withLabel('Last Error')
+                .withDescription('Last sensor error: site << 16 | operation << 8 | errno, see lib_ret_err.h (sites 0x05xx: no exchange, e.g. sensor lost)')
+                .withCategory('diagnostic'),
+            e.numeric('active_preset', ea.STATE_GET)
+                .withLabel('Active Preset')
+                .withCategory('config'),
+            e.numeric('store_preset', ea.SET)
+                .withLabel('Store Preset')
+                .withDescription("Store current config as preset N")
+                .withValueMin(0)
+                .withValueMax(3)
+                .withCategory('config'),
+            e.numeric('activate_preset', ea.SET)
+                .withLabel('Activate Preset')
+                .withDescription("Apply preset N stored on the device")
+                .withValueMin(0)
+                .withValueMax(3)
+                .withCategory('config'),
+            e.composite('apply_config', 'apply_config', ea.SET)
+                .withDescription("Apply several config parameters in one go")
+                .withFeature(e.numeric('range_min', ea.SET))
+                .withFeature(e.numeric('range_max', ea.SET))
+                .withFeature(e.numeric('range_trig', ea.SET))
+                .withFeature(e.numeric('inhibit_duration', ea.SET))
+                .withFeature(e.numeric('sensitivity_detect', ea.SET))
+                .withFeature(e.numeric('sensitivity_hold', ea.SET))
+                .withFeature(e.numeric('detect_delay', ea.SET))
+                .withFeature(e.numeric('clear_delay', ea.SET))
+                .withCategory("config"),
+        ]);
+        const attributes = ['range_min', 'range_max', 'range_trig', 'inhibit_duration', 'sensitivity_detect', 'sensitivity_hold', 'sw_ver', 'hw_ver', 'detect_delay', 'clear_delay', 'active_preset', 'presence_glitch', 'presence_hold', 'occupancy_hold',
+            'run_mode', 'target_distance', 'target_speed', 'target_energy', 'target_report_interval', 'target_distance_change', 'target_speed_change', 'approach_lead',
+            'calib_frames', 'calib_ghosts', 'calib_energy_mean', 'calib_energy_std', 'calib_energy_max',
+            'recoveries', 'recovery_time', 'last_error'];
+        const calibStates = ['idle', 'running', 'done', 'failed'];
+        //order defines the bits of the applyConfig/configResponse 'mask'
+        const bulkAttributes = ['range_min', 'range_max', 'range_trig', 'inhibit_duration', 'sensitivity_detect', 'sensitivity_hold', 'detect_delay', 'clear_delay'];
         const fromZigbee = [
             {
                 cluster: 'c40001Config',
@@ -81,14 +231,78 @@ const orlangurC4001Extended = {
                     const data = msg.data;
                     for (const attr of attributes) {
                         if (data[attr] !== undefined) 
-                            result[attr] = data[attr];
+                            result[sensorKey(attr, msg, model, meta)] = data[attr];
+                    }
+                    if (data['calib_state'] !== undefined) {
+                        result[sensorKey('calib_state', msg, model, meta)] = calibStates[data['calib_state']];
+                        //the statistics are final once the state is
+                        if (data['calib_state'] >= 2)
+                            msg.endpoint.read('c40001Config', ['sensitivity_detect', 'sensitivity_hold', 'calib_frames', 'calib_ghosts', 'calib_energy_mean', 'calib_energy_std', 'calib_energy_max']).catch((e) => logger.warning(`${e}`, NS));
+                    }
+                    //recovery_time is not reportable, it changes along with recoveries
+                    if (msg.type === 'attributeReport' && data['recoveries'] !== undefined && data['recovery_time'] === undefined)
+                        msg.endpoint.read('c40001Config', ['recovery_time']).catch((e) => logger.warning(`${e}`, NS));
+                    return result;
+                }
+            },
+            {
+                cluster: 'c40001Config',
+                type: ['commandConfigResponse'],
+                convert: (model, msg, publish, options, meta) => {
+                    const result = {};
+                    const data = msg.data;
+                    for (const attr of attributes) {
+                        if (data[attr] !== undefined) 
+                            result[sensorKey(attr, msg, model, meta)] = data[attr];
                     }
+                    result[sensorKey('status1', msg, model, meta)] = data['status'];
                     return result;
                 }
             }
         ];
 
         const toZigbee = [
+            {
+                key: ['apply_config'],
+                convertSet: async (entity, key, value, meta) => {
+                    const payload = {mask: 0};
+                    bulkAttributes.forEach((attr, bit) => {
+                        if (value[attr] !== undefined) {
+                            payload.mask |= (1 << bit);
+                            payload[attr] = value[attr];
+                        } else {
+                            payload[attr] = 0;
+                        }
+                    });
+                    await entity.command("c40001Config", "applyConfig", payload, {
+                        disableDefaultResponse: true,
+                    });
+                },
+            },
+            {
+                key: ['store_preset', 'activate_preset'],
+                convertSet: async (entity, key, value, meta) => {
+                    const cmd = key === 'store_preset' ? 'storePreset' : 'activatePreset';
+                    await entity.command("c40001Config", cmd, {preset: value}, {
+                        disableDefaultResponse: true,
+                    });
+                },
+            },
+            {
+                key: ['calibrate'],
+                convertSet: async (entity, key, value, meta) => {
+                    await entity.command("c40001Config", "calibrate", {step: value}, {
+                        disableDefaultResponse: true,
+                    });
+                    return {state: {calib_state: 'running'}};
+                },
+            },
+            {
+                key: ['calib_state'],
+                convertGet: async (entity, key, meta) => {
+                    await entity.read('c40001Config', [key]);
+                },
+            },
             {
                 key: attributes,
                 convertGet: async (entity, key, meta) => {
@@ -116,12 +330,110 @@ const orlangurC4001Extended = {
             isModernExtend: true,
         };
     },
-    extendedStatus: () => {
+    zones: () => {
+        const zoneNames = Object.keys(zoneEndpoints());
+        const zoneAttributes = ['zone_from', 'zone_to', 'zone_hysteresis'];
+        const exposes = [];
+        for (const z of zoneNames) {
+            exposes.push(
+                e.binary('occupancy', ea.STATE, true, false)
+                    .withEndpoint(z)
+                    .withDescription('A target within the zone distance interval'),
+                e.numeric('zone_from', ea.ALL)
+                    .withEndpoint(z)
+                    .withLabel('Zone From')
+                    .withUnit('m')
+                    .withValueMin(0)
+                    .withValueMax(25)
+                    .withValueStep(0.1)
+                    .withCategory('config'),
+                e.numeric('zone_to', ea.ALL)
+                    .withEndpoint(z)
+                    .withLabel('Zone To')
+                    .withDescription('Not above Zone From - zone disabled')
+                    .withUnit('m')
+                    .withValueMin(0)
+                    .withValueMax(25)
+                    .withValueStep(0.1)
+                    .withCategory('config'),
+                e.numeric('zone_hysteresis', ea.ALL)
+                    .withEndpoint(z)
+                    .withLabel('Zone Hysteresis')
+                    .withUnit('m')
+                    .withValueMin(0)
+                    .withValueMax(2)
+                    .withValueStep(0.05)
+                    .withCategory('config'),
+            );
+        }
+
+        //the main endpoint's occupancy is the occupancy() extend's
+        const fromZigbee = [
+            {
+                cluster: 'msOccupancySensing',
+                type: ['attributeReport', 'readResponse'],
+                convert: (model, msg, publish, options, meta) => {
+                    if (msg.endpoint.ID === kSensorEndpoints.main || msg.data.occupancy === undefined)
+                        return;
+                    return {[utils.postfixWithEndpointName('occupancy', msg, model, meta)]: (msg.data.occupancy & 1) > 0};
+                }
+            },
+            {
+                cluster: 'c4001Zone',
+                type: ['attributeReport', 'readResponse'],
+                convert: (model, msg, publish, options, meta) => {
+                    const result = {};
+                    for (const attr of zoneAttributes) {
+                        if (msg.data[attr] !== undefined)
+                            result[utils.postfixWithEndpointName(attr, msg, model, meta)] = msg.data[attr];
+                    }
+                    return result;
+                }
+            },
+        ];
+
+        const toZigbee = [
+            {
+                key: zoneAttributes,
+                convertGet: async (entity, key, meta) => {
+                    await entity.read('c4001Zone', [key]);
+                },
+                convertSet: async (entity, key, value, meta) => {
+                    await entity.write('c4001Zone', {[key]: value});
+                    return {state: {[key]: value}};
+                },
+            },
+        ];
+
+        return {
+            exposes,
+            fromZigbee,
+            toZigbee,
+            isModernExtend: true,
+        };
+    },
+    //a second C4001 (second 'dfr,c4001' devicetree node) reports on its own endpoint:
+    //its config and status come with c4001Config() and extendedStatus(), its
+    //occupancy is published by the zones() converter (any endpoint but main)
+    secondSensor: () => {
         const exposes = [
+            e.binary('occupancy', ea.STATE, true, false)
+                .withEndpoint('sensor2')
+                .withDescription('Occupancy seen by the second sensor'),
+        ];
+        return {
+            exposes,
+            fromZigbee: [],
+            toZigbee: [],
+            isModernExtend: true,
+        };
+    },
+    extendedStatus: () => {
+        const exposes = forEverySensor(() => [
             e.numeric('status1', ea.STATE_GET).withLabel('Status1').withCategory('diagnostic'),
             e.numeric('status2', ea.STATE_GET).withLabel('Status2').withCategory('diagnostic'),
             e.numeric('status3', ea.STATE_GET).withLabel('Status3').withCategory('diagnostic'),
-        ];
+        ]);
 
         const fromZigbee = [
             {
@@ -130,12 +442,10 @@ const orlangurC4001Extended = {
                 convert: (model, msg, publish, options, meta) => {
                     const result = {};
                     const data = msg.data;
-                    if (data['status1'] !== undefined) 
-                        result['status1'] = data['status1'];
-                    if (data['status2'] !== undefined) 
-                        result['status2'] = data['status2'];
-                    if (data['status3'] !== undefined) 
-                        result['status3'] = data['status3'];
+                    for (const attr of ['status1', 'status2', 'status3']) {
+                        if (data[attr] !== undefined) 
+                            result[sensorKey(attr, msg, model, meta)] = data[attr];
+                    }
                     return result
                 }
             }
@@ -166,6 +476,7 @@ const definition = {
     vendor: 'SFINAE',
     description: 'C4001-NG',
     extend: [
+        deviceEndpoints({endpoints: {...kSensorEndpoints, ...zoneEndpoints()}}),
         deviceAddCustomCluster('customStatus', {
             ID: 0xfc80,
             attributes: {
@@ -191,58 +502,146 @@ const definition = {
 
                 detect_delay:         {ID: 0x0008, type: Zcl.DataType.SINGLE_PREC},
                 clear_delay:          {ID: 0x0009, type: Zcl.DataType.SINGLE_PREC},
+                active_preset:        {ID: 0x000a, type: Zcl.DataType.UINT8},
+                presence_glitch:      {ID: 0x000b, type: Zcl.DataType.UINT16},
+                presence_hold:        {ID: 0x000c, type: Zcl.DataType.UINT16},
+                occupancy_hold:       {ID: 0x000d, type: Zcl.DataType.UINT16},
+                run_mode:             {ID: 0x000e, type: Zcl.DataType.UINT8},
+                target_distance:      {ID: 0x000f, type: Zcl.DataType.SINGLE_PREC},
+                target_speed:         {ID: 0x0010, type: Zcl.DataType.SINGLE_PREC},
+                target_energy:        {ID: 0x0011, type: Zcl.DataType.UINT32},
+                target_report_interval: {ID: 0x0012, type: Zcl.DataType.UINT16},
+                target_distance_change: {ID: 0x0013, type: Zcl.DataType.SINGLE_PREC},
+                target_speed_change:    {ID: 0x0014, type: Zcl.DataType.SINGLE_PREC},
+                approach_lead:        {ID: 0x0015, type: Zcl.DataType.UINT16},
+                calib_state:          {ID: 0x0016, type: Zcl.DataType.UINT8},
+                calib_frames:         {ID: 0x0017, type: Zcl.DataType.UINT16},
+                calib_ghosts:         {ID: 0x0018, type: Zcl.DataType.UINT16},
+                calib_energy_mean:    {ID: 0x0019, type: Zcl.DataType.SINGLE_PREC},
+                calib_energy_std:     {ID: 0x001a, type: Zcl.DataType.SINGLE_PREC},
+                calib_energy_max:     {ID: 0x001b, type: Zcl.DataType.SINGLE_PREC},
+                recoveries:           {ID: 0x001c, type: Zcl.DataType.UINT16},
+                recovery_time:        {ID: 0x001d, type: Zcl.DataType.UINT32},
+                last_error:           {ID: 0x001e, type: Zcl.DataType.UINT32},
             },
             commands: {
                 restartC4001: {
                     ID: 0x01,
                     parameters: [],
                 },
+                applyConfig: {
+                    ID: 0x02,
+                    parameters: [
+                        {name: 'mask', type: Zcl.DataType.UINT8},
+                        {name: 'range_min', type: Zcl.DataType.SINGLE_PREC},
+                        {name: 'range_max', type: Zcl.DataType.SINGLE_PREC},
+                        {name: 'range_trig', type: Zcl.DataType.SINGLE_PREC},
+                        {name: 'inhibit_duration', type: Zcl.DataType.SINGLE_PREC},
+                        {name: 'sensitivity_detect', type: Zcl.DataType.UINT8},
+                        {name: 'sensitivity_hold', type: Zcl.DataType.UINT8},
+                        {name: 'detect_delay', type: Zcl.DataType.SINGLE_PREC},
+                        {name: 'clear_delay', type: Zcl.DataType.SINGLE_PREC},
+                    ],
+                },
+                readConfig: {
+                    ID: 0x03,
+                    parameters: [],
+                },
+                storePreset: {
+                    ID: 0x04,
+                    parameters: [{name: 'preset', type: Zcl.DataType.UINT8}],
+                },
+                activatePreset: {
+                    ID: 0x05,
+                    parameters: [{name: 'preset', type: Zcl.DataType.UINT8}],
+                },
+                calibrate: {
+                    ID: 0x06,
+                    parameters: [{name: 'step', type: Zcl.DataType.UINT8}],
+                },
             },
+            commandsResponse: {
+                configResponse: {
+                    ID: 0x00,
+                    parameters: [
+                        {name: 'status', type: Zcl.DataType.UINT8},
+                        {name: 'mask', type: Zcl.DataType.UINT8},
+                        {name: 'range_min', type: Zcl.DataType.SINGLE_PREC},
+                        {name: 'range_max', type: Zcl.DataType.SINGLE_PREC},
+                        {name: 'range_trig', type: Zcl.DataType.SINGLE_PREC},
+                        {name: 'inhibit_duration', type: Zcl.DataType.SINGLE_PREC},
+                        {name: 'sensitivity_detect', type: Zcl.DataType.UINT8},
+                        {name: 'sensitivity_hold', type: Zcl.DataType.UINT8},
+                        {name: 'detect_delay', type: Zcl.DataType.SINGLE_PREC},
+                        {name: 'clear_delay', type: Zcl.DataType.SINGLE_PREC},
+                        {name: 'sw_ver', type: Zcl.DataType.CHAR_STR},
+                        {name: 'hw_ver', type: Zcl.DataType.CHAR_STR},
+                    ],
+                },
+            }
+        }),
+        deviceAddCustomCluster('c4001Zone', {
+            ID: 0xfc82,
+            attributes: {
+                zone_from:            {ID: 0x0000, type: Zcl.DataType.SINGLE_PREC},
+                zone_to:              {ID: 0x0001, type: Zcl.DataType.SINGLE_PREC},
+                zone_hysteresis:      {ID: 0x0002, type: Zcl.DataType.SINGLE_PREC},
+            },
+            commands: {},
             commandsResponse: {}
         }),
         orlangurC4001Extended.c4001Config(),
+        orlangurC4001Extended.zones(),
+        orlangurC4001Extended.secondSensor(),
         orlangurC4001Extended.extendedStatus(),
         occupancy({/*pirConfig:["otu_delay", "uto_delay"],ultrasonicConfig:["otu_delay", "uto_delay"]*/})
     ],
     configure: async (device, coordinatorEndpoint) => {
-        const endpoint = device.getEndpoint(1);
-        await reporting.bind(endpoint, coordinatorEndpoint, ['customStatus']);
-        await endpoint.read('c40001Config', ['range_min', 'range_max', 'range_trig']);
-        await endpoint.read('c40001Config', ['sw_ver', 'hw_ver']);
-        await endpoint.read('c40001Config', ['inhibit_duration'
-            , 'sensitivity_detect' 
-            , 'sensitivity_hold' 
-            , 'detect_delay' 
-            , 'clear_delay' 
-        ]);
-        await endpoint.read('customStatus', [ 'status1', 'status2', 'status3']);
+        //endpoints of sensors and zones a build doesn't have are missing
+        for (const id of Object.values(kSensorEndpoints)) {
+            const endpoint = device.getEndpoint(id);
+            if (!endpoint)
+                continue;
+            await reporting.bind(endpoint, coordinatorEndpoint, ['customStatus', 'c40001Config']);
+            if (id !== kSensorEndpoints.main) {
+                await reporting.bind(endpoint, coordinatorEndpoint, ['msOccupancySensing']);
+                await reporting.occupancy(endpoint);
+            }
+            //the whole config arrives with a single configResponse
+            await endpoint.command('c40001Config', 'readConfig', {}, {disableDefaultResponse: true});
+            await endpoint.read('customStatus', [ 'status1', 'status2', 'status3']);
 
-        await endpoint.configureReporting('customStatus', [
-            {
-                attribute: 'status1',
+            await endpoint.configureReporting('customStatus', ['status1', 'status2', 'status3'].map((attribute) => ({
+                attribute,
                 minimumReportInterval: 30,
                 maximumReportInterval: constants.repInterval.HOUR,
                 reportableChange: 1,
-            },
-        ]);
+            })));
 
-        await endpoint.configureReporting('customStatus', [
-            {
-                attribute: 'status2',
-                minimumReportInterval: 30,
+            await endpoint.configureReporting('c40001Config', ['calib_state', 'recoveries', 'last_error'].map((attribute) => ({
+                attribute,
+                minimumReportInterval: 0,
                 maximumReportInterval: constants.repInterval.HOUR,
                 reportableChange: 1,
-            },
-        ]);
+            })));
 
-        await endpoint.configureReporting('customStatus', [
-            {
-                attribute: 'status3',
-                minimumReportInterval: 30,
+            //the device already limits target updates (target_report_interval, target_*_change)
+            await endpoint.configureReporting('c40001Config', ['target_distance', 'target_speed', 'target_energy'].map((attribute) => ({
+                attribute,
+                minimumReportInterval: 0,
                 maximumReportInterval: constants.repInterval.HOUR,
-                reportableChange: 1,
-            },
-        ]);
+                reportableChange: 0,
+            })));
+        }
+
+        for (const id of Object.values(zoneEndpoints())) {
+            const zone = device.getEndpoint(id);
+            if (!zone)
+                continue;
+            await reporting.bind(zone, coordinatorEndpoint, ['msOccupancySensing', 'c4001Zone']);
+            await reporting.occupancy(zone);
+            await zone.read('c4001Zone', ['zone_from', 'zone_to', 'zone_hysteresis']);
+        }
     },
 
 };